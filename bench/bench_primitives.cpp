@@ -0,0 +1,429 @@
+// Microbenchmarks for the conversion and buffering primitives.
+//
+// Runs on synthetic frames, so it needs no capture hardware and builds on any
+// Linux or macOS machine. Every benchmark runs in batches until --min-time
+// has passed and reports the median batch, as ns per frame, Gpix/s and GB/s.
+// GB/s counts the bytes the primitive reads plus the bytes it writes; for the
+// hand-off benchmarks (move, triple buffer) it is the frame bytes handed over
+// per second, which no memory traffic corresponds to.
+//
+//   bench_primitives [--min-time SECONDS] [--filter TEXT] [--json PATH]
+
+#include "bmcapture_convert.h"
+#include "bmcapture_frame.h"
+#include "bmcapture_frame_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Resolution {
+    const char* name;
+    int width;
+    int height;
+};
+
+const Resolution kResolutions[] = {
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"2160p", 3840, 2160},
+};
+
+struct Result {
+    std::string name;
+    std::string resolution;
+    int width = 0;
+    int height = 0;
+    uint64_t iterations = 0;
+    double ns_per_frame = 0.0;
+    double min_ns_per_frame = 0.0;
+    uint64_t pixels = 0;            // Per frame, 0 when not meaningful
+    uint64_t bytes = 0;             // Read plus written per frame
+    uint64_t reader_swaps = 0;      // Triple buffer only
+};
+
+double g_min_time = 0.5;
+const char* g_filter = nullptr;
+volatile uintptr_t g_sink = 0;      // Written by consume() so results stay live
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool selected(const std::string& name) {
+    return g_filter == nullptr || name.find(g_filter) != std::string::npos;
+}
+
+// Keep the compiler from discarding a result
+void consume(const void* pointer) {
+    g_sink = (uintptr_t)pointer;
+}
+
+// Run `body(count)` in batches until the minimum time has passed
+void measure(Result* result, const std::function<void(uint64_t)>& body) {
+    body(1);    // Warm up caches, page in buffers and build lazy state
+
+    // Size batches to roughly 10 ms so short primitives are not clock bound
+    uint64_t batch = 1;
+    for (;;) {
+        int64_t start = now_ns();
+        body(batch);
+        int64_t elapsed = now_ns() - start;
+        if (elapsed >= 10000000 || batch >= (1u << 30)) {
+            break;
+        }
+        batch *= elapsed < 1000000 ? 10 : 2;
+    }
+
+    std::vector<double> samples;
+    int64_t deadline = now_ns() + (int64_t)(g_min_time * 1e9);
+    do {
+        int64_t start = now_ns();
+        body(batch);
+        samples.push_back((double)(now_ns() - start) / batch);
+        result->iterations += batch;
+    } while (now_ns() < deadline || samples.size() < 3);
+
+    std::sort(samples.begin(), samples.end());
+    result->ns_per_frame = samples[samples.size() / 2];
+    result->min_ns_per_frame = samples[0];
+}
+
+// Deterministic 8-bit 4:2:2 test frame with varied chroma
+std::vector<uint8_t> synthetic_frame(int width, int height) {
+    std::vector<uint8_t> frame((size_t)width * height * 2);
+    uint32_t state = 0x9e3779b9u;
+    for (size_t i = 0; i < frame.size(); i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        frame[i] = (uint8_t)state;
+    }
+    return frame;
+}
+
+Result make_result(const char* name, const Resolution* resolution) {
+    Result result;
+    result.name = name;
+    if (resolution != nullptr) {
+        result.resolution = resolution->name;
+        result.width = resolution->width;
+        result.height = resolution->height;
+        result.pixels = (uint64_t)resolution->width * resolution->height;
+    }
+    return result;
+}
+
+void bench_table_init(std::vector<Result>* results) {
+    if (!selected("table_init")) {
+        return;
+    }
+    Result result = make_result("table_init", nullptr);
+    result.bytes = sizeof(YUVConversionTables);
+    std::unique_ptr<YUVConversionTables> tables(new YUVConversionTables());
+    measure(&result, [&](uint64_t count) {
+        for (uint64_t i = 0; i < count; i++) {
+            tables->initialized = false;
+            initialize_yuv_tables(tables.get());
+            consume(tables.get());
+        }
+    });
+    results->push_back(result);
+}
+
+void bench_yuv_to_rgb(const Resolution& resolution, YUVConversionTables* tables, std::vector<Result>* results) {
+    Result result = make_result("yuv_to_rgb", &resolution);
+    if (!selected(result.name + "/" + result.resolution)) {
+        return;
+    }
+    result.bytes = result.pixels * 2 + result.pixels * 3;
+    std::vector<uint8_t> yuv = synthetic_frame(resolution.width, resolution.height);
+    std::vector<uint8_t> rgb(result.pixels * 3);
+    measure(&result, [&](uint64_t count) {
+        for (uint64_t i = 0; i < count; i++) {
+            yuv_to_rgb(yuv.data(), rgb.data(), (unsigned int)result.pixels, tables);
+            consume(rgb.data());
+        }
+    });
+    results->push_back(result);
+}
+
+void bench_yuv_to_gray(const Resolution& resolution, std::vector<Result>* results) {
+    Result result = make_result("yuv_to_gray", &resolution);
+    if (!selected(result.name + "/" + result.resolution)) {
+        return;
+    }
+    result.bytes = result.pixels * 2 + result.pixels;
+    std::vector<uint8_t> yuv = synthetic_frame(resolution.width, resolution.height);
+    std::vector<uint8_t> gray(result.pixels);
+    measure(&result, [&](uint64_t count) {
+        for (uint64_t i = 0; i < count; i++) {
+            yuv_to_gray(yuv.data(), gray.data(), (unsigned int)result.pixels);
+            consume(gray.data());
+        }
+    });
+    results->push_back(result);
+}
+
+// What the capture callback does per frame: take a pooled buffer and copy
+// the driver's frame into it
+void bench_frame_copy(const Resolution& resolution, std::vector<Result>* results) {
+    Result result = make_result("frame_copy", &resolution);
+    if (!selected(result.name + "/" + result.resolution)) {
+        return;
+    }
+    size_t frame_size = result.pixels * 2;
+    result.bytes = frame_size * 2;
+    std::vector<uint8_t> source = synthetic_frame(resolution.width, resolution.height);
+    FramePool pool;
+    pool.reserve(2, frame_size);
+    CapturedFrame frame;
+    measure(&result, [&](uint64_t count) {
+        for (uint64_t i = 0; i < count; i++) {
+            frame.yuv_data = pool.acquire(frame_size);
+            memcpy(frame.yuv_data.data(), source.data(), frame_size);
+            consume(frame.yuv_data.data());
+        }
+    });
+    results->push_back(result);
+}
+
+// Moving a buffered frame, as the triple buffer does on every swap
+void bench_frame_move(const Resolution& resolution, std::vector<Result>* results) {
+    Result result = make_result("frame_move", &resolution);
+    if (!selected(result.name + "/" + result.resolution)) {
+        return;
+    }
+    size_t frame_size = result.pixels * 2;
+    result.bytes = frame_size;
+    FramePool pool;
+    CapturedFrame first;
+    CapturedFrame second;
+    first.yuv_data = pool.acquire(frame_size);
+    first.rgb_data.resize(result.pixels * 3);
+    first.gray_data.resize(result.pixels);
+    first.width = resolution.width;
+    first.height = resolution.height;
+    CapturedFrame* from = &first;
+    CapturedFrame* to = &second;
+    measure(&result, [&](uint64_t count) {
+        for (uint64_t i = 0; i < count; i++) {
+            *to = std::move(*from);
+            std::swap(from, to);
+            consume(from->yuv_data.data());
+        }
+    });
+    results->push_back(result);
+}
+
+// A writer swapping frames in as fast as it can while a reader takes them
+// out and locks each one, as the callback and get_frame do
+void bench_triple_buffer(const Resolution& resolution, std::vector<Result>* results) {
+    Result result = make_result("triple_buffer", &resolution);
+    if (!selected(result.name + "/" + result.resolution)) {
+        return;
+    }
+    size_t frame_size = result.pixels * 2;
+    result.bytes = frame_size;
+    FramePool pool;
+    pool.reserve(5, frame_size);
+    TripleBuffer<CapturedFrame> buffer;
+
+    std::atomic<bool> running(true);
+    std::atomic<uint64_t> reader_swaps(0);
+    std::thread reader([&] {
+        uint64_t swaps = 0;
+        while (running.load(std::memory_order_relaxed)) {
+            buffer.swapFront();
+            CapturedFrame& front = buffer.getFront();
+            if (front.mutex != nullptr) {
+                std::lock_guard<std::timed_mutex> lock(*front.mutex);
+                consume(front.yuv_data.data());
+            }
+            swaps++;
+        }
+        reader_swaps.store(swaps);
+    });
+
+    CapturedFrame frame;
+    measure(&result, [&](uint64_t count) {
+        for (uint64_t i = 0; i < count; i++) {
+            frame.yuv_data = pool.acquire(frame_size);
+            buffer.swapBack(frame);
+            frame = CapturedFrame();
+        }
+    });
+
+    running.store(false);
+    reader.join();
+    result.reader_swaps = reader_swaps.load();
+    results->push_back(result);
+}
+
+double gpix_per_second(const Result& result) {
+    return result.pixels > 0 ? result.pixels / result.ns_per_frame : 0.0;
+}
+
+double gb_per_second(const Result& result) {
+    return result.bytes / result.ns_per_frame;
+}
+
+void print_results(const std::vector<Result>& results) {
+    printf("%-16s %-6s %12s %12s %10s %10s\n", "benchmark", "size", "ns/frame", "min ns", "Gpix/s", "GB/s");
+    for (const Result& result : results) {
+        char gpix[32] = "-";
+        if (result.pixels > 0) {
+            snprintf(gpix, sizeof(gpix), "%.3f", gpix_per_second(result));
+        }
+        printf("%-16s %-6s %12.0f %12.0f %10s %10.2f", result.name.c_str(),
+               result.resolution.empty() ? "-" : result.resolution.c_str(),
+               result.ns_per_frame, result.min_ns_per_frame, gpix, gb_per_second(result));
+        if (result.reader_swaps > 0) {
+            printf("  (%llu reader swaps)", (unsigned long long)result.reader_swaps);
+        }
+        printf("\n");
+    }
+}
+
+std::string cpu_model() {
+    std::string model = "unknown";
+    FILE* file = fopen("/proc/cpuinfo", "r");
+    if (file == nullptr) {
+        return model;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (strncmp(line, "model name", 10) == 0) {
+            const char* value = strchr(line, ':');
+            if (value != nullptr) {
+                model = value + 1 + strspn(value + 1, " \t");
+                model.erase(model.find_last_not_of("\r\n") + 1);
+            }
+            break;
+        }
+    }
+    fclose(file);
+    return model;
+}
+
+// Escape the characters JSON does not allow in strings
+std::string json_string(const std::string& text) {
+    std::string escaped = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if ((unsigned char)c < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped + "\"";
+}
+
+bool write_json(const char* path, const std::vector<Result>& results) {
+    FILE* file = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Error: Failed to create %s\n", path);
+        return false;
+    }
+
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+
+    fprintf(file, "{\n  \"schema\": 1,\n");
+    fprintf(file, "  \"timestamp\": %lld,\n", (long long)time(nullptr));
+    fprintf(file, "  \"host\": %s,\n", json_string(host).c_str());
+    fprintf(file, "  \"cpu\": %s,\n", json_string(cpu_model()).c_str());
+    fprintf(file, "  \"cpus\": %u,\n", std::thread::hardware_concurrency());
+#if defined(__VERSION__)
+    fprintf(file, "  \"compiler\": %s,\n", json_string(__VERSION__).c_str());
+#endif
+    fprintf(file, "  \"min_time_s\": %.3f,\n", g_min_time);
+    fprintf(file, "  \"results\": [");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        fprintf(file, "%s\n    {\"name\": %s, \"resolution\": %s, \"width\": %d, \"height\": %d, "
+                "\"iterations\": %llu, \"ns_per_frame\": %.1f, \"min_ns_per_frame\": %.1f, "
+                "\"bytes_per_frame\": %llu, \"gb_per_s\": %.4f",
+                i == 0 ? "" : ",", json_string(result.name).c_str(),
+                result.resolution.empty() ? "null" : json_string(result.resolution).c_str(),
+                result.width, result.height, (unsigned long long)result.iterations,
+                result.ns_per_frame, result.min_ns_per_frame,
+                (unsigned long long)result.bytes, gb_per_second(result));
+        if (result.pixels > 0) {
+            fprintf(file, ", \"gpix_per_s\": %.4f", gpix_per_second(result));
+        } else {
+            fprintf(file, ", \"gpix_per_s\": null");
+        }
+        if (result.reader_swaps > 0) {
+            fprintf(file, ", \"reader_swaps\": %llu", (unsigned long long)result.reader_swaps);
+        }
+        fprintf(file, "}");
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    if (file != stdout) {
+        fclose(file);
+    }
+    return true;
+}
+
+void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [--min-time SECONDS] [--filter TEXT] [--json PATH|-]\n", program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* json_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            g_min_time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            g_filter = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Result> results;
+    bench_table_init(&results);
+
+    std::unique_ptr<YUVConversionTables> tables(new YUVConversionTables());
+    initialize_yuv_tables(tables.get());
+    for (const Resolution& resolution : kResolutions) {
+        bench_yuv_to_rgb(resolution, tables.get(), &results);
+        bench_yuv_to_gray(resolution, &results);
+        bench_frame_copy(resolution, &results);
+        bench_frame_move(resolution, &results);
+        bench_triple_buffer(resolution, &results);
+    }
+
+    // Keep stdout parseable when the JSON goes there
+    if (json_path == nullptr || strcmp(json_path, "-") != 0) {
+        print_results(results);
+    }
+    if (json_path != nullptr && !write_json(json_path, results)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,429 @@
+// Accuracy and performance gate for the conversion kernels.
+//
+// Accuracy: every kernel in kRGBKernels and kGrayKernels that the CPU
+// supports must match the reference conversion within kRGBTolerance or
+// kGrayTolerance. Each kernel converts an exhaustive sweep of every (u, v, y)
+// combination, then random frames whose widths are not a multiple of any
+// vector length, from misaligned buffers. Writes outside the output, caught
+// by guard bytes, fail the check.
+//
+// Performance: each kernel's fastest time per frame is compared with the
+// baseline recorded for this host. Noise only ever adds time, so the fastest
+// of many repetitions is the most repeatable figure on a busy machine. A
+// kernel more than --max-regression percent slower, even after measuring
+// twice more, fails the gate. --update-baseline records the current figures
+// instead; baselines of other hosts in the file are kept.
+//
+//   check_kernels [--accuracy-only | --performance-only] [--baseline PATH]
+//                 [--update-baseline] [--max-regression PERCENT] [--min-time SECONDS]
+//
+// Exits with 0 if every check passed, 1 if one failed and 2 on bad usage or
+// a missing baseline.
+
+#include "bmcapture_convert.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const int kGuardBytes = 64;
+const uint8_t kGuardValue = 0xA5;
+
+// Pixel widths that leave a remainder for every vector length from 2 to 64 pixels
+const int kOddWidths[] = {2, 6, 14, 30, 62, 126, 254, 718, 1282, 1922, 3842};
+const int kOddHeight = 7;
+
+struct Resolution {
+    const char* name;
+    int width;
+    int height;
+};
+
+const Resolution kResolutions[] = {
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"2160p", 3840, 2160},
+};
+
+// Output buffer with guard bytes on both sides, starting `offset` bytes past alignment
+class GuardedBuffer {
+public:
+    GuardedBuffer(size_t size, size_t offset)
+        : storage(size + 2 * kGuardBytes + offset, kGuardValue), size(size), start(kGuardBytes + offset) {
+    }
+
+    uint8_t* data() {
+        return storage.data() + start;
+    }
+
+    bool guardsIntact() const {
+        for (size_t i = 0; i < storage.size(); i++) {
+            if ((i < start || i >= start + size) && storage[i] != kGuardValue) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    std::vector<uint8_t> storage;
+    size_t size;
+    size_t start;
+};
+
+struct Mismatch {
+    int max_difference = 0;
+    uint64_t count = 0;         // Values beyond the tolerance
+    size_t first = 0;           // Index of the first of them
+};
+
+Mismatch compare(const uint8_t* expected, const uint8_t* actual, size_t size, int tolerance) {
+    Mismatch mismatch;
+    for (size_t i = 0; i < size; i++) {
+        int difference = abs((int)expected[i] - (int)actual[i]);
+        mismatch.max_difference = std::max(mismatch.max_difference, difference);
+        if (difference > tolerance) {
+            if (mismatch.count == 0) {
+                mismatch.first = i;
+            }
+            mismatch.count++;
+        }
+    }
+    return mismatch;
+}
+
+// Every (u, v, y) combination, with y0 = y and y1 = 255 - y so both pixel positions see every value
+std::vector<uint8_t> sweep_frame() {
+    std::vector<uint8_t> yuv;
+    yuv.reserve(256 * 256 * 256 * 4);
+    for (int u = 0; u < 256; u++) {
+        for (int v = 0; v < 256; v++) {
+            for (int y = 0; y < 256; y++) {
+                yuv.push_back((uint8_t)u);
+                yuv.push_back((uint8_t)y);
+                yuv.push_back((uint8_t)v);
+                yuv.push_back((uint8_t)(255 - y));
+            }
+        }
+    }
+    return yuv;
+}
+
+// Convert `yuv` with `convert` into a guarded buffer and compare with the reference output
+bool check_frame(const char* label, const std::vector<uint8_t>& yuv, unsigned int pixel_count,
+                 int bytes_per_pixel, size_t offset, int tolerance, const std::vector<uint8_t>& expected,
+                 const std::function<void(const uint8_t*, uint8_t*, unsigned int)>& convert) {
+    // Misalign the input the same way as the output
+    std::vector<uint8_t> input(yuv.size() + offset);
+    memcpy(input.data() + offset, yuv.data(), yuv.size());
+
+    size_t size = (size_t)pixel_count * bytes_per_pixel;
+    GuardedBuffer output(size, offset);
+    convert(input.data() + offset, output.data(), pixel_count);
+
+    Mismatch mismatch = compare(expected.data(), output.data(), size, tolerance);
+    bool guards = output.guardsIntact();
+    if (mismatch.count == 0 && guards) {
+        return true;
+    }
+    if (!guards) {
+        printf("FAIL  %s: wrote outside the output buffer\n", label);
+    }
+    if (mismatch.count > 0) {
+        size_t pixel = mismatch.first / bytes_per_pixel;
+        const uint8_t* pair = yuv.data() + (pixel / 2) * 4;
+        printf("FAIL  %s: %llu values beyond tolerance %d (max difference %d); first at pixel %zu "
+               "(u=%d y=%d v=%d): expected %d, got %d\n",
+               label, (unsigned long long)mismatch.count, tolerance, mismatch.max_difference, pixel,
+               pair[0], pair[(pixel % 2) * 2 + 1], pair[2], expected[mismatch.first],
+               output.data()[mismatch.first]);
+    }
+    return false;
+}
+
+bool check_accuracy(YUVConversionTables* tables) {
+    bool passed = true;
+    std::mt19937 random(12345);
+
+    std::vector<uint8_t> sweep = sweep_frame();
+    unsigned int sweep_pixels = (unsigned int)(sweep.size() / 2);
+    std::vector<uint8_t> sweep_rgb(sweep_pixels * 3);
+    std::vector<uint8_t> sweep_gray(sweep_pixels);
+    yuv_to_rgb_reference(sweep.data(), sweep_rgb.data(), sweep_pixels);
+    yuv_to_gray_reference(sweep.data(), sweep_gray.data(), sweep_pixels);
+
+    for (int k = 0; k < kRGBKernelCount; k++) {
+        const RGBKernel& kernel = kRGBKernels[k];
+        if (!kernel.supported()) {
+            printf("SKIP  yuv_to_rgb/%s: not supported by this CPU\n", kernel.name);
+            continue;
+        }
+        auto convert = [&](const uint8_t* yuv, uint8_t* rgb, unsigned int count) {
+            kernel.convert(yuv, rgb, count, tables);
+        };
+        std::string name = std::string("yuv_to_rgb/") + kernel.name;
+        bool ok = check_frame((name + " sweep").c_str(), sweep, sweep_pixels, 3, 0, kRGBTolerance, sweep_rgb, convert);
+        for (int width : kOddWidths) {
+            for (size_t offset : {0, 1, 3}) {
+                unsigned int pixels = width * kOddHeight;
+                std::vector<uint8_t> yuv(pixels * 2);
+                for (uint8_t& value : yuv) {
+                    value = (uint8_t)random();
+                }
+                std::vector<uint8_t> expected(pixels * 3);
+                yuv_to_rgb_reference(yuv.data(), expected.data(), pixels);
+                std::string label = name + " " + std::to_string(width) + "x" + std::to_string(kOddHeight) +
+                                    " offset " + std::to_string(offset);
+                ok = check_frame(label.c_str(), yuv, pixels, 3, offset, kRGBTolerance, expected, convert) && ok;
+            }
+        }
+        printf("%s  %s\n", ok ? "PASS" : "FAIL", name.c_str());
+        passed = passed && ok;
+    }
+
+    for (int k = 0; k < kGrayKernelCount; k++) {
+        const GrayKernel& kernel = kGrayKernels[k];
+        if (!kernel.supported()) {
+            printf("SKIP  yuv_to_gray/%s: not supported by this CPU\n", kernel.name);
+            continue;
+        }
+        std::string name = std::string("yuv_to_gray/") + kernel.name;
+        bool ok = check_frame((name + " sweep").c_str(), sweep, sweep_pixels, 1, 0, kGrayTolerance, sweep_gray,
+                              kernel.convert);
+        for (int width : kOddWidths) {
+            for (size_t offset : {0, 1, 3}) {
+                unsigned int pixels = width * kOddHeight;
+                std::vector<uint8_t> yuv(pixels * 2);
+                for (uint8_t& value : yuv) {
+                    value = (uint8_t)random();
+                }
+                std::vector<uint8_t> expected(pixels);
+                yuv_to_gray_reference(yuv.data(), expected.data(), pixels);
+                std::string label = name + " " + std::to_string(width) + "x" + std::to_string(kOddHeight) +
+                                    " offset " + std::to_string(offset);
+                ok = check_frame(label.c_str(), yuv, pixels, 1, offset, kGrayTolerance, expected, kernel.convert) && ok;
+            }
+        }
+        printf("%s  %s\n", ok ? "PASS" : "FAIL", name.c_str());
+        passed = passed && ok;
+    }
+    return passed;
+}
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Fastest time of one call, repeated until min_time has passed
+double fastest_ns(const std::function<void()>& body, double min_time) {
+    body();     // Warm up caches and page in the buffers
+    int64_t fastest = INT64_MAX;
+    int64_t total = 0;
+    for (int runs = 0; total < (int64_t)(min_time * 1e9) || runs < 5; runs++) {
+        int64_t start = now_ns();
+        body();
+        int64_t elapsed = now_ns() - start;
+        fastest = std::min(fastest, elapsed);
+        total += elapsed;
+    }
+    return (double)fastest;
+}
+
+// "yuv_to_rgb/table/1080p" -> fastest ns per frame
+std::map<std::string, double> measure_kernels(YUVConversionTables* tables, double min_time) {
+    std::map<std::string, double> results;
+    for (const Resolution& resolution : kResolutions) {
+        unsigned int pixels = resolution.width * resolution.height;
+        // Smooth gradients, like video: random pixels would mostly time cache misses in the tables
+        std::vector<uint8_t> yuv(pixels * 2);
+        for (int row = 0; row < resolution.height; row++) {
+            uint8_t* line = yuv.data() + (size_t)row * resolution.width * 2;
+            for (int x = 0; x < resolution.width; x += 2) {
+                line[x * 2 + 0] = (uint8_t)(64 + (x * 128) / resolution.width);
+                line[x * 2 + 1] = (uint8_t)(16 + (x + row) * 219 / (resolution.width + resolution.height));
+                line[x * 2 + 2] = (uint8_t)(64 + (row * 128) / resolution.height);
+                line[x * 2 + 3] = line[x * 2 + 1];
+            }
+        }
+        std::vector<uint8_t> output(pixels * 3);
+
+        for (int k = 0; k < kRGBKernelCount; k++) {
+            const RGBKernel& kernel = kRGBKernels[k];
+            if (kernel.supported()) {
+                results[std::string("yuv_to_rgb/") + kernel.name + "/" + resolution.name] = fastest_ns(
+                    [&] { kernel.convert(yuv.data(), output.data(), pixels, tables); }, min_time);
+            }
+        }
+        for (int k = 0; k < kGrayKernelCount; k++) {
+            const GrayKernel& kernel = kGrayKernels[k];
+            if (kernel.supported()) {
+                results[std::string("yuv_to_gray/") + kernel.name + "/" + resolution.name] = fastest_ns(
+                    [&] { kernel.convert(yuv.data(), output.data(), pixels); }, min_time);
+            }
+        }
+    }
+    return results;
+}
+
+const int kRetries = 2;
+
+bool over_limit(const std::map<std::string, double>& results, const std::map<std::string, double>& baseline,
+                double max_regression) {
+    for (const auto& result : results) {
+        auto found = baseline.find(result.first);
+        if (found != baseline.end() && (result.second / found->second - 1.0) * 100.0 > max_regression) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string host_name() {
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    return host;
+}
+
+// Baseline file: one "host<TAB>benchmark<TAB>ns_per_frame" line per result
+typedef std::map<std::string, std::map<std::string, double>> Baselines;
+
+Baselines read_baselines(const char* path) {
+    Baselines baselines;
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return baselines;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (line[0] == '#') {
+            continue;
+        }
+        char host[256], benchmark[256];
+        double ns = 0.0;
+        if (sscanf(line, "%255[^\t]\t%255[^\t]\t%lf", host, benchmark, &ns) == 3) {
+            baselines[host][benchmark] = ns;
+        }
+    }
+    fclose(file);
+    return baselines;
+}
+
+bool write_baselines(const char* path, const Baselines& baselines) {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Error: Failed to create %s\n", path);
+        return false;
+    }
+    fprintf(file, "# Conversion kernel baselines from bench/check_kernels --update-baseline\n");
+    fprintf(file, "# host\tbenchmark\tfastest ns per frame\n");
+    for (const auto& host : baselines) {
+        for (const auto& result : host.second) {
+            fprintf(file, "%s\t%s\t%.0f\n", host.first.c_str(), result.first.c_str(), result.second);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [--accuracy-only | --performance-only] [--baseline PATH] [--update-baseline]\n"
+                    "          [--max-regression PERCENT] [--min-time SECONDS]\n", program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool accuracy = true;
+    bool performance = true;
+    bool update = false;
+    const char* baseline_path = "kernel_baseline.tsv";
+    double max_regression = 10.0;
+    double min_time = 0.5;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--accuracy-only") == 0) {
+            performance = false;
+        } else if (strcmp(argv[i], "--performance-only") == 0) {
+            accuracy = false;
+        } else if (strcmp(argv[i], "--update-baseline") == 0) {
+            update = true;
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--max-regression") == 0 && i + 1 < argc) {
+            max_regression = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!accuracy && !performance) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::unique_ptr<YUVConversionTables> tables(new YUVConversionTables());
+    initialize_yuv_tables(tables.get());
+    bool passed = true;
+
+    if (accuracy) {
+        printf("Accuracy (tolerance: rgb %d, gray %d)\n", kRGBTolerance, kGrayTolerance);
+        passed = check_accuracy(tables.get());
+    }
+
+    if (performance) {
+        std::map<std::string, double> results = measure_kernels(tables.get(), min_time);
+        std::string host = host_name();
+        Baselines baselines = read_baselines(baseline_path);
+
+        if (update) {
+            baselines[host] = results;
+            if (!write_baselines(baseline_path, baselines)) {
+                return 2;
+            }
+            printf("\nRecorded %zu baselines for %s in %s\n", results.size(), host.c_str(), baseline_path);
+        } else {
+            auto found = baselines.find(host);
+            if (found == baselines.end()) {
+                fprintf(stderr, "Error: %s has no baseline for %s; record one with --update-baseline\n",
+                        baseline_path, host.c_str());
+                return 2;
+            }
+            // Noise can still slow a whole run, so measure again before failing a kernel
+            for (int retry = 0; retry < kRetries && over_limit(results, found->second, max_regression); retry++) {
+                for (const auto& result : measure_kernels(tables.get(), min_time)) {
+                    results[result.first] = std::min(results[result.first], result.second);
+                }
+            }
+
+            printf("\nPerformance against %s (limit +%.1f%%)\n", baseline_path, max_regression);
+            for (const auto& result : results) {
+                auto baseline = found->second.find(result.first);
+                if (baseline == found->second.end()) {
+                    printf("NEW   %-28s %12.0f ns (no baseline)\n", result.first.c_str(), result.second);
+                    continue;
+                }
+                double change = (result.second / baseline->second - 1.0) * 100.0;
+                bool ok = change <= max_regression;
+                printf("%s  %-28s %12.0f ns %12.0f ns %+7.1f%%\n", ok ? "PASS" : "FAIL", result.first.c_str(),
+                       result.second, baseline->second, change);
+                passed = passed && ok;
+            }
+        }
+    }
+
+    printf("\n%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
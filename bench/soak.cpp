@@ -0,0 +1,806 @@
+// Multi-channel soak and stress test through the public C API.
+//
+// Opens N channels, on mock devices by default or on the installed cards with
+// --hardware, and pulls every frame from each on its own consumer thread, as
+// an application would. Optional stress threads compete for the CPU and churn
+// a block of memory while it runs. After a warm-up the channel statistics are
+// reset, and from then on the harness reports delivered fps, lost frames,
+// capture latency percentiles and resident memory every interval. At the end
+// it checks each channel against the SLOs and exits with 0 if all of them
+// pass, 1 if any fails and 2 if the run could not start.
+//
+// A frame counts as lost if the source skipped it (a stream time gap), the
+// callback could not buffer it, or a newer frame replaced it before the
+// consumer got to it. RSS growth is measured from the end of the warm-up, so
+// pools and tables allocated at start-up do not count.
+//
+//   soak [--channels N] [--mode WxH@FPS]... [--duration 4h] [--json PATH|-]
+//        see --help for the stress, impairment and SLO options
+
+#include "bmcapture.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+
+namespace {
+
+struct Mode {
+    int width;
+    int height;
+    double framerate;
+};
+
+struct Config {
+    int channels = 2;
+    std::vector<Mode> modes;
+    double duration = 60.0;         // Seconds, after the warm-up
+    double warmup = 10.0;
+    double interval = 10.0;
+    BMPixelFormat format = BM_FORMAT_RGB;
+    BMCaptureMode capture_mode = BM_LOW_LATENCY;
+    bool hardware = false;
+    int ports_per_device = 2;       // Mock devices only
+
+    // Stress
+    int cpu_threads = 0;
+    double cpu_duty = 1.0;          // Fraction of each 10 ms a stress thread spins
+    size_t memory_pressure_mb = 0;
+
+    // Mock impairments
+    double jitter_ms = 0.0;
+    double drop_rate = 0.0;
+    double signal_loss_rate = 0.0;
+    unsigned int seed = 1;
+
+    // SLOs, a negative limit disables the check
+    double min_fps_ratio = 0.99;
+    double max_loss_rate = 0.001;
+    double max_p99_ms = 50.0;
+    double max_p999_ms = -1.0;
+    double max_rss_growth_mb = 64.0;
+
+    const char* json_path = nullptr;
+};
+
+struct Channel {
+    int device_index = 0;
+    int port_index = 0;
+    Mode mode;
+    BMCaptureChannel* handle = nullptr;
+    std::thread consumer;
+    std::atomic<uint64_t> failed_reads;
+    BMChannelStats stats;
+    uint64_t last_delivered = 0;
+    uint64_t last_lost = 0;
+    uint64_t last_seen = 0;
+
+    // Frames delivered since the warm-up and the capture times of the first
+    // and last of them, written by the consumer
+    std::mutex span_mutex;
+    uint64_t span_frames = 0;
+    int64_t span_first_ns = 0;
+    int64_t span_last_ns = 0;
+
+    Channel() : failed_reads(0) {
+        memset(&stats, 0, sizeof(stats));
+    }
+};
+
+// One line of the periodic report
+struct Sample {
+    double seconds;                 // Since the end of the warm-up
+    double fps;                     // Delivered over the interval, all channels
+    double loss_rate;               // Over the interval, all channels
+    double worst_p99_ms;            // Cumulative, worst channel
+    double rss_mb;
+    double library_mb;              // Memory the library accounts for
+};
+
+struct SloResult {
+    std::string name;
+    std::string channel;            // Empty for process-wide checks
+    double value;
+    double limit;
+    bool passed;
+};
+
+volatile sig_atomic_t g_interrupted = 0;
+std::atomic<bool> g_stop(false);
+std::atomic<uint64_t> g_log_warnings(0);
+std::atomic<uint64_t> g_log_errors(0);
+
+void on_signal(int) {
+    g_interrupted = 1;
+}
+
+double now_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t resident_bytes() {
+#if defined(__APPLE__)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size;
+#else
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == nullptr) {
+        return 0;
+    }
+    unsigned long long size = 0, resident = 0;
+    int fields = fscanf(file, "%llu %llu", &size, &resident);
+    fclose(file);
+    return fields == 2 ? resident * (uint64_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+void on_log(BMLogLevel level, const char* message, void*) {
+    if (level >= BM_LOG_ERROR) {
+        g_log_errors.fetch_add(1, std::memory_order_relaxed);
+    } else if (level == BM_LOG_WARNING) {
+        g_log_warnings.fetch_add(1, std::memory_order_relaxed);
+    }
+    fprintf(stderr, "bmcapture: %s\n", message);
+}
+
+uint64_t lost_frames(const BMChannelStats& stats) {
+    return stats.frames_missed + stats.frames_dropped + stats.frames_overwritten;
+}
+
+// Frames the source sent, whether or not they arrived
+uint64_t seen_frames(const BMChannelStats& stats) {
+    return stats.frames_arrived + stats.frames_missed;
+}
+
+// Delivered fps over the span between the first and last delivered frame, so
+// a short run is not a frame short just because of where its window fell
+double delivered_fps(Channel& channel) {
+    std::lock_guard<std::mutex> lock(channel.span_mutex);
+    if (channel.span_frames < 2 || channel.span_last_ns <= channel.span_first_ns) {
+        return 0.0;
+    }
+    return (channel.span_frames - 1) * 1e9 / (double)(channel.span_last_ns - channel.span_first_ns);
+}
+
+// p99 of the capture latency, or of the delivery latency without hardware timestamps
+const BMHistogramSummary& latency_of(const BMChannelStats& stats) {
+    return stats.capture_latency.count > 0 ? stats.capture_latency : stats.delivery_latency;
+}
+
+std::string channel_name(const Channel& channel) {
+    char name[96];
+    snprintf(name, sizeof(name), "%d.%d %dx%d@%g", channel.device_index, channel.port_index,
+             channel.mode.width, channel.mode.height, channel.mode.framerate);
+    return name;
+}
+
+// Pull every frame, the way an application's capture loop would
+void consume(BMContext* context, Channel* channel, BMPixelFormat format) {
+    std::vector<uint8_t> buffer(bm_get_channel_frame_size(context, channel->handle, format));
+    BMFrameInfo info;
+    while (!g_stop.load(std::memory_order_relaxed)) {
+        if (!bm_update_channel(context, channel->handle)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if (!bm_get_channel_frame(context, channel->handle, format, buffer.data(), buffer.size(),
+                                  nullptr, nullptr, nullptr)) {
+            // The input may have switched to a larger format
+            size_t size = bm_get_channel_frame_size(context, channel->handle, format);
+            if (size > buffer.size()) {
+                buffer.resize(size);
+            }
+            channel->failed_reads.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        // Time the span by capture time, falling back to now without a hardware clock
+        int64_t captured_ns = 0;
+        if (bm_channel_get_frame_info(context, channel->handle, &info, nullptr)) {
+            captured_ns = info.hardware_timestamp;
+        }
+        if (captured_ns == 0) {
+            captured_ns = (int64_t)(now_seconds() * 1e9);
+        }
+        std::lock_guard<std::mutex> lock(channel->span_mutex);
+        if (channel->span_frames == 0) {
+            channel->span_first_ns = captured_ns;
+        }
+        channel->span_last_ns = captured_ns;
+        channel->span_frames++;
+    }
+}
+
+// Spin for `duty` of every 10 ms
+void burn_cpu(double duty) {
+    const double period = 0.010;
+    volatile uint64_t sink = 0;
+    uint64_t x = 88172645463325252ULL;
+    while (!g_stop.load(std::memory_order_relaxed)) {
+        double start = now_seconds();
+        while (now_seconds() - start < period * duty) {
+            for (int i = 0; i < 1000; i++) {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+            }
+            sink = x;
+        }
+        if (duty < 1.0) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(period * (1.0 - duty)));
+        }
+    }
+    (void)sink;
+}
+
+// Keep `megabytes` resident and dirty: sweep writes through all of it, which
+// evicts the caches the capture path relies on, and reallocate an eighth of it
+// in 1 MB blocks per sweep to keep the allocator busy
+void press_memory(size_t megabytes) {
+    const size_t block_size = 1 << 20;
+    std::vector<std::unique_ptr<uint8_t[]>> blocks(megabytes);
+    for (auto& block : blocks) {
+        block.reset(new uint8_t[block_size]);
+        memset(block.get(), 0, block_size);
+    }
+    size_t next = 0;
+    uint8_t value = 0;
+    while (!g_stop.load(std::memory_order_relaxed)) {
+        value++;
+        for (size_t i = 0; i < blocks.size() && !g_stop.load(std::memory_order_relaxed); i++) {
+            memset(blocks[i].get(), value, block_size);
+        }
+        for (size_t i = 0; i < std::max<size_t>(blocks.size() / 8, 1); i++) {
+            blocks[next].reset(new uint8_t[block_size]);
+            memset(blocks[next].get(), value, block_size);
+            next = (next + 1) % blocks.size();
+        }
+    }
+}
+
+// "1920x1080@29.97"
+bool parse_mode(const char* text, Mode* mode) {
+    char tail;
+    return sscanf(text, "%dx%d@%lf%c", &mode->width, &mode->height, &mode->framerate, &tail) == 3 &&
+           mode->width > 0 && mode->height > 0 && mode->framerate > 0.0;
+}
+
+// Seconds, with an optional s, m or h suffix
+bool parse_duration(const char* text, double* seconds) {
+    char* end = nullptr;
+    double value = strtod(text, &end);
+    if (end == text || value < 0.0) {
+        return false;
+    }
+    if (*end == 'h') {
+        value *= 3600.0;
+        end++;
+    } else if (*end == 'm') {
+        value *= 60.0;
+        end++;
+    } else if (*end == 's') {
+        end++;
+    }
+    if (*end != '\0') {
+        return false;
+    }
+    *seconds = value;
+    return true;
+}
+
+// NTSC rates (23.98, 29.97, 59.94) run at 1000/1001 of the integer rate
+BMMockMode mock_mode(const Mode& mode) {
+    BMMockMode mock;
+    mock.width = mode.width;
+    mock.height = mode.height;
+    double integer_rate = floor(mode.framerate * 1.001 + 0.5);
+    if (fabs(mode.framerate - integer_rate / 1.001) < 0.005 && fabs(mode.framerate - integer_rate) > 0.005) {
+        mock.frame_duration = 1001;
+        mock.time_scale = (int64_t)integer_rate * 1000;
+    } else {
+        mock.frame_duration = 1000;
+        mock.time_scale = (int64_t)floor(mode.framerate * 1000.0 + 0.5);
+    }
+    return mock;
+}
+
+BMContext* open_context(const Config& config) {
+    if (config.hardware) {
+        return bm_create_context();
+    }
+
+    std::vector<BMMockMode> modes;
+    for (const Mode& mode : config.modes) {
+        modes.push_back(mock_mode(mode));
+    }
+    BMMockOptions options;
+    bm_mock_options_init(&options);
+    options.ports_per_device = config.ports_per_device;
+    options.device_count = (config.channels + config.ports_per_device - 1) / config.ports_per_device;
+    options.modes = modes.data();
+    options.mode_count = (int)modes.size();
+    options.jitter_ms = config.jitter_ms;
+    options.drop_rate = config.drop_rate;
+    options.signal_loss_rate = config.signal_loss_rate;
+    options.seed = config.seed;
+    return bm_create_mock_context(&options);
+}
+
+// Open channels on every input port of every device, in order, until there are enough
+bool open_channels(BMContext* context, const Config& config, std::vector<BMCaptureDevice*>* devices,
+                   std::vector<std::unique_ptr<Channel>>* channels) {
+    int device_count = bm_get_device_count(context);
+    for (int d = 0; d < device_count && (int)channels->size() < config.channels; d++) {
+        BMCaptureDevice* device = bm_create_device(context, d);
+        if (device == nullptr) {
+            continue;
+        }
+        devices->push_back(device);
+        int port_count = bm_get_input_port_count(context, d);
+        for (int p = 0; p < port_count && (int)channels->size() < config.channels; p++) {
+            std::unique_ptr<Channel> channel(new Channel());
+            channel->device_index = d;
+            channel->port_index = p;
+            channel->mode = config.modes[channels->size() % config.modes.size()];
+            channel->handle = bm_create_channel(context, device, p);
+            if (channel->handle == nullptr) {
+                fprintf(stderr, "Error: Failed to open input %d of device %d\n", p, d);
+                return false;
+            }
+            if (!bm_start_channel_capture(context, channel->handle, channel->mode.width, channel->mode.height,
+                                          (float)channel->mode.framerate, config.capture_mode)) {
+                fprintf(stderr, "Error: Failed to start %s\n", channel_name(*channel).c_str());
+                bm_destroy_channel(context, channel->handle);
+                return false;
+            }
+            channels->push_back(std::move(channel));
+        }
+    }
+    if ((int)channels->size() < config.channels) {
+        fprintf(stderr, "Error: Only %d of %d channels are available\n", (int)channels->size(), config.channels);
+        return false;
+    }
+    return true;
+}
+
+void close_channels(BMContext* context, std::vector<BMCaptureDevice*>* devices,
+                    std::vector<std::unique_ptr<Channel>>* channels) {
+    for (auto& channel : *channels) {
+        bm_stop_channel_capture(context, channel->handle);
+        bm_destroy_channel(context, channel->handle);
+    }
+    channels->clear();
+    for (BMCaptureDevice* device : *devices) {
+        bm_destroy_device(context, device);
+    }
+    devices->clear();
+}
+
+// Sleep until `deadline`, waking early on Ctrl-C
+void sleep_until(double deadline) {
+    while (!g_interrupted) {
+        double remaining = deadline - now_seconds();
+        if (remaining <= 0.0) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(std::min(remaining, 0.1)));
+    }
+}
+
+Sample take_sample(BMContext* context, std::vector<std::unique_ptr<Channel>>& channels,
+                   double seconds, double interval) {
+    Sample sample;
+    sample.seconds = seconds;
+    sample.worst_p99_ms = 0.0;
+    uint64_t delivered = 0, lost = 0, seen = 0;
+    for (auto& channel : channels) {
+        bm_channel_get_stats(context, channel->handle, &channel->stats);
+        delivered += channel->stats.frames_delivered - channel->last_delivered;
+        lost += lost_frames(channel->stats) - channel->last_lost;
+        seen += seen_frames(channel->stats) - channel->last_seen;
+        channel->last_delivered = channel->stats.frames_delivered;
+        channel->last_lost = lost_frames(channel->stats);
+        channel->last_seen = seen_frames(channel->stats);
+        sample.worst_p99_ms = std::max(sample.worst_p99_ms, latency_of(channel->stats).p99_us / 1000.0);
+    }
+    sample.fps = interval > 0.0 ? delivered / interval : 0.0;
+    sample.loss_rate = seen > 0 ? (double)lost / seen : 0.0;
+    sample.rss_mb = resident_bytes() / 1e6;
+    BMMemoryUsage usage;
+    sample.library_mb = bm_get_memory_usage(context, &usage) ? usage.total / 1e6 : 0.0;
+    return sample;
+}
+
+// Least squares slope of RSS, in MB per hour
+double rss_slope(const std::vector<Sample>& samples) {
+    if (samples.size() < 2) {
+        return 0.0;
+    }
+    double mean_t = 0.0, mean_rss = 0.0;
+    for (const Sample& sample : samples) {
+        mean_t += sample.seconds;
+        mean_rss += sample.rss_mb;
+    }
+    mean_t /= samples.size();
+    mean_rss /= samples.size();
+    double covariance = 0.0, variance = 0.0;
+    for (const Sample& sample : samples) {
+        covariance += (sample.seconds - mean_t) * (sample.rss_mb - mean_rss);
+        variance += (sample.seconds - mean_t) * (sample.seconds - mean_t);
+    }
+    return variance > 0.0 ? covariance / variance * 3600.0 : 0.0;
+}
+
+void check(std::vector<SloResult>* results, const char* name, const std::string& channel,
+           double value, double limit, bool at_least) {
+    if (limit < 0.0) {
+        return;
+    }
+    SloResult result;
+    result.name = name;
+    result.channel = channel;
+    result.value = value;
+    result.limit = limit;
+    result.passed = at_least ? value >= limit : value <= limit;
+    results->push_back(result);
+}
+
+std::vector<SloResult> evaluate(const Config& config, const std::vector<std::unique_ptr<Channel>>& channels,
+                                double rss_growth_mb) {
+    std::vector<SloResult> results;
+    for (const auto& channel : channels) {
+        const BMChannelStats& stats = channel->stats;
+        std::string name = channel_name(*channel);
+        double fps = delivered_fps(*channel);
+        double seen = (double)seen_frames(stats);
+        check(&results, "fps_ratio", name, fps / channel->mode.framerate, config.min_fps_ratio, true);
+        check(&results, "loss_rate", name, seen > 0.0 ? lost_frames(stats) / seen : 1.0, config.max_loss_rate, false);
+        check(&results, "p99_ms", name, latency_of(stats).p99_us / 1000.0, config.max_p99_ms, false);
+        check(&results, "p999_ms", name, latency_of(stats).p999_us / 1000.0, config.max_p999_ms, false);
+    }
+    check(&results, "rss_growth_mb", "", rss_growth_mb, config.max_rss_growth_mb, false);
+    return results;
+}
+
+void print_summary(const std::vector<std::unique_ptr<Channel>>& channels, const std::vector<SloResult>& slos,
+                   double rss_growth_mb, double slope, bool passed) {
+    printf("\n%-26s %9s %9s %9s %9s %9s %8s %8s %8s\n", "channel", "fps", "delivered", "missed",
+           "dropped", "overwrite", "p50 ms", "p99 ms", "p99.9 ms");
+    for (const auto& channel : channels) {
+        const BMChannelStats& stats = channel->stats;
+        const BMHistogramSummary& latency = latency_of(stats);
+        printf("%-26s %9.2f %9llu %9llu %9llu %9llu %8.2f %8.2f %8.2f\n", channel_name(*channel).c_str(),
+               delivered_fps(*channel),
+               (unsigned long long)stats.frames_delivered, (unsigned long long)stats.frames_missed,
+               (unsigned long long)stats.frames_dropped, (unsigned long long)stats.frames_overwritten,
+               latency.p50_us / 1000.0, latency.p99_us / 1000.0, latency.p999_us / 1000.0);
+    }
+    printf("\nRSS growth %.1f MB (%.2f MB/hour), %llu warnings, %llu errors logged\n\n", rss_growth_mb, slope,
+           (unsigned long long)g_log_warnings.load(), (unsigned long long)g_log_errors.load());
+
+    for (const SloResult& slo : slos) {
+        printf("%s  %-14s %-26s %12.4f %s %.4f\n", slo.passed ? "PASS" : "FAIL", slo.name.c_str(),
+               slo.channel.c_str(), slo.value, slo.name == "fps_ratio" ? ">=" : "<=", slo.limit);
+    }
+    printf("\n%s\n", passed ? "PASS" : "FAIL");
+}
+
+// Escape the characters JSON does not allow in strings
+std::string json_string(const std::string& text) {
+    std::string escaped = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if ((unsigned char)c < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped + "\"";
+}
+
+bool write_json(const char* path, const Config& config, double seconds,
+                const std::vector<std::unique_ptr<Channel>>& channels, const std::vector<Sample>& samples,
+                const std::vector<SloResult>& slos, double rss_growth_mb, double slope, bool passed) {
+    FILE* file = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Error: Failed to create %s\n", path);
+        return false;
+    }
+
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+
+    fprintf(file, "{\n  \"schema\": 1,\n");
+    fprintf(file, "  \"timestamp\": %lld,\n", (long long)time(nullptr));
+    fprintf(file, "  \"host\": %s,\n", json_string(host).c_str());
+    fprintf(file, "  \"backend\": \"%s\",\n", config.hardware ? "hardware" : "mock");
+    fprintf(file, "  \"seconds\": %.1f,\n", seconds);
+    fprintf(file, "  \"stress\": {\"cpu_threads\": %d, \"cpu_duty\": %.2f, \"memory_pressure_mb\": %zu},\n",
+            config.cpu_threads, config.cpu_duty, config.memory_pressure_mb);
+    fprintf(file, "  \"passed\": %s,\n", passed ? "true" : "false");
+    fprintf(file, "  \"rss_growth_mb\": %.2f,\n  \"rss_mb_per_hour\": %.3f,\n", rss_growth_mb, slope);
+    fprintf(file, "  \"log_warnings\": %llu,\n  \"log_errors\": %llu,\n",
+            (unsigned long long)g_log_warnings.load(), (unsigned long long)g_log_errors.load());
+
+    fprintf(file, "  \"channels\": [");
+    for (size_t i = 0; i < channels.size(); i++) {
+        const BMChannelStats& stats = channels[i]->stats;
+        const BMHistogramSummary& latency = latency_of(stats);
+        fprintf(file, "%s\n    {\"name\": %s, \"width\": %d, \"height\": %d, \"framerate\": %.3f, "
+                "\"fps\": %.3f, \"delivered\": %llu, \"missed\": %llu, \"dropped\": %llu, "
+                "\"overwritten\": %llu, \"no_signal\": %llu, \"failed_reads\": %llu, "
+                "\"latency_p50_ms\": %.3f, \"latency_p99_ms\": %.3f, \"latency_p999_ms\": %.3f, "
+                "\"latency_max_ms\": %.3f}",
+                i == 0 ? "" : ",", json_string(channel_name(*channels[i])).c_str(),
+                channels[i]->mode.width, channels[i]->mode.height, channels[i]->mode.framerate,
+                delivered_fps(*channels[i]),
+                (unsigned long long)stats.frames_delivered, (unsigned long long)stats.frames_missed,
+                (unsigned long long)stats.frames_dropped, (unsigned long long)stats.frames_overwritten,
+                (unsigned long long)stats.frames_no_signal, (unsigned long long)channels[i]->failed_reads.load(),
+                latency.p50_us / 1000.0, latency.p99_us / 1000.0, latency.p999_us / 1000.0,
+                latency.max_us / 1000.0);
+    }
+    fprintf(file, "\n  ],\n");
+
+    fprintf(file, "  \"slos\": [");
+    for (size_t i = 0; i < slos.size(); i++) {
+        fprintf(file, "%s\n    {\"name\": %s, \"channel\": %s, \"value\": %.6f, \"limit\": %.6f, \"passed\": %s}",
+                i == 0 ? "" : ",", json_string(slos[i].name).c_str(),
+                slos[i].channel.empty() ? "null" : json_string(slos[i].channel).c_str(),
+                slos[i].value, slos[i].limit, slos[i].passed ? "true" : "false");
+    }
+    fprintf(file, "\n  ],\n");
+
+    fprintf(file, "  \"samples\": [");
+    for (size_t i = 0; i < samples.size(); i++) {
+        fprintf(file, "%s\n    {\"seconds\": %.1f, \"fps\": %.2f, \"loss_rate\": %.6f, \"worst_p99_ms\": %.3f, "
+                "\"rss_mb\": %.2f, \"library_mb\": %.2f}",
+                i == 0 ? "" : ",", samples[i].seconds, samples[i].fps, samples[i].loss_rate,
+                samples[i].worst_p99_ms, samples[i].rss_mb, samples[i].library_mb);
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    if (file != stdout) {
+        fclose(file);
+    }
+    return true;
+}
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --channels N              channels to open (default: 2)\n"
+            "  --mode WxH@FPS            channel mode, repeat to cycle channels through several (default: 1920x1080@29.97)\n"
+            "  --duration TIME           measured run time, e.g. 90s, 30m, 4h (default: 60s)\n"
+            "  --warmup TIME             time before statistics are reset (default: 10s)\n"
+            "  --interval TIME           report interval (default: 10s)\n"
+            "  --format rgb|gray|yuv     format the consumers pull (default: rgb)\n"
+            "  --no-drops                capture in BM_NO_FRAME_DROPS mode\n"
+            "  --hardware                use the installed cards instead of mock devices\n"
+            "  --ports N                 inputs per mock device (default: 2)\n"
+            "  --cpu-threads N           CPU stress threads (default: 0)\n"
+            "  --cpu-duty FRACTION       share of the time each stress thread spins (default: 1)\n"
+            "  --memory-pressure MB      memory kept resident and rewritten (default: 0)\n"
+            "  --jitter-ms MS, --drop-rate R, --signal-loss-rate R, --seed N\n"
+            "                            mock device impairments\n"
+            "  --slo-fps-ratio R         minimum delivered fps over nominal (default: 0.99)\n"
+            "  --slo-loss-rate R         maximum lost frames over frames sent (default: 0.001)\n"
+            "  --slo-p99-ms MS           maximum p99 capture latency (default: 50)\n"
+            "  --slo-p999-ms MS          maximum p99.9 capture latency (default: off)\n"
+            "  --slo-rss-growth-mb MB    maximum RSS growth after the warm-up (default: 64)\n"
+            "                            a negative SLO limit disables the check\n"
+            "  --json PATH|-             write the results as JSON\n",
+            program);
+}
+
+bool parse_args(int argc, char** argv, Config* config) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+        if (strcmp(arg, "--no-drops") == 0) {
+            config->capture_mode = BM_NO_FRAME_DROPS;
+            continue;
+        } else if (strcmp(arg, "--hardware") == 0) {
+            config->hardware = true;
+            continue;
+        } else if (value == nullptr) {
+            return false;
+        } else if (strcmp(arg, "--channels") == 0) {
+            config->channels = atoi(value);
+            ok = config->channels > 0;
+        } else if (strcmp(arg, "--mode") == 0) {
+            Mode mode;
+            ok = parse_mode(value, &mode);
+            config->modes.push_back(mode);
+        } else if (strcmp(arg, "--duration") == 0) {
+            ok = parse_duration(value, &config->duration);
+        } else if (strcmp(arg, "--warmup") == 0) {
+            ok = parse_duration(value, &config->warmup);
+        } else if (strcmp(arg, "--interval") == 0) {
+            ok = parse_duration(value, &config->interval) && config->interval > 0.0;
+        } else if (strcmp(arg, "--format") == 0) {
+            if (strcmp(value, "rgb") == 0) {
+                config->format = BM_FORMAT_RGB;
+            } else if (strcmp(value, "gray") == 0) {
+                config->format = BM_FORMAT_GRAY;
+            } else if (strcmp(value, "yuv") == 0) {
+                config->format = BM_FORMAT_YUV;
+            } else {
+                ok = false;
+            }
+        } else if (strcmp(arg, "--ports") == 0) {
+            config->ports_per_device = atoi(value);
+            ok = config->ports_per_device > 0;
+        } else if (strcmp(arg, "--cpu-threads") == 0) {
+            config->cpu_threads = atoi(value);
+            ok = config->cpu_threads >= 0;
+        } else if (strcmp(arg, "--cpu-duty") == 0) {
+            config->cpu_duty = atof(value);
+            ok = config->cpu_duty > 0.0 && config->cpu_duty <= 1.0;
+        } else if (strcmp(arg, "--memory-pressure") == 0) {
+            config->memory_pressure_mb = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--jitter-ms") == 0) {
+            config->jitter_ms = atof(value);
+        } else if (strcmp(arg, "--drop-rate") == 0) {
+            config->drop_rate = atof(value);
+        } else if (strcmp(arg, "--signal-loss-rate") == 0) {
+            config->signal_loss_rate = atof(value);
+        } else if (strcmp(arg, "--seed") == 0) {
+            config->seed = (unsigned int)strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--slo-fps-ratio") == 0) {
+            config->min_fps_ratio = atof(value);
+        } else if (strcmp(arg, "--slo-loss-rate") == 0) {
+            config->max_loss_rate = atof(value);
+        } else if (strcmp(arg, "--slo-p99-ms") == 0) {
+            config->max_p99_ms = atof(value);
+        } else if (strcmp(arg, "--slo-p999-ms") == 0) {
+            config->max_p999_ms = atof(value);
+        } else if (strcmp(arg, "--slo-rss-growth-mb") == 0) {
+            config->max_rss_growth_mb = atof(value);
+        } else if (strcmp(arg, "--json") == 0) {
+            config->json_path = value;
+        } else {
+            return false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Error: Invalid value for %s: %s\n", arg, value);
+            return false;
+        }
+        i++;
+    }
+    if (config->modes.empty()) {
+        config->modes.push_back(Mode{1920, 1080, 29.97});
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Config config;
+    if (!parse_args(argc, argv, &config)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Keep stdout parseable when the JSON goes there
+    FILE* report = config.json_path != nullptr && strcmp(config.json_path, "-") == 0 ? stderr : stdout;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    bm_set_log_callback(on_log, nullptr);
+
+    BMContext* context = open_context(config);
+    if (context == nullptr) {
+        fprintf(stderr, "Error: Failed to create the capture context\n");
+        return 2;
+    }
+
+    std::vector<BMCaptureDevice*> devices;
+    std::vector<std::unique_ptr<Channel>> channels;
+    if (!open_channels(context, config, &devices, &channels)) {
+        close_channels(context, &devices, &channels);
+        bm_free_context(context);
+        return 2;
+    }
+
+    for (auto& channel : channels) {
+        channel->consumer = std::thread(consume, context, channel.get(), config.format);
+    }
+    std::vector<std::thread> stress;
+    for (int i = 0; i < config.cpu_threads; i++) {
+        stress.push_back(std::thread(burn_cpu, config.cpu_duty));
+    }
+    if (config.memory_pressure_mb > 0) {
+        stress.push_back(std::thread(press_memory, config.memory_pressure_mb));
+    }
+
+    fprintf(report, "%d %s channels, %d CPU stress threads, %zu MB memory pressure; warming up for %.0f s\n",
+            (int)channels.size(), config.hardware ? "hardware" : "mock", config.cpu_threads,
+            config.memory_pressure_mb, config.warmup);
+    sleep_until(now_seconds() + config.warmup);
+
+    for (auto& channel : channels) {
+        bm_channel_reset_stats(context, channel->handle);
+        std::lock_guard<std::mutex> lock(channel->span_mutex);
+        channel->span_frames = 0;
+    }
+    double start = now_seconds();
+    double rss_baseline = resident_bytes() / 1e6;
+    std::vector<Sample> samples;
+
+    fprintf(report, "%10s %10s %10s %10s %10s %10s\n", "seconds", "fps", "loss", "p99 ms", "rss MB", "library MB");
+    double last = start;
+    while (!g_interrupted && last - start < config.duration) {
+        double next = std::min(last + config.interval, start + config.duration);
+        sleep_until(next);
+        double now = now_seconds();
+        Sample sample = take_sample(context, channels, now - start, now - last);
+        samples.push_back(sample);
+        fprintf(report, "%10.0f %10.2f %10.6f %10.2f %10.1f %10.1f\n", sample.seconds, sample.fps,
+                sample.loss_rate, sample.worst_p99_ms, sample.rss_mb, sample.library_mb);
+        fflush(report);
+        last = now;
+    }
+    double seconds = now_seconds() - start;
+
+    g_stop.store(true);
+    for (auto& channel : channels) {
+        channel->consumer.join();
+    }
+    for (std::thread& thread : stress) {
+        thread.join();
+    }
+
+    double rss_growth = samples.empty() ? 0.0 : samples.back().rss_mb - rss_baseline;
+    double slope = rss_slope(samples);
+    std::vector<SloResult> slos = evaluate(config, channels, rss_growth);
+    bool passed = !g_interrupted;
+    for (const SloResult& slo : slos) {
+        passed = passed && slo.passed;
+    }
+    bm_flush_log();     // Count everything logged during the run
+    if (g_interrupted) {
+        fprintf(stderr, "Interrupted after %.0f s; the run does not qualify\n", seconds);
+    }
+
+    if (report == stdout) {
+        print_summary(channels, slos, rss_growth, slope, passed);
+    }
+    bool written = config.json_path == nullptr ||
+                   write_json(config.json_path, config, seconds, channels, samples, slos, rss_growth, slope, passed);
+
+    close_channels(context, &devices, &channels);
+    bm_free_context(context);
+    bm_flush_log();
+    bm_set_log_callback(nullptr, nullptr);
+    if (!written) {
+        return 2;
+    }
+    return passed ? 0 : 1;
+}
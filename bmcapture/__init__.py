@@ -15,9 +15,13 @@ from bmcapture_c import (
     # Classes
     BMCapture, 
     BMChannel,
+    RawFile,
+    RtpReceiver,
     
     # Functions 
     initialize,
+    initialize_mock,
+    driver_available,
     shutdown,
     get_device_count,
     get_device_name,
@@ -26,6 +30,17 @@ from bmcapture_c import (
     create_device,
     select_input_port,
     destroy_device,
+    open_replay,
+    decode_latency_probe,
+    get_memory_usage,
+    set_memory_budget,
+    trace_start,
+    trace_stop,
+    trace_write,
+    set_log_level,
+    set_log_callback,
+    flush_log,
+    get_log_dropped,
 )
 
 # Version information
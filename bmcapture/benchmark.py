@@ -0,0 +1,257 @@
+"""
+Throughput of BMCapture.get_frame and BMChannel.get_frame from Python.
+
+Runs on mock devices, so it needs neither a capture card nor the drivers:
+
+    python -m bmcapture.benchmark --size 1920x1080 --threads 2 --json results.json
+
+Every combination of path (BMCapture or BMChannel), format, fresh or reused
+output arrays and competing Python threads is timed call by call. The mean
+time per call is split into:
+
+  allocation   creating the numpy array (0 when reusing one with out=)
+  conversion   converting the frame to the requested format, native
+  copy         copying the frame into the array, native; first-touch page
+               faults of a fresh array land here
+  binding      the rest: the Python call, argument parsing, format and shape
+               checks, taking the frame lock and the statistics, and with
+               competing threads the wait to get the GIL back
+
+Conversion and copy come from get_frame_info(), so the Python figures line up
+with the native ones. Pass --native bench/bench_primitives.json to include the
+native microbenchmarks for the same resolution in the JSON.
+"""
+import argparse
+import json
+import platform
+import socket
+import sys
+import threading
+import time
+from typing import List, Optional
+
+import numpy as np
+
+import bmcapture_c
+
+FORMATS = ("rgb", "yuv", "gray")
+
+
+def _shape(fmt: str, width: int, height: int) -> tuple:
+    if fmt == "rgb":
+        return (height, width, 3)
+    if fmt == "yuv":
+        return (height, width // 2, 4)
+    return (height, width)
+
+
+def _percentile(values: List[int], fraction: float) -> float:
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def _allocation_ns(shape: tuple, min_time: float) -> float:
+    """Mean time to create an uninitialised array, as get_frame does without out=."""
+    count = 0
+    start = time.perf_counter_ns()
+    deadline = start + min_time * 1e9 / 10
+    while True:
+        array = np.empty(shape, dtype=np.uint8)
+        del array
+        count += 1
+        now = time.perf_counter_ns()
+        if now >= deadline:
+            return (now - start) / count
+
+
+class _CompetingThreads:
+    """Pure Python threads that contend for the GIL while a measurement runs."""
+
+    def __init__(self, count: int):
+        self._stop = threading.Event()
+        self._threads = [threading.Thread(target=self._spin, daemon=True) for _ in range(count)]
+
+    def _spin(self):
+        while not self._stop.is_set():
+            sum(range(1000))
+
+    def __enter__(self):
+        for thread in self._threads:
+            thread.start()
+        return self
+
+    def __exit__(self, exc_type, exc, tb):
+        self._stop.set()
+        for thread in self._threads:
+            thread.join()
+
+
+def _wait_for_frames(source, count: int = 5, timeout: float = 5.0):
+    deadline = time.monotonic() + timeout
+    while source.get_frame_count() < count:
+        if time.monotonic() > deadline:
+            raise RuntimeError("The mock source delivered no frames")
+        time.sleep(0.01)
+
+
+def measure(source, path: str, fmt: str, width: int, height: int, reuse: bool,
+            threads: int, min_time: float) -> dict:
+    """Time get_frame on `source` until min_time seconds of calls have been made."""
+    shape = _shape(fmt, width, height)
+    out = np.empty(shape, dtype=np.uint8) if reuse else None
+    frame_bytes = int(np.prod(shape))
+
+    def call():
+        return source.get_frame(fmt, out=out) if reuse else source.get_frame(fmt)
+
+    for _ in range(3):  # Warm up caches and the conversion buffers
+        source.update()
+        call()
+
+    times = []
+    conversion_us = 0.0
+    copy_us = 0.0
+    converted = 0
+    with _CompetingThreads(threads):
+        measured = 0
+        while measured < min_time * 1e9 or len(times) < 10:
+            source.update()
+            start = time.perf_counter_ns()
+            call()
+            elapsed = time.perf_counter_ns() - start
+            info = source.get_frame_info()
+            times.append(elapsed)
+            measured += elapsed
+            if info is not None:
+                conversion_us += info["conversion_us"]
+                copy_us += info["delivery_us"]
+                converted += info["conversion_us"] > 0
+
+    calls = len(times)
+    mean_us = sum(times) / calls / 1000
+    conversion_us /= calls
+    copy_us /= calls
+    allocation_us = 0.0 if reuse else _allocation_ns(shape, min_time) / 1000
+    binding_us = max(0.0, mean_us - allocation_us - conversion_us - copy_us)
+    return {
+        "path": path,
+        "format": fmt,
+        "arrays": "reused" if reuse else "fresh",
+        "threads": threads,
+        "width": width,
+        "height": height,
+        "calls": calls,
+        "calls_per_s": 1e6 / mean_us,
+        "mb_per_s": frame_bytes / mean_us,
+        "mean_us": mean_us,
+        "p50_us": _percentile(times, 0.50) / 1000,
+        "p99_us": _percentile(times, 0.99) / 1000,
+        "converted_fraction": converted / calls,
+        "breakdown_us": {
+            "allocation": allocation_us,
+            "conversion": conversion_us,
+            "copy": copy_us,
+            "binding": binding_us,
+        },
+        "native_us": conversion_us + copy_us,
+    }
+
+
+def run(width: int = 1920, height: int = 1080, fps: float = 240.0, formats=FORMATS,
+        threads: int = 2, min_time: float = 1.0) -> List[dict]:
+    """
+    Measure both get_frame paths on a mock device.
+
+    The mock runs at `fps` so that most calls find a new frame to convert. It
+    replaces the module's capture context, so run this in its own process.
+    """
+    bmcapture_c.initialize_mock(devices=1, ports=2, modes=[(width, height, fps)])
+    capture = bmcapture_c.BMCapture(0, width, height, fps, True)
+    channel = capture.create_channel(port_index=1, width=width, height=height, framerate=fps)
+    try:
+        _wait_for_frames(capture)
+        _wait_for_frames(channel)
+        results = []
+        for path, source in (("BMCapture", capture), ("BMChannel", channel)):
+            for fmt in formats:
+                for reuse in (False, True):
+                    for competing in sorted({0, threads}):
+                        results.append(measure(source, path, fmt, width, height, reuse,
+                                               competing, min_time))
+        return results
+    finally:
+        channel.close()
+        capture.close()
+        bmcapture_c.shutdown()
+
+
+def _native_results(path: str, width: int, height: int) -> Optional[list]:
+    """Microbenchmark results for the same resolution from bench_primitives JSON."""
+    with open(path) as file:
+        native = json.load(file)
+    return [result for result in native.get("results", [])
+            if result.get("width") == width and result.get("height") == height]
+
+
+def print_results(results: List[dict], stream=sys.stdout):
+    print(f"{'path':<10} {'format':<6} {'arrays':<7} {'threads':>7} {'calls/s':>9} {'MB/s':>8} "
+          f"{'mean us':>9} {'p99 us':>9} {'alloc':>8} {'convert':>8} {'copy':>8} {'binding':>8}",
+          file=stream)
+    for result in results:
+        breakdown = result["breakdown_us"]
+        print(f"{result['path']:<10} {result['format']:<6} {result['arrays']:<7} {result['threads']:>7} "
+              f"{result['calls_per_s']:>9.0f} {result['mb_per_s']:>8.0f} {result['mean_us']:>9.1f} "
+              f"{result['p99_us']:>9.1f} {breakdown['allocation']:>8.1f} {breakdown['conversion']:>8.1f} "
+              f"{breakdown['copy']:>8.1f} {breakdown['binding']:>8.1f}", file=stream)
+
+
+def main(argv=None) -> int:
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0].strip())
+    parser.add_argument("--size", default="1920x1080", help="frame size WxH (default: 1920x1080)")
+    parser.add_argument("--fps", type=float, default=240.0, help="mock source frame rate (default: 240)")
+    parser.add_argument("--formats", default=",".join(FORMATS), help="comma separated (default: rgb,yuv,gray)")
+    parser.add_argument("--threads", type=int, default=2, help="competing Python threads (default: 2)")
+    parser.add_argument("--min-time", type=float, default=1.0, help="seconds of calls per measurement (default: 1)")
+    parser.add_argument("--native", help="bench_primitives JSON to include for comparison")
+    parser.add_argument("--json", help="write the results as JSON to PATH, or - for stdout")
+    args = parser.parse_args(argv)
+
+    try:
+        width, height = (int(value) for value in args.size.lower().split("x"))
+    except ValueError:
+        parser.error(f"invalid --size {args.size}")
+    formats = [fmt.strip() for fmt in args.formats.split(",") if fmt.strip()]
+    for fmt in formats:
+        if fmt not in FORMATS:
+            parser.error(f"invalid format {fmt}")
+
+    results = run(width, height, args.fps, formats, args.threads, args.min_time)
+
+    # Keep stdout parseable when the JSON goes there
+    if args.json != "-":
+        print_results(results)
+    if args.json:
+        document = {
+            "schema": 1,
+            "timestamp": int(time.time()),
+            "host": socket.gethostname(),
+            "cpu": platform.processor() or platform.machine(),
+            "python": platform.python_version(),
+            "numpy": np.__version__,
+            "source": {"kind": "mock", "width": width, "height": height, "fps": args.fps},
+            "min_time_s": args.min_time,
+            "results": results,
+        }
+        if args.native:
+            document["native"] = _native_results(args.native, width, height)
+        text = json.dumps(document, indent=2)
+        if args.json == "-":
+            print(text)
+        else:
+            with open(args.json, "w") as file:
+                file.write(text + "\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,217 @@
+"""
+Subscriber for the local frame server started with BMChannel.start_server().
+
+Needs only the standard library and numpy, not the DeckLink drivers.
+Frames are numpy views of memory shared with the capturing process; the
+wire format matches src/bmcapture_protocol.h.
+"""
+import mmap
+import os
+import select
+import socket
+import struct
+from typing import Optional
+
+import numpy as np
+
+PROTOCOL_VERSION = 1
+MESSAGE_SIZE = 64
+
+_HELLO = 1
+_FRAME = 2
+_RELEASE = 3
+
+_HELLO_FORMAT = struct.Struct("<IIIIQQIIIIqq")
+_FRAME_FORMAT = struct.Struct("<IIQQqqqIIQ")
+_GENERATION_FORMAT = struct.Struct("<Q")
+
+
+class Frame:
+    """
+    A frame leased from the server.
+
+    `data` is a read-only uint8 view of shared memory, shaped (height, row_bytes)
+    when the frame is a full picture. It stays readable after release(), but
+    its contents may then be replaced at any time.
+    """
+
+    def __init__(self, client, slot, generation, sequence, stream_time,
+                 frame_duration, hardware_timestamp, flags, data):
+        self._client = client
+        self.slot = slot
+        self.generation = generation
+        self.sequence = sequence
+        self.stream_time = stream_time
+        self.frame_duration = frame_duration
+        self.hardware_timestamp = hardware_timestamp
+        self.flags = flags
+        self.data = data
+        self._released = False
+
+    def is_valid(self) -> bool:
+        """True if the frame has not been reclaimed; check after reading the data."""
+        return self._client.generation(self.slot) == self.generation
+
+    def copy(self) -> Optional[np.ndarray]:
+        """Copy the frame out of shared memory, or None if it was reclaimed meanwhile."""
+        result = self.data.copy()
+        return result if self.is_valid() else None
+
+    def release(self):
+        """Hand the slot back to the server."""
+        if not self._released:
+            self._released = True
+            self._client.release(self)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc, tb):
+        self.release()
+
+
+class FrameClient:
+    """
+    Connection to a frame server.
+
+        with FrameClient("/tmp/bmcapture.sock") as client:
+            frame = client.next_frame(timeout=1.0)
+            if frame is not None:
+                with frame:
+                    process(frame.data)
+    """
+
+    def __init__(self, path: str):
+        self._sock = None
+        self._map = None
+        self._buffer = None
+        for kind in (getattr(socket, "SOCK_SEQPACKET", None), socket.SOCK_STREAM):
+            if kind is None:
+                continue
+            sock = socket.socket(socket.AF_UNIX, kind)
+            try:
+                sock.connect(path)
+            except OSError:
+                sock.close()
+                continue
+            self._sock = sock
+            break
+        if self._sock is None:
+            raise ConnectionError(f"Could not connect to frame server at {path}")
+
+        try:
+            self._receive_hello()
+        except Exception:
+            self.close()
+            raise
+
+    def _receive_hello(self):
+        fds = []
+        data, ancdata, _, _ = self._sock.recvmsg(MESSAGE_SIZE, socket.CMSG_SPACE(struct.calcsize("i")))
+        for level, kind, payload in ancdata:
+            if level == socket.SOL_SOCKET and kind == socket.SCM_RIGHTS:
+                fds.extend(struct.unpack(f"{len(payload) // 4}i", payload[:len(payload) - len(payload) % 4]))
+        if not fds:
+            raise ConnectionError("Frame server did not send its shared memory")
+        memory_fd = fds[0]
+
+        try:
+            if len(data) < MESSAGE_SIZE:
+                data += self._receive_exact(MESSAGE_SIZE - len(data))
+            (kind, version, self.slot_count, _, self.slot_size, self.data_offset,
+             self.width, self.height, self.row_bytes, self.pixel_format,
+             self.time_scale, self.frame_duration) = _HELLO_FORMAT.unpack_from(data)
+            if kind != _HELLO or version != PROTOCOL_VERSION:
+                raise ConnectionError("Unsupported frame server protocol")
+
+            size = self.data_offset + self.slot_count * self.slot_size
+            self._map = mmap.mmap(memory_fd, size, mmap.MAP_SHARED, mmap.PROT_READ)
+        finally:
+            for fd in fds:
+                os.close(fd)
+
+        self._buffer = np.frombuffer(self._map, dtype=np.uint8)
+
+    def _receive_exact(self, count: int) -> bytes:
+        data = b""
+        while len(data) < count:
+            chunk = self._sock.recv(count - len(data))
+            if not chunk:
+                raise ConnectionError("Frame server closed the connection")
+            data += chunk
+        return data
+
+    @property
+    def format(self) -> dict:
+        """Stream format announced by the server."""
+        return {
+            "width": self.width,
+            "height": self.height,
+            "row_bytes": self.row_bytes,
+            "pixel_format": self.pixel_format,
+            "time_scale": self.time_scale,
+            "frame_duration": self.frame_duration,
+            "slot_count": self.slot_count,
+        }
+
+    def fileno(self) -> int:
+        """Socket descriptor, readable when a frame is announced."""
+        return self._sock.fileno()
+
+    def generation(self, slot: int) -> int:
+        return _GENERATION_FORMAT.unpack_from(self._map, slot * 8)[0]
+
+    def next_frame(self, timeout: Optional[float] = None) -> Optional[Frame]:
+        """
+        Wait for the next frame.
+
+        Args:
+            timeout: Seconds to wait, None to wait forever
+
+        Returns:
+            The frame, or None on timeout. Raises ConnectionError if the server went away.
+        """
+        while True:
+            ready, _, _ = select.select([self._sock], [], [], timeout)
+            if not ready:
+                return None
+            message = self._receive_exact(MESSAGE_SIZE)
+            (kind, slot, generation, sequence, stream_time, frame_duration,
+             hardware_timestamp, flags, size, _) = _FRAME_FORMAT.unpack_from(message)
+            if kind != _FRAME or slot >= self.slot_count or size > self.slot_size:
+                continue
+
+            start = self.data_offset + slot * self.slot_size
+            data = self._buffer[start:start + size]
+            if self.row_bytes > 0 and size == self.row_bytes * self.height:
+                data = data.reshape(self.height, self.row_bytes)
+            return Frame(self, slot, generation, sequence, stream_time,
+                         frame_duration, hardware_timestamp, flags, data)
+
+    def release(self, frame: Frame):
+        """Hand a frame's slot back to the server."""
+        message = _FRAME_FORMAT.pack(_RELEASE, frame.slot, frame.generation, frame.sequence,
+                                     0, 0, 0, 0, 0, 0)
+        try:
+            self._sock.send(message.ljust(MESSAGE_SIZE, b"\0"))
+        except OSError:
+            pass  # The lease simply expires
+
+    def close(self):
+        """Disconnect. Views of frames must not be used afterwards."""
+        if self._sock is not None:
+            self._sock.close()
+            self._sock = None
+        self._buffer = None
+        if self._map is not None:
+            try:
+                self._map.close()
+            except BufferError:
+                pass  # Frame views are still alive; the mapping goes with them
+            self._map = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc, tb):
+        self.close()
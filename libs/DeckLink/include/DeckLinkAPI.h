@@ -39,8 +39,12 @@
 
 /* DeckLink API */
 
+#if defined(__APPLE__)
 #include <CoreFoundation/CoreFoundation.h>
 #include <CoreFoundation/CFPlugInCOM.h>
+#else
+#include "LinuxCOM.h"
+#endif
 #include <stdint.h>
 
 #include "DeckLinkAPITypes.h"
@@ -0,0 +1,123 @@
+/* LinuxCOM.h */
+
+// The COM and CoreFoundation declarations the macOS DeckLink headers rely on,
+// for building on Linux. The types match the Linux DeckLink SDK, so the
+// interfaces keep the layout libDeckLinkAPI.so was built with: IUnknown has
+// a virtual destructor and strings are plain `const char*`.
+//
+// The Linux driver hands out strings allocated with malloc() and expects the
+// caller to free() them. CFStringRef is therefore `const char*` here, and the
+// few CFString functions this project calls are implemented on top of it, so
+// code written for macOS (CFStringGetCString, CFRelease, ...) works
+// unchanged.
+
+#ifndef BMD_LINUXCOM_H
+#define BMD_LINUXCOM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	unsigned char byte0;
+	unsigned char byte1;
+	unsigned char byte2;
+	unsigned char byte3;
+	unsigned char byte4;
+	unsigned char byte5;
+	unsigned char byte6;
+	unsigned char byte7;
+	unsigned char byte8;
+	unsigned char byte9;
+	unsigned char byte10;
+	unsigned char byte11;
+	unsigned char byte12;
+	unsigned char byte13;
+	unsigned char byte14;
+	unsigned char byte15;
+} CFUUIDBytes;
+
+typedef CFUUIDBytes		REFIID;
+typedef int				HRESULT;
+typedef unsigned long	ULONG;
+typedef void*			LPVOID;
+
+#define STDMETHODCALLTYPE
+
+#define SUCCEEDED(Status)	((HRESULT)(Status) >= 0)
+#define FAILED(Status)		((HRESULT)(Status) < 0)
+
+#define S_OK				((HRESULT)0x00000000L)
+#define S_FALSE				((HRESULT)0x00000001L)
+#define E_UNEXPECTED		((HRESULT)0x8000FFFFL)
+#define E_NOTIMPL			((HRESULT)0x80000001L)
+#define E_OUTOFMEMORY		((HRESULT)0x80000002L)
+#define E_INVALIDARG		((HRESULT)0x80000003L)
+#define E_NOINTERFACE		((HRESULT)0x80000004L)
+#define E_POINTER			((HRESULT)0x80000005L)
+#define E_HANDLE			((HRESULT)0x80000006L)
+#define E_ABORT				((HRESULT)0x80000007L)
+#define E_FAIL				((HRESULT)0x80000008L)
+#define E_ACCESSDENIED		((HRESULT)0x80000009L)
+
+#if defined(__cplusplus)
+
+class IUnknown
+{
+public:
+	virtual ~IUnknown() {}
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) = 0;
+	virtual ULONG STDMETHODCALLTYPE AddRef(void) = 0;
+	virtual ULONG STDMETHODCALLTYPE Release(void) = 0;
+};
+
+#endif
+
+/* CoreFoundation subset */
+
+typedef const char*		CFStringRef;
+typedef const void*		CFTypeRef;
+typedef const void*		CFAllocatorRef;
+typedef uint32_t		CFStringEncoding;
+typedef long			CFIndex;
+typedef unsigned char	Boolean;
+
+#define kCFAllocatorDefault			((CFAllocatorRef)0)
+#define kCFStringEncodingMacRoman	((CFStringEncoding)0)
+#define kCFStringEncodingUTF8		((CFStringEncoding)0x08000100)
+
+// Strings are UTF-8 throughout, so the encoding arguments are ignored
+
+static inline CFStringRef CFStringCreateWithCString(CFAllocatorRef allocator, const char* cStr, CFStringEncoding encoding)
+{
+	(void)allocator;
+	(void)encoding;
+	return cStr != NULL ? strdup(cStr) : NULL;
+}
+
+static inline const char* CFStringGetCStringPtr(CFStringRef theString, CFStringEncoding encoding)
+{
+	(void)encoding;
+	return theString;
+}
+
+static inline Boolean CFStringGetCString(CFStringRef theString, char* buffer, CFIndex bufferSize, CFStringEncoding encoding)
+{
+	(void)encoding;
+	if (theString == NULL || buffer == NULL || bufferSize <= 0)
+		return 0;
+
+	size_t length = strlen(theString);
+	if (length >= (size_t)bufferSize)
+		return 0;
+
+	memcpy(buffer, theString, length + 1);
+	return 1;
+}
+
+static inline void CFRelease(CFTypeRef cf)
+{
+	free((void*)cf);
+}
+
+#endif /* BMD_LINUXCOM_H */
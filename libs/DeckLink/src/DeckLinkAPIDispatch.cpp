@@ -28,13 +28,21 @@
 
 #include "DeckLinkAPI.h"
 #include <pthread.h>
+#if !defined(__APPLE__)
+#include <dlfcn.h>
+#endif
 
 #if BLACKMAGIC_DECKLINK_API_MAGIC != 1
 	#error The DeckLink API version of DeckLinkAPIDispatch.cpp is not the same version as DeckLinkAPI.h
 #endif
 
+#if defined(__APPLE__)
 #define kDeckLinkAPI_BundlePath "/Library/Frameworks/DeckLinkAPI.framework"
-
+#else
+// Installed by the Desktop Video package; found through the usual library path
+#define kDeckLinkAPI_Name "libDeckLinkAPI.so"
+#define kDeckLinkPreviewAPI_Name "libDeckLinkPreviewAPI.so"
+#endif
 
 typedef IDeckLinkIterator* (*CreateIteratorFunc)(void);
 typedef IDeckLinkAPIInformation* (*CreateAPIInformationFunc)(void);
@@ -44,7 +52,12 @@ typedef IDeckLinkVideoConversion* (*CreateVideoConversionInstanceFunc)(void);
 typedef IDeckLinkDiscovery* (*CreateDeckLinkDiscoveryInstanceFunc)(void);
 
 static pthread_once_t						gDeckLinkOnceControl		= PTHREAD_ONCE_INIT;
+#if defined(__APPLE__)
 static CFBundleRef							gDeckLinkAPIBundleRef		= NULL;
+#else
+static void*								gDeckLinkAPIHandle			= NULL;
+static void*								gDeckLinkPreviewAPIHandle	= NULL;
+#endif
 static CreateIteratorFunc					gCreateIteratorFunc			= NULL;
 static CreateAPIInformationFunc				gCreateAPIInformationFunc	= NULL;
 static CreateOpenGLScreenPreviewHelperFunc	gCreateOpenGLPreviewFunc	= NULL;
@@ -53,6 +66,8 @@ static CreateVideoConversionInstanceFunc	gCreateVideoConversionFunc	= NULL;
 static CreateDeckLinkDiscoveryInstanceFunc  gCreateDeckLinkDiscoveryFunc= NULL;
 
 
+#if defined(__APPLE__)
+
 void	InitDeckLinkAPI (void)
 {
 	CFURLRef		bundleURL;
@@ -76,6 +91,8 @@ void	InitDeckLinkAPI (void)
 
 bool		IsDeckLinkAPIPresent (void)
 {
+	pthread_once(&gDeckLinkOnceControl, InitDeckLinkAPI);
+
 	// If the DeckLink API bundle was successfully loaded, return this knowledge to the caller
 	if (gDeckLinkAPIBundleRef != NULL)
 		return true;
@@ -83,6 +100,41 @@ bool		IsDeckLinkAPIPresent (void)
 	return false;
 }
 
+#else
+
+// Loading the library is deferred to the first call that needs it, so that
+// programs start quickly and still run on hosts without the driver
+void	InitDeckLinkAPI (void)
+{
+	gDeckLinkAPIHandle = dlopen(kDeckLinkAPI_Name, RTLD_NOW | RTLD_GLOBAL);
+	if (gDeckLinkAPIHandle == NULL)
+		return;
+
+	gCreateIteratorFunc = (CreateIteratorFunc)dlsym(gDeckLinkAPIHandle, "CreateDeckLinkIteratorInstance_0002");
+	gCreateAPIInformationFunc = (CreateAPIInformationFunc)dlsym(gDeckLinkAPIHandle, "CreateDeckLinkAPIInformationInstance_0001");
+	gCreateVideoConversionFunc = (CreateVideoConversionInstanceFunc)dlsym(gDeckLinkAPIHandle, "CreateVideoConversionInstance_0001");
+	gCreateDeckLinkDiscoveryFunc = (CreateDeckLinkDiscoveryInstanceFunc)dlsym(gDeckLinkAPIHandle, "CreateDeckLinkDiscoveryInstance_0001");
+
+	// The OpenGL preview helper lives in its own library, which may be missing
+	// on headless machines; Cocoa previews do not exist on Linux
+	gDeckLinkPreviewAPIHandle = dlopen(kDeckLinkPreviewAPI_Name, RTLD_NOW | RTLD_GLOBAL);
+	if (gDeckLinkPreviewAPIHandle != NULL)
+		gCreateOpenGLPreviewFunc = (CreateOpenGLScreenPreviewHelperFunc)dlsym(gDeckLinkPreviewAPIHandle, "CreateOpenGLScreenPreviewHelper_0001");
+}
+
+bool		IsDeckLinkAPIPresent (void)
+{
+	pthread_once(&gDeckLinkOnceControl, InitDeckLinkAPI);
+
+	// If the DeckLink API library was successfully loaded, return this knowledge to the caller
+	if (gDeckLinkAPIHandle != NULL)
+		return true;
+
+	return false;
+}
+
+#endif
+
 IDeckLinkIterator*		CreateDeckLinkIteratorInstance (void)
 {
 	pthread_once(&gDeckLinkOnceControl, InitDeckLinkAPI);
@@ -144,6 +196,8 @@ IDeckLinkDiscovery* CreateDeckLinkDiscoveryInstance (void)
 }
 
 
+#if defined(__APPLE__)
+
 #define kBMDStreamingAPI_BundlePath "/Library/Application Support/Blackmagic Design/Streaming/BMDStreamingAPI.bundle"
 
 typedef IBMDStreamingDiscovery* (*CreateDiscoveryFunc)(void);
@@ -191,3 +245,19 @@ IBMDStreamingH264NALParser* CreateBMDStreamingH264NALParser()
 
 	return gCreateNALParserFunc();
 }
+
+#else
+
+// The streaming encoders are only supported on macOS by this project
+
+IBMDStreamingDiscovery* CreateBMDStreamingDiscoveryInstance()
+{
+	return NULL;
+}
+
+IBMDStreamingH264NALParser* CreateBMDStreamingH264NALParser()
+{
+	return NULL;
+}
+
+#endif
@@ -1,12 +1,27 @@
 from setuptools import setup, Extension, find_packages
 import os
+import platform
 import sys
 import numpy as np
 
 # Platform-specific configuration
 is_macos = sys.platform == 'darwin'
-extra_compile_args = ['-std=c++11', '-g', '-Wno-unused-function', '-Wno-deprecated-declarations']
+is_x86_64 = platform.machine().lower() in ('x86_64', 'amd64')
+extra_compile_args = ['-std=c++11', '-g', '-Wno-unused-function', '-Wno-deprecated-declarations', '-Wno-multichar']
 extra_link_args = []
+libraries = []
+define_macros = []
+
+# Kernels for newer instruction sets need their own compiler flags, so they
+# are built as a separate library; the extension checks the CPU before use
+kernel_libraries = []
+if is_x86_64:
+    kernel_libraries.append(('bmcapture_kernels_avx2', {
+        'sources': ['src/bmcapture_convert_avx2.cpp'],
+        'include_dirs': ['src'],
+        'cflags': ['-std=c++11', '-O3', '-mavx2'],
+    }))
+    define_macros.append(('BMCAPTURE_HAVE_AVX2', '1'))
 
 # macOS-specific settings
 if is_macos:
@@ -21,6 +36,9 @@ if is_macos:
         '-framework', 'CoreVideo',
         '-framework', 'CoreMedia'
     ])
+else:
+    # The DeckLink driver is loaded with dlopen when it is first needed
+    libraries.append('dl')
 
 # Define extension module
 bmcapture_c_module = Extension(
@@ -28,6 +46,26 @@ bmcapture_c_module = Extension(
     sources=[
         'src/bmcapture_python.cpp',
         'src/bmcapture.cpp',
+        'src/bmcapture_arena.cpp',
+        'src/bmcapture_audio.cpp',
+        'src/bmcapture_codec.cpp',
+        'src/bmcapture_matroska.cpp',
+        'src/bmcapture_memory.cpp',
+        'src/bmcapture_mock.cpp',
+        'src/bmcapture_container.cpp',
+        'src/bmcapture_convert.cpp',
+        'src/bmcapture_frame_pool.cpp',
+        'src/bmcapture_log.cpp',
+        'src/bmcapture_perf.cpp',
+        'src/bmcapture_pretrigger.cpp',
+        'src/bmcapture_recorder.cpp',
+        'src/bmcapture_replay.cpp',
+        'src/bmcapture_rtp.cpp',
+        'src/bmcapture_server.cpp',
+        'src/bmcapture_stats.cpp',
+        'src/bmcapture_stream.cpp',
+        'src/bmcapture_timecode.cpp',
+        'src/bmcapture_trace.cpp',
         'libs/DeckLink/src/DeckLinkAPIDispatch.cpp'
     ],
     include_dirs=[
@@ -35,6 +73,8 @@ bmcapture_c_module = Extension(
         'libs/DeckLink/include',
         '.'
     ],
+    define_macros=define_macros,
+    libraries=libraries,
     extra_compile_args=extra_compile_args,
     extra_link_args=extra_link_args,
     language='c++'
@@ -42,4 +82,5 @@ bmcapture_c_module = Extension(
 
 setup(
     ext_modules=[bmcapture_c_module],
+    libraries=kernel_libraries,
 )
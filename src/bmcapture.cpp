@@ -1,5 +1,25 @@
 #include "bmcapture.h"
+#include "bmcapture_audio.h"
+#include "bmcapture_container.h"
+#include "bmcapture_convert.h"
+#include "bmcapture_frame.h"
+#include "bmcapture_frame_pool.h"
+#include "bmcapture_frame_sink.h"
+#include "bmcapture_log.h"
+#include "bmcapture_memory.h"
+#include "bmcapture_mock.h"
+#include "bmcapture_perf.h"
+#include "bmcapture_pretrigger.h"
+#include "bmcapture_recorder.h"
+#include "bmcapture_replay.h"
+#include "bmcapture_rtp.h"
+#include "bmcapture_server.h"
+#include "bmcapture_stats.h"
+#include "bmcapture_stream.h"
+#include "bmcapture_timecode.h"
+#include "bmcapture_trace.h"
 #include "DeckLinkAPI.h"
+#include <math.h>
 #include <vector>
 #include <string>
 #include <memory>
@@ -7,6 +27,9 @@
 #include <mutex>
 #include <condition_variable>
 
+// Defined in DeckLinkAPIDispatch.cpp; loads the driver on first use
+bool IsDeckLinkAPIPresent(void);
+
 // Forward declarations for C++ implementation
 struct BMCaptureChannel;
 
@@ -47,108 +70,47 @@ public:
     }
 };
 
-// Structure to store YUV -> RGB lookup tables for color conversion
-struct YUVConversionTables {
-    bool initialized = false;
-    uint8_t red[256][256];         // [v][y]
-    uint8_t green[256][256][256];  // [u][v][y]
-    uint8_t blue[256][256];        // [u][y]
-};
-
-// Structure for a captured frame
-struct CapturedFrame {
-    std::vector<uint8_t> yuv_data;
-    std::vector<uint8_t> rgb_data;
-    std::vector<uint8_t> gray_data;
-    bool rgb_updated = false;
-    bool gray_updated = false;
-    std::timed_mutex* mutex;  // Use a pointer to the mutex
-    int width = 0;
-    int height = 0;
-
-    // Default constructor initializes the mutex
-    CapturedFrame() : mutex(new std::timed_mutex()) {}
-
-    // Move constructor
-    CapturedFrame(CapturedFrame&& other) noexcept :
-        yuv_data(std::move(other.yuv_data)),
-        rgb_data(std::move(other.rgb_data)),
-        gray_data(std::move(other.gray_data)),
-        rgb_updated(other.rgb_updated),
-        gray_updated(other.gray_updated),
-        width(other.width),
-        height(other.height) {
-        mutex = other.mutex;
-        other.mutex = nullptr;  // Transfer ownership
-    }
-
-    // Move assignment operator
-    CapturedFrame& operator=(CapturedFrame&& other) noexcept {
-        if (this != &other) {
-            yuv_data = std::move(other.yuv_data);
-            rgb_data = std::move(other.rgb_data);
-            gray_data = std::move(other.gray_data);
-            rgb_updated = other.rgb_updated;
-            gray_updated = other.gray_updated;
-            width = other.width;
-            height = other.height;
-
-            // Handle the mutex
-            delete mutex;
-            mutex = other.mutex;
-            other.mutex = nullptr;  // Transfer ownership
-        }
-        return *this;
-    }
+// Pooled YUV buffers a capturing channel may hold at once: the triple
+// buffer, the priming copies and the frame in the callback
+static const size_t kCaptureFramesReserved = 6;
 
-    // Destructor to clean up the mutex
-    ~CapturedFrame() {
-        delete mutex;
-    }
+// Main context for the library
+struct BMContext {
+    // We might add more global state here in the future
+    IDeckLinkIterator* iterator;
+    std::shared_ptr<const MockConfig> mock;       // Set when the devices are simulated
+    MemoryAccount memory;
+    std::mutex tables_mutex;
+    std::unique_ptr<YUVConversionTables> tables;  // Built on first use, shared by every channel
+    bool tables_reserved = false;                 // Counted against the budget once, for the context's lifetime
 
-    // Delete copy constructor and assignment operator
-    CapturedFrame(const CapturedFrame&) = delete;
-    CapturedFrame& operator=(const CapturedFrame&) = delete;
-};
+    // Lookup tables for yuv_to_rgb, built the first time they are needed, or
+    // NULL if the RGB kernel for this CPU does without them
+    YUVConversionTables* conversionTables();
 
-// Triple buffer implementation
-template <typename T>
-class TripleBuffer {
-private:
-    T buffers[3];
-    int back = 0;
-    int middle = 1;
-    int front = 2;
-    std::mutex mutex;
+    // Reserve room for the lookup tables the first time a channel starts, if
+    // the RGB kernel uses them
+    bool reserveTables();
 
-public:
-    bool swapBack(T& data) {
-        std::lock_guard<std::mutex> lock(mutex);
-        // Move the data to the back buffer
-        buffers[back] = std::move(data);
-        std::swap(back, middle);
-        return true;
-    }
+    // The driver is loaded the first time devices are looked up, not here,
+    // so creating a context stays fast and works without the driver
+    BMContext() : iterator(nullptr) {}
 
-    bool swapFront() {
-        std::lock_guard<std::mutex> lock(mutex);
-        std::swap(middle, front);
-        return true;
-    }
+    explicit BMContext(std::shared_ptr<const MockConfig> mock_config)
+        : iterator(nullptr), mock(std::move(mock_config)) {}
 
-    T& getFront() {
-        return buffers[front];
+    // A fresh iterator over the driver's devices, or the mock ones
+    IDeckLinkIterator* createIterator() {
+        return mock ? mock_create_iterator(mock) : CreateDeckLinkIteratorInstance();
     }
-};
-
-// Main context for the library
-struct BMContext {
-    // We might add more global state here in the future
-    IDeckLinkIterator* iterator;
 
-    BMContext() : iterator(nullptr) {
-        // Initialize DeckLink SDK here
-        iterator = CreateDeckLinkIteratorInstance();
+    // Start over from the first device, or NULL without the driver
+    IDeckLinkIterator* resetIterator() {
+        if (iterator) {
+            iterator->Release();
+        }
+        iterator = createIterator();
+        return iterator;
     }
 
     ~BMContext() {
@@ -156,7 +118,9 @@ struct BMContext {
             iterator->Release();
             iterator = nullptr;
         }
-        // Cleanup other resources if needed
+        if (tables) {
+            memory.release(MEMORY_TABLES, sizeof(YUVConversionTables));
+        }
     }
 };
 
@@ -171,7 +135,6 @@ struct BMCaptureDevice {
     BMCaptureCallback* callback = nullptr;
     std::vector<BMCaptureChannel*> channels;  // Store all channels associated with this device
     TripleBuffer<CapturedFrame> buffer;
-    YUVConversionTables yuv_tables;
     int width = 0;
     int height = 0;
     bool capturing = false;
@@ -180,29 +143,19 @@ struct BMCaptureDevice {
     BMCaptureDevice() = default;
 
     ~BMCaptureDevice() {
-        fprintf(stderr, "E.1\n");
         // Channels should be deleted by the caller
         if (input) {
+            log_debug("Stopping device input");
             input->StopStreams();
             input->DisableVideoInput();
             input->SetCallback(nullptr);
             input->Release();
             input = nullptr;
         }
-        fprintf(stderr, "E.2\n");
         // Clean up callback object
         delete callback;
         callback = nullptr;
-        fprintf(stderr, "E.3\n");
-
-        // if (device) {
-        //     fprintf(stderr, "E.3.1\n");
-        //     device->Release();
-        //     fprintf(stderr, "E.3.2\n");
-        //     device = nullptr;
-        //     fprintf(stderr, "E.3.3\n");
-        // }
-        fprintf(stderr, "E.4\n");
+        log_debug("Device released");
     }
 };
 
@@ -241,11 +194,34 @@ public:
 #include <chrono>
 
 struct BMCaptureChannel {
+    BMContext* context = nullptr;
     BMCaptureDevice* parent_device = nullptr;
     IDeckLinkInput* input = nullptr;
     BMChannelCallback* callback = nullptr;
     TripleBuffer<CapturedFrame> buffer;
-    YUVConversionTables yuv_tables;
+    FramePool frame_pool;
+    size_t capture_reservation = 0;     // Bytes reserved against the memory budget by each activity
+    size_t recording_reservation = 0;
+    size_t pretrigger_reservation = 0;
+    size_t stream_reservation = 0;
+    size_t server_reservation = 0;
+    size_t rtp_reservation = 0;
+    std::mutex sink_mutex;           // Guards sinks against the callback thread
+    std::vector<FrameSink*> sinks;   // Consumers of raw frames, fed from the callback
+    std::unique_ptr<FrameRecorder> recorder;
+    std::unique_ptr<PreTriggerBuffer> pretrigger;
+    std::unique_ptr<FrameStreamer> streamer;
+    std::unique_ptr<FrameServer> server;
+    std::unique_ptr<RtpSender> rtp;
+    std::unique_ptr<ReplaySource> replay;   // Set for replay channels, which have no device
+    bool audio_enabled = false;      // Capture embedded audio with audio_options
+    BMAudioOptions audio_options;
+    AudioRing audio;                 // Written by the callback while capturing with audio
+    ChannelStats stats;
+    std::mutex delivered_mutex;      // Guards the record of the last delivered frame
+    bool has_delivered = false;
+    BMFrameInfo delivered_info;
+    BMFrameLatency delivered_latency;
     int width = 0;
     int height = 0;
     int port_index = 0;
@@ -258,11 +234,14 @@ struct BMCaptureChannel {
     int max_lost_frames = 5;         // Maximum lost frames before signal is considered unstable
     std::chrono::time_point<std::chrono::steady_clock> last_frame_time;
     BMCaptureMode capture_mode = BM_LOW_LATENCY;
+    BMDTimeScale time_scale = 1000000;  // Stream time units per second, taken from the display mode
+    BMDTimeValue frame_duration = 0;    // Nominal frame duration in time_scale units
 
-    BMCaptureChannel(BMCaptureDevice* device, int port)
-        : parent_device(device), port_index(port) {
+    BMCaptureChannel(BMContext* owner, BMCaptureDevice* device, int port)
+        : context(owner), parent_device(device), port_index(port) {
         callback = new BMChannelCallback(this);
         last_frame_time = std::chrono::steady_clock::now();
+        frame_pool.setMemoryAccount(&context->memory, MEMORY_FRAME_POOLS);
     }
 
     ~BMCaptureChannel() {
@@ -271,6 +250,9 @@ struct BMCaptureChannel {
             if (input) {
                 input->StopStreams();
                 input->DisableVideoInput();
+                if (audio.enabled()) {
+                    input->DisableAudioInput();
+                }
                 input->SetCallback(nullptr);
                 input->Release();
                 input = nullptr;
@@ -278,9 +260,113 @@ struct BMCaptureChannel {
             capturing = false;
         }
 
+        // The replay thread calls into the callback, so it must finish first
+        if (replay) {
+            replay->stop();
+        }
+
+        stopRecording();
+        stopPreTrigger();
+        stopStream();
+        stopServer();
+        stopRtp();
+        releaseReservation(capture_reservation);
         delete callback;
     }
 
+    // Reserve memory for an activity, failing if the context's budget is exhausted
+    bool reserve(size_t& reservation, size_t bytes, const char* purpose) {
+        releaseReservation(reservation);
+        if (!context->memory.reserve(bytes, purpose)) {
+            return false;
+        }
+        reservation = bytes;
+        return true;
+    }
+
+    void releaseReservation(size_t& reservation) {
+        context->memory.unreserve(reservation);
+        reservation = 0;
+    }
+
+    // Store an audio packet in the ring at its stream position
+    void writeAudio(IDeckLinkAudioInputPacket* packet) {
+        void* samples = nullptr;
+        long frame_count = packet->GetSampleFrameCount();
+        if (frame_count <= 0 || packet->GetBytes(&samples) != S_OK || samples == nullptr) {
+            return;
+        }
+        BMDTimeValue position = 0;
+        bool has_position = packet->GetPacketTime(&position, kAudioSampleRate) == S_OK;
+        audio.write(samples, (uint32_t)frame_count, has_position, position);
+    }
+
+    void addSink(FrameSink* sink) {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        sinks.push_back(sink);
+    }
+
+    void removeSink(FrameSink* sink) {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        sinks.erase(std::remove(sinks.begin(), sinks.end(), sink), sinks.end());
+    }
+
+    // Hand a freshly captured frame to every sink; sinks only queue a reference
+    void dispatchToSinks(const FrameData& data, const FrameInfo& info) {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        for (FrameSink* sink : sinks) {
+            sink->onFrame(data, info);
+        }
+    }
+
+    // Detach the recorder and let it flush its queue; the object is kept for its stats
+    void stopRecording() {
+        if (recorder) {
+            removeSink(recorder.get());
+            recorder->close();
+        }
+        releaseReservation(recording_reservation);
+    }
+
+    // Close the stream before detaching it: with BM_STREAM_BLOCK the callback
+    // may be waiting inside it while holding sink_mutex
+    void stopStream() {
+        if (streamer) {
+            streamer->close();
+            removeSink(streamer.get());
+        }
+        releaseReservation(stream_reservation);
+    }
+
+    // Detach the frame server and move capture back to private buffers;
+    // frames still leased or queued return their slots when released
+    void stopServer() {
+        if (server) {
+            removeSink(server.get());
+            frame_pool.setArena(nullptr);
+            server->close();
+        }
+        releaseReservation(server_reservation);
+    }
+
+    // Detach the RTP sender; the frame being sent is finished, queued ones are dropped
+    void stopRtp() {
+        if (rtp) {
+            removeSink(rtp.get());
+            rtp->close();
+        }
+        releaseReservation(rtp_reservation);
+    }
+
+    // Detach the pre-trigger ring, finishing any dump in progress
+    void stopPreTrigger() {
+        if (pretrigger) {
+            removeSink(pretrigger.get());
+            pretrigger->stop();
+        }
+        releaseReservation(pretrigger_reservation);
+    }
+
     // Check if the channel has a locked signal with valid frames
     bool hasValidSignal() const {
         // Signal is considered locked if:
@@ -315,42 +401,6 @@ struct BMCaptureChannel {
         }
     }
 
-    // Prime the buffer to make frames available faster at startup
-    void primeBuffer(CapturedFrame& frame) {
-        // Create a deep copy of the frame for each buffer to avoid reference issues
-        CapturedFrame back_frame = createFrameCopy(frame);
-        buffer.swapBack(back_frame);
-
-        // Move to front buffer right away - triple buffer design needs this
-        buffer.swapFront();
-    }
-
-    // Create a deep copy of a frame
-    CapturedFrame createFrameCopy(const CapturedFrame& src) {
-        CapturedFrame copy;
-
-        // Copy basic properties
-        copy.width = src.width;
-        copy.height = src.height;
-        copy.rgb_updated = src.rgb_updated;
-        copy.gray_updated = src.gray_updated;
-
-        // Deep copy of data buffers
-        if (!src.yuv_data.empty()) {
-            copy.yuv_data = src.yuv_data; // std::vector handles deep copy
-        }
-
-        if (!src.rgb_data.empty()) {
-            copy.rgb_data = src.rgb_data;
-        }
-
-        if (!src.gray_data.empty()) {
-            copy.gray_data = src.gray_data;
-        }
-
-        return copy;
-    }
-
     // Check if we're getting frames at the expected rate
     bool isFrameRateStable() const {
         if (frame_count < 10) return false; // Need minimum frames to determine
@@ -399,9 +449,15 @@ HRESULT STDMETHODCALLTYPE BMCaptureCallback::VideoInputFrameArrived(
     frame.width = width;
     frame.height = height;
 
-    // Copy YUV data
+    // Copy YUV data into a pooled buffer
+    if (channel == nullptr) {
+        return S_OK;
+    }
     size_t dataSize = height * rowBytes;
-    frame.yuv_data.resize(dataSize);
+    frame.yuv_data = channel->frame_pool.acquire(dataSize);
+    if (frame.yuv_data.empty()) {
+        return S_OK;
+    }
     memcpy(frame.yuv_data.data(), frameBytes, dataSize);
 
     // Mark RGB and gray data as needing update
@@ -409,9 +465,7 @@ HRESULT STDMETHODCALLTYPE BMCaptureCallback::VideoInputFrameArrived(
     frame.gray_updated = false;
 
     // Add to triple buffer using move semantics
-    if (channel != nullptr) {
-        channel->buffer.swapBack(frame);
-    }
+    channel->buffer.swapBack(frame);
 
     return S_OK;
 }
@@ -429,19 +483,39 @@ HRESULT STDMETHODCALLTYPE BMChannelCallback::VideoInputFrameArrived(
     IDeckLinkVideoInputFrame* videoFrame,
     IDeckLinkAudioInputPacket* audioPacket) {
 
-    if (videoFrame == nullptr || channel == nullptr) {
+    if (channel == nullptr) {
+        return S_OK;
+    }
+
+    // Audio goes in first, so a frame's samples are there by the time the frame is
+    if (audioPacket != nullptr && channel->audio.enabled()) {
+        TraceSpan audio_span(TRACE_AUDIO);
+        channel->writeAudio(audioPacket);
+    }
+
+    if (videoFrame == nullptr) {
         return S_OK;
     }
 
+    ChannelStats& stats = channel->stats;
+    int64_t callback_start = ChannelStats::now();
+    ChannelStats::count(stats.frames_arrived);
+    trace_name_thread("capture callback");
+    TraceSpan callback_span(TRACE_CALLBACK);
+
     // Check frame flags to determine if we have a valid signal
     BMDFrameFlags flags = videoFrame->GetFlags();
     bool has_valid_frame = !(flags & bmdFrameHasNoInputSource);
+    if (!has_valid_frame) {
+        ChannelStats::count(stats.frames_no_signal);
+    }
 
     // Update our signal status tracking
     channel->updateSignalStatus(has_valid_frame);
 
     // Increment frame counter - useful for startup synchronization
     channel->frame_count++;
+    callback_span.setArg(channel->frame_count);
 
     // Get frame dimensions
     long width = videoFrame->GetWidth();
@@ -457,126 +531,167 @@ HRESULT STDMETHODCALLTYPE BMChannelCallback::VideoInputFrameArrived(
     void* frameBytes;
     if (videoFrame->GetBytes(&frameBytes) != S_OK || frameBytes == nullptr) {
         // Cannot get frame data
+        ChannelStats::count(stats.frames_dropped);
+        stats.callback_time.record(ChannelStats::now() - callback_start);
         return S_OK;
     }
 
     // Prepare captured frame
-    CapturedFrame frame;
+    CapturedFrame frame(&channel->context->memory);
     frame.width = width;
     frame.height = height;
 
-    // Copy YUV data
+    // Copy YUV data into a pooled buffer; this is the only copy of the pixels
     size_t dataSize = height * rowBytes;
-    frame.yuv_data.resize(dataSize);
-    memcpy(frame.yuv_data.data(), frameBytes, dataSize);
+    frame.yuv_data = channel->frame_pool.acquire(dataSize);
+    if (frame.yuv_data.empty()) {
+        ChannelStats::count(stats.frames_dropped);
+        stats.callback_time.record(ChannelStats::now() - callback_start);
+        return S_OK;
+    }
+    {
+        TraceSpan copy_span(TRACE_FRAME_COPY, channel->frame_count);
+        PerfRegion copy_region(stats.copy_counters, stats.perf_enabled.load(std::memory_order_relaxed), 2 * dataSize);
+        memcpy(frame.yuv_data.data(), frameBytes, dataSize);
+    }
 
     // Mark RGB and gray data as needing update
     frame.rgb_updated = false;
     frame.gray_updated = false;
 
-    // Add to triple buffer using move semantics
-    channel->buffer.swapBack(frame);
+    // Let recorders and other sinks take their own reference to the buffer
+    FrameInfo info;
+    info.width = width;
+    info.height = height;
+    info.row_bytes = rowBytes;
+    info.pixel_format = videoFrame->GetPixelFormat();
+    info.flags = flags;
+    info.sequence = channel->frame_count;
+    info.time_scale = channel->time_scale;
+    BMDTimeValue stream_time = 0;
+    BMDTimeValue frame_duration = 0;
+    if (videoFrame->GetStreamTime(&stream_time, &frame_duration, channel->time_scale) == S_OK) {
+        info.stream_time = stream_time;
+        info.frame_duration = frame_duration;
+        stats.recordStreamTime(stream_time, frame_duration);
+    }
+    // Frames still queued in the driver mean the callback is falling behind the card
+    uint32_t queued_frames = 0;
+    if (channel->input != nullptr && channel->input->GetAvailableVideoFrameCount(&queued_frames) == S_OK) {
+        stats.recordDriverQueue(queued_frames);
+    }
+    // Straight into the frame's metadata; sinks and the delivered frame get copies
+    timecode_read_frame(videoFrame, info.timecodes, &info.timecode);
+    BMDTimeValue hardware_time = 0;
+    BMDTimeValue hardware_duration = 0;
+    if (videoFrame->GetHardwareReferenceTimestamp(BM_HARDWARE_TIME_SCALE, &hardware_time, &hardware_duration) == S_OK) {
+        info.hardware_timestamp = hardware_time;
+    }
+    info.arrival_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        channel->last_frame_time.time_since_epoch()).count();
+    info.signal_locked = channel->signal_locked;
+    {
+        TraceSpan sinks_span(TRACE_SINKS, info.sequence);
+        channel->dispatchToSinks(frame.yuv_data, info);
+    }
+
+    // Work out when the frame was captured from how old its hardware timestamp
+    // is now; replay sources stamp frames with the steady clock directly
+    frame.info = info;
+    frame.capture_ns = info.arrival_ns;
+    if (info.hardware_timestamp != 0) {
+        BMDTimeValue hardware_now = 0;
+        BMDTimeValue time_in_frame = 0;
+        BMDTimeValue ticks_per_frame = 0;
+        if (channel->replay) {
+            frame.capture_ns = info.hardware_timestamp;
+        } else if (channel->input != nullptr &&
+                   channel->input->GetHardwareReferenceClock(BM_HARDWARE_TIME_SCALE, &hardware_now,
+                                                             &time_in_frame, &ticks_per_frame) == S_OK) {
+            frame.capture_ns = info.arrival_ns - (hardware_now - info.hardware_timestamp);
+        }
+        if (frame.capture_ns > info.arrival_ns) {
+            frame.capture_ns = info.arrival_ns;
+        }
+    }
+    frame.buffered_ns = ChannelStats::now();
 
-    // For the first few frames, also prime the buffer to make frames available immediately
-    if (channel->frame_count <= channel->min_frames_for_lock) {
-        // Prime the middle and front buffers too
-        channel->primeBuffer(frame);
+    // Add to triple buffer using move semantics
+    {
+        TraceSpan swap_span(TRACE_SWAP_BACK, info.sequence);
+        if (channel->buffer.swapBack(frame)) {
+            ChannelStats::count(stats.frames_overwritten);
+        }
     }
 
+    stats.callback_time.record(ChannelStats::now() - callback_start);
     return S_OK;
 }
 
-// Utility functions for color conversion
-static uint8_t clamp(int value) {
-    if (value > 255) return 255;
-    if (value < 0) return 0;
-    return (uint8_t)value;
-}
-
-static void initialize_yuv_tables(YUVConversionTables* tables) {
-    if (tables->initialized) {
-        return;
-    }
-
-    int yy, uu, vv, ug_plus_vg, ub, vr, val;
-
-    // Generate red component lookup table [v][y]
-    for (int y = 0; y < 256; y++) {
-        for (int v = 0; v < 256; v++) {
-            yy = y << 8;
-            vv = v - 128;
-            vr = vv * 359;
-            val = (yy + vr) >> 8;
-            tables->red[v][y] = clamp(val);
-        }
+YUVConversionTables* BMContext::conversionTables() {
+    if (!yuv_to_rgb_needs_tables()) {
+        return nullptr;
     }
 
-    // Generate green component lookup table [u][v][y]
-    for (int y = 0; y < 256; y++) {
-        for (int u = 0; u < 256; u++) {
-            for (int v = 0; v < 256; v++) {
-                yy = y << 8;
-                uu = u - 128;
-                vv = v - 128;
-                ug_plus_vg = uu * 88 + vv * 183;
-                val = (yy - ug_plus_vg) >> 8;
-                tables->green[u][v][y] = clamp(val);
-            }
-        }
+    std::lock_guard<std::mutex> lock(tables_mutex);
+    if (!tables) {
+        tables.reset(new YUVConversionTables());
+        memory.charge(MEMORY_TABLES, sizeof(YUVConversionTables));
+        initialize_yuv_tables(tables.get());
     }
+    return tables.get();
+}
 
-    // Generate blue component lookup table [u][y]
-    for (int y = 0; y < 256; y++) {
-        for (int u = 0; u < 256; u++) {
-            yy = y << 8;
-            uu = u - 128;
-            ub = uu * 454;
-            val = (yy + ub) >> 8;
-            tables->blue[u][y] = clamp(val);
-        }
+bool BMContext::reserveTables() {
+    if (!yuv_to_rgb_needs_tables()) {
+        return true;
     }
 
-    tables->initialized = true;
-}
-
-static void yuv_to_gray(const uint8_t* yuv, uint8_t* gray, unsigned int pixel_count) {
-    // YUV is in cb-y0-cr-y1 format, extract only y values
-    for (unsigned int i = 0, j = 1; i < pixel_count; i++, j += 2) {
-        gray[i] = yuv[j];
+    std::lock_guard<std::mutex> lock(tables_mutex);
+    if (tables_reserved) {
+        return true;
     }
+    tables_reserved = memory.reserve(sizeof(YUVConversionTables), "RGB conversion tables");
+    return tables_reserved;
 }
 
-static void yuv_to_rgb(const uint8_t* yuv, uint8_t* rgb, unsigned int pixel_count, YUVConversionTables* tables) {
-    initialize_yuv_tables(tables);
+// Implementation of the API functions
 
-    uint8_t u, y0, v, y1;
-    unsigned int yuv_size = 2 * pixel_count;
+BMContext* bm_create_context(void) {
+    // Without the DeckLink driver the context reports no devices, but replay
+    // channels still work
+    return new BMContext();
+}
 
-    for (unsigned int i = 0, j = 0; i < yuv_size; i += 4, j += 6) {
-        u = yuv[i+0];
-        y0 = yuv[i+1];
-        v = yuv[i+2];
-        y1 = yuv[i+3];
+BMContext* bm_create_mock_context(const BMMockOptions* options) {
+    BMMockOptions mock_options;
+    if (options != nullptr) {
+        mock_options = *options;
+    } else {
+        bm_mock_options_init(&mock_options);
+    }
 
-        rgb[j+0] = tables->red[v][y0];      // R0
-        rgb[j+1] = tables->green[u][v][y0]; // G0
-        rgb[j+2] = tables->blue[u][y0];     // B0
+    std::shared_ptr<const MockConfig> config = mock_configure(mock_options);
+    if (!config) {
+        return nullptr;
+    }
+    return new BMContext(config);
+}
 
-        rgb[j+3] = tables->red[v][y1];      // R1
-        rgb[j+4] = tables->green[u][v][y1]; // G1
-        rgb[j+5] = tables->blue[u][y1];     // B1
+BMContext* bm_create_context_or_mock(const BMMockOptions* options) {
+    if (bm_driver_available()) {
+        return bm_create_context();
     }
+    log_warning("DeckLink driver not found, using mock devices");
+    return bm_create_mock_context(options);
 }
 
-// Implementation of the API functions
+bool bm_context_is_mock(BMContext* context) {
+    return context != nullptr && context->mock != nullptr;
+}
 
-BMContext* bm_create_context(void) {
-    BMContext* context = new BMContext();
-    if (context->iterator == nullptr) {
-        delete context;
-        return nullptr;
-    }
-    return context;
+bool bm_driver_available(void) {
+    return IsDeckLinkAPIPresent();
 }
 
 void bm_free_context(BMContext* context) {
@@ -586,19 +701,13 @@ void bm_free_context(BMContext* context) {
 }
 
 int bm_get_device_count(BMContext* context) {
-    if (context == nullptr || context->iterator == nullptr) {
+    if (context == nullptr) {
         return 0;
     }
 
     int count = 0;
     IDeckLink* device = nullptr;
-    IDeckLinkIterator* iterator = context->iterator;
-
-    // Reset the iterator to the beginning
-    iterator->Release();
-    context->iterator = CreateDeckLinkIteratorInstance();
-    iterator = context->iterator;
-
+    IDeckLinkIterator* iterator = context->resetIterator();
     if (iterator == nullptr) {
         return 0;
     }
@@ -616,16 +725,7 @@ bool bm_get_device_name(BMContext* context, int device_index, char* name_buffer,
         return false;
     }
 
-    IDeckLinkIterator* iterator = context->iterator;
-    if (iterator == nullptr) {
-        return false;
-    }
-
-    // Reset the iterator to the beginning
-    iterator->Release();
-    context->iterator = CreateDeckLinkIteratorInstance();
-    iterator = context->iterator;
-
+    IDeckLinkIterator* iterator = context->resetIterator();
     if (iterator == nullptr) {
         return false;
     }
@@ -662,16 +762,7 @@ int bm_get_input_port_count(BMContext* context, int device_index) {
         return -1;
     }
 
-    IDeckLinkIterator* iterator = context->iterator;
-    if (iterator == nullptr) {
-        return -1;
-    }
-
-    // Reset the iterator to the beginning
-    iterator->Release();
-    context->iterator = CreateDeckLinkIteratorInstance();
-    iterator = context->iterator;
-
+    IDeckLinkIterator* iterator = context->resetIterator();
     if (iterator == nullptr) {
         return -1;
     }
@@ -724,16 +815,7 @@ bool bm_get_input_port_name(BMContext* context, int device_index, int port_index
         return false;
     }
 
-    IDeckLinkIterator* iterator = context->iterator;
-    if (iterator == nullptr) {
-        return false;
-    }
-
-    // Reset the iterator to the beginning
-    iterator->Release();
-    context->iterator = CreateDeckLinkIteratorInstance();
-    iterator = context->iterator;
-
+    IDeckLinkIterator* iterator = context->resetIterator();
     if (iterator == nullptr) {
         return false;
     }
@@ -794,16 +876,7 @@ BMCaptureDevice* bm_create_device(BMContext* context, int device_index) {
         return nullptr;
     }
 
-    IDeckLinkIterator* iterator = context->iterator;
-    if (iterator == nullptr) {
-        return nullptr;
-    }
-
-    // Reset the iterator to the beginning
-    iterator->Release();
-    context->iterator = CreateDeckLinkIteratorInstance();
-    iterator = context->iterator;
-
+    IDeckLinkIterator* iterator = context->resetIterator();
     if (iterator == nullptr) {
         return nullptr;
     }
@@ -898,7 +971,7 @@ bool bm_select_input_port(BMContext* context, BMCaptureDevice* device, int port_
 
 bool bm_start_capture(BMContext* context, BMCaptureDevice* device, int width, int height, float framerate, BMCaptureMode mode) {
     if (context == nullptr || device == nullptr || device->device == nullptr) {
-        fprintf(stderr, "Error: Invalid device handle\n");
+        log_error("Invalid device handle");
         return false;
     }
 
@@ -913,7 +986,7 @@ bool bm_start_capture(BMContext* context, BMCaptureDevice* device, int width, in
     // Get the IDeckLinkInput interface
     HRESULT result = device->device->QueryInterface(IID_IDeckLinkInput, (void**)&device->input);
     if (result != S_OK) {
-        fprintf(stderr, "Error: Failed to get DeckLink input interface (error code: %ld)\n", (long)result);
+        log_error("Failed to get DeckLink input interface (error code: %ld)", (long)result);
         return false;
     }
 
@@ -924,7 +997,7 @@ bool bm_start_capture(BMContext* context, BMCaptureDevice* device, int width, in
     IDeckLinkDisplayModeIterator* display_mode_iterator = nullptr;
     result = device->input->GetDisplayModeIterator(&display_mode_iterator);
     if (result != S_OK) {
-        fprintf(stderr, "Error: Failed to get display mode iterator (error code: %ld)\n", (long)result);
+        log_error("Failed to get display mode iterator (error code: %ld)", (long)result);
         device->input->Release();
         device->input = nullptr;
         return false;
@@ -936,7 +1009,7 @@ bool bm_start_capture(BMContext* context, BMCaptureDevice* device, int width, in
     bool found_matching_mode = false;
 
     // Create a list of available modes for error reporting
-    fprintf(stderr, "Available display modes:\n");
+    log_debug("Available display modes:");
 
     while (display_mode_iterator->Next(&display_mode) == S_OK) {
         BMDTimeValue time_value;
@@ -959,12 +1032,9 @@ bool bm_start_capture(BMContext* context, BMCaptureDevice* device, int width, in
                 CFRelease(mode_name_ref);
             }
 
-            fprintf(stderr, "  - %ldx%ld @ %.2f fps (%s)\n",
+            log_debug("  - %ldx%ld @ %.2f fps (%s), raw frame rate %lld/%lld",
                     display_mode->GetWidth(), display_mode->GetHeight(),
-                    mode_framerate, mode_name_buffer);
-
-            // Store the raw frame rate components for debugging
-            fprintf(stderr, "    (raw frame rate: %lld/%lld)\n", (long long)time_value, (long long)time_scale);
+                    mode_framerate, mode_name_buffer, (long long)time_value, (long long)time_scale);
 
             // Check if this mode matches our requested parameters
             // Use a small epsilon for floating point comparison
@@ -991,9 +1061,13 @@ bool bm_start_capture(BMContext* context, BMCaptureDevice* device, int width, in
             }
 
             if (width_match && height_match && framerate_match) {
-                fprintf(stderr, "  * Found matching mode: %ldx%ld @ %.2f fps (%s)\n",
+                log_info("Found matching mode: %ldx%ld @ %.2f fps (%s)",
                         display_mode->GetWidth(), display_mode->GetHeight(),
                         mode_framerate, mode_name_buffer);
+                // 29.97 and 30 fps both match a request for 30, keep the last
+                if (selected_mode != nullptr) {
+                    selected_mode->Release();
+                }
                 selected_mode = display_mode;
                 selected_mode_id = display_mode->GetDisplayMode();
                 found_matching_mode = true;
@@ -1007,7 +1081,7 @@ bool bm_start_capture(BMContext* context, BMCaptureDevice* device, int width, in
     display_mode_iterator->Release();
 
     if (!found_matching_mode) {
-        fprintf(stderr, "Error: No matching display mode found for %dx%d @ %.2f fps\n",
+        log_error("No matching display mode found for %dx%d @ %.2f fps",
                 width, height, framerate);
         device->input->Release();
         device->input = nullptr;
@@ -1020,23 +1094,23 @@ bool bm_start_capture(BMContext* context, BMCaptureDevice* device, int width, in
 
     result = device->input->EnableVideoInput(selected_mode_id, pixel_format, input_flags);
     if (result != S_OK) {
-        fprintf(stderr, "Error: Failed to enable video input (error code: %ld)\n", (long)result);
-
         // Provide more specific error messages based on common error codes
+        const char* reason;
         switch (result) {
             case E_INVALIDARG:
-                fprintf(stderr, "  - Invalid argument (check display mode and pixel format)\n");
+                reason = "invalid argument (check display mode and pixel format)";
                 break;
             case E_ACCESSDENIED:
-                fprintf(stderr, "  - Access denied (device may be in use by another application)\n");
+                reason = "access denied (device may be in use by another application)";
                 break;
             case E_OUTOFMEMORY:
-                fprintf(stderr, "  - Out of memory\n");
+                reason = "out of memory";
                 break;
             default:
-                fprintf(stderr, "  - Hardware error or unsupported configuration\n");
+                reason = "hardware error or unsupported configuration";
                 break;
         }
+        log_error("Failed to enable video input (error code: %ld): %s", (long)result, reason);
 
         selected_mode->Release();
         device->input->Release();
@@ -1049,17 +1123,11 @@ bool bm_start_capture(BMContext* context, BMCaptureDevice* device, int width, in
     // Start the stream
     result = device->input->StartStreams();
     if (result != S_OK) {
-        fprintf(stderr, "Error: Failed to start capture streams (error code: %ld)\n", (long)result);
-
         // Provide more specific error messages
-        switch (result) {
-            case E_ACCESSDENIED:
-                fprintf(stderr, "  - Access denied (device may be in use by another application)\n");
-                break;
-            default:
-                fprintf(stderr, "  - Hardware error or device disconnected\n");
-                break;
-        }
+        const char* reason = result == E_ACCESSDENIED
+            ? "access denied (device may be in use by another application)"
+            : "hardware error or device disconnected";
+        log_error("Failed to start capture streams (error code: %ld): %s", (long)result, reason);
 
         device->input->DisableVideoInput();
         device->input->Release();
@@ -1128,7 +1196,7 @@ bool bm_get_frame(BMContext* context, BMCaptureDevice* device, BMPixelFormat for
             if (!frame.rgb_updated && !frame.yuv_data.empty()) {
                 unsigned int pixel_count = frame.width * frame.height;
                 frame.rgb_data.resize(pixel_count * 3);
-                yuv_to_rgb(frame.yuv_data.data(), frame.rgb_data.data(), pixel_count, &device->yuv_tables);
+                yuv_to_rgb(frame.yuv_data.data(), frame.rgb_data.data(), pixel_count, context->conversionTables());
                 frame.rgb_updated = true;
             }
 
@@ -1207,11 +1275,10 @@ void bm_stop_capture(BMContext* context, BMCaptureDevice* device) {
 }
 
 void bm_destroy_device(BMContext* context, BMCaptureDevice* device) {
-    fprintf(stderr, "A: %x\n", device);
     if (context == nullptr || device == nullptr) {
         return;
     }
-    fprintf(stderr, "B\n");
+    log_debug("Destroying device %p with %zu channels", (void*)device, device->channels.size());
     // Clean up all channels
     for (auto* channel : device->channels) {
         if (channel->capturing) {
@@ -1219,16 +1286,12 @@ void bm_destroy_device(BMContext* context, BMCaptureDevice* device) {
         }
         delete channel;
     }
-    fprintf(stderr, "C\n");
     device->channels.clear();
-    fprintf(stderr, "D\n");
     // Clean up the device
     if (device->device != nullptr) {
         device->device->Release();
     }
-    fprintf(stderr, "E\n");
     delete device;
-    fprintf(stderr, "F\n");
 }
 
 // Multi-channel API implementation
@@ -1267,7 +1330,7 @@ BMCaptureChannel* bm_create_channel(BMContext* context, BMCaptureDevice* device,
     }
 
     // Create the channel object
-    BMCaptureChannel* channel = new BMCaptureChannel(device, port_index);
+    BMCaptureChannel* channel = new BMCaptureChannel(context, device, port_index);
 
     // Add the channel to the device's channel list
     device->channels.push_back(channel);
@@ -1275,11 +1338,12 @@ BMCaptureChannel* bm_create_channel(BMContext* context, BMCaptureDevice* device,
     return channel;
 }
 
-bool bm_start_channel_capture(BMContext* context, BMCaptureChannel* channel,
-                             int width, int height, float framerate, BMCaptureMode mode) {
-    if (context == nullptr || channel == nullptr || channel->parent_device == nullptr ||
-        channel->parent_device->device == nullptr) {
-        fprintf(stderr, "Error: Invalid channel handle\n");
+// Everything bm_start_channel_capture does; a failure may leave capture_reservation held
+static bool start_channel_capture(BMContext* context, BMCaptureChannel* channel,
+                                  int width, int height, float framerate, BMCaptureMode mode) {
+    if (context == nullptr || channel == nullptr ||
+        (!channel->replay && (channel->parent_device == nullptr || channel->parent_device->device == nullptr))) {
+        log_error("Invalid channel handle");
         return false;
     }
 
@@ -1291,10 +1355,32 @@ bool bm_start_channel_capture(BMContext* context, BMCaptureChannel* channel,
     channel->height = height;
     channel->capture_mode = mode;
 
+    // Each of the three buffered frames may also carry RGB and grayscale conversions
+    size_t pixels = (size_t)width * height;
+    size_t capture_bytes = kCaptureFramesReserved * bm_align_up(pixels * 2) + 3 * pixels * 4;
+    if (channel->audio_enabled) {
+        const BMAudioOptions& audio = channel->audio_options;
+        capture_bytes += (size_t)ceil(audio.buffer_seconds * kAudioSampleRate) *
+                         audio.channel_count * (audio.sample_depth / 8);
+    }
+    if (!context->reserveTables() ||
+        !channel->reserve(channel->capture_reservation, capture_bytes, "Channel capture")) {
+        return false;
+    }
+
+    if (channel->replay) {
+        if (!channel->replay->configure(width, height, framerate, &channel->time_scale, &channel->frame_duration) ||
+            !channel->replay->start(channel->callback)) {
+            return false;
+        }
+        channel->capturing = true;
+        return true;
+    }
+
     // Get the IDeckLinkInput interface
     HRESULT result = channel->parent_device->device->QueryInterface(IID_IDeckLinkInput, (void**)&channel->input);
     if (result != S_OK) {
-        fprintf(stderr, "Error: Failed to get DeckLink input interface (error code: %ld)\n", (long)result);
+        log_error("Failed to get DeckLink input interface (error code: %ld)", (long)result);
         return false;
     }
 
@@ -1341,7 +1427,7 @@ bool bm_start_channel_capture(BMContext* context, BMCaptureChannel* channel,
     IDeckLinkDisplayModeIterator* display_mode_iterator = nullptr;
     result = channel->input->GetDisplayModeIterator(&display_mode_iterator);
     if (result != S_OK) {
-        fprintf(stderr, "Error: Failed to get display mode iterator (error code: %ld)\n", (long)result);
+        log_error("Failed to get display mode iterator (error code: %ld)", (long)result);
         channel->input->Release();
         channel->input = nullptr;
         return false;
@@ -1399,10 +1485,16 @@ bool bm_start_channel_capture(BMContext* context, BMCaptureChannel* channel,
             }
 
             if (width_match && height_match && framerate_match) {
-                fprintf(stderr, "  * Found matching mode: %ldx%ld @ %.2f fps (%s)\n",
+                log_info("Found matching mode: %ldx%ld @ %.2f fps (%s)",
                         display_mode->GetWidth(), display_mode->GetHeight(),
                         mode_framerate, mode_name_buffer);
+                // 29.97 and 30 fps both match a request for 30, keep the last
+                if (selected_mode != nullptr) {
+                    selected_mode->Release();
+                }
                 selected_mode = display_mode;
+                channel->time_scale = time_scale;
+                channel->frame_duration = time_value;
                 selected_mode_id = display_mode->GetDisplayMode();
                 found_matching_mode = true;
                 continue; // Don't release, we're keeping this one
@@ -1415,7 +1507,7 @@ bool bm_start_channel_capture(BMContext* context, BMCaptureChannel* channel,
     display_mode_iterator->Release();
 
     if (!found_matching_mode) {
-        fprintf(stderr, "Error: No matching display mode found for %dx%d @ %.2f fps\n",
+        log_error("No matching display mode found for %dx%d @ %.2f fps",
                 width, height, framerate);
         channel->input->Release();
         channel->input = nullptr;
@@ -1428,23 +1520,23 @@ bool bm_start_channel_capture(BMContext* context, BMCaptureChannel* channel,
 
     result = channel->input->EnableVideoInput(selected_mode_id, pixel_format, input_flags);
     if (result != S_OK) {
-        fprintf(stderr, "Error: Failed to enable video input (error code: %ld)\n", (long)result);
-
         // Provide more specific error messages based on common error codes
+        const char* reason;
         switch (result) {
             case E_INVALIDARG:
-                fprintf(stderr, "  - Invalid argument (check display mode and pixel format)\n");
+                reason = "invalid argument (check display mode and pixel format)";
                 break;
             case E_ACCESSDENIED:
-                fprintf(stderr, "  - Access denied (device may be in use by another application)\n");
+                reason = "access denied (device may be in use by another application)";
                 break;
             case E_OUTOFMEMORY:
-                fprintf(stderr, "  - Out of memory\n");
+                reason = "out of memory";
                 break;
             default:
-                fprintf(stderr, "  - Hardware error or unsupported configuration\n");
+                reason = "hardware error or unsupported configuration";
                 break;
         }
+        log_error("Failed to enable video input (error code: %ld): %s", (long)result, reason);
 
         selected_mode->Release();
         channel->input->Release();
@@ -1454,21 +1546,42 @@ bool bm_start_channel_capture(BMContext* context, BMCaptureChannel* channel,
 
     selected_mode->Release();
 
+    // Embedded audio arrives with each frame once enabled; the ring must exist first
+    if (channel->audio_enabled) {
+        const BMAudioOptions& audio = channel->audio_options;
+        BMDAudioSampleType sample_type = audio.sample_depth == 32
+            ? bmdAudioSampleType32bitInteger : bmdAudioSampleType16bitInteger;
+        if (!channel->audio.configure(audio.channel_count, audio.sample_depth, audio.buffer_seconds,
+                                      &context->memory)) {
+            result = E_INVALIDARG;
+        } else {
+            result = channel->input->EnableAudioInput(bmdAudioSampleRate48kHz, sample_type,
+                                                      (uint32_t)audio.channel_count);
+        }
+        if (result != S_OK) {
+            log_error("Failed to enable %d channel %d-bit audio input (error code: %ld)",
+                      audio.channel_count, audio.sample_depth, (long)result);
+            channel->audio.release();
+            channel->input->DisableVideoInput();
+            channel->input->Release();
+            channel->input = nullptr;
+            return false;
+        }
+    }
+
     // Start the stream
     result = channel->input->StartStreams();
     if (result != S_OK) {
-        fprintf(stderr, "Error: Failed to start capture streams (error code: %ld)\n", (long)result);
-
         // Provide more specific error messages
-        switch (result) {
-            case E_ACCESSDENIED:
-                fprintf(stderr, "  - Access denied (device may be in use by another application)\n");
-                break;
-            default:
-                fprintf(stderr, "  - Hardware error or device disconnected\n");
-                break;
+        const char* reason = result == E_ACCESSDENIED
+            ? "access denied (device may be in use by another application)"
+            : "hardware error or device disconnected";
+        log_error("Failed to start capture streams (error code: %ld): %s", (long)result, reason);
+
+        if (channel->audio.enabled()) {
+            channel->input->DisableAudioInput();
+            channel->audio.release();
         }
-
         channel->input->DisableVideoInput();
         channel->input->Release();
         channel->input = nullptr;
@@ -1479,22 +1592,25 @@ bool bm_start_channel_capture(BMContext* context, BMCaptureChannel* channel,
     return true;
 }
 
-bool bm_update_channel(BMContext* context, BMCaptureChannel* channel) {
-    if (context == nullptr || channel == nullptr || !channel->capturing) {
+bool bm_start_channel_capture(BMContext* context, BMCaptureChannel* channel,
+                             int width, int height, float framerate, BMCaptureMode mode) {
+    if (!start_channel_capture(context, channel, width, height, framerate, mode)) {
+        if (context != nullptr && channel != nullptr) {
+            channel->releaseReservation(channel->capture_reservation);
+        }
         return false;
     }
+    return true;
+}
 
-    // Check if we have received any frames yet
-    if (channel->frame_count == 0) {
+bool bm_update_channel(BMContext* context, BMCaptureChannel* channel) {
+    if (context == nullptr || channel == nullptr || !channel->capturing) {
         return false;
     }
 
-    // In the first few frames, we've already primed the buffer, so just return true
-    if (channel->frame_count <= channel->min_frames_for_lock) {
-        return true;
-    }
-
-    // Swap front buffer to get most recent frame
+    // Swap front buffer to get most recent frame; only the reader moves the front,
+    // so the capture callback never touches a frame that is being read
+    TraceSpan swap_span(TRACE_SWAP_FRONT);
     return channel->buffer.swapFront();
 }
 
@@ -1572,62 +1688,128 @@ bool bm_get_channel_frame(BMContext* context, BMCaptureChannel* channel, BMPixel
         }
     }
 
+    ChannelStats& stats = channel->stats;
+
     // Check if mutex exists and try to lock with timeout
-    if (!frame.mutex || !frame.mutex->try_lock_for(std::chrono::milliseconds(channel->capture_mode))) {
+    int64_t wait_start = trace_enabled() ? trace_now() : 0;
+    bool locked = frame.mutex && frame.mutex->try_lock_for(std::chrono::milliseconds(channel->capture_mode));
+    if (wait_start != 0) {
+        trace_record(TRACE_LOCK_WAIT, wait_start, trace_now(), frame.info.sequence);
+    }
+    if (!locked) {
+        if (frame.mutex) {
+            ChannelStats::count(stats.lock_timeouts);
+        }
         return false;
     }
 
     // Use RAII lock guard for automatic unlocking
     std::lock_guard<std::timed_mutex> lock(*frame.mutex, std::adopt_lock);
+    int64_t taken_ns = ChannelStats::now();
+    int64_t conversion_ns = 0;
 
+    const AccountedBuffer* converted = nullptr;
+    const uint8_t* source = nullptr;
     size_t required_size = 0;
 
     switch (format) {
         case BM_FORMAT_RGB: {
             // Convert YUV to RGB if needed
             if (!frame.rgb_updated && !frame.yuv_data.empty()) {
+                TraceSpan convert_span(TRACE_CONVERT_RGB, frame.info.sequence);
+                int64_t start = ChannelStats::now();
                 unsigned int pixel_count = frame.width * frame.height;
                 frame.rgb_data.resize(pixel_count * 3);
-                yuv_to_rgb(frame.yuv_data.data(), frame.rgb_data.data(), pixel_count, &channel->yuv_tables);
+                {
+                    PerfRegion convert_region(stats.conversion_counters, stats.perf_enabled.load(std::memory_order_relaxed),
+                                              frame.yuv_data.size() + frame.rgb_data.size());
+                    yuv_to_rgb(frame.yuv_data.data(), frame.rgb_data.data(), pixel_count, context->conversionTables());
+                }
                 frame.rgb_updated = true;
+                conversion_ns = ChannelStats::now() - start;
+                stats.conversion_time.record(conversion_ns);
+                ChannelStats::count(stats.conversions);
             }
-
-            required_size = frame.rgb_data.size();
-            if (buffer_size >= required_size) {
-                memcpy(buffer, frame.rgb_data.data(), required_size);
-                return true;
-            }
+            converted = &frame.rgb_data;
             break;
         }
 
         case BM_FORMAT_YUV: {
+            source = frame.yuv_data.data();
             required_size = frame.yuv_data.size();
-            if (buffer_size >= required_size) {
-                memcpy(buffer, frame.yuv_data.data(), required_size);
-                return true;
-            }
             break;
         }
 
         case BM_FORMAT_GRAY: {
             // Convert YUV to grayscale if needed
             if (!frame.gray_updated && !frame.yuv_data.empty()) {
+                TraceSpan convert_span(TRACE_CONVERT_GRAY, frame.info.sequence);
+                int64_t start = ChannelStats::now();
                 unsigned int pixel_count = frame.width * frame.height;
                 frame.gray_data.resize(pixel_count);
-                yuv_to_gray(frame.yuv_data.data(), frame.gray_data.data(), pixel_count);
+                {
+                    PerfRegion convert_region(stats.conversion_counters, stats.perf_enabled.load(std::memory_order_relaxed),
+                                              frame.yuv_data.size() + frame.gray_data.size());
+                    yuv_to_gray(frame.yuv_data.data(), frame.gray_data.data(), pixel_count);
+                }
                 frame.gray_updated = true;
+                conversion_ns = ChannelStats::now() - start;
+                stats.conversion_time.record(conversion_ns);
+                ChannelStats::count(stats.conversions);
             }
-
-            required_size = frame.gray_data.size();
-            if (buffer_size >= required_size) {
-                memcpy(buffer, frame.gray_data.data(), required_size);
-                return true;
-            }
+            converted = &frame.gray_data;
             break;
         }
+
+        default:
+            return false;
     }
 
-    return false;
+    if (converted != nullptr) {
+        source = converted->data();
+        required_size = converted->size();
+    }
+
+    if (buffer_size < required_size) {
+        return false;
+    }
+    {
+        TraceSpan copy_span(TRACE_COPY_OUT, frame.info.sequence);
+        PerfRegion copy_region(stats.copy_counters, stats.perf_enabled.load(std::memory_order_relaxed), 2 * required_size);
+        if (required_size > 0) {   // Frames without input carry no data
+            memcpy(buffer, source, required_size);
+        }
+    }
+
+    int64_t done_ns = ChannelStats::now();
+    ChannelStats::count(stats.frames_delivered);
+    if (frame.info.arrival_ns == 0) {
+        return true;    // Nothing captured into this buffer yet, so no latency to record
+    }
+    stats.delivery_latency.record(done_ns - frame.info.arrival_ns);
+    stats.capture_latency.record(done_ns - frame.capture_ns);
+
+    {
+        std::lock_guard<std::mutex> delivered_lock(channel->delivered_mutex);
+        BMFrameInfo& info = channel->delivered_info;
+        info.sequence = frame.info.sequence;
+        info.stream_time = frame.info.stream_time;
+        info.frame_duration = frame.info.frame_duration;
+        info.hardware_timestamp = frame.info.hardware_timestamp;
+        info.flags = frame.info.flags;
+        info.timecode = frame.info.timecode;
+        memcpy(info.timecodes, frame.info.timecodes, sizeof(info.timecodes));
+
+        BMFrameLatency& latency = channel->delivered_latency;
+        latency.capture_to_callback_us = (frame.info.arrival_ns - frame.capture_ns) / 1e3;
+        latency.callback_us = (frame.buffered_ns - frame.info.arrival_ns) / 1e3;
+        latency.queue_us = (taken_ns - frame.buffered_ns) / 1e3;
+        latency.conversion_us = conversion_ns / 1e3;
+        latency.delivery_us = (done_ns - taken_ns - conversion_ns) / 1e3;
+        latency.total_us = (done_ns - frame.capture_ns) / 1e3;
+        channel->has_delivered = true;
+    }
+    return true;
 }
 
 size_t bm_get_channel_frame_size(BMContext* context, BMCaptureChannel* channel, BMPixelFormat format) {
@@ -1650,29 +1832,237 @@ size_t bm_get_channel_frame_size(BMContext* context, BMCaptureChannel* channel,
     }
 }
 
-void bm_stop_channel_capture(BMContext* context, BMCaptureChannel* channel) {
-    if (context == nullptr || channel == nullptr || !channel->capturing) {
-        return;
-    }
-
-    if (channel->input != nullptr) {
-        channel->input->StopStreams();
-        channel->input->DisableVideoInput();
-        channel->input->SetCallback(nullptr);
-        channel->input->Release();
-        channel->input = nullptr;
+bool bm_channel_get_stats(BMContext* context, BMCaptureChannel* channel, BMChannelStats* stats) {
+    if (context == nullptr || channel == nullptr || stats == nullptr) {
+        return false;
     }
 
-    channel->capturing = false;
+    channel->stats.read(stats);
+    return true;
 }
 
-void bm_destroy_channel(BMContext* context, BMCaptureChannel* channel) {
+bool bm_channel_get_frame_info(BMContext* context, BMCaptureChannel* channel,
+                               BMFrameInfo* info, BMFrameLatency* latency) {
     if (context == nullptr || channel == nullptr) {
-        return;
+        return false;
     }
 
-    if (channel->capturing) {
-        bm_stop_channel_capture(context, channel);
+    std::lock_guard<std::mutex> lock(channel->delivered_mutex);
+    if (!channel->has_delivered) {
+        return false;
+    }
+    if (info != nullptr) {
+        *info = channel->delivered_info;
+    }
+    if (latency != nullptr) {
+        *latency = channel->delivered_latency;
+    }
+    return true;
+}
+
+bool bm_enable_channel_audio(BMContext* context, BMCaptureChannel* channel, const BMAudioOptions* options) {
+    if (context == nullptr || channel == nullptr) {
+        return false;
+    }
+    if (channel->replay) {
+        log_error("Replay channels have no audio");
+        return false;
+    }
+    if (channel->capturing) {
+        log_error("Enable audio before starting capture");
+        return false;
+    }
+
+    BMAudioOptions audio_options;
+    if (options != nullptr) {
+        audio_options = *options;
+    } else {
+        bm_audio_options_init(&audio_options);
+    }
+    if (audio_options.channel_count != 2 && audio_options.channel_count != 8 &&
+        audio_options.channel_count != 16) {
+        log_error("Unsupported audio channel count %d (use 2, 8 or 16)", audio_options.channel_count);
+        return false;
+    }
+    if (audio_options.sample_depth != 16 && audio_options.sample_depth != 32) {
+        log_error("Unsupported audio sample depth %d (use 16 or 32)", audio_options.sample_depth);
+        return false;
+    }
+    if (!(audio_options.buffer_seconds > 0.0) || audio_options.buffer_seconds > 60.0) {
+        log_error("Audio buffer of %.2f seconds out of range (0 to 60)", audio_options.buffer_seconds);
+        return false;
+    }
+
+    channel->audio_options = audio_options;
+    channel->audio_enabled = true;
+    return true;
+}
+
+void bm_disable_channel_audio(BMContext* context, BMCaptureChannel* channel) {
+    if (context == nullptr || channel == nullptr || channel->capturing) {
+        return;
+    }
+    channel->audio_enabled = false;
+}
+
+// The ring positions of a frame's samples: from its stream time up to the next frame's
+static bool audio_range_for(BMCaptureChannel* channel, const BMFrameInfo* frame,
+                            int64_t* position, uint32_t* frame_count) {
+    BMFrameInfo info;
+    if (frame != nullptr) {
+        info = *frame;
+    } else {
+        std::lock_guard<std::mutex> lock(channel->delivered_mutex);
+        if (!channel->has_delivered) {
+            return false;
+        }
+        info = channel->delivered_info;
+    }
+
+    int64_t duration = info.frame_duration > 0 ? info.frame_duration : channel->frame_duration;
+    int64_t first = audio_position_for(info.stream_time, channel->time_scale);
+    int64_t end = audio_position_for(info.stream_time + duration, channel->time_scale);
+    if (end < first) {
+        return false;
+    }
+    *position = first;
+    *frame_count = (uint32_t)(end - first);
+    return true;
+}
+
+bool bm_get_channel_audio_view(BMContext* context, BMCaptureChannel* channel,
+                               const BMFrameInfo* frame, BMAudioView* view) {
+    if (context == nullptr || channel == nullptr || view == nullptr || !channel->audio.enabled()) {
+        return false;
+    }
+
+    int64_t position = 0;
+    uint32_t frame_count = 0;
+    return audio_range_for(channel, frame, &position, &frame_count) &&
+           channel->audio.view(position, frame_count, view);
+}
+
+bool bm_channel_audio_view_valid(BMContext* context, BMCaptureChannel* channel, const BMAudioView* view) {
+    if (context == nullptr || channel == nullptr || view == nullptr) {
+        return false;
+    }
+    return channel->audio.valid(*view);
+}
+
+bool bm_get_channel_audio(BMContext* context, BMCaptureChannel* channel, const BMFrameInfo* frame,
+                          void* buffer, size_t size, uint32_t* frame_count) {
+    BMAudioView view;
+    if (buffer == nullptr || !bm_get_channel_audio_view(context, channel, frame, &view)) {
+        return false;
+    }
+
+    size_t frame_bytes = channel->audio.frameBytes();
+    if (size < view.frame_count * frame_bytes) {
+        log_error("Audio buffer too small: %zu bytes for %u sample frames", size, view.frame_count);
+        return false;
+    }
+    uint8_t* out = (uint8_t*)buffer;
+    if (view.frames[0] > 0) {
+        memcpy(out, view.data[0], view.frames[0] * frame_bytes);
+    }
+    if (view.frames[1] > 0) {
+        memcpy(out + view.frames[0] * frame_bytes, view.data[1], view.frames[1] * frame_bytes);
+    }
+    if (!channel->audio.valid(view)) {
+        return false;   // Overwritten while copying
+    }
+
+    if (frame_count != nullptr) {
+        *frame_count = view.frame_count;
+    }
+    return true;
+}
+
+bool bm_channel_get_audio_stats(BMContext* context, BMCaptureChannel* channel, BMAudioStats* stats) {
+    if (context == nullptr || channel == nullptr || stats == nullptr) {
+        return false;
+    }
+
+    channel->audio.getStats(stats);
+    return true;
+}
+
+bool bm_get_memory_usage(BMContext* context, BMMemoryUsage* usage) {
+    if (context == nullptr || usage == nullptr) {
+        return false;
+    }
+
+    context->memory.read(usage);
+    return true;
+}
+
+bool bm_set_memory_budget(BMContext* context, uint64_t bytes) {
+    if (context == nullptr) {
+        return false;
+    }
+
+    context->memory.setBudget(bytes);
+    return true;
+}
+
+bool bm_channel_enable_perf_counters(BMContext* context, BMCaptureChannel* channel, bool enable) {
+    if (context == nullptr || channel == nullptr) {
+        return false;
+    }
+
+    channel->stats.perf_enabled.store(enable, std::memory_order_relaxed);
+    return perf_counters_available();
+}
+
+bool bm_channel_reset_stats(BMContext* context, BMCaptureChannel* channel) {
+    if (context == nullptr || channel == nullptr) {
+        return false;
+    }
+
+    channel->stats.reset();
+    return true;
+}
+
+void bm_stop_channel_capture(BMContext* context, BMCaptureChannel* channel) {
+    if (context == nullptr || channel == nullptr || !channel->capturing) {
+        return;
+    }
+
+    if (channel->input != nullptr) {
+        channel->input->StopStreams();
+        channel->input->DisableVideoInput();
+        if (channel->audio.enabled()) {
+            channel->input->DisableAudioInput();
+        }
+        channel->input->SetCallback(nullptr);
+        channel->input->Release();
+        channel->input = nullptr;
+    }
+
+    if (channel->replay) {
+        channel->replay->stop();
+    }
+
+    // Flush and close any recording; the next capture may use a different mode.
+    // Matroska recordings read the audio ring until then.
+    channel->stopRecording();
+    channel->stopPreTrigger();
+    channel->stopStream();
+    channel->stopServer();
+    channel->stopRtp();
+    channel->audio.release();
+    channel->releaseReservation(channel->capture_reservation);
+
+    channel->capturing = false;
+}
+
+void bm_destroy_channel(BMContext* context, BMCaptureChannel* channel) {
+    if (context == nullptr || channel == nullptr) {
+        return;
+    }
+
+    if (channel->capturing) {
+        bm_stop_channel_capture(context, channel);
     }
 
     // Remove the channel from its parent device's list
@@ -1683,3 +2073,373 @@ void bm_destroy_channel(BMContext* context, BMCaptureChannel* channel) {
 
     delete channel;
 }
+
+// Replay API implementation
+
+BMCaptureChannel* bm_create_replay_channel(BMContext* context, const char* path,
+                                           const BMReplayOptions* options) {
+    if (context == nullptr) {
+        return nullptr;
+    }
+
+    BMReplayOptions replay_options;
+    if (options != nullptr) {
+        replay_options = *options;
+    } else {
+        bm_replay_options_init(&replay_options);
+    }
+
+    BMCaptureChannel* channel = new BMCaptureChannel(context, nullptr, 0);
+    channel->replay.reset(new ReplaySource(replay_options));
+    if (!channel->replay->open(path)) {
+        log_error("Failed to open replay file %s", path);
+        delete channel;
+        return nullptr;
+    }
+
+    return channel;
+}
+
+// Recording API implementation
+
+bool bm_channel_start_recording(BMContext* context, BMCaptureChannel* channel,
+                                const char* path, const BMRecordingOptions* options) {
+    if (context == nullptr || channel == nullptr || path == nullptr) {
+        return false;
+    }
+
+    BMRecordingOptions recording_options;
+    if (options != nullptr) {
+        recording_options = *options;
+    } else {
+        bm_recording_options_init(&recording_options);
+    }
+
+    channel->stopRecording();
+
+    // A full writer queue pins its frames in the pool; compressed recordings
+    // also hold a couple of encode buffers
+    size_t frame_size = bm_get_channel_frame_size(context, channel, BM_FORMAT_YUV);
+    size_t queued_frames = (size_t)recording_options.queue_depth + 4;
+    if (recording_options.compression != BM_COMPRESSION_NONE) {
+        queued_frames += 2;
+    }
+    if (!channel->reserve(channel->recording_reservation, queued_frames * bm_align_up(frame_size), "Recording")) {
+        return false;
+    }
+
+    channel->recorder.reset(new FrameRecorder());
+    channel->recorder->setMemoryAccount(&context->memory);
+    channel->recorder->setAudioSource(&channel->audio);
+
+    if (!channel->recorder->open(path, recording_options)) {
+        log_error("Failed to open recording file %s", path);
+        channel->releaseReservation(channel->recording_reservation);
+        return false;
+    }
+
+    // Allocate enough buffers for a full writer queue now, not on the callback thread
+    if (frame_size > 0) {
+        channel->frame_pool.reserve(recording_options.queue_depth + 4, frame_size);
+    }
+
+    channel->addSink(channel->recorder.get());
+    return true;
+}
+
+void bm_channel_stop_recording(BMContext* context, BMCaptureChannel* channel) {
+    if (context == nullptr || channel == nullptr) {
+        return;
+    }
+
+    channel->stopRecording();
+}
+
+bool bm_channel_get_recording_stats(BMContext* context, BMCaptureChannel* channel,
+                                    BMRecordingStats* stats) {
+    if (context == nullptr || channel == nullptr || stats == nullptr) {
+        return false;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    if (channel->recorder) {
+        channel->recorder->getStats(stats);
+    }
+    return true;
+}
+
+// Streaming API implementation
+
+bool bm_channel_start_stream(BMContext* context, BMCaptureChannel* channel,
+                             int fd, const BMStreamOptions* options) {
+    if (context == nullptr || channel == nullptr || fd < 0) {
+        return false;
+    }
+
+    BMStreamOptions stream_options;
+    if (options != nullptr) {
+        stream_options = *options;
+    } else {
+        bm_stream_options_init(&stream_options);
+    }
+
+    channel->stopStream();
+
+    // Frames queued for the pipe stay out of the pool until written
+    size_t frame_size = bm_get_channel_frame_size(context, channel, BM_FORMAT_YUV);
+    size_t queued_frames = (size_t)stream_options.queue_depth + 8;
+    if (!channel->reserve(channel->stream_reservation, queued_frames * bm_align_up(frame_size), "Stream")) {
+        return false;
+    }
+
+    channel->streamer.reset(new FrameStreamer());
+
+    if (!channel->streamer->open(fd, stream_options)) {
+        log_error("Failed to open stream output (fd %d)", fd);
+        channel->releaseReservation(channel->stream_reservation);
+        return false;
+    }
+
+    // Frames referenced by the queue and the pipe must not come from the capture thread's allocations
+    if (frame_size > 0) {
+        channel->frame_pool.reserve(stream_options.queue_depth + 8, frame_size);
+    }
+
+    channel->addSink(channel->streamer.get());
+    return true;
+}
+
+void bm_channel_stop_stream(BMContext* context, BMCaptureChannel* channel) {
+    if (context == nullptr || channel == nullptr) {
+        return;
+    }
+
+    channel->stopStream();
+}
+
+bool bm_channel_get_stream_stats(BMContext* context, BMCaptureChannel* channel,
+                                 BMStreamStats* stats) {
+    if (context == nullptr || channel == nullptr || stats == nullptr) {
+        return false;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    if (channel->streamer) {
+        channel->streamer->getStats(stats);
+    }
+    return true;
+}
+
+// Frame server API implementation
+
+bool bm_channel_start_server(BMContext* context, BMCaptureChannel* channel,
+                             const char* socket_path, const BMServerOptions* options) {
+    if (context == nullptr || channel == nullptr || socket_path == nullptr || !channel->capturing) {
+        return false;
+    }
+
+    BMServerOptions server_options;
+    if (options != nullptr) {
+        server_options = *options;
+    } else {
+        bm_server_options_init(&server_options);
+    }
+
+    size_t frame_size = bm_get_channel_frame_size(context, channel, BM_FORMAT_YUV);
+    if (frame_size == 0) {
+        log_error("Channel format unknown, cannot start frame server");
+        return false;
+    }
+
+    FrameInfo format;
+    format.width = channel->width;
+    format.height = channel->height;
+    format.row_bytes = (long)channel->width * 2;
+    format.pixel_format = bmdFormat8BitYUV;
+    format.time_scale = channel->time_scale;
+    format.frame_duration = channel->frame_duration;
+
+    channel->stopServer();
+
+    // The shared arena maps every slot up front; FrameServer::open keeps at least two
+    size_t slot_count = (size_t)std::max(server_options.slot_count, 2);
+    if (!channel->reserve(channel->server_reservation, slot_count * bm_align_up(frame_size), "Frame server")) {
+        return false;
+    }
+
+    channel->server.reset(new FrameServer());
+
+    if (!channel->server->open(socket_path, server_options, format)) {
+        log_error("Failed to start frame server on %s", socket_path);
+        channel->releaseReservation(channel->server_reservation);
+        return false;
+    }
+
+    // Capture into the shared slots from the next frame on, with every slot prepared up front
+    channel->frame_pool.setArena(channel->server->arena());
+    channel->frame_pool.reserve(channel->server->arena()->slotCount(), frame_size);
+
+    channel->addSink(channel->server.get());
+    return true;
+}
+
+void bm_channel_stop_server(BMContext* context, BMCaptureChannel* channel) {
+    if (context == nullptr || channel == nullptr) {
+        return;
+    }
+
+    channel->stopServer();
+}
+
+bool bm_channel_get_server_stats(BMContext* context, BMCaptureChannel* channel,
+                                 BMServerStats* stats) {
+    if (context == nullptr || channel == nullptr || stats == nullptr) {
+        return false;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    if (channel->server) {
+        channel->server->getStats(stats);
+    }
+    return true;
+}
+
+// RTP API implementation
+
+bool bm_channel_start_rtp(BMContext* context, BMCaptureChannel* channel,
+                          const char* host, int port, const BMRtpOptions* options) {
+    if (context == nullptr || channel == nullptr || host == nullptr || !channel->capturing) {
+        return false;
+    }
+
+    BMRtpOptions rtp_options;
+    if (options != nullptr) {
+        rtp_options = *options;
+    } else {
+        bm_rtp_options_init(&rtp_options);
+    }
+
+    FrameInfo format;
+    format.width = channel->width;
+    format.height = channel->height;
+    format.row_bytes = (long)channel->width * 2;
+    format.pixel_format = bmdFormat8BitYUV;
+    format.time_scale = channel->time_scale;
+    format.frame_duration = channel->frame_duration;
+
+    channel->stopRtp();
+
+    // Frames waiting to be packetized stay out of the pool until sent
+    size_t frame_size = bm_get_channel_frame_size(context, channel, BM_FORMAT_YUV);
+    size_t queued_frames = (size_t)rtp_options.queue_depth + 4;
+    if (!channel->reserve(channel->rtp_reservation, queued_frames * bm_align_up(frame_size), "RTP output")) {
+        return false;
+    }
+
+    channel->rtp.reset(new RtpSender());
+
+    if (!channel->rtp->open(host, port, rtp_options, format)) {
+        log_error("Failed to start RTP output to %s:%d", host, port);
+        channel->releaseReservation(channel->rtp_reservation);
+        return false;
+    }
+
+    if (frame_size > 0) {
+        channel->frame_pool.reserve(rtp_options.queue_depth + 4, frame_size);
+    }
+
+    channel->addSink(channel->rtp.get());
+    return true;
+}
+
+void bm_channel_stop_rtp(BMContext* context, BMCaptureChannel* channel) {
+    if (context == nullptr || channel == nullptr) {
+        return;
+    }
+
+    channel->stopRtp();
+}
+
+bool bm_channel_get_rtp_stats(BMContext* context, BMCaptureChannel* channel,
+                              BMRtpStats* stats) {
+    if (context == nullptr || channel == nullptr || stats == nullptr) {
+        return false;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    if (channel->rtp) {
+        channel->rtp->getStats(stats);
+    }
+    return true;
+}
+
+// Pre-trigger API implementation
+
+bool bm_channel_enable_pretrigger(BMContext* context, BMCaptureChannel* channel,
+                                  const BMPreTriggerOptions* options) {
+    if (context == nullptr || channel == nullptr || !channel->capturing) {
+        return false;
+    }
+
+    BMPreTriggerOptions pretrigger_options;
+    if (options != nullptr) {
+        pretrigger_options = *options;
+    } else {
+        bm_pretrigger_options_init(&pretrigger_options);
+    }
+
+    channel->stopPreTrigger();
+    channel->pretrigger.reset(new PreTriggerBuffer());
+
+    size_t frame_size = bm_get_channel_frame_size(context, channel, BM_FORMAT_YUV);
+    if (!channel->pretrigger->start(pretrigger_options, channel->time_scale,
+                                    channel->frame_duration, frame_size)) {
+        log_error("Failed to set up pre-trigger buffer");
+        channel->pretrigger.reset();
+        return false;
+    }
+
+    size_t ring_bytes = (channel->pretrigger->capacity() + 8) * bm_align_up(frame_size);
+    if (!channel->reserve(channel->pretrigger_reservation, ring_bytes, "Pre-trigger buffer")) {
+        channel->stopPreTrigger();
+        channel->pretrigger.reset();
+        return false;
+    }
+
+    // The ring keeps every buffer it references out of the pool, so allocate
+    // them all now instead of on the capture thread
+    channel->frame_pool.reserve(channel->pretrigger->capacity() + 8, frame_size);
+
+    channel->addSink(channel->pretrigger.get());
+    return true;
+}
+
+void bm_channel_disable_pretrigger(BMContext* context, BMCaptureChannel* channel) {
+    if (context == nullptr || channel == nullptr) {
+        return;
+    }
+
+    channel->stopPreTrigger();
+    channel->pretrigger.reset();
+}
+
+bool bm_channel_trigger_dump(BMContext* context, BMCaptureChannel* channel, const char* path) {
+    if (context == nullptr || channel == nullptr || !channel->pretrigger) {
+        return false;
+    }
+
+    return channel->pretrigger->trigger(path);
+}
+
+bool bm_channel_get_pretrigger_stats(BMContext* context, BMCaptureChannel* channel,
+                                     BMPreTriggerStats* stats) {
+    if (context == nullptr || channel == nullptr || stats == nullptr) {
+        return false;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    if (channel->pretrigger) {
+        channel->pretrigger->getStats(stats);
+    }
+    return true;
+}
@@ -35,13 +35,502 @@ typedef enum {
     BM_FORMAT_GRAY     // 1 channel, 8-bit grayscale format
 } BMPixelFormat;
 
+/**
+ * Reader handle for an indexed raw capture container (.bmraw)
+ */
+typedef struct BMRawFile BMRawFile;
+typedef struct BMRtpReceiver BMRtpReceiver;
+
+typedef enum {
+    BM_RECORDING_RAW,       // Frames written back to back with no header
+    BM_RECORDING_CONTAINER, // Indexed container with page-aligned frames, readable with bm_raw_file_open
+    BM_RECORDING_MATROSKA   // Matroska file with an uncompressed 2vuy or v210 video track, plus PCM audio when captured
+} BMRecordingFormat;
+
+typedef enum {
+    BM_COMPRESSION_NONE,    // Frames stored as captured
+    BM_COMPRESSION_LOSSLESS // Built-in lossless codec for 2vuy and v210, container format only
+} BMRecordingCompression;
+
+typedef enum {
+    BM_LOG_DEBUG,           // Mode lists and teardown steps
+    BM_LOG_INFO,            // Selected modes and other one-off events
+    BM_LOG_WARNING,         // Recoverable problems (default level)
+    BM_LOG_ERROR,           // Failed operations
+    BM_LOG_OFF              // Log level that silences everything
+} BMLogLevel;
+
+/**
+ * Receives log messages on the library's logging thread, one line without a
+ * trailing newline per call
+ */
+typedef void (*BMLogCallback)(BMLogLevel level, const char* message, void* user_data);
+
+typedef enum {
+    BM_TRACE_JSON,          // Chrome trace event JSON, for chrome://tracing and Perfetto UI
+    BM_TRACE_PERFETTO       // Perfetto protobuf trace
+} BMTraceFormat;
+
+/**
+ * Options controlling a native disk recording
+ */
+typedef struct {
+    BMRecordingFormat format;   // File layout (default: BM_RECORDING_RAW)
+    int queue_depth;            // Frames the writer may fall behind before frames are dropped (default: 8)
+    uint64_t preallocate_bytes; // Disk space reserved ahead of the writer, 0 to disable (default: 1 GiB)
+    bool direct_io;             // Bypass the page cache when frame sizes allow it; raw recordings need
+                                // frames of whole 4096-byte blocks (default: true)
+    BMRecordingCompression compression; // Frame coding (default: BM_COMPRESSION_NONE)
+    int compression_threads;    // Threads encoding each frame, 0 for one per core up to 8 (default: 0)
+    double segment_seconds;     // Rotate to a new container file every this many seconds of stream time, 0 for one file (default: 0)
+    uint64_t retain_bytes;      // Delete the oldest segments beyond this total size, 0 to keep all (default: 0)
+    double retain_seconds;      // Delete segments finished longer ago than this, 0 to keep all (default: 0)
+} BMRecordingOptions;
+
+/**
+ * Recording progress and backpressure statistics
+ */
+typedef struct {
+    bool active;                // true while a recording is open
+    bool direct_io;             // true if writes currently bypass the page cache
+    uint64_t frames_written;    // Frames fully written to disk
+    uint64_t frames_dropped;    // Frames discarded because the writer queue was full
+    uint64_t bytes_written;     // Bytes written to disk
+    int queue_length;           // Frames currently waiting for the writer
+    int queue_high_water;       // Deepest the writer queue has been
+    double max_write_ms;        // Slowest single frame write, including encoding
+    double max_encode_ms;       // Slowest single frame encode, 0 without compression
+    double compression_ratio;   // Captured bytes per byte written, 1 without compression
+    uint64_t segments_completed;    // Segment files finished (including the last one once stopped)
+    uint64_t segments_deleted;      // Old segments removed by the retention limits
+    double max_segment_switch_ms;   // Slowest switch from one segment file to the next
+    int audio_channels;             // Channels of the Matroska audio track, 0 without one
+    uint64_t audio_silence_frames;  // Sample frames recorded as silence because the audio ring no longer held them
+    int last_error;             // errno of the last failed write, 0 if none
+} BMRecordingStats;
+
+typedef enum {
+    BM_STREAM_Y4M,          // YUV4MPEG2 with planar 4:2:2 frames, readable by ffmpeg and most encoders
+    BM_STREAM_RAW           // Captured frames unconverted (8-bit 4:2:2, cb-y0-cr-y1) and back to back
+} BMStreamFormat;
+
+typedef enum {
+    BM_STREAM_DROP,         // Drop and count frames when the reader falls behind
+    BM_STREAM_BLOCK         // Hold up the capture callback until the reader catches up
+} BMStreamOverflow;
+
+/**
+ * Options controlling a streaming output
+ */
+typedef struct {
+    BMStreamFormat format;      // Stream format (default: BM_STREAM_Y4M)
+    BMStreamOverflow overflow;  // Behaviour when the reader is slow (default: BM_STREAM_DROP)
+    int queue_depth;            // Frames the writer may fall behind before overflow applies (default: 4)
+    bool zero_copy;             // Splice frame memory into pipes instead of copying it (default: true)
+} BMStreamOptions;
+
+/**
+ * Streaming output progress and backpressure statistics
+ */
+typedef struct {
+    bool active;                // true while the stream is open
+    bool zero_copy;             // true if frames are currently spliced into a pipe
+    uint64_t frames_written;    // Frames fully handed to the descriptor
+    uint64_t frames_dropped;    // Frames discarded because the reader was too slow or went away
+    uint64_t bytes_written;     // Bytes written, including stream and frame headers
+    int queue_length;           // Frames currently waiting for the writer
+    int queue_high_water;       // Deepest the writer queue has been
+    double max_write_ms;        // Slowest single frame write
+    double blocked_ms;          // Total time the capture callback was held up (BM_STREAM_BLOCK)
+    int last_error;             // errno of the last failed write (EPIPE if the reader exited), 0 if none
+} BMStreamStats;
+
+/**
+ * Options controlling a local frame server
+ */
+typedef struct {
+    int slot_count;             // Shared frame slots; every buffered or leased frame occupies one (default: 16)
+    int max_clients;            // Subscribers connected at once (default: 8)
+    int max_leases;             // Frames one subscriber may hold at once (default: 4)
+    int lease_ms;               // Time a subscriber may hold a frame before it is reclaimed (default: 200)
+} BMServerOptions;
+
+/**
+ * Frame server statistics
+ */
+typedef struct {
+    bool active;                // true while the server is listening
+    int clients;                // Subscribers currently connected
+    int slots_in_use;           // Shared slots referenced by capture, sinks or subscribers
+    uint64_t clients_accepted;  // Subscribers accepted since the server started
+    uint64_t frames_published;  // Frames captured into shared slots and announced
+    uint64_t frames_unshared;   // Frames captured into private memory because every slot was taken
+    uint64_t frames_skipped;    // Announcements not sent because a subscriber was at max_leases or not reading
+    uint64_t leases_expired;    // Leases reclaimed because a subscriber held them longer than lease_ms
+} BMServerStats;
+
+/**
+ * Options controlling an RTP video sender
+ */
+typedef struct {
+    int payload_type;           // RTP payload type (default: 96)
+    int packet_size;            // Largest UDP payload in bytes, RTP headers included (default: 1400)
+    bool paced;                 // Spread each frame's packets across the frame interval (default: true)
+    bool segmentation_offload;  // Hand groups of packets to the kernel as one UDP GSO send where supported (default: true)
+    int queue_depth;            // Frames waiting to be sent before new frames are dropped (default: 2)
+    int multicast_ttl;          // TTL of packets to multicast groups (default: 1)
+} BMRtpOptions;
+
+/**
+ * RTP sender statistics
+ */
+typedef struct {
+    bool active;                // true while the sender is running
+    bool segmentation_offload;  // true if UDP GSO is in use
+    uint64_t frames_sent;
+    uint64_t frames_dropped;    // Frames discarded because the sender fell queue_depth frames behind
+    uint64_t frames_late;       // Frames whose packets took longer than one frame interval to send
+    uint64_t packets_sent;
+    uint64_t bytes_sent;        // UDP payload bytes, RTP headers included
+    int last_error;             // errno of the last failed send, 0 if none
+} BMRtpStats;
+
+/**
+ * Metadata of a frame reassembled by an RTP receiver
+ */
+typedef struct {
+    uint64_t frame_number;      // Frames delivered by the receiver, starting at 1
+    uint32_t rtp_timestamp;     // 90 kHz RTP timestamp of the frame
+    bool complete;              // false if packets were lost; their parts of the frame hold stale data
+    int packets_lost;           // Packets of this frame that never arrived
+} BMRtpFrameInfo;
+
+/**
+ * RTP receiver statistics
+ */
+typedef struct {
+    uint64_t frames_received;   // Frames reassembled, complete or not
+    uint64_t frames_incomplete; // Frames with missing packets
+    uint64_t frames_dropped;    // Reassembled frames discarded because nobody collected them
+    uint64_t packets_received;
+    uint64_t packets_lost;      // Gaps in the RTP sequence numbers
+    uint64_t packets_reordered; // Packets that arrived after a later one
+    uint64_t bytes_received;
+    double jitter_ms;           // RFC 3550 interarrival jitter of the frame start packets
+} BMRtpReceiverStats;
+
+/**
+ * Where a frame's timecode was carried, in order of preference
+ */
+typedef enum {
+    BM_TIMECODE_RP188_VITC1 = 0,    // RP188 (SMPTE 12M ancillary data) carrying VITC1
+    BM_TIMECODE_RP188_LTC,          // RP188 carrying LTC
+    BM_TIMECODE_RP188_VITC2,        // RP188 carrying VITC2
+    BM_TIMECODE_VITC,               // Analog-style VITC, field 1
+    BM_TIMECODE_VITC_FIELD2,        // Analog-style VITC, field 2
+    BM_TIMECODE_SOURCE_COUNT
+} BMTimecodeSource;
+
+/**
+ * SMPTE timecode of a frame
+ */
+typedef struct {
+    bool valid;                 // false if the frame carried no timecode of this kind
+    bool drop_frame;            // Drop-frame counting (29.97 and 59.94 fps)
+    uint8_t hours;
+    uint8_t minutes;
+    uint8_t seconds;
+    uint8_t frames;
+    uint8_t source;             // BMTimecodeSource the timecode was read from
+    uint32_t bcd;               // The timecode as BCD, 0xHHMMSSFF
+    uint32_t user_bits;         // The 32 binary group bits
+} BMTimecode;
+
+/**
+ * Per-frame capture metadata
+ */
+typedef struct {
+    uint64_t sequence;           // Capture sequence number; gaps mean frames were not recorded
+    int64_t stream_time;         // Stream time in time_scale units
+    int64_t frame_duration;      // Frame duration in time_scale units
+    int64_t hardware_timestamp;  // Hardware reference timestamp in nanoseconds
+    uint32_t flags;              // DeckLink frame flags (e.g. no input source)
+    BMTimecode timecode;         // The first valid of timecodes[], in BMTimecodeSource order
+    BMTimecode timecodes[BM_TIMECODE_SOURCE_COUNT];  // Every timecode the frame carried, by source
+} BMFrameInfo;
+
+/**
+ * Options for capturing the embedded audio of a channel
+ */
+typedef struct {
+    int channel_count;          // Audio channels: 2, 8 or 16 (default: 2)
+    int sample_depth;           // Bits per sample, 16 or 32 (default: 16)
+    double buffer_seconds;      // Audio kept in the channel's ring for readers (default: 2)
+} BMAudioOptions;
+
+/**
+ * Audio samples seen in place in a channel's ring. Samples are signed
+ * integers at 48 kHz, interleaved channel_count to a sample frame. Where the
+ * range wraps around the end of the ring it comes in two parts.
+ */
+typedef struct {
+    const void* data[2];        // Start of each part; data[1] is NULL unless the range wraps
+    uint32_t frames[2];         // Sample frames in each part
+    uint32_t frame_count;       // frames[0] + frames[1]
+    int64_t start_sample;       // Position of the first sample frame, in 48 kHz units of stream time
+    int channel_count;
+    int sample_depth;           // Bits per sample
+    uint64_t ring_counter;      // Identifies the samples to bm_channel_audio_view_valid
+} BMAudioView;
+
+/**
+ * Embedded audio statistics of a channel
+ */
+typedef struct {
+    bool enabled;               // true if audio capture is set up
+    int channel_count;
+    int sample_depth;
+    uint32_t buffer_frames;     // Sample frames the ring holds
+    uint64_t packets;           // Audio packets received
+    uint64_t sample_frames;     // Sample frames received
+    uint64_t silence_frames;    // Sample frames of silence filled in for missing packets
+    uint64_t discontinuities;   // Jumps in packet time that restarted the ring
+    uint64_t reads_expired;     // Reads of audio the ring had already overwritten
+    uint64_t reads_pending;     // Reads of audio that had not arrived yet
+    int64_t write_position;     // One past the newest sample frame, in 48 kHz units of stream time
+} BMAudioStats;
+
+/**
+ * Format of a raw capture container
+ */
+typedef struct {
+    int width;
+    int height;
+    int row_bytes;
+    uint32_t pixel_format;       // DeckLink pixel format code ('2vuy' for 8-bit, 'v210' for 10-bit 4:2:2)
+    int64_t time_scale;          // Units per second of stream times and durations
+    int64_t frame_duration;      // Nominal frame duration in time_scale units
+    int64_t frame_count;         // Number of complete frames in the file
+    bool indexed;                // false if the .idx sidecar is missing; metadata is then synthesized
+    bool compressed;             // true if frames are stored losslessly compressed; read them with bm_raw_file_read_frame
+} BMRawFileInfo;
+
+/**
+ * Options controlling a pre-trigger ring buffer
+ */
+typedef struct {
+    double pre_seconds;             // Seconds of frames kept in memory before a trigger (default: 10)
+    double post_seconds;            // Seconds recorded after a trigger (default: 5)
+    uint64_t memory_limit;          // Upper bound for the ring in bytes, 0 for no limit (default: 0)
+    const char* signal_loss_prefix; // Dump automatically on signal loss to <prefix>-<time>.bmraw, NULL to disable (default: NULL)
+    BMRecordingOptions recording;   // Options for dump files (default: container format)
+} BMPreTriggerOptions;
+
+/**
+ * Pre-trigger ring occupancy and dump statistics
+ */
+typedef struct {
+    bool enabled;                // true while the ring is active
+    bool dumping;                // true while a dump is being written
+    int ring_capacity;           // Frames the ring can hold
+    int ring_frames;             // Frames currently held
+    double ring_seconds;         // Pre-roll currently available
+    uint64_t memory_bytes;       // Memory budget of the ring
+    uint64_t dumps_completed;    // Dumps written and closed
+    uint64_t frames_dumped;      // Frames written by all dumps
+    uint64_t frames_dropped;     // Frames lost from dumps because the writer fell behind
+    uint64_t bytes_dumped;       // Bytes written by all dumps
+    double last_dump_seconds;    // Time from trigger to closing the last dump file
+    double last_dump_mb_per_s;   // Average write rate of the last dump
+    int last_error;              // errno of the last failed dump, 0 if none
+} BMPreTriggerStats;
+
+/**
+ * Distribution of a duration, from a log-bucketed histogram (values within 1/16)
+ */
+typedef struct {
+    uint64_t count;             // Samples recorded
+    double min_us;
+    double mean_us;
+    double max_us;
+    double p50_us;
+    double p90_us;
+    double p99_us;
+    double p999_us;
+} BMHistogramSummary;
+
+/**
+ * Memory held by a context and its channels, in bytes
+ */
+typedef struct {
+    uint64_t conversion_tables;     // YUV to RGB lookup tables, shared by the context's channels
+    uint64_t frame_pools;           // Pooled capture buffers, free and in use
+    uint64_t conversion_buffers;    // RGB and grayscale copies of buffered frames
+    uint64_t recorder_buffers;      // Recorder encode buffers
+    uint64_t audio_buffers;         // Embedded audio rings
+    uint64_t total;                 // Sum of the above
+    uint64_t peak;                  // Highest total so far
+    uint64_t reserved;              // Worst-case footprint of running channels, recordings and pre-trigger rings
+    uint64_t budget;                // Limit on reserved, 0 for no limit
+    uint64_t rejected;              // Starts refused because they would exceed the budget
+} BMMemoryUsage;
+
+/**
+ * Hardware counter totals of one kernel, per frame. Counter fields are 0 when
+ * perf events are not available; bytes and GB/s are always measured.
+ */
+typedef struct {
+    uint64_t frames;                // Regions measured
+    uint64_t counted_frames;        // Regions with hardware counter readings
+    double bytes_per_frame;         // Bytes read plus bytes written
+    double cycles_per_frame;
+    double instructions_per_frame;
+    double llc_misses_per_frame;    // Last level cache misses
+    double instructions_per_cycle;
+    double bytes_per_cycle;
+    double gb_per_second;           // Bytes over the time spent in the region
+} BMPerfCounterSummary;
+
+/**
+ * Per-channel pipeline counters and timings since the last reset
+ */
+typedef struct {
+    uint64_t frames_missed;      // Frames the card or driver dropped before the callback, from gaps in stream time
+    uint64_t frames_arrived;     // Frames handed to the capture callback
+    uint64_t frames_no_signal;   // Arrived frames flagged as having no input source
+    uint64_t frames_dropped;     // Arrived frames lost before buffering (no data or no buffer)
+    uint64_t frames_overwritten; // Buffered frames replaced by a newer one before bm_update_channel picked them up
+    uint64_t frames_delivered;   // Successful bm_get_channel_frame calls
+    uint64_t lock_timeouts;      // bm_get_channel_frame calls that timed out waiting for the frame lock
+    uint64_t conversions;        // RGB or grayscale conversions performed
+    uint64_t driver_queue_depth; // Frames waiting in the driver behind the latest callback
+    uint64_t driver_queue_max;   // Largest driver_queue_depth seen
+    double elapsed_seconds;      // Time since the statistics were last reset
+    BMHistogramSummary callback_time;    // Time spent in the capture callback
+    BMHistogramSummary conversion_time;  // Time per RGB or grayscale conversion
+    BMHistogramSummary delivery_latency; // Frame arrival to its return from bm_get_channel_frame
+    BMHistogramSummary capture_latency;  // Hardware capture to the return from bm_get_channel_frame
+    BMPerfCounterSummary conversion_counters; // RGB and grayscale conversions, with perf counters enabled
+    BMPerfCounterSummary copy_counters;       // Frame copies into the pool and out to the caller
+} BMChannelStats;
+
+/**
+ * Where the time went between capturing a frame and handing it to the caller.
+ * Capture time comes from the frame's hardware reference timestamp; without a
+ * usable hardware clock it is the callback arrival and capture_to_callback is 0.
+ */
+typedef struct {
+    double capture_to_callback_us;  // Hardware capture to the start of the capture callback
+    double callback_us;             // Callback start to the frame being buffered (copy and sinks)
+    double queue_us;                // Buffered to bm_get_channel_frame taking the frame lock
+    double conversion_us;           // Conversion to the requested format, 0 if already converted
+    double delivery_us;             // Copy into the caller's buffer
+    double total_us;                // Hardware capture to the return from bm_get_channel_frame
+} BMFrameLatency;
+
+/**
+ * Embedded code of a latency-probe test pattern frame
+ */
+typedef struct {
+    uint32_t sequence;          // Frame index of the replay source, starting at 0
+    int64_t emitted_ns;         // steady_clock time the source emitted the frame
+    double age_us;              // Time from emission to decoding the code
+} BMLatencyProbe;
+
+typedef enum {
+    BM_REPLAY_REALTIME,            // Deliver frames at the recorded frame rate
+    BM_REPLAY_AS_FAST_AS_POSSIBLE, // Deliver the next frame as soon as the callback returns
+    BM_REPLAY_SCALED               // Deliver frames at speed times the recorded frame rate
+} BMReplayPacing;
+
+/**
+ * Options controlling a replay channel
+ */
+typedef struct {
+    BMReplayPacing pacing;      // Frame pacing (default: BM_REPLAY_REALTIME)
+    double speed;               // Rate multiplier for BM_REPLAY_SCALED (default: 1.0)
+    bool loop;                  // Restart from the first frame at the end of the file (default: true)
+    bool latency_probe;         // Stamp a sequence and time code into each 8-bit frame (default: false)
+} BMReplayOptions;
+
+/**
+ * A display mode offered by a mock device
+ */
+typedef struct {
+    int width;
+    int height;
+    int64_t frame_duration;     // Frame duration in time_scale units, e.g. 1001
+    int64_t time_scale;         // Units per second, e.g. 30000 for 29.97 fps
+} BMMockMode;
+
+/**
+ * Options for a context backed by simulated DeckLink devices
+ */
+typedef struct {
+    int device_count;           // Number of mock devices (default: 1)
+    int ports_per_device;       // Input connections per device, 1 to 6 (default: 2)
+    const BMMockMode* modes;    // Display modes every device offers, or NULL for the
+                                // common 720p, 1080p and 2160p modes (default: NULL)
+    int mode_count;             // Number of entries in modes
+    double jitter_ms;           // Each frame is delivered up to this much late, at random (default: 0)
+    double drop_rate;           // Fraction of frames the device never delivers (default: 0)
+    double signal_loss_rate;    // Chance per frame that the input signal drops out (default: 0)
+    int signal_loss_frames;     // Length of each signal dropout in frames (default: 25)
+    int format_change_interval; // Frames between switches of the source to another mode,
+                                // 0 to keep the mode fixed (default: 0)
+    uint32_t seed;              // Seed for the random impairments (default: 1)
+} BMMockOptions;
+
 /**
  * Create a new BlackMagic context.
- * This must be called before any other functions.
+ * This must be called before any other functions. The DeckLink driver is
+ * loaded the first time the context looks for devices, and without it the
+ * context reports no devices while replay channels still work.
  * @return A new context, or NULL if initialization failed
  */
 BMContext* bm_create_context(void);
 
+/**
+ * Fill a mock options structure with the default values.
+ * @param options Options structure to initialize
+ */
+void bm_mock_options_init(BMMockOptions* options);
+
+/**
+ * Create a context whose devices are simulated instead of found through the
+ * DeckLink driver. Each mock device offers the configured display modes and
+ * delivers colour bar frames from its own timer thread, through the same
+ * callback as a card, with optional jitter, dropped frames, signal loss and
+ * source format changes. The rest of the API works unchanged, so capture,
+ * multi-channel use and everything downstream run without hardware.
+ * @param options Mock options, or NULL for the defaults
+ * @return A new context, or NULL if the options are invalid
+ */
+BMContext* bm_create_mock_context(const BMMockOptions* options);
+
+/**
+ * Create a context that uses the DeckLink driver when it is installed, and
+ * simulated devices when it is not, so the same program runs on hosts
+ * without a capture card. Falling back is logged as a warning.
+ * @param options Mock options for the fallback, or NULL for the defaults
+ * @return A new context, or NULL if the options are invalid
+ */
+BMContext* bm_create_context_or_mock(const BMMockOptions* options);
+
+/**
+ * Check whether a context's devices are simulated.
+ * @param context The context
+ * @return true if the context was created with mock devices
+ */
+bool bm_context_is_mock(BMContext* context);
+
+/**
+ * Check whether the DeckLink driver library can be loaded. Contexts load it
+ * the first time they look for devices; the first call here loads it too.
+ * @return true if the driver is installed
+ */
+bool bm_driver_available(void);
+
 /**
  * Free a BlackMagic context.
  * This should be called when done with the library to release resources.
@@ -194,6 +683,9 @@ bool bm_start_channel_capture(BMContext* context, BMCaptureChannel* channel,
 
 /**
  * Update the capture channel and check for new frames.
+ * Takes the newest captured frame for bm_get_channel_frame; the previous frame
+ * stays current when nothing new has arrived. Call it from the thread that
+ * reads the frames.
  * @param context The library context
  * @param channel Handle to the capture channel
  * @return true if a new frame is available, false otherwise
@@ -262,6 +754,198 @@ int bm_channel_get_frame_count(BMContext* context, BMCaptureChannel* channel);
 bool bm_channel_set_signal_parameters(BMContext* context, BMCaptureChannel* channel, 
                                      int min_frames, int max_bad_frames);
 
+/**
+ * Get the pipeline statistics of a channel. Counters are updated with relaxed
+ * atomics on the capture path, so reading them never stalls capture.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param stats Structure to receive the statistics
+ * @return true if successful, false otherwise
+ */
+bool bm_channel_get_stats(BMContext* context, BMCaptureChannel* channel, BMChannelStats* stats);
+
+/**
+ * Get the memory held by a context and all of its channels.
+ * @param context The library context
+ * @param usage Structure to receive the memory usage
+ * @return true if successful, false otherwise
+ */
+bool bm_get_memory_usage(BMContext* context, BMMemoryUsage* usage);
+
+/**
+ * Limit the memory a context may commit. Starting a channel, a recording or a
+ * pre-trigger ring reserves its worst-case footprint first, and fails if the
+ * reservations would exceed the budget. Running captures are not affected.
+ * @param context The library context
+ * @param bytes Budget in bytes, 0 for no limit (the default)
+ * @return true if successful, false otherwise
+ */
+bool bm_set_memory_budget(BMContext* context, uint64_t bytes);
+
+/**
+ * Turn hardware performance counters around the conversion and copy kernels
+ * on or off. Counting uses perf_event_open on Linux; where perf events are not
+ * permitted or not supported, bytes moved and GB/s are still measured.
+ * Results appear in the conversion_counters and copy_counters statistics.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param enable true to measure, false to stop
+ * @return true if hardware counters can be read, false if only bytes and time are measured
+ */
+bool bm_channel_enable_perf_counters(BMContext* context, BMCaptureChannel* channel, bool enable);
+
+/**
+ * Get the metadata and latency breakdown of the frame last returned by
+ * bm_get_channel_frame on this channel. The metadata includes the RP188 and
+ * VITC timecodes and user bits the frame carried.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param info Structure to receive the frame metadata, or NULL
+ * @param latency Structure to receive the latency breakdown, or NULL
+ * @return true if a frame has been delivered, false otherwise
+ */
+bool bm_channel_get_frame_info(BMContext* context, BMCaptureChannel* channel,
+                               BMFrameInfo* info, BMFrameLatency* latency);
+
+/**
+ * Fill an audio options structure with the default values.
+ * @param options Options structure to initialize
+ */
+void bm_audio_options_init(BMAudioOptions* options);
+
+/**
+ * Capture the embedded audio of a channel along with its video. Call before
+ * bm_start_channel_capture; the setting lasts until bm_disable_channel_audio.
+ * Audio goes into a ring stamped with stream time, so the samples of any
+ * recent frame can be read back exactly. Replay channels have no audio.
+ * @param context The library context
+ * @param channel Handle to a channel that is not capturing
+ * @param options Audio options, or NULL for the defaults
+ * @return true if successful, false otherwise
+ */
+bool bm_enable_channel_audio(BMContext* context, BMCaptureChannel* channel, const BMAudioOptions* options);
+
+/**
+ * Stop capturing audio on a channel and free its ring.
+ * @param context The library context
+ * @param channel Handle to a channel that is not capturing
+ */
+void bm_disable_channel_audio(BMContext* context, BMCaptureChannel* channel);
+
+/**
+ * View the audio samples belonging to a video frame without copying them.
+ * A frame owns the samples from its stream time up to that of the next frame,
+ * so consecutive frames never share or skip samples (at 29.97 fps they
+ * alternate between 1601 and 1602). The view points into the ring, which the
+ * capture callback keeps overwriting: read the samples promptly, then check
+ * bm_channel_audio_view_valid before trusting what was read.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param frame Metadata of the frame, or NULL for the frame last returned by bm_get_channel_frame
+ * @param view Structure to receive the view
+ * @return true if the frame's audio is in the ring, false if it is not or was already overwritten
+ */
+bool bm_get_channel_audio_view(BMContext* context, BMCaptureChannel* channel,
+                               const BMFrameInfo* frame, BMAudioView* view);
+
+/**
+ * Check that the samples of a view have not been overwritten since it was taken.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param view View from bm_get_channel_audio_view
+ * @return true if everything read through the view so far is intact
+ */
+bool bm_channel_audio_view_valid(BMContext* context, BMCaptureChannel* channel, const BMAudioView* view);
+
+/**
+ * Copy the audio samples belonging to a video frame into a buffer.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param frame Metadata of the frame, or NULL for the frame last returned by bm_get_channel_frame
+ * @param buffer Buffer for the interleaved samples
+ * @param size Size of the buffer in bytes
+ * @param frame_count Receives the number of sample frames copied, or NULL
+ * @return true if successful, false if the audio is unavailable or the buffer too small
+ */
+bool bm_get_channel_audio(BMContext* context, BMCaptureChannel* channel, const BMFrameInfo* frame,
+                          void* buffer, size_t size, uint32_t* frame_count);
+
+/**
+ * Get the embedded audio statistics of a channel.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param stats Structure to receive the statistics
+ * @return true if successful, false otherwise
+ */
+bool bm_channel_get_audio_stats(BMContext* context, BMCaptureChannel* channel, BMAudioStats* stats);
+
+/**
+ * Format a timecode as HH:MM:SS:FF, or HH:MM:SS;FF for drop-frame timecode.
+ * @param timecode Timecode to format
+ * @param buffer Buffer for the text, at least 12 bytes
+ * @param size Size of the buffer in bytes
+ * @return true if the timecode is valid and fits, false otherwise
+ */
+bool bm_timecode_format(const BMTimecode* timecode, char* buffer, size_t size);
+
+/**
+ * Clear the pipeline statistics of a channel while capture continues.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @return true if successful, false otherwise
+ */
+bool bm_channel_reset_stats(BMContext* context, BMCaptureChannel* channel);
+
+/**
+ * Set the lowest level of messages to log. Messages are queued in memory and
+ * written by a background thread, so logging never blocks capture.
+ * @param level Lowest level logged (default: BM_LOG_WARNING)
+ */
+void bm_set_log_level(BMLogLevel level);
+
+/**
+ * Send log messages to a callback instead of stderr. The callback runs on the
+ * logging thread; once this returns, the previous callback is no longer called.
+ * @param callback Function receiving each message, or NULL for stderr
+ * @param user_data Passed to the callback
+ */
+void bm_set_log_callback(BMLogCallback callback, void* user_data);
+
+/**
+ * Wait until every message logged so far has been passed to the callback.
+ */
+void bm_flush_log(void);
+
+/**
+ * Get the number of messages dropped because the log queue was full.
+ * @return Count of dropped messages
+ */
+uint64_t bm_get_log_dropped(void);
+
+/**
+ * Start recording timeline events of the capture pipeline: callbacks, frame
+ * copies, buffer swaps, conversions and recorder writes, across all channels.
+ * Each thread records into its own ring without locks; when a ring is full the
+ * oldest events are overwritten. Starting again discards unwritten events.
+ * @param events_per_thread Ring size per thread, rounded up to a power of two (0 for 65536)
+ * @return true if tracing started, false otherwise
+ */
+bool bm_trace_start(size_t events_per_thread);
+
+/**
+ * Stop recording trace events. Events already recorded can still be written.
+ */
+void bm_trace_stop(void);
+
+/**
+ * Write the events recorded since the last write to a file. Can be called
+ * while tracing continues.
+ * @param path File to create
+ * @param format Trace file format
+ * @return Number of events written, or -1 on error
+ */
+int64_t bm_trace_write(const char* path, BMTraceFormat format);
+
 /**
  * Stop capture on a channel and release its resources.
  * @param context The library context
@@ -276,6 +960,344 @@ void bm_stop_channel_capture(BMContext* context, BMCaptureChannel* channel);
  */
 void bm_destroy_channel(BMContext* context, BMCaptureChannel* channel);
 
+/**
+ * Fill a replay options structure with the default values.
+ * @param options Options structure to initialize
+ */
+void bm_replay_options_init(BMReplayOptions* options);
+
+/**
+ * Read the code a latency-probe replay source stamped into a frame, and how
+ * long ago the frame was emitted. Works on frames as returned by
+ * bm_get_channel_frame in any format.
+ * @param frame Frame data, rows packed without padding
+ * @param format Pixel format of the frame data
+ * @param width Frame width in pixels
+ * @param height Frame height in pixels
+ * @param probe Structure to receive the code
+ * @return true if the frame carries a valid code, false otherwise
+ */
+bool bm_decode_latency_probe(const uint8_t* frame, BMPixelFormat format, int width, int height,
+                             BMLatencyProbe* probe);
+
+/**
+ * Create a channel that replays recorded frames instead of capturing from a device.
+ * Frames are fed through the same callback, buffering, signal detection and
+ * conversion as a hardware channel, so it works without a DeckLink card or driver.
+ * The source is a BM_RECORDING_CONTAINER file, a BM_RECORDING_RAW file (read
+ * with the size passed to bm_start_channel_capture), or a generated colour bar
+ * pattern with a moving marker when path is NULL. With latency_probe set, each
+ * 8-bit frame carries a code readable with bm_decode_latency_probe.
+ * @param context The library context
+ * @param path Recording to replay, or NULL for the test pattern
+ * @param options Replay options, or NULL for the defaults
+ * @return Handle to the channel, or NULL if the file could not be opened
+ */
+BMCaptureChannel* bm_create_replay_channel(BMContext* context, const char* path,
+                                           const BMReplayOptions* options);
+
+/**
+ * Fill a recording options structure with the default values.
+ * @param options Options structure to initialize
+ */
+void bm_recording_options_init(BMRecordingOptions* options);
+
+/**
+ * Start recording the raw captured frames of a channel to disk.
+ * Frames are written unconverted (8-bit 4:2:2, cb-y0-cr-y1) and back to back.
+ * The capture callback only hands a reference to each frame buffer to a
+ * dedicated writer thread; when the writer falls behind by more than
+ * queue_depth frames, new frames are dropped and counted instead of stalling capture.
+ * With segment_seconds set, path names the series: capture.bmraw is written as
+ * capture-000000.bmraw, capture-000001.bmraw, ... each with its own index.
+ * Any recording already running on the channel is stopped first.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param path Path of the file to create (an existing file is truncated)
+ * @param options Recording options, or NULL for the defaults
+ * @return true if the recording was started, false otherwise
+ */
+bool bm_channel_start_recording(BMContext* context, BMCaptureChannel* channel,
+                                const char* path, const BMRecordingOptions* options);
+
+/**
+ * Stop a recording, writing any queued frames before closing the file.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ */
+void bm_channel_stop_recording(BMContext* context, BMCaptureChannel* channel);
+
+/**
+ * Get the statistics of the current (or last) recording on a channel.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param stats Structure to receive the statistics
+ * @return true if successful, false otherwise
+ */
+bool bm_channel_get_recording_stats(BMContext* context, BMCaptureChannel* channel,
+                                    BMRecordingStats* stats);
+
+/**
+ * Fill a stream options structure with the default values.
+ * @param options Options structure to initialize
+ */
+void bm_stream_options_init(BMStreamOptions* options);
+
+/**
+ * Stream the captured frames of a channel to a file descriptor, e.g. the stdin
+ * pipe of an encoder. A native writer thread does all I/O; with a pipe and
+ * zero_copy, BM_STREAM_RAW frames are spliced from the capture buffers and
+ * BM_STREAM_Y4M frames from their planar conversion, without further copies.
+ * Any stream already running on the channel is stopped first.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param fd Descriptor to write to; it is duplicated, so the caller may close its copy
+ * @param options Stream options, or NULL for the defaults
+ * @return true if the stream was started, false otherwise
+ */
+bool bm_channel_start_stream(BMContext* context, BMCaptureChannel* channel,
+                             int fd, const BMStreamOptions* options);
+
+/**
+ * Stop a stream, writing any queued frames before closing the descriptor.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ */
+void bm_channel_stop_stream(BMContext* context, BMCaptureChannel* channel);
+
+/**
+ * Get the statistics of the current (or last) stream on a channel.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param stats Structure to receive the statistics
+ * @return true if successful, false otherwise
+ */
+bool bm_channel_get_stream_stats(BMContext* context, BMCaptureChannel* channel,
+                                 BMStreamStats* stats);
+
+/**
+ * Fill a frame server options structure with the default values.
+ * @param options Options structure to initialize
+ */
+void bm_server_options_init(BMServerOptions* options);
+
+/**
+ * Share the raw frames of a capturing channel with other local processes.
+ * The channel's frames are captured into a shared memory arena that is passed
+ * to subscribers over a Unix domain socket, so subscribers read frames in
+ * place without copies. See bmcapture_client.h for the subscriber side.
+ * Any server already running on the channel is stopped first.
+ * @param context The library context
+ * @param channel Handle to a capturing channel
+ * @param socket_path Path of the Unix socket to create (an existing socket is replaced)
+ * @param options Server options, or NULL for the defaults
+ * @return true if the server was started, false otherwise
+ */
+bool bm_channel_start_server(BMContext* context, BMCaptureChannel* channel,
+                             const char* socket_path, const BMServerOptions* options);
+
+/**
+ * Stop the frame server, disconnecting all subscribers.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ */
+void bm_channel_stop_server(BMContext* context, BMCaptureChannel* channel);
+
+/**
+ * Get the statistics of the frame server on a channel.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param stats Structure to receive the statistics
+ * @return true if successful, false otherwise
+ */
+bool bm_channel_get_server_stats(BMContext* context, BMCaptureChannel* channel,
+                                 BMServerStats* stats);
+
+/**
+ * Fill an RTP sender options structure with the default values.
+ * @param options Options structure to initialize
+ */
+void bm_rtp_options_init(BMRtpOptions* options);
+
+/**
+ * Send the frames of a capturing channel as uncompressed RTP video
+ * (RFC 4175, 8-bit YCbCr 4:2:2, progressive) to a UDP destination.
+ * Any RTP sender already running on the channel is stopped first.
+ * @param context The library context
+ * @param channel Handle to a capturing channel
+ * @param host Destination host name or address (unicast or multicast)
+ * @param port Destination UDP port
+ * @param options Sender options, or NULL for the defaults
+ * @return true if the sender was started, false otherwise
+ */
+bool bm_channel_start_rtp(BMContext* context, BMCaptureChannel* channel,
+                          const char* host, int port, const BMRtpOptions* options);
+
+/**
+ * Stop sending RTP video.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ */
+void bm_channel_stop_rtp(BMContext* context, BMCaptureChannel* channel);
+
+/**
+ * Get the statistics of the RTP sender on a channel.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param stats Structure to receive the statistics
+ * @return true if successful, false otherwise
+ */
+bool bm_channel_get_rtp_stats(BMContext* context, BMCaptureChannel* channel,
+                              BMRtpStats* stats);
+
+/**
+ * Open a receiver for RTP video in the format sent by bm_channel_start_rtp.
+ * Packets are received and reassembled on a background thread.
+ * @param address Local address to bind, or a multicast group to join (NULL for any)
+ * @param port UDP port to receive on
+ * @param width Frame width in pixels
+ * @param height Frame height in lines
+ * @return Handle to the receiver, or NULL if it could not be opened
+ */
+BMRtpReceiver* bm_rtp_receiver_open(const char* address, int port, int width, int height);
+
+/**
+ * Close an RTP receiver.
+ * @param receiver Handle to the receiver
+ */
+void bm_rtp_receiver_close(BMRtpReceiver* receiver);
+
+/**
+ * Wait for the next reassembled frame and copy it out.
+ * @param receiver Handle to the receiver
+ * @param buffer Buffer for width * 2 * height bytes of 2vuy data
+ * @param size Size of the buffer
+ * @param timeout_ms Maximum wait in milliseconds, 0 to poll, -1 to wait forever
+ * @param info Optional pointer to store the frame metadata
+ * @return true if a frame was copied, false on timeout or if the buffer is too small
+ */
+bool bm_rtp_receiver_get_frame(BMRtpReceiver* receiver, uint8_t* buffer, size_t size,
+                               int timeout_ms, BMRtpFrameInfo* info);
+
+/**
+ * Get the loss and jitter statistics of an RTP receiver.
+ * @param receiver Handle to the receiver
+ * @param stats Structure to receive the statistics
+ * @return true if successful, false otherwise
+ */
+bool bm_rtp_receiver_get_stats(BMRtpReceiver* receiver, BMRtpReceiverStats* stats);
+
+/**
+ * Fill a pre-trigger options structure with the default values.
+ * @param options Options structure to initialize
+ */
+void bm_pretrigger_options_init(BMPreTriggerOptions* options);
+
+/**
+ * Keep the most recent frames of a capturing channel in memory so they can be
+ * written out after an event.
+ * The ring holds references to the raw capture buffers, sized from the current
+ * mode and allocated up front, so the capture callback never copies or
+ * allocates for it. Any previous pre-trigger ring on the channel is replaced.
+ * @param context The library context
+ * @param channel Handle to a capturing channel
+ * @param options Pre-trigger options, or NULL for the defaults
+ * @return true if the ring was set up, false otherwise
+ */
+bool bm_channel_enable_pretrigger(BMContext* context, BMCaptureChannel* channel,
+                                  const BMPreTriggerOptions* options);
+
+/**
+ * Release the pre-trigger ring, finishing any dump in progress.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ */
+void bm_channel_disable_pretrigger(BMContext* context, BMCaptureChannel* channel);
+
+/**
+ * Write the buffered pre-roll and the next post_seconds of frames to a file.
+ * Returns immediately; the file is opened and written by a background thread
+ * while capture continues. Only one dump runs at a time.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param path Path of the file to create, or NULL to name it from signal_loss_prefix
+ * @return true if the dump was started, false if none is possible or one is already running
+ */
+bool bm_channel_trigger_dump(BMContext* context, BMCaptureChannel* channel, const char* path);
+
+/**
+ * Get the occupancy and dump statistics of the pre-trigger ring.
+ * @param context The library context
+ * @param channel Handle to the capture channel
+ * @param stats Structure to receive the statistics
+ * @return true if successful, false otherwise
+ */
+bool bm_channel_get_pretrigger_stats(BMContext* context, BMCaptureChannel* channel,
+                                     BMPreTriggerStats* stats);
+
+/**
+ * Open a raw capture container written with BM_RECORDING_CONTAINER.
+ * The file and its <path>.idx index are memory-mapped; frames can be read
+ * in any order without parsing. A container that is still being recorded
+ * can be opened; frames written after opening are not visible.
+ * @param path Path of the container
+ * @return Handle to the container, or NULL if it could not be opened
+ */
+BMRawFile* bm_raw_file_open(const char* path);
+
+/**
+ * Close a raw capture container. Frame pointers obtained from it become invalid.
+ * @param file Handle to the container
+ */
+void bm_raw_file_close(BMRawFile* file);
+
+/**
+ * Get the format and frame count of a raw capture container.
+ * @param file Handle to the container
+ * @param info Structure to receive the format
+ * @return true if successful, false otherwise
+ */
+bool bm_raw_file_get_info(BMRawFile* file, BMRawFileInfo* info);
+
+/**
+ * Get a frame of a raw capture container without copying it.
+ * For compressed containers this is the encoded frame as stored.
+ * @param file Handle to the container
+ * @param index Index of the frame (0-based)
+ * @param out_size Optional pointer to store the frame size in bytes
+ * @param out_info Optional pointer to store the frame metadata
+ * @return Pointer to the page-aligned frame data, valid until the file is closed, or NULL if out of range
+ */
+const uint8_t* bm_raw_file_get_frame(BMRawFile* file, int64_t index, size_t* out_size, BMFrameInfo* out_info);
+
+/**
+ * Copy a frame of a raw capture container, decoding it if the container is compressed.
+ * Decoding uses a codec owned by the file, so calls on one file must not overlap.
+ * @param file Handle to the container
+ * @param index Index of the frame (0-based)
+ * @param buffer Buffer for row_bytes * height bytes
+ * @param size Size of the buffer in bytes
+ * @param out_info Optional pointer to store the frame metadata
+ * @return true if successful, false if out of range, the buffer is too small or the frame is damaged
+ */
+bool bm_raw_file_read_frame(BMRawFile* file, int64_t index, uint8_t* buffer, size_t size, BMFrameInfo* out_info);
+
+/**
+ * Find the last frame whose stream time is at or before the given time.
+ * @param file Handle to the container
+ * @param stream_time Stream time in the container's time_scale units
+ * @return Index of the frame, or -1 if the container is empty
+ */
+int64_t bm_raw_file_find_frame(BMRawFile* file, int64_t stream_time);
+
+/**
+ * Hint that a range of frames will be read soon, so the kernel can start reading them.
+ * @param file Handle to the container
+ * @param index Index of the first frame
+ * @param count Number of frames
+ */
+void bm_raw_file_prefetch(BMRawFile* file, int64_t index, int count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,111 @@
+#include "bmcapture_arena.h"
+#include "bmcapture_frame_pool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Create an anonymous shared memory file that only lives as long as its descriptors
+static int create_shared_memory(size_t size) {
+    int fd = -1;
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    fd = memfd_create("bmcapture-arena", MFD_CLOEXEC);
+#endif
+    if (fd < 0) {
+        char name[64];
+        for (int attempt = 0; attempt < 16 && fd < 0; attempt++) {
+            snprintf(name, sizeof(name), "/bmcapture-%d-%d", (int)getpid(), attempt);
+            fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd >= 0) {
+                shm_unlink(name);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
+        }
+    }
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+SharedArena* SharedArena::create(size_t count, size_t size_per_slot) {
+    if (count == 0 || size_per_slot == 0) {
+        return nullptr;
+    }
+
+    SharedArena* arena = new SharedArena();
+    arena->slot_count = count;
+    arena->slot_size = bm_align_up(size_per_slot);
+    arena->data_offset = bm_align_up(count * sizeof(uint64_t));
+    arena->size = arena->data_offset + count * arena->slot_size;
+
+    arena->memory_fd = create_shared_memory(arena->size);
+    if (arena->memory_fd < 0) {
+        delete arena;
+        return nullptr;
+    }
+
+    void* mapping = mmap(nullptr, arena->size, PROT_READ | PROT_WRITE, MAP_SHARED, arena->memory_fd, 0);
+    if (mapping == MAP_FAILED) {
+        delete arena;
+        return nullptr;
+    }
+    arena->base = static_cast<uint8_t*>(mapping);
+    arena->generations = reinterpret_cast<uint64_t*>(arena->base);
+
+    // Fault every page in now rather than on the capture thread
+    memset(arena->base, 0, arena->size);
+
+    arena->free_slots.reserve(count);
+    for (size_t i = count; i > 0; i--) {
+        arena->free_slots.push_back((int)(i - 1));
+    }
+    return arena;
+}
+
+SharedArena::~SharedArena() {
+    if (base != nullptr) {
+        munmap(base, size);
+    }
+    if (memory_fd >= 0) {
+        close(memory_fd);
+    }
+}
+
+int SharedArena::allocateSlot() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (free_slots.empty()) {
+        return -1;
+    }
+    int slot = free_slots.back();
+    free_slots.pop_back();
+    return slot;
+}
+
+void SharedArena::freeSlot(int slot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    free_slots.push_back(slot);
+}
+
+size_t SharedArena::slotsInUse() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return slot_count - free_slots.size();
+}
+
+void SharedArena::beginWrite(int slot) {
+    // The fence keeps the new frame's stores from becoming visible before the
+    // generation change, like the writer side of a seqlock
+    __atomic_add_fetch(&generations[slot], 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+uint64_t SharedArena::generation(int slot) const {
+    return __atomic_load_n(&generations[slot], __ATOMIC_ACQUIRE);
+}
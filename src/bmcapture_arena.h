@@ -0,0 +1,54 @@
+#ifndef BMCAPTURE_ARENA_H
+#define BMCAPTURE_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include <vector>
+
+// Fixed-size frame slots in an anonymous shared memory file (memfd on Linux,
+// an unlinked POSIX shm object elsewhere), so the same pages can be mapped by
+// other processes through the descriptor. Layout follows bmcapture_protocol.h:
+// a generation counter per slot, then the page-aligned slots.
+class SharedArena {
+public:
+    ~SharedArena();
+
+    // Create an arena of slot_count slots of at least slot_size bytes each
+    static SharedArena* create(size_t slot_count, size_t slot_size);
+
+    int fd() const { return memory_fd; }
+    size_t slotCount() const { return slot_count; }
+    size_t slotSize() const { return slot_size; }
+    size_t dataOffset() const { return data_offset; }
+
+    uint8_t* slotData(int slot) const { return base + data_offset + (size_t)slot * slot_size; }
+
+    // Take a free slot, or return -1 when every slot is in use
+    int allocateSlot();
+    void freeSlot(int slot);
+    size_t slotsInUse() const;
+
+    // Mark a slot as about to be rewritten, invalidating readers of its old contents
+    void beginWrite(int slot);
+    uint64_t generation(int slot) const;
+
+    SharedArena(const SharedArena&) = delete;
+    SharedArena& operator=(const SharedArena&) = delete;
+
+private:
+    SharedArena() {}
+
+    int memory_fd = -1;
+    uint8_t* base = nullptr;
+    size_t size = 0;
+    size_t slot_count = 0;
+    size_t slot_size = 0;
+    size_t data_offset = 0;
+    uint64_t* generations = nullptr;    // Lives in the shared mapping
+
+    mutable std::mutex mutex;
+    std::vector<int> free_slots;
+};
+
+#endif /* BMCAPTURE_ARENA_H */
@@ -0,0 +1,214 @@
+#include "bmcapture_audio.h"
+#include "bmcapture_log.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+void bm_audio_options_init(BMAudioOptions* options) {
+    if (options == nullptr) {
+        return;
+    }
+    options->channel_count = 2;
+    options->sample_depth = 16;
+    options->buffer_seconds = 2.0;
+}
+
+AudioRing::AudioRing()
+    : written(0), reserved(0), segment_seq(0), segment_position(0), segment_counter(0),
+      packets(0), sample_frames(0), silence_frames(0), discontinuities(0),
+      reads_expired(0), reads_pending(0) {}
+
+bool AudioRing::configure(int channel_count, int sample_depth, double seconds,
+                          MemoryAccount* account) {
+    if (channel_count != 2 && channel_count != 8 && channel_count != 16) {
+        log_error("Unsupported audio channel count %d (use 2, 8 or 16)", channel_count);
+        return false;
+    }
+    if (sample_depth != 16 && sample_depth != 32) {
+        log_error("Unsupported audio sample depth %d (use 16 or 32)", sample_depth);
+        return false;
+    }
+    if (!(seconds > 0.0) || seconds > 60.0) {
+        log_error("Audio buffer of %.2f seconds out of range (0 to 60)", seconds);
+        return false;
+    }
+
+    release();
+    channels = channel_count;
+    depth = sample_depth;
+    frame_bytes = (size_t)channel_count * (sample_depth / 8);
+    capacity = (uint64_t)ceil(seconds * kAudioSampleRate);
+    data = AccountedBuffer(AccountedAllocator<uint8_t>(account, MEMORY_AUDIO));
+    data.resize(capacity * frame_bytes);
+
+    // Counters carry on from the previous configuration, and everything below
+    // the first new slot reads as overwritten, so old views stay invalid
+    uint64_t counter = written.load(std::memory_order_relaxed);
+    reserved.store(counter + capacity, std::memory_order_relaxed);
+    has_segment = false;
+    segment_seq.store(0, std::memory_order_relaxed);
+
+    packets.store(0, std::memory_order_relaxed);
+    sample_frames.store(0, std::memory_order_relaxed);
+    silence_frames.store(0, std::memory_order_relaxed);
+    discontinuities.store(0, std::memory_order_relaxed);
+    reads_expired.store(0, std::memory_order_relaxed);
+    reads_pending.store(0, std::memory_order_relaxed);
+    return true;
+}
+
+void AudioRing::release() {
+    capacity = 0;
+    AccountedBuffer().swap(data);
+}
+
+void AudioRing::startSegment(int64_t position) {
+    uint64_t seq = segment_seq.load(std::memory_order_relaxed);
+    segment_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    segment_position.store(position, std::memory_order_relaxed);
+    segment_counter.store(written.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    segment_seq.store(seq + 2, std::memory_order_release);
+    has_segment = true;
+}
+
+void AudioRing::append(const uint8_t* samples, uint64_t frame_count) {
+    uint64_t counter = written.load(std::memory_order_relaxed);
+    uint64_t limit = reserved.load(std::memory_order_relaxed);
+    while (frame_count > 0) {
+        uint64_t chunk = std::min(frame_count, capacity);
+
+        // Announce the slots about to be reused before touching them
+        if (counter + chunk > limit) {
+            limit = counter + chunk;
+            reserved.store(limit, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        uint64_t slot = counter % capacity;
+        uint64_t first = std::min(chunk, capacity - slot);
+        uint8_t* ring = data.data();
+        if (samples != nullptr) {
+            memcpy(ring + slot * frame_bytes, samples, first * frame_bytes);
+            memcpy(ring, samples + first * frame_bytes, (chunk - first) * frame_bytes);
+            samples += chunk * frame_bytes;
+        } else {
+            memset(ring + slot * frame_bytes, 0, first * frame_bytes);
+            memset(ring, 0, (chunk - first) * frame_bytes);
+        }
+
+        counter += chunk;
+        frame_count -= chunk;
+        written.store(counter, std::memory_order_release);
+    }
+}
+
+void AudioRing::write(const void* samples, uint32_t frame_count, bool has_position, int64_t position) {
+    if (capacity == 0 || samples == nullptr || frame_count == 0) {
+        return;
+    }
+    packets.fetch_add(1, std::memory_order_relaxed);
+
+    if (!has_segment) {
+        startSegment(has_position ? position : 0);
+    } else if (has_position) {
+        uint64_t counter = written.load(std::memory_order_relaxed);
+        int64_t expected = segment_position.load(std::memory_order_relaxed) +
+            (int64_t)(counter - segment_counter.load(std::memory_order_relaxed));
+        int64_t gap = position - expected;
+        if (gap > 0 && (uint64_t)gap <= capacity) {
+            // Keep positions continuous across a lost packet
+            append(nullptr, (uint64_t)gap);
+            silence_frames.fetch_add((uint64_t)gap, std::memory_order_relaxed);
+        } else if (gap != 0) {
+            log_debug("Audio packet time jumped by %lld sample frames; restarting the ring", (long long)gap);
+            startSegment(position);
+            discontinuities.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    append((const uint8_t*)samples, frame_count);
+    sample_frames.fetch_add(frame_count, std::memory_order_relaxed);
+}
+
+bool AudioRing::view(int64_t position, uint32_t frame_count, BMAudioView* out) {
+    if (capacity == 0 || out == nullptr) {
+        return false;
+    }
+
+    uint64_t seq;
+    int64_t first_position;
+    uint64_t first_counter;
+    do {
+        seq = segment_seq.load(std::memory_order_acquire);
+        first_position = segment_position.load(std::memory_order_relaxed);
+        first_counter = segment_counter.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) != 0 || seq != segment_seq.load(std::memory_order_relaxed));
+
+    if (seq == 0) {
+        reads_pending.fetch_add(1, std::memory_order_relaxed);
+        return false;   // No audio yet
+    }
+    if (position < first_position) {
+        reads_expired.fetch_add(1, std::memory_order_relaxed);
+        return false;   // Before the current segment
+    }
+
+    uint64_t start = first_counter + (uint64_t)(position - first_position);
+    if (start + frame_count > written.load(std::memory_order_acquire)) {
+        reads_pending.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (reserved.load(std::memory_order_acquire) > start + capacity) {
+        reads_expired.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint64_t slot = start % capacity;
+    uint32_t first = (uint32_t)std::min<uint64_t>(frame_count, capacity - slot);
+    const uint8_t* ring = data.data();
+    out->data[0] = frame_count > 0 ? ring + slot * frame_bytes : nullptr;
+    out->frames[0] = first;
+    out->data[1] = first < frame_count ? ring : nullptr;
+    out->frames[1] = frame_count - first;
+    out->frame_count = frame_count;
+    out->start_sample = position;
+    out->channel_count = channels;
+    out->sample_depth = depth;
+    out->ring_counter = start;
+    return true;
+}
+
+bool AudioRing::valid(const BMAudioView& view) const {
+    if (capacity == 0) {
+        return false;
+    }
+    // Order the caller's reads of the samples before the check
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (reserved.load(std::memory_order_relaxed) > view.ring_counter + capacity) {
+        reads_expired.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void AudioRing::getStats(BMAudioStats* stats) const {
+    stats->enabled = capacity > 0;
+    stats->channel_count = channels;
+    stats->sample_depth = depth;
+    stats->buffer_frames = (uint32_t)capacity;
+    stats->packets = packets.load(std::memory_order_relaxed);
+    stats->sample_frames = sample_frames.load(std::memory_order_relaxed);
+    stats->silence_frames = silence_frames.load(std::memory_order_relaxed);
+    stats->discontinuities = discontinuities.load(std::memory_order_relaxed);
+    stats->reads_expired = reads_expired.load(std::memory_order_relaxed);
+    stats->reads_pending = reads_pending.load(std::memory_order_relaxed);
+
+    stats->write_position = 0;
+    if (segment_seq.load(std::memory_order_acquire) != 0) {
+        stats->write_position = segment_position.load(std::memory_order_relaxed) +
+            (int64_t)(written.load(std::memory_order_relaxed) -
+                      segment_counter.load(std::memory_order_relaxed));
+    }
+}
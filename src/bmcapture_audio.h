@@ -0,0 +1,94 @@
+#ifndef BMCAPTURE_AUDIO_H
+#define BMCAPTURE_AUDIO_H
+
+#include "bmcapture.h"
+#include "bmcapture_memory.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Sample rate of embedded SDI audio; positions in the ring count 48 kHz sample frames
+static const int64_t kAudioSampleRate = 48000;
+
+// First sample frame belonging to a video frame that starts at stream_time.
+// Flooring both ends of the frame gives each frame exactly the samples up to
+// the next one, e.g. the 1601/1602 cadence at 29.97 fps.
+static inline int64_t audio_position_for(int64_t stream_time, int64_t time_scale) {
+    if (time_scale <= 0) {
+        return 0;
+    }
+    int64_t scaled = stream_time * kAudioSampleRate;
+    int64_t position = scaled / time_scale;
+    if (scaled % time_scale != 0 && scaled < 0) {
+        position--;
+    }
+    return position;
+}
+
+// Embedded audio of one channel, kept in a ring of interleaved samples that
+// readers can look at in place.
+//
+// The capture callback is the only writer. Every sample frame gets a counter
+// that only grows; the ring slot is the counter modulo the capacity, and a
+// segment maps counters to stream positions (48 kHz sample frames). Missing
+// packets are filled with silence so positions stay continuous; a jump back in
+// time or further ahead than the ring holds starts a new segment.
+//
+// Nothing is locked. The writer publishes `reserved` before overwriting slots
+// and `written` after, and readers check `reserved` after touching the data,
+// the same way a seqlock would: a view is good as long as no slot in it has
+// been reused since it was taken.
+class AudioRing {
+public:
+    AudioRing();
+
+    // Size the ring and clear it; only while the capture callback is not running
+    bool configure(int channel_count, int sample_depth, double seconds,
+                   MemoryAccount* account);
+    void release();
+
+    bool enabled() const { return capacity > 0; }
+    int channelCount() const { return channels; }
+    int sampleDepth() const { return depth; }
+    size_t frameBytes() const { return frame_bytes; }
+
+    // Writer: the capture callback only. Packets without a time follow the previous one.
+    void write(const void* samples, uint32_t frame_count, bool has_position, int64_t position);
+
+    // View the sample frames [position, position + frame_count) in place
+    bool view(int64_t position, uint32_t frame_count, BMAudioView* out);
+
+    // true while the samples of a view have not been overwritten
+    bool valid(const BMAudioView& view) const;
+
+    void getStats(BMAudioStats* stats) const;
+
+    AudioRing(const AudioRing&) = delete;
+    AudioRing& operator=(const AudioRing&) = delete;
+
+private:
+    void startSegment(int64_t position);
+    void append(const uint8_t* samples, uint64_t frame_count);
+
+    AccountedBuffer data;
+    uint64_t capacity = 0;          // Sample frames the ring holds
+    int channels = 0;
+    int depth = 0;
+    size_t frame_bytes = 0;
+
+    std::atomic<uint64_t> written;          // Counter of the next sample frame to write
+    std::atomic<uint64_t> reserved;         // Counters below this may be being written
+    std::atomic<uint64_t> segment_seq;      // Odd while the segment below changes
+    std::atomic<int64_t> segment_position;  // Stream position of the segment's first sample frame
+    std::atomic<uint64_t> segment_counter;  // Counter of the segment's first sample frame
+    bool has_segment = false;               // Writer only
+
+    std::atomic<uint64_t> packets;
+    std::atomic<uint64_t> sample_frames;
+    std::atomic<uint64_t> silence_frames;
+    std::atomic<uint64_t> discontinuities;
+    mutable std::atomic<uint64_t> reads_expired;
+    mutable std::atomic<uint64_t> reads_pending;
+};
+
+#endif /* BMCAPTURE_AUDIO_H */
@@ -0,0 +1,293 @@
+#include "bmcapture_client.h"
+#include "bmcapture_protocol.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  /* macOS uses SO_NOSIGPIPE on the socket instead */
+#endif
+
+struct BMClient {
+    int fd;
+    int memory_fd;
+    uint8_t* base;
+    size_t size;
+    BMServerHello hello;
+};
+
+static int connect_socket(const char* socket_path, int type) {
+    struct sockaddr_un address;
+    int fd;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+
+    fd = socket(AF_UNIX, type, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+/* Receive one message; stream sockets may deliver it in pieces */
+static bool receive_message(int fd, uint8_t* message) {
+    size_t received = 0;
+    while (received < BM_SERVER_MESSAGE_SIZE) {
+        ssize_t n = recv(fd, message + received, BM_SERVER_MESSAGE_SIZE - received, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        received += (size_t)n;
+    }
+    return true;
+}
+
+/* Receive the HELLO message and the arena descriptor that comes with it.
+ * Sets errno on failure, EPROTO when the server is not speaking our protocol. */
+static bool receive_hello(BMClient* client) {
+    uint8_t message[BM_SERVER_MESSAGE_SIZE];
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr* cmsg;
+    ssize_t n;
+
+    iov.iov_base = message;
+    iov.iov_len = sizeof(message);
+    memset(&control, 0, sizeof(control));
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    do {
+        n = recvmsg(client->fd, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        if (n == 0) {
+            errno = ECONNRESET;
+        }
+        return false;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            memcpy(&client->memory_fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    if (client->memory_fd < 0) {
+        errno = EPROTO;
+        return false;
+    }
+
+    /* The descriptor arrives with the first bytes; finish a split message */
+    if (n < (ssize_t)sizeof(message)) {
+        size_t received = (size_t)n;
+        while (received < sizeof(message)) {
+            n = recv(client->fd, message + received, sizeof(message) - received, 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                if (n == 0) {
+                    errno = ECONNRESET;
+                }
+                return false;
+            }
+            received += (size_t)n;
+        }
+    }
+
+    memcpy(&client->hello, message, sizeof(client->hello));
+    if (client->hello.type != BM_SERVER_HELLO || client->hello.version != BM_SERVER_PROTOCOL_VERSION) {
+        errno = EPROTO;
+        return false;
+    }
+    return true;
+}
+
+BMClient* bm_client_connect(const char* socket_path) {
+    BMClient* client;
+    void* mapping;
+    int error;
+
+    if (socket_path == NULL || strlen(socket_path) >= sizeof(((struct sockaddr_un*)0)->sun_path)) {
+        errno = socket_path == NULL ? EINVAL : ENAMETOOLONG;
+        return NULL;
+    }
+
+    client = (BMClient*)calloc(1, sizeof(BMClient));
+    if (client == NULL) {
+        return NULL;
+    }
+    client->memory_fd = -1;
+
+    /* The server listens with SOCK_SEQPACKET where the system has it */
+    client->fd = connect_socket(socket_path, SOCK_SEQPACKET);
+    if (client->fd < 0) {
+        client->fd = connect_socket(socket_path, SOCK_STREAM);
+    }
+    if (client->fd < 0) {
+        free(client);
+        return NULL;
+    }
+#ifdef SO_NOSIGPIPE
+    {
+        int on = 1;
+        setsockopt(client->fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+    }
+#endif
+
+    if (!receive_hello(client)) {
+        error = errno;
+        bm_client_close(client);
+        errno = error;
+        return NULL;
+    }
+
+    client->size = (size_t)(client->hello.data_offset + client->hello.slot_count * client->hello.slot_size);
+    mapping = mmap(NULL, client->size, PROT_READ, MAP_SHARED, client->memory_fd, 0);
+    if (mapping == MAP_FAILED) {
+        error = errno;
+        client->size = 0;
+        bm_client_close(client);
+        errno = error;
+        return NULL;
+    }
+    client->base = (uint8_t*)mapping;
+    return client;
+}
+
+void bm_client_close(BMClient* client) {
+    if (client == NULL) {
+        return;
+    }
+    if (client->base != NULL) {
+        munmap(client->base, client->size);
+    }
+    if (client->memory_fd >= 0) {
+        close(client->memory_fd);
+    }
+    if (client->fd >= 0) {
+        close(client->fd);
+    }
+    free(client);
+}
+
+void bm_client_get_format(BMClient* client, BMClientFormat* format) {
+    if (client == NULL || format == NULL) {
+        return;
+    }
+    format->width = (int)client->hello.width;
+    format->height = (int)client->hello.height;
+    format->row_bytes = (int)client->hello.row_bytes;
+    format->pixel_format = client->hello.pixel_format;
+    format->time_scale = client->hello.time_scale;
+    format->frame_duration = client->hello.frame_duration;
+    format->slot_count = (int)client->hello.slot_count;
+}
+
+int bm_client_fd(BMClient* client) {
+    return client != NULL ? client->fd : -1;
+}
+
+int bm_client_next_frame(BMClient* client, BMClientFrame* frame, int timeout_ms) {
+    uint8_t message[BM_SERVER_MESSAGE_SIZE];
+    const BMServerFrame* announce = (const BMServerFrame*)message;
+
+    if (client == NULL || frame == NULL) {
+        return -1;
+    }
+
+    for (;;) {
+        struct pollfd pfd;
+        int ready;
+
+        pfd.fd = client->fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready < 0) {
+            return -1;
+        }
+        if (ready == 0) {
+            return 0;
+        }
+
+        if (!receive_message(client->fd, message)) {
+            return -1;
+        }
+        if (announce->type != BM_SERVER_FRAME || announce->slot >= client->hello.slot_count ||
+            announce->size > client->hello.slot_size) {
+            continue;
+        }
+
+        frame->slot = (int)announce->slot;
+        frame->data = client->base + client->hello.data_offset + (size_t)announce->slot * client->hello.slot_size;
+        frame->size = announce->size;
+        frame->generation = announce->generation;
+        frame->sequence = announce->sequence;
+        frame->stream_time = announce->stream_time;
+        frame->frame_duration = announce->frame_duration;
+        frame->hardware_timestamp = announce->hardware_timestamp;
+        frame->flags = announce->flags;
+        return 1;
+    }
+}
+
+bool bm_client_frame_valid(BMClient* client, const BMClientFrame* frame) {
+    const uint64_t* generations;
+
+    if (client == NULL || frame == NULL || frame->slot < 0 || (uint32_t)frame->slot >= client->hello.slot_count) {
+        return false;
+    }
+
+    /* Reader side of the seqlock: order the data reads before the generation check */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    generations = (const uint64_t*)client->base;
+    return __atomic_load_n(&generations[frame->slot], __ATOMIC_RELAXED) == frame->generation;
+}
+
+void bm_client_release_frame(BMClient* client, const BMClientFrame* frame) {
+    uint8_t message[BM_SERVER_MESSAGE_SIZE];
+    BMServerFrame* release = (BMServerFrame*)message;
+    ssize_t n;
+
+    if (client == NULL || frame == NULL || frame->slot < 0) {
+        return;
+    }
+
+    memset(message, 0, sizeof(message));
+    release->type = BM_SERVER_RELEASE;
+    release->slot = (uint32_t)frame->slot;
+    release->generation = frame->generation;
+    release->sequence = frame->sequence;
+
+    /* A lost release only means the lease runs to its expiry */
+    do {
+        n = send(client->fd, message, sizeof(message), MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+}
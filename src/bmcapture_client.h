@@ -0,0 +1,112 @@
+#ifndef BMCAPTURE_CLIENT_H
+#define BMCAPTURE_CLIENT_H
+
+/*
+ * Subscriber side of the local frame server (bm_channel_start_server).
+ * Plain C with no dependency on the capture library or the DeckLink SDK:
+ * compile bmcapture_client.c into the consuming program.
+ *
+ * Frames are read in place from memory shared with the capturing process.
+ * Each frame returned by bm_client_next_frame() is leased to the client until
+ * it is released or the server's lease time runs out; a client that holds a
+ * frame too long has it reclaimed rather than stalling capture, which
+ * bm_client_frame_valid() detects.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct BMClient BMClient;
+
+/**
+ * Stream format announced by the server
+ */
+typedef struct {
+    int width;
+    int height;
+    int row_bytes;
+    uint32_t pixel_format;      // DeckLink pixel format code ('2vuy')
+    int64_t time_scale;         // Units per second of the frame times
+    int64_t frame_duration;     // Nominal frame duration in time_scale units
+    int slot_count;             // Frame slots in the shared memory
+} BMClientFormat;
+
+/**
+ * A frame leased from the server
+ */
+typedef struct {
+    const uint8_t* data;        // Frame data in shared memory, valid until released
+    size_t size;
+    int slot;
+    uint64_t generation;
+    uint64_t sequence;          // Capture sequence number; gaps are frames this client missed
+    int64_t stream_time;
+    int64_t frame_duration;
+    int64_t hardware_timestamp; // Nanoseconds
+    uint32_t flags;             // DeckLink frame flags
+} BMClientFrame;
+
+/**
+ * Connect to a frame server and map its frame memory.
+ * @param socket_path Path of the server's Unix socket
+ * @return Client handle, or NULL with errno set on failure (EPROTO if the
+ *         server's greeting is missing or from another protocol version)
+ */
+BMClient* bm_client_connect(const char* socket_path);
+
+/**
+ * Disconnect and unmap the frame memory. Frames still held become invalid.
+ * @param client Client handle
+ */
+void bm_client_close(BMClient* client);
+
+/**
+ * Get the stream format.
+ * @param client Client handle
+ * @param format Structure to receive the format
+ */
+void bm_client_get_format(BMClient* client, BMClientFormat* format);
+
+/**
+ * Get the socket descriptor, for waiting on several sources with poll().
+ * @param client Client handle
+ * @return Descriptor that becomes readable when a frame is announced
+ */
+int bm_client_fd(BMClient* client);
+
+/**
+ * Wait for the next frame.
+ * @param client Client handle
+ * @param frame Structure to receive the frame
+ * @param timeout_ms Maximum wait in milliseconds, 0 to poll, -1 to wait forever
+ * @return 1 if a frame was received, 0 on timeout, -1 if the server went away
+ */
+int bm_client_next_frame(BMClient* client, BMClientFrame* frame, int timeout_ms);
+
+/**
+ * Check that a frame was not reclaimed while it was being read.
+ * Call after reading (or copying) the data; if this returns false the data
+ * may be mixed with a newer frame and must be discarded.
+ * @param client Client handle
+ * @param frame Frame returned by bm_client_next_frame
+ * @return true if the data read is intact
+ */
+bool bm_client_frame_valid(BMClient* client, const BMClientFrame* frame);
+
+/**
+ * Hand a frame back to the server so its slot can be reused.
+ * @param client Client handle
+ * @param frame Frame returned by bm_client_next_frame
+ */
+void bm_client_release_frame(BMClient* client, const BMClientFrame* frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BMCAPTURE_CLIENT_H */
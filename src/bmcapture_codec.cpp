@@ -0,0 +1,578 @@
+#include "bmcapture_codec.h"
+#include <algorithm>
+#include <string.h>
+
+static const uint32_t kFormat8BitYUV = 0x32767579;     // '2vuy'
+static const uint32_t kFormat10BitYUV = 0x76323130;    // 'v210'
+
+// Residuals are packed in blocks of this many samples, two blocks per width byte
+static const int kBlockSamples = 16;
+static const int kPairSamples = 2 * kBlockSamples;
+
+// Samples of the same component are 4 apart in both packings (cb y cr y)
+static const int kComponentStride = 4;
+
+// Slices are fixed by the frame height alone, so the encoded data does not
+// depend on how many threads wrote it
+static int slice_count_for(int height) {
+    return std::max(1, std::min(32, height / 64));
+}
+
+static int bit_depth_for(uint32_t pixel_format) {
+    if (pixel_format == kFormat8BitYUV) {
+        return 8;
+    }
+    if (pixel_format == kFormat10BitYUV) {
+        return 10;
+    }
+    return 0;
+}
+
+// Rows must hold whole cb-y-cr-y groups (2vuy) or whole 6-pixel blocks (v210)
+static long row_alignment_for(int bits) {
+    return bits == 10 ? 16 : 4;
+}
+
+// Samples in one row once unpacked
+static size_t row_samples_for(long row_bytes, uint32_t pixel_format) {
+    if (pixel_format == kFormat10BitYUV) {
+        return (size_t)row_bytes / 4 * 3;  // Three 10-bit samples per 32-bit word
+    }
+    return (size_t)row_bytes;
+}
+
+static size_t padded_samples(size_t samples) {
+    return (samples + kPairSamples - 1) / kPairSamples * kPairSamples;
+}
+
+// Worst case for a run of samples: every block at full width
+static size_t max_packed_size(size_t samples, int bits) {
+    return padded_samples(samples) / kPairSamples * (1 + 4 * (size_t)bits);
+}
+
+static void slice_rows(int height, int slice_count, int slice, int* first, int* count) {
+    *first = (int)((int64_t)height * slice / slice_count);
+    *count = (int)((int64_t)height * (slice + 1) / slice_count) - *first;
+}
+
+// Row loading and storing
+
+static void load_row(const uint8_t* src, uint16_t* dst, size_t samples, int bits) {
+    if (bits == 8) {
+        for (size_t i = 0; i < samples; i++) {
+            dst[i] = src[i];
+        }
+        return;
+    }
+    for (size_t w = 0; w < samples / 3; w++) {
+        uint32_t word;
+        memcpy(&word, src + 4 * w, sizeof(word));
+        dst[3 * w] = (uint16_t)(word & 0x3ff);
+        dst[3 * w + 1] = (uint16_t)((word >> 10) & 0x3ff);
+        dst[3 * w + 2] = (uint16_t)((word >> 20) & 0x3ff);
+    }
+}
+
+static void store_row(const uint16_t* src, uint8_t* dst, size_t samples, int bits) {
+    if (bits == 8) {
+        for (size_t i = 0; i < samples; i++) {
+            dst[i] = (uint8_t)src[i];
+        }
+        return;
+    }
+    for (size_t w = 0; w < samples / 3; w++) {
+        uint32_t word = (uint32_t)src[3 * w] | ((uint32_t)src[3 * w + 1] << 10) | ((uint32_t)src[3 * w + 2] << 20);
+        memcpy(dst + 4 * w, &word, sizeof(word));
+    }
+}
+
+// Prediction
+
+// Map a difference onto Bits bits: wrap it into the signed range, then
+// interleave signs (0, -1, 1, -2, ...) so small residuals have few bits set
+template <int Bits>
+static inline uint16_t zigzag(int diff) {
+    int32_t wrapped = (int32_t)((uint32_t)diff << (32 - Bits)) >> (32 - Bits);
+    return (uint16_t)((((uint32_t)wrapped << 1) ^ (uint32_t)(wrapped >> 31)) & ((1u << Bits) - 1));
+}
+
+template <int Bits>
+static inline int unzigzag(uint16_t value) {
+    return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+// LOCO-I median predictor: a + b - c clamped between a and b
+static inline int median(int a, int b, int c) {
+    int low = std::min(a, b);
+    int high = std::max(a, b);
+    return std::min(std::max(a + b - c, low), high);
+}
+
+// First row of a slice: predict from the left neighbour only
+template <int Bits>
+static void predict_left(const uint16_t* cur, uint16_t* residuals, size_t samples) {
+    const int mid = 1 << (Bits - 1);
+    for (size_t i = 0; i < (size_t)kComponentStride && i < samples; i++) {
+        residuals[i] = zigzag<Bits>(cur[i] - mid);
+    }
+    for (size_t i = kComponentStride; i < samples; i++) {
+        residuals[i] = zigzag<Bits>(cur[i] - cur[i - kComponentStride]);
+    }
+}
+
+template <int Bits>
+static void predict_median(const uint16_t* cur, const uint16_t* prev, uint16_t* residuals, size_t samples) {
+    for (size_t i = 0; i < (size_t)kComponentStride && i < samples; i++) {
+        residuals[i] = zigzag<Bits>(cur[i] - prev[i]);
+    }
+    for (size_t i = kComponentStride; i < samples; i++) {
+        int predicted = median(cur[i - kComponentStride], prev[i], prev[i - kComponentStride]);
+        residuals[i] = zigzag<Bits>(cur[i] - predicted);
+    }
+}
+
+// Rows always hold whole groups of 4 samples. Reconstruction carries the
+// previous sample of each component in registers rather than reading it back
+// from the row, which keeps the four dependency chains short.
+template <int Bits>
+static void reconstruct_left(uint16_t* cur, const uint16_t* residuals, size_t samples) {
+    const int mask = (1 << Bits) - 1;
+    int left[kComponentStride];
+    for (int k = 0; k < kComponentStride; k++) {
+        left[k] = 1 << (Bits - 1);
+    }
+    for (size_t i = 0; i < samples; i += kComponentStride) {
+        for (int k = 0; k < kComponentStride; k++) {
+            left[k] = (left[k] + unzigzag<Bits>(residuals[i + k])) & mask;
+            cur[i + k] = (uint16_t)left[k];
+        }
+    }
+}
+
+template <int Bits>
+static void reconstruct_median(uint16_t* cur, const uint16_t* prev, const uint16_t* residuals, size_t samples) {
+    const int mask = (1 << Bits) - 1;
+    int left[kComponentStride];
+    for (int k = 0; k < kComponentStride; k++) {
+        left[k] = (prev[k] + unzigzag<Bits>(residuals[k])) & mask;
+        cur[k] = (uint16_t)left[k];
+    }
+    for (size_t i = kComponentStride; i < samples; i += kComponentStride) {
+        for (int k = 0; k < kComponentStride; k++) {
+            int predicted = median(left[k], prev[i + k], prev[i + k - kComponentStride]);
+            left[k] = (predicted + unzigzag<Bits>(residuals[i + k])) & mask;
+            cur[i + k] = (uint16_t)left[k];
+        }
+    }
+}
+
+// Bit packing. A block of 16 samples at width B takes 2 * B bytes; each half
+// is assembled in two 64-bit words, and with B known at compile time the
+// shifts fold into straight-line code. Words are stored little endian.
+
+template <int B>
+static uint8_t* pack_block(const uint16_t* values, uint8_t* out) {
+    for (int half = 0; half < 2; half++, values += 8) {
+        uint64_t low = 0;
+        uint64_t high = 0;
+        for (int i = 0; i < 8; i++) {
+            const int shift = i * B;
+            if (shift < 64) {
+                low |= (uint64_t)values[i] << shift;
+                if (shift + B > 64) {
+                    high |= (uint64_t)values[i] >> (64 - shift);
+                }
+            } else {
+                high |= (uint64_t)values[i] << (shift - 64);
+            }
+        }
+        memcpy(out, &low, B < 8 ? B : 8);
+        if (B > 8) {
+            memcpy(out + 8, &high, B > 8 ? B - 8 : 0);
+        }
+        out += B;
+    }
+    return out;
+}
+
+template <int B>
+static const uint8_t* unpack_block(const uint8_t* in, uint16_t* values) {
+    const uint64_t mask = (1u << B) - 1;
+    for (int half = 0; half < 2; half++, values += 8) {
+        uint64_t low = 0;
+        uint64_t high = 0;
+        memcpy(&low, in, B < 8 ? B : 8);
+        if (B > 8) {
+            memcpy(&high, in + 8, B > 8 ? B - 8 : 0);
+        }
+        for (int i = 0; i < 8; i++) {
+            const int shift = i * B;
+            uint64_t value;
+            if (shift < 64) {
+                value = low >> shift;
+                if (shift + B > 64) {
+                    value |= high << (64 - shift);
+                }
+            } else {
+                value = high >> (shift - 64);
+            }
+            values[i] = (uint16_t)(value & mask);
+        }
+        in += B;
+    }
+    return in;
+}
+
+// All-zero blocks take no bytes at all
+template <>
+uint8_t* pack_block<0>(const uint16_t*, uint8_t* out) {
+    return out;
+}
+
+template <>
+const uint8_t* unpack_block<0>(const uint8_t* in, uint16_t* values) {
+    memset(values, 0, kBlockSamples * sizeof(uint16_t));
+    return in;
+}
+
+typedef uint8_t* (*PackBlockFn)(const uint16_t*, uint8_t*);
+typedef const uint8_t* (*UnpackBlockFn)(const uint8_t*, uint16_t*);
+
+static const int kMaxBlockWidth = 10;
+
+static const PackBlockFn kPackBlock[kMaxBlockWidth + 1] = {
+    pack_block<0>, pack_block<1>, pack_block<2>, pack_block<3>, pack_block<4>, pack_block<5>,
+    pack_block<6>, pack_block<7>, pack_block<8>, pack_block<9>, pack_block<10>,
+};
+
+static const UnpackBlockFn kUnpackBlock[kMaxBlockWidth + 1] = {
+    unpack_block<0>, unpack_block<1>, unpack_block<2>, unpack_block<3>, unpack_block<4>, unpack_block<5>,
+    unpack_block<6>, unpack_block<7>, unpack_block<8>, unpack_block<9>, unpack_block<10>,
+};
+
+static int block_width(const uint16_t* values) {
+    unsigned combined = 0;
+    for (int i = 0; i < kBlockSamples; i++) {
+        combined |= values[i];
+    }
+    return combined != 0 ? 32 - __builtin_clz(combined) : 0;
+}
+
+// samples must be padded to a whole number of block pairs
+static size_t pack_residuals(const uint16_t* residuals, size_t samples, uint8_t* out) {
+    uint8_t* start = out;
+    for (size_t i = 0; i < samples; i += kPairSamples) {
+        int first = block_width(residuals + i);
+        int second = block_width(residuals + i + kBlockSamples);
+        *out++ = (uint8_t)(first | (second << 4));
+        out = kPackBlock[first](residuals + i, out);
+        out = kPackBlock[second](residuals + i + kBlockSamples, out);
+    }
+    return (size_t)(out - start);
+}
+
+static bool unpack_residuals(const uint8_t* in, size_t size, uint16_t* residuals, size_t samples, int bits) {
+    const uint8_t* end = in + size;
+    for (size_t i = 0; i < samples; i += kPairSamples) {
+        if (in >= end) {
+            return false;
+        }
+        int first = *in & 0x0f;
+        int second = *in >> 4;
+        in++;
+        if (first > bits || second > bits || (size_t)(end - in) < 2 * (size_t)(first + second)) {
+            return false;
+        }
+        in = kUnpackBlock[first](in, residuals + i);
+        in = kUnpackBlock[second](in, residuals + i + kBlockSamples);
+    }
+    return true;
+}
+
+// SliceWorkers
+
+SliceWorkers::SliceWorkers(int threads) {
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(&SliceWorkers::workerLoop, this);
+    }
+}
+
+SliceWorkers::~SliceWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_cv.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void SliceWorkers::run(int count, const std::function<void(int)>& slice_job) {
+    if (workers.empty() || count <= 1) {
+        for (int i = 0; i < count; i++) {
+            slice_job(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &slice_job;
+        next_slice = 0;
+        slice_count = count;
+        pending = count;
+        generation++;
+    }
+    start_cv.notify_all();
+
+    drain();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this] { return pending == 0; });
+    job = nullptr;
+}
+
+// Take slices until none are left
+void SliceWorkers::drain() {
+    for (;;) {
+        const std::function<void(int)>* current;
+        int slice;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (job == nullptr || next_slice >= slice_count) {
+                return;
+            }
+            current = job;
+            slice = next_slice++;
+        }
+
+        (*current)(slice);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) {
+            done_cv.notify_all();
+        }
+    }
+}
+
+void SliceWorkers::workerLoop() {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_cv.wait(lock, [this, seen] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        drain();
+    }
+}
+
+// FrameCodec
+
+static int default_threads(int threads) {
+    if (threads > 0) {
+        return threads;
+    }
+    int cores = (int)std::thread::hardware_concurrency();
+    return std::max(1, std::min(8, cores));
+}
+
+FrameCodec::FrameCodec(int threads) : workers(default_threads(threads)) {
+}
+
+bool FrameCodec::supports(uint32_t pixel_format) {
+    return bit_depth_for(pixel_format) != 0;
+}
+
+size_t FrameCodec::maxEncodedSize(int height, long row_bytes, uint32_t pixel_format) {
+    int bits = bit_depth_for(pixel_format);
+    if (bits == 0 || height <= 0 || row_bytes <= 0) {
+        return 0;
+    }
+
+    int slice_count = slice_count_for(height);
+    size_t row_samples = row_samples_for(row_bytes, pixel_format);
+    size_t size = sizeof(BMCodecHeader) + sizeof(uint32_t) * (size_t)slice_count;
+    for (int slice = 0; slice < slice_count; slice++) {
+        int first, rows;
+        slice_rows(height, slice_count, slice, &first, &rows);
+        size += max_packed_size((size_t)rows * row_samples, bits);
+    }
+    return size;
+}
+
+void FrameCodec::prepare(int slice_count, size_t slice_samples, size_t row_samples, size_t packed_capacity) {
+    if ((int)slices.size() < slice_count) {
+        slices.resize(slice_count);
+    }
+    for (int i = 0; i < slice_count; i++) {
+        Slice& slice = slices[i];
+        if (slice.residuals.size() < padded_samples(slice_samples)) {
+            slice.residuals.resize(padded_samples(slice_samples));
+        }
+        if (slice.rows.size() < 2 * row_samples) {
+            slice.rows.resize(2 * row_samples);
+        }
+        if (slice.packed.size() < packed_capacity) {
+            slice.packed.resize(packed_capacity);
+        }
+    }
+}
+
+size_t FrameCodec::encode(const uint8_t* frame, int width, int height, long row_bytes, uint32_t pixel_format,
+                          uint8_t* out, size_t capacity) {
+    const int bits = bit_depth_for(pixel_format);
+    if (bits == 0 || height <= 0 || row_bytes <= 0 || row_bytes % row_alignment_for(bits) != 0 ||
+        capacity < maxEncodedSize(height, row_bytes, pixel_format)) {
+        return 0;
+    }
+
+    const int slice_count = slice_count_for(height);
+    const size_t row_samples = row_samples_for(row_bytes, pixel_format);
+    const int max_rows = height / slice_count + 1;
+    prepare(slice_count, (size_t)max_rows * row_samples, row_samples,
+            max_packed_size((size_t)max_rows * row_samples, bits));
+
+    workers.run(slice_count, [&](int index) {
+        Slice& slice = slices[index];
+        int first, rows;
+        slice_rows(height, slice_count, index, &first, &rows);
+
+        uint16_t* prev = slice.rows.data();
+        uint16_t* cur = prev + row_samples;
+        uint16_t* residuals = slice.residuals.data();
+        for (int row = 0; row < rows; row++) {
+            load_row(frame + (size_t)(first + row) * row_bytes, cur, row_samples, bits);
+            if (bits == 8) {
+                if (row == 0) {
+                    predict_left<8>(cur, residuals, row_samples);
+                } else {
+                    predict_median<8>(cur, prev, residuals, row_samples);
+                }
+            } else {
+                if (row == 0) {
+                    predict_left<10>(cur, residuals, row_samples);
+                } else {
+                    predict_median<10>(cur, prev, residuals, row_samples);
+                }
+            }
+            residuals += row_samples;
+            std::swap(prev, cur);
+        }
+
+        size_t samples = (size_t)rows * row_samples;
+        size_t padded = padded_samples(samples);
+        std::fill(slice.residuals.begin() + samples, slice.residuals.begin() + padded, 0);
+        slice.packed_size = pack_residuals(slice.residuals.data(), padded, slice.packed.data());
+    });
+
+    BMCodecHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = BM_CODEC_MAGIC;
+    header.version = BM_CODEC_VERSION;
+    header.bit_depth = (uint16_t)bits;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.row_bytes = (uint32_t)row_bytes;
+    header.pixel_format = pixel_format;
+    header.slice_count = (uint32_t)slice_count;
+    memcpy(out, &header, sizeof(header));
+
+    uint8_t* sizes = out + sizeof(header);
+    uint8_t* data = sizes + sizeof(uint32_t) * slice_count;
+    for (int i = 0; i < slice_count; i++) {
+        uint32_t slice_size = (uint32_t)slices[i].packed_size;
+        memcpy(sizes + sizeof(uint32_t) * i, &slice_size, sizeof(slice_size));
+        memcpy(data, slices[i].packed.data(), slice_size);
+        data += slice_size;
+    }
+    return (size_t)(data - out);
+}
+
+bool FrameCodec::decode(const uint8_t* data, size_t size, uint8_t* frame, size_t frame_size) {
+    BMCodecHeader header;
+    if (data == nullptr || size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    const int bits = bit_depth_for(header.pixel_format);
+    if (header.magic != BM_CODEC_MAGIC || header.version != BM_CODEC_VERSION || bits == 0 ||
+        header.bit_depth != bits || header.height == 0 || header.row_bytes == 0 || header.row_bytes % row_alignment_for(bits) != 0 ||
+        (uint64_t)header.row_bytes * header.height != frame_size ||
+        header.slice_count != (uint32_t)slice_count_for((int)header.height)) {
+        return false;
+    }
+
+    const int height = (int)header.height;
+    const long row_bytes = (long)header.row_bytes;
+    const int slice_count = (int)header.slice_count;
+    if (size - sizeof(header) < sizeof(uint32_t) * (size_t)slice_count) {
+        return false;
+    }
+
+    // Locate every slice before starting any of them
+    std::vector<const uint8_t*> starts(slice_count);
+    std::vector<uint32_t> sizes(slice_count);
+    const uint8_t* table = data + sizeof(header);
+    const uint8_t* next = table + sizeof(uint32_t) * slice_count;
+    const uint8_t* end = data + size;
+    for (int i = 0; i < slice_count; i++) {
+        memcpy(&sizes[i], table + sizeof(uint32_t) * i, sizeof(uint32_t));
+        if ((size_t)(end - next) < sizes[i]) {
+            return false;
+        }
+        starts[i] = next;
+        next += sizes[i];
+    }
+
+    const size_t row_samples = row_samples_for(row_bytes, header.pixel_format);
+    const int max_rows = height / slice_count + 1;
+    prepare(slice_count, (size_t)max_rows * row_samples, row_samples, 0);
+
+    workers.run(slice_count, [&](int index) {
+        Slice& slice = slices[index];
+        int first, rows;
+        slice_rows(height, slice_count, index, &first, &rows);
+
+        size_t samples = (size_t)rows * row_samples;
+        slice.ok = unpack_residuals(starts[index], sizes[index], slice.residuals.data(),
+                                    padded_samples(samples), bits);
+        if (!slice.ok) {
+            return;
+        }
+
+        uint16_t* prev = slice.rows.data();
+        uint16_t* cur = prev + row_samples;
+        const uint16_t* residuals = slice.residuals.data();
+        for (int row = 0; row < rows; row++) {
+            if (bits == 8) {
+                if (row == 0) {
+                    reconstruct_left<8>(cur, residuals, row_samples);
+                } else {
+                    reconstruct_median<8>(cur, prev, residuals, row_samples);
+                }
+            } else {
+                if (row == 0) {
+                    reconstruct_left<10>(cur, residuals, row_samples);
+                } else {
+                    reconstruct_median<10>(cur, prev, residuals, row_samples);
+                }
+            }
+            store_row(cur, frame + (size_t)(first + row) * row_bytes, row_samples, bits);
+            residuals += row_samples;
+            std::swap(prev, cur);
+        }
+    });
+
+    for (int i = 0; i < slice_count; i++) {
+        if (!slices[i].ok) {
+            return false;
+        }
+    }
+    return true;
+}
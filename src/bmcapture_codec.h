@@ -0,0 +1,112 @@
+#ifndef BMCAPTURE_CODEC_H
+#define BMCAPTURE_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Lossless codec for captured 4:2:2 frames (8-bit 2vuy and 10-bit v210).
+//
+// A frame is cut into horizontal slices that are coded independently, so
+// encoding and decoding run on several cores. Within a slice each sample is
+// predicted from its neighbours of the same component (left on the first row,
+// the LOCO-I median of left, above and above-left after that); residuals are
+// zigzag mapped and bit-packed in blocks of 16 with a per-block width, which
+// is cheap enough to keep up with several 1080p streams and still halves the
+// size of typical camera content. v210 rows are unpacked to 10-bit samples
+// before prediction and repacked on decode, with the unused bits zeroed.
+//
+//   frame: [BMCodecHeader][slice sizes, uint32 x slice_count][slice 0][slice 1]...
+//   slice: [width byte for two blocks][2 * width bytes][2 * width bytes]...
+
+#define BM_CODEC_MAGIC 0x434c4d42u     // "BMLC"
+#define BM_CODEC_VERSION 1
+
+struct BMCodecHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t bit_depth;         // 8 for 2vuy, 10 for v210
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_bytes;
+    uint32_t pixel_format;
+    uint32_t slice_count;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(BMCodecHeader) == 32, "codec header must stay 32 bytes");
+
+// Runs a job over a number of slices on a fixed set of threads.
+// The calling thread takes part, so a pool of N threads starts N - 1 workers.
+class SliceWorkers {
+public:
+    explicit SliceWorkers(int threads);
+    ~SliceWorkers();
+
+    // Call job(i) for i in [0, count) and return when all calls are done
+    void run(int count, const std::function<void(int)>& job);
+
+    int threads() const { return (int)workers.size() + 1; }
+
+    SliceWorkers(const SliceWorkers&) = delete;
+    SliceWorkers& operator=(const SliceWorkers&) = delete;
+
+private:
+    void workerLoop();
+    void drain();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    const std::function<void(int)>* job = nullptr;
+    uint64_t generation = 0;
+    int next_slice = 0;
+    int slice_count = 0;
+    int pending = 0;
+    bool stopping = false;
+};
+
+class FrameCodec {
+public:
+    // threads <= 0 picks one per core, up to 8
+    explicit FrameCodec(int threads = 0);
+
+    // true if frames of this DeckLink pixel format can be coded
+    static bool supports(uint32_t pixel_format);
+
+    // Largest possible encoded size of a frame
+    static size_t maxEncodedSize(int height, long row_bytes, uint32_t pixel_format);
+
+    // Encode a frame; returns the encoded size, or 0 if the format is not
+    // supported or capacity is too small
+    size_t encode(const uint8_t* frame, int width, int height, long row_bytes, uint32_t pixel_format,
+                  uint8_t* out, size_t capacity);
+
+    // Decode a frame into frame_size bytes at frame; false if the data is
+    // damaged or does not describe a frame of that size
+    bool decode(const uint8_t* data, size_t size, uint8_t* frame, size_t frame_size);
+
+    FrameCodec(const FrameCodec&) = delete;
+    FrameCodec& operator=(const FrameCodec&) = delete;
+
+private:
+    struct Slice {
+        std::vector<uint16_t> residuals;
+        std::vector<uint16_t> rows;         // Current and previous unpacked row
+        std::vector<uint8_t> packed;        // Encoded slice before it is gathered
+        size_t packed_size = 0;
+        bool ok = false;
+    };
+
+    void prepare(int slice_count, size_t slice_samples, size_t row_samples, size_t packed_capacity);
+
+    SliceWorkers workers;
+    std::vector<Slice> slices;
+};
+
+#endif /* BMCAPTURE_CODEC_H */
@@ -0,0 +1,348 @@
+#include "bmcapture.h"
+#include "bmcapture_codec.h"
+#include "bmcapture_container.h"
+#include "bmcapture_log.h"
+#include "bmcapture_timecode.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void bm_container_init_header(BMRawHeader* header, const FrameInfo& info, size_t frame_size,
+                              uint32_t compression) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, BM_CONTAINER_MAGIC, sizeof(header->magic));
+    // Uncompressed files stay readable by version 1 readers
+    header->version = compression != BM_CONTAINER_UNCOMPRESSED ? BM_CONTAINER_VERSION_COMPRESSED : BM_CONTAINER_VERSION;
+    header->header_size = BM_FRAME_ALIGNMENT;
+    header->width = (uint32_t)info.width;
+    header->height = (uint32_t)info.height;
+    header->row_bytes = (uint32_t)info.row_bytes;
+    header->pixel_format = info.pixel_format;
+    header->frame_size = frame_size;
+    header->frame_stride = bm_align_up(frame_size);
+    header->data_offset = BM_FRAME_ALIGNMENT;
+    header->time_scale = info.time_scale;
+    header->frame_duration = info.frame_duration;
+    header->frame_count = 0;
+    header->compression = compression;
+}
+
+void bm_container_init_index_header(BMRawIndexHeader* header) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, BM_CONTAINER_INDEX_MAGIC, sizeof(header->magic));
+    header->version = BM_CONTAINER_VERSION;
+    header->entry_size = sizeof(BMRawIndexEntry);
+}
+
+void bm_container_init_index_entry(BMRawIndexEntry* entry, const FrameInfo& info,
+                                   uint64_t offset, size_t size) {
+    memset(entry, 0, sizeof(*entry));
+    entry->sequence = info.sequence;
+    entry->stream_time = info.stream_time;
+    entry->frame_duration = info.frame_duration;
+    entry->hardware_timestamp = info.hardware_timestamp;
+    entry->offset = offset;
+    entry->size = (uint32_t)size;
+    entry->flags = info.flags;
+    if (info.timecode.valid) {
+        entry->timecode_bcd = info.timecode.bcd;
+        entry->timecode_user_bits = info.timecode.user_bits;
+        entry->timecode_flags = BM_INDEX_TIMECODE_VALID | info.timecode.source |
+            (info.timecode.drop_frame ? BM_INDEX_TIMECODE_DROP_FRAME : 0);
+    }
+}
+
+// Reader for .bmraw containers.
+// Both files are mapped read-only; frames are returned as pointers into the
+// mapping, so seeking is a constant-time offset computation. Compressed
+// frames are decoded on request by a codec created with the first one.
+struct BMRawFile {
+    const uint8_t* data = nullptr;
+    size_t data_size = 0;
+    const uint8_t* index = nullptr;
+    size_t index_size = 0;
+    const BMRawHeader* header = nullptr;
+    const BMRawIndexEntry* entries = nullptr;
+    int64_t frame_count = 0;
+    bool indexed = false;
+    bool compressed = false;
+    std::unique_ptr<FrameCodec> codec;
+
+    ~BMRawFile() {
+        if (data != nullptr) {
+            munmap((void*)data, data_size);
+        }
+        if (index != nullptr) {
+            munmap((void*)index, index_size);
+        }
+    }
+};
+
+// Map a whole file read-only
+static const uint8_t* map_file(const char* path, size_t* size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    void* mapping = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    *size = (size_t)st.st_size;
+    return static_cast<const uint8_t*>(mapping);
+}
+
+BMRawFile* bm_raw_file_open(const char* path) {
+    if (path == nullptr) {
+        return nullptr;
+    }
+
+    BMRawFile* file = new BMRawFile();
+    file->data = map_file(path, &file->data_size);
+    if (file->data == nullptr || file->data_size < sizeof(BMRawHeader)) {
+        delete file;
+        return nullptr;
+    }
+
+    file->header = reinterpret_cast<const BMRawHeader*>(file->data);
+    const BMRawHeader* header = file->header;
+    if (memcmp(header->magic, BM_CONTAINER_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version < BM_CONTAINER_VERSION || header->version > BM_CONTAINER_VERSION_COMPRESSED ||
+        header->frame_size == 0 || header->frame_stride < header->frame_size ||
+        header->data_offset > file->data_size) {
+        delete file;
+        return nullptr;
+    }
+
+    // Version 1 headers end before the compression field, which is zero there
+    file->compressed = header->version >= BM_CONTAINER_VERSION_COMPRESSED &&
+                       header->compression != BM_CONTAINER_UNCOMPRESSED;
+    if (file->compressed && header->compression != BM_CONTAINER_LOSSLESS) {
+        delete file;
+        return nullptr;
+    }
+
+    // Frames that are fully present in the data file
+    int64_t stored_frames = (int64_t)((file->data_size - header->data_offset) / header->frame_stride);
+    file->frame_count = stored_frames;
+
+    // The index is optional; without it frames are still reachable by stride
+    std::string index_path = std::string(path) + BM_CONTAINER_INDEX_SUFFIX;
+    file->index = map_file(index_path.c_str(), &file->index_size);
+    if (file->index != nullptr && file->index_size >= sizeof(BMRawIndexHeader)) {
+        const BMRawIndexHeader* index_header = reinterpret_cast<const BMRawIndexHeader*>(file->index);
+        if (memcmp(index_header->magic, BM_CONTAINER_INDEX_MAGIC, sizeof(index_header->magic)) == 0 &&
+            index_header->entry_size == sizeof(BMRawIndexEntry)) {
+            file->entries = reinterpret_cast<const BMRawIndexEntry*>(file->index + sizeof(BMRawIndexHeader));
+            int64_t indexed_frames = (int64_t)((file->index_size - sizeof(BMRawIndexHeader)) / sizeof(BMRawIndexEntry));
+            // Compressed frames are smaller than the stride, so only the index counts them
+            if (file->compressed || indexed_frames < file->frame_count) {
+                file->frame_count = indexed_frames;
+            }
+            file->indexed = true;
+        }
+    }
+
+    if (file->compressed && !file->indexed) {
+        log_error("Compressed container %s has no usable index", path);
+        delete file;
+        return nullptr;
+    }
+
+    if (header->frame_count > 0 && (int64_t)header->frame_count < file->frame_count) {
+        file->frame_count = (int64_t)header->frame_count;
+    }
+
+    // Scrubbing jumps around; don't let the kernel read ahead whole frames we skip
+    madvise((void*)file->data, file->data_size, MADV_RANDOM);
+
+    return file;
+}
+
+void bm_raw_file_close(BMRawFile* file) {
+    delete file;
+}
+
+bool bm_raw_file_get_info(BMRawFile* file, BMRawFileInfo* info) {
+    if (file == nullptr || info == nullptr) {
+        return false;
+    }
+
+    const BMRawHeader* header = file->header;
+    info->width = (int)header->width;
+    info->height = (int)header->height;
+    info->row_bytes = (int)header->row_bytes;
+    info->pixel_format = header->pixel_format;
+    info->time_scale = header->time_scale;
+    info->frame_duration = header->frame_duration;
+    info->frame_count = file->frame_count;
+    info->indexed = file->indexed;
+    info->compressed = file->compressed;
+    return true;
+}
+
+const uint8_t* bm_raw_file_get_frame(BMRawFile* file, int64_t index, size_t* out_size, BMFrameInfo* out_info) {
+    if (file == nullptr || index < 0 || index >= file->frame_count) {
+        return nullptr;
+    }
+
+    const BMRawHeader* header = file->header;
+    uint64_t offset = header->data_offset + (uint64_t)index * header->frame_stride;
+    size_t size = (size_t)header->frame_size;
+
+    if (file->indexed) {
+        const BMRawIndexEntry& entry = file->entries[index];
+        // Compare without adding, so a damaged offset cannot wrap past the check
+        if (entry.offset > file->data_size || entry.size > file->data_size - entry.offset) {
+            return nullptr;
+        }
+        offset = entry.offset;
+        size = entry.size;
+
+        if (out_info != nullptr) {
+            memset(out_info, 0, sizeof(*out_info));
+            out_info->sequence = entry.sequence;
+            out_info->stream_time = entry.stream_time;
+            out_info->frame_duration = entry.frame_duration;
+            out_info->hardware_timestamp = entry.hardware_timestamp;
+            out_info->flags = entry.flags;
+
+            int source = entry.timecode_flags & 0xFF;
+            if ((entry.timecode_flags & BM_INDEX_TIMECODE_VALID) && source < BM_TIMECODE_SOURCE_COUNT) {
+                out_info->timecode = timecode_from_bcd(entry.timecode_bcd, entry.timecode_user_bits,
+                                                       (entry.timecode_flags & BM_INDEX_TIMECODE_DROP_FRAME) != 0,
+                                                       source);
+                out_info->timecodes[source] = out_info->timecode;
+            }
+        }
+    } else if (out_info != nullptr) {
+        // Without an index, synthesize metadata from the nominal frame rate
+        memset(out_info, 0, sizeof(*out_info));
+        out_info->sequence = (uint64_t)index + 1;
+        out_info->stream_time = index * header->frame_duration;
+        out_info->frame_duration = header->frame_duration;
+    }
+
+    if (out_size != nullptr) {
+        *out_size = size;
+    }
+    return file->data + offset;
+}
+
+bool bm_raw_file_read_frame(BMRawFile* file, int64_t index, uint8_t* buffer, size_t size, BMFrameInfo* out_info) {
+    if (file == nullptr || buffer == nullptr || size < file->header->frame_size) {
+        return false;
+    }
+
+    size_t stored_size = 0;
+    const uint8_t* stored = bm_raw_file_get_frame(file, index, &stored_size, out_info);
+    if (stored == nullptr) {
+        return false;
+    }
+
+    if (!file->compressed) {
+        // The index entry's size only has to fit the data file; never copy more than a frame
+        if (stored_size != file->header->frame_size) {
+            log_error("Frame %lld of the container has %zu bytes, expected %llu", (long long)index,
+                      stored_size, (unsigned long long)file->header->frame_size);
+            return false;
+        }
+        memcpy(buffer, stored, stored_size);
+        return true;
+    }
+
+    if (!file->codec) {
+        file->codec.reset(new FrameCodec());
+    }
+    if (!file->codec->decode(stored, stored_size, buffer, (size_t)file->header->frame_size)) {
+        log_error("Frame %lld of the container is damaged", (long long)index);
+        return false;
+    }
+    return true;
+}
+
+int64_t bm_raw_file_find_frame(BMRawFile* file, int64_t stream_time) {
+    if (file == nullptr || file->frame_count == 0) {
+        return -1;
+    }
+
+    if (!file->indexed) {
+        if (file->header->frame_duration <= 0) {
+            return -1;
+        }
+        int64_t index = stream_time / file->header->frame_duration;
+        if (index < 0) {
+            return 0;
+        }
+        return index < file->frame_count ? index : file->frame_count - 1;
+    }
+
+    // Last frame starting at or before stream_time
+    int64_t low = 0;
+    int64_t high = file->frame_count - 1;
+    if (file->entries[0].stream_time > stream_time) {
+        return 0;
+    }
+    while (low < high) {
+        int64_t mid = low + (high - low + 1) / 2;
+        if (file->entries[mid].stream_time <= stream_time) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+void bm_raw_file_prefetch(BMRawFile* file, int64_t index, int count) {
+    if (file == nullptr || index < 0 || count <= 0 || index >= file->frame_count) {
+        return;
+    }
+
+    if (index + count > file->frame_count) {
+        count = (int)(file->frame_count - index);
+    }
+
+    const BMRawHeader* header = file->header;
+    uint64_t start = header->data_offset + (uint64_t)index * header->frame_stride;
+    uint64_t end = start + (uint64_t)count * header->frame_stride;
+    if (file->indexed) {
+        start = file->entries[index].offset;
+        const BMRawIndexEntry& last = file->entries[index + count - 1];
+        end = file->data_size;
+        if (last.offset < file->data_size) {
+            end = last.offset + std::min((uint64_t)last.size, file->data_size - last.offset);
+        }
+    }
+    // Index offsets come from the file; never hint outside the mapping
+    if (start > file->data_size) {
+        start = file->data_size;
+    }
+    if (end > file->data_size) {
+        end = file->data_size;
+    }
+    if (end <= start) {
+        return;
+    }
+
+    // Written files keep frames page aligned, but a crafted index need not
+    start &= ~(uint64_t)(BM_FRAME_ALIGNMENT - 1);
+    madvise((void*)(file->data + start), (size_t)(end - start), MADV_WILLNEED);
+}
@@ -0,0 +1,92 @@
+#ifndef BMCAPTURE_CONTAINER_H
+#define BMCAPTURE_CONTAINER_H
+
+#include <stdint.h>
+#include "bmcapture_frame_sink.h"
+
+// On-disk layout of the .bmraw capture container.
+//
+//   data file:  [header page][frame 0][frame 1]...
+//   index file: <path>.idx = [index header][entry 0][entry 1]...
+//
+// The header occupies the first BM_FRAME_ALIGNMENT bytes of the data file.
+// Every frame starts on a page boundary; raw frames are stored at a fixed
+// stride, so frame N lives at data_offset + N * frame_stride even when the
+// index is missing. Compressed containers (version 2) store each frame in
+// its encoded size, still page aligned, and can only be read through the
+// index. Index entries are appended only after their frame has
+// been written, so a crash never leaves an entry pointing at missing data.
+// All fields are little endian.
+
+#define BM_CONTAINER_MAGIC "BMRAW\0\0\0"
+#define BM_CONTAINER_INDEX_MAGIC "BMRIDX\0\0"
+#define BM_CONTAINER_VERSION 1
+#define BM_CONTAINER_VERSION_COMPRESSED 2   // Frames coded as given by the compression field
+#define BM_CONTAINER_INDEX_SUFFIX ".idx"
+
+// Values of BMRawHeader::compression
+#define BM_CONTAINER_UNCOMPRESSED 0
+#define BM_CONTAINER_LOSSLESS 1         // FrameCodec, see bmcapture_codec.h
+
+// Bits of BMRawIndexEntry::timecode_flags; the low byte holds the BMTimecodeSource.
+// Files written before timecode was recorded have zeros here.
+#define BM_INDEX_TIMECODE_VALID 0x100
+#define BM_INDEX_TIMECODE_DROP_FRAME 0x200
+
+// Hardware timestamps are always stored in nanoseconds
+#define BM_HARDWARE_TIME_SCALE 1000000000LL
+
+struct BMRawHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;       // Size of this header page
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_bytes;
+    uint32_t pixel_format;      // DeckLink pixel format code ('2vuy', 'v210')
+    uint64_t frame_size;        // Bytes of pixel data per frame once decoded
+    uint64_t frame_stride;      // Distance between uncompressed frames, a multiple of the page size
+    uint64_t data_offset;       // Offset of frame 0
+    int64_t time_scale;         // Units per second of stream times and durations
+    int64_t frame_duration;     // Nominal frame duration in time_scale units
+    uint64_t frame_count;       // Written when the recording is closed cleanly, 0 otherwise
+    uint32_t compression;       // BM_CONTAINER_UNCOMPRESSED or BM_CONTAINER_LOSSLESS
+    uint32_t reserved;
+};
+
+struct BMRawIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t reserved[6];
+};
+
+struct BMRawIndexEntry {
+    uint64_t sequence;
+    int64_t stream_time;
+    int64_t frame_duration;
+    int64_t hardware_timestamp;
+    uint64_t offset;            // Offset of the frame in the data file
+    uint32_t size;              // Bytes of frame data at offset, as stored
+    uint32_t flags;             // DeckLink frame flags
+    uint32_t timecode_bcd;      // Preferred timecode of the frame as BCD, see timecode_flags
+    uint32_t timecode_user_bits;
+    uint32_t timecode_flags;    // BM_INDEX_TIMECODE_* bits and source; 0 for frames without timecode
+    uint32_t reserved;
+};
+
+static_assert(sizeof(BMRawIndexHeader) == 64, "index header must stay 64 bytes");
+static_assert(sizeof(BMRawIndexEntry) == 64, "index entries must stay 64 bytes");
+
+// Fill in a header describing frames shaped like `info`
+void bm_container_init_header(BMRawHeader* header, const FrameInfo& info, size_t frame_size,
+                              uint32_t compression = BM_CONTAINER_UNCOMPRESSED);
+
+// Fill in the index header
+void bm_container_init_index_header(BMRawIndexHeader* header);
+
+// Build the index entry for a frame stored at `offset`
+void bm_container_init_index_entry(BMRawIndexEntry* entry, const FrameInfo& info,
+                                   uint64_t offset, size_t size);
+
+#endif /* BMCAPTURE_CONTAINER_H */
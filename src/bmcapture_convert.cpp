@@ -0,0 +1,167 @@
+#include "bmcapture_convert.h"
+#include <math.h>
+
+// Utility functions for color conversion
+static uint8_t clamp(int value) {
+    if (value > 255) return 255;
+    if (value < 0) return 0;
+    return (uint8_t)value;
+}
+
+void initialize_yuv_tables(YUVConversionTables* tables) {
+    if (tables->initialized) {
+        return;
+    }
+
+    int yy, uu, vv, ug_plus_vg, ub, vr, val;
+
+    // Generate red component lookup table [v][y]
+    for (int y = 0; y < 256; y++) {
+        for (int v = 0; v < 256; v++) {
+            yy = y << 8;
+            vv = v - 128;
+            vr = vv * 359;
+            val = (yy + vr) >> 8;
+            tables->red[v][y] = clamp(val);
+        }
+    }
+
+    // Generate green component lookup table [u][v][y]
+    for (int y = 0; y < 256; y++) {
+        for (int u = 0; u < 256; u++) {
+            for (int v = 0; v < 256; v++) {
+                yy = y << 8;
+                uu = u - 128;
+                vv = v - 128;
+                ug_plus_vg = uu * 88 + vv * 183;
+                val = (yy - ug_plus_vg) >> 8;
+                tables->green[u][v][y] = clamp(val);
+            }
+        }
+    }
+
+    // Generate blue component lookup table [u][y]
+    for (int y = 0; y < 256; y++) {
+        for (int u = 0; u < 256; u++) {
+            yy = y << 8;
+            uu = u - 128;
+            ub = uu * 454;
+            val = (yy + ub) >> 8;
+            tables->blue[u][y] = clamp(val);
+        }
+    }
+
+    tables->initialized = true;
+}
+
+void yuv_to_gray_scalar(const uint8_t* yuv, uint8_t* gray, unsigned int pixel_count) {
+    // YUV is in cb-y0-cr-y1 format, extract only y values
+    for (unsigned int i = 0, j = 1; i < pixel_count; i++, j += 2) {
+        gray[i] = yuv[j];
+    }
+}
+
+void yuv_to_rgb_table(const uint8_t* yuv, uint8_t* rgb, unsigned int pixel_count, YUVConversionTables* tables) {
+    initialize_yuv_tables(tables);
+
+    uint8_t u, y0, v, y1;
+    unsigned int yuv_size = 2 * pixel_count;
+
+    for (unsigned int i = 0, j = 0; i < yuv_size; i += 4, j += 6) {
+        u = yuv[i+0];
+        y0 = yuv[i+1];
+        v = yuv[i+2];
+        y1 = yuv[i+3];
+
+        rgb[j+0] = tables->red[v][y0];      // R0
+        rgb[j+1] = tables->green[u][v][y0]; // G0
+        rgb[j+2] = tables->blue[u][y0];     // B0
+
+        rgb[j+3] = tables->red[v][y1];      // R1
+        rgb[j+4] = tables->green[u][v][y1]; // G1
+        rgb[j+5] = tables->blue[u][y1];     // B1
+    }
+}
+
+// Same coefficients as the tables, which hold them in 8.8 fixed point
+static uint8_t round_channel(double value) {
+    return clamp((int)floor(value + 0.5));
+}
+
+void yuv_to_rgb_reference(const uint8_t* yuv, uint8_t* rgb, unsigned int pixel_count) {
+    for (unsigned int i = 0; i < pixel_count; i++) {
+        const uint8_t* pair = yuv + (i / 2) * 4;
+        double y = pair[(i % 2) * 2 + 1];
+        double u = pair[0] - 128.0;
+        double v = pair[2] - 128.0;
+        rgb[i * 3 + 0] = round_channel(y + v * (359.0 / 256.0));
+        rgb[i * 3 + 1] = round_channel(y - u * (88.0 / 256.0) - v * (183.0 / 256.0));
+        rgb[i * 3 + 2] = round_channel(y + u * (454.0 / 256.0));
+    }
+}
+
+void yuv_to_gray_reference(const uint8_t* yuv, uint8_t* gray, unsigned int pixel_count) {
+    for (unsigned int i = 0; i < pixel_count; i++) {
+        gray[i] = yuv[i * 2 + 1];
+    }
+}
+
+static bool always_supported() {
+    return true;
+}
+
+#if defined(BMCAPTURE_HAVE_AVX2)
+static bool avx2_supported() {
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+const RGBKernel kRGBKernels[] = {
+    {"table", always_supported, yuv_to_rgb_table, true},
+#if defined(BMCAPTURE_HAVE_AVX2)
+    {"avx2", avx2_supported, yuv_to_rgb_avx2, false},
+#endif
+};
+const int kRGBKernelCount = sizeof(kRGBKernels) / sizeof(kRGBKernels[0]);
+
+const GrayKernel kGrayKernels[] = {
+    {"scalar", always_supported, yuv_to_gray_scalar},
+#if defined(BMCAPTURE_HAVE_AVX2)
+    {"avx2", avx2_supported, yuv_to_gray_avx2},
+#endif
+};
+const int kGrayKernelCount = sizeof(kGrayKernels) / sizeof(kGrayKernels[0]);
+
+// The first entry of each list runs everywhere
+template <typename Kernel>
+static const Kernel* select_kernel(const Kernel* kernels, int count) {
+    const Kernel* best = &kernels[0];
+    for (int i = 1; i < count; i++) {
+        if (kernels[i].supported()) {
+            best = &kernels[i];
+        }
+    }
+    return best;
+}
+
+static const RGBKernel* rgb_kernel() {
+    static const RGBKernel* kernel = select_kernel(kRGBKernels, kRGBKernelCount);
+    return kernel;
+}
+
+static const GrayKernel* gray_kernel() {
+    static const GrayKernel* kernel = select_kernel(kGrayKernels, kGrayKernelCount);
+    return kernel;
+}
+
+void yuv_to_gray(const uint8_t* yuv, uint8_t* gray, unsigned int pixel_count) {
+    gray_kernel()->convert(yuv, gray, pixel_count);
+}
+
+void yuv_to_rgb(const uint8_t* yuv, uint8_t* rgb, unsigned int pixel_count, YUVConversionTables* tables) {
+    rgb_kernel()->convert(yuv, rgb, pixel_count, tables);
+}
+
+bool yuv_to_rgb_needs_tables() {
+    return rgb_kernel()->needs_tables;
+}
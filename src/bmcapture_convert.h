@@ -0,0 +1,71 @@
+#ifndef BMCAPTURE_CONVERT_H
+#define BMCAPTURE_CONVERT_H
+
+#include <stdint.h>
+
+// Pixel conversions from the DeckLink 8-bit 4:2:2 layout (cb-y0-cr-y1).
+// These have no DeckLink or platform dependencies, so the benchmarks can
+// build them on any machine.
+
+// Structure to store YUV -> RGB lookup tables for color conversion
+struct YUVConversionTables {
+    bool initialized = false;
+    uint8_t red[256][256];         // [v][y]
+    uint8_t green[256][256][256];  // [u][v][y]
+    uint8_t blue[256][256];        // [u][y]
+};
+
+// Fill the tables unless they are already initialized
+void initialize_yuv_tables(YUVConversionTables* tables);
+
+// Convert with the fastest kernel below that this CPU supports
+void yuv_to_gray(const uint8_t* yuv, uint8_t* gray, unsigned int pixel_count);
+
+// Convert to packed RGB. tables may be NULL when yuv_to_rgb_needs_tables()
+// is false; otherwise they are initialized if needed.
+void yuv_to_rgb(const uint8_t* yuv, uint8_t* rgb, unsigned int pixel_count, YUVConversionTables* tables);
+bool yuv_to_rgb_needs_tables();
+
+// The kernels. The AVX2 ones exist when BMCAPTURE_HAVE_AVX2 is defined, as
+// CMake does when it builds bmcapture_convert_avx2.cpp with -mavx2.
+void yuv_to_gray_scalar(const uint8_t* yuv, uint8_t* gray, unsigned int pixel_count);
+void yuv_to_rgb_table(const uint8_t* yuv, uint8_t* rgb, unsigned int pixel_count, YUVConversionTables* tables);
+#if defined(BMCAPTURE_HAVE_AVX2)
+void yuv_to_gray_avx2(const uint8_t* yuv, uint8_t* gray, unsigned int pixel_count);
+void yuv_to_rgb_avx2(const uint8_t* yuv, uint8_t* rgb, unsigned int pixel_count, YUVConversionTables* tables);
+#endif
+
+// Reference conversions: the defining arithmetic in double precision, rounded
+// to nearest. Slow; they exist to check the kernels against. pixel_count is
+// even for every conversion, as 4:2:2 stores pixels in pairs.
+void yuv_to_rgb_reference(const uint8_t* yuv, uint8_t* rgb, unsigned int pixel_count);
+void yuv_to_gray_reference(const uint8_t* yuv, uint8_t* gray, unsigned int pixel_count);
+
+// Largest difference in any channel a kernel may have from the reference.
+// The fixed-point kernels truncate where the reference rounds.
+const int kRGBTolerance = 1;
+const int kGrayTolerance = 0;
+
+// Every variant of a conversion built into this binary, slowest first; the
+// conversions above use the last one the CPU supports. supported() is false
+// when the CPU lacks the instructions a variant needs. New variants are added
+// here so the accuracy and performance checks (bench/check_kernels) cover them.
+struct RGBKernel {
+    const char* name;
+    bool (*supported)();
+    void (*convert)(const uint8_t* yuv, uint8_t* rgb, unsigned int pixel_count, YUVConversionTables* tables);
+    bool needs_tables;
+};
+
+struct GrayKernel {
+    const char* name;
+    bool (*supported)();
+    void (*convert)(const uint8_t* yuv, uint8_t* gray, unsigned int pixel_count);
+};
+
+extern const RGBKernel kRGBKernels[];
+extern const int kRGBKernelCount;
+extern const GrayKernel kGrayKernels[];
+extern const int kGrayKernelCount;
+
+#endif /* BMCAPTURE_CONVERT_H */
@@ -0,0 +1,146 @@
+#include "bmcapture_convert.h"
+
+// AVX2 conversion kernels. This file is compiled on its own with -mavx2 (see
+// CMakeLists.txt) and the kernels are only called after checking the CPU, so
+// the rest of the library still runs on processors without AVX2. Compiled
+// without -mavx2 it is empty.
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+static inline uint8_t clamp_channel(int value) {
+    if (value > 255) return 255;
+    if (value < 0) return 0;
+    return (uint8_t)value;
+}
+
+// The table arithmetic for the pixels left over after the vector loop
+static void yuv_to_rgb_tail(const uint8_t* yuv, uint8_t* rgb, unsigned int pixel_count) {
+    for (unsigned int i = 0, j = 0; i < pixel_count * 2; i += 4, j += 6) {
+        int u = yuv[i+0] - 128;
+        int y0 = yuv[i+1] << 8;
+        int v = yuv[i+2] - 128;
+        int y1 = yuv[i+3] << 8;
+
+        rgb[j+0] = clamp_channel((y0 + v * 359) >> 8);
+        rgb[j+1] = clamp_channel((y0 - (u * 88 + v * 183)) >> 8);
+        rgb[j+2] = clamp_channel((y0 + u * 454) >> 8);
+
+        rgb[j+3] = clamp_channel((y1 + v * 359) >> 8);
+        rgb[j+4] = clamp_channel((y1 - (u * 88 + v * 183)) >> 8);
+        rgb[j+5] = clamp_channel((y1 + u * 454) >> 8);
+    }
+}
+
+// Two 16-bit values repeated across every 32-bit lane, a in the low half
+static inline __m256i pair16(int16_t a, int16_t b) {
+    return _mm256_set1_epi32((int)(((uint32_t)(uint16_t)b << 16) | (uint16_t)a));
+}
+
+struct ChannelPlanes {
+    __m256i r;
+    __m256i g;
+    __m256i b;
+};
+
+// R, G and B as 16-bit values for the 8 pixel pairs in one register. The
+// results match the lookup tables exactly: with Y scaled by 256 the tables'
+// arithmetic shift comes down to Y plus the floored chroma term, and mulhi
+// and the shifted madd floor the same way.
+static inline ChannelPlanes convert_pairs(__m256i yuv) {
+    const __m256i chroma_mask = _mm256_set1_epi16(0x00FF);
+    const __m256i bias = _mm256_set1_epi16(128);
+
+    __m256i y = _mm256_srli_epi16(yuv, 8);                                 // y0, y1
+    __m256i uv = _mm256_sub_epi16(_mm256_and_si256(yuv, chroma_mask), bias); // u, v
+
+    // (u * 454) >> 8 and (v * 359) >> 8
+    __m256i blue_red = _mm256_mulhi_epi16(_mm256_slli_epi16(uv, 8), pair16(454, 359));
+    // -(u * 88 + v * 183) >> 8, in the low half of each 32-bit lane
+    __m256i green = _mm256_srai_epi32(_mm256_madd_epi16(uv, pair16(-88, -183)), 8);
+
+    // Give both pixels of a pair the pair's chroma terms
+    const int low = _MM_SHUFFLE(2, 2, 0, 0);
+    const int high = _MM_SHUFFLE(3, 3, 1, 1);
+    ChannelPlanes planes;
+    planes.r = _mm256_add_epi16(y, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(blue_red, high), high));
+    planes.g = _mm256_add_epi16(y, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(green, low), low));
+    planes.b = _mm256_add_epi16(y, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(blue_red, low), low));
+    return planes;
+}
+
+// Saturate two registers of 16-bit values to 32 bytes in pixel order
+static inline __m256i pack_channel(__m256i first, __m256i second) {
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// Where each byte of the 48 interleaved output bytes for 16 pixels comes
+// from: output block, then source channel; -1 leaves the byte zero
+static const int8_t kInterleave[3][3][16] = {
+    {
+        { 0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1,  5},
+        {-1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1},
+        {-1, -1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1},
+    },
+    {
+        {-1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10, -1},
+        { 5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10},
+        {-1,  5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1},
+    },
+    {
+        {-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1},
+        {-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1},
+        {10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15},
+    },
+};
+
+// Write 16 pixels of planar R, G and B as 48 bytes of packed RGB
+static inline void store_rgb16(uint8_t* rgb, __m128i r, __m128i g, __m128i b) {
+    for (int block = 0; block < 3; block++) {
+        __m128i out = _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(r, _mm_loadu_si128((const __m128i*)kInterleave[block][0])),
+                         _mm_shuffle_epi8(g, _mm_loadu_si128((const __m128i*)kInterleave[block][1]))),
+            _mm_shuffle_epi8(b, _mm_loadu_si128((const __m128i*)kInterleave[block][2])));
+        _mm_storeu_si128((__m128i*)(rgb + block * 16), out);
+    }
+}
+
+void yuv_to_rgb_avx2(const uint8_t* yuv, uint8_t* rgb, unsigned int pixel_count, YUVConversionTables* tables) {
+    (void)tables;  // Computed directly; the tables would only cost cache misses
+
+    // 32 pixels, 64 bytes of 4:2:2, per iteration
+    unsigned int vector_pixels = pixel_count & ~31u;
+    for (unsigned int i = 0; i < vector_pixels; i += 32) {
+        const uint8_t* in = yuv + i * 2;
+        ChannelPlanes first = convert_pairs(_mm256_loadu_si256((const __m256i*)in));
+        ChannelPlanes second = convert_pairs(_mm256_loadu_si256((const __m256i*)(in + 32)));
+
+        __m256i r = pack_channel(first.r, second.r);
+        __m256i g = pack_channel(first.g, second.g);
+        __m256i b = pack_channel(first.b, second.b);
+
+        uint8_t* out = rgb + i * 3;
+        store_rgb16(out, _mm256_castsi256_si128(r), _mm256_castsi256_si128(g), _mm256_castsi256_si128(b));
+        store_rgb16(out + 48, _mm256_extracti128_si256(r, 1), _mm256_extracti128_si256(g, 1),
+                    _mm256_extracti128_si256(b, 1));
+    }
+
+    yuv_to_rgb_tail(yuv + vector_pixels * 2, rgb + vector_pixels * 3, pixel_count - vector_pixels);
+}
+
+void yuv_to_gray_avx2(const uint8_t* yuv, uint8_t* gray, unsigned int pixel_count) {
+    // 32 pixels per iteration: the luma is the high byte of every 16-bit word
+    unsigned int vector_pixels = pixel_count & ~31u;
+    for (unsigned int i = 0; i < vector_pixels; i += 32) {
+        __m256i first = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(yuv + i * 2)), 8);
+        __m256i second = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(yuv + i * 2 + 32)), 8);
+        _mm256_storeu_si256((__m256i*)(gray + i), pack_channel(first, second));
+    }
+
+    for (unsigned int i = vector_pixels; i < pixel_count; i++) {
+        gray[i] = yuv[i * 2 + 1];
+    }
+}
+
+#endif /* __AVX2__ */
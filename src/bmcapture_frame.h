@@ -0,0 +1,124 @@
+#ifndef BMCAPTURE_FRAME_H
+#define BMCAPTURE_FRAME_H
+
+#include "bmcapture_frame_pool.h"
+#include "bmcapture_frame_sink.h"
+#include "bmcapture_memory.h"
+#include <mutex>
+#include <utility>
+
+// The buffered frame of a channel and the triple buffer handing it from the
+// capture callback to readers. Kept apart from the DeckLink code so the
+// benchmarks can exercise them on any machine.
+
+// Structure for a captured frame
+struct CapturedFrame {
+    FrameData yuv_data;             // Pooled, shared with sinks and read-only once captured
+    AccountedBuffer rgb_data;       // Conversion scratch, charged to the context's memory account
+    AccountedBuffer gray_data;
+    bool rgb_updated = false;
+    bool gray_updated = false;
+    std::timed_mutex* mutex;  // Use a pointer to the mutex
+    int width = 0;
+    int height = 0;
+    FrameInfo info;                 // Capture metadata, arrival_ns is when the callback started
+    int64_t capture_ns = 0;         // Steady clock estimate of the hardware capture time
+    int64_t buffered_ns = 0;        // Steady clock time the callback buffered the frame
+
+    // Default constructor initializes the mutex
+    CapturedFrame() : mutex(new std::timed_mutex()) {}
+
+    explicit CapturedFrame(MemoryAccount* account)
+        : rgb_data(AccountedAllocator<uint8_t>(account, MEMORY_CONVERSION)),
+          gray_data(AccountedAllocator<uint8_t>(account, MEMORY_CONVERSION)),
+          mutex(new std::timed_mutex()) {}
+
+    // Move constructor
+    CapturedFrame(CapturedFrame&& other) noexcept :
+        yuv_data(std::move(other.yuv_data)),
+        rgb_data(std::move(other.rgb_data)),
+        gray_data(std::move(other.gray_data)),
+        rgb_updated(other.rgb_updated),
+        gray_updated(other.gray_updated),
+        width(other.width),
+        height(other.height),
+        info(other.info),
+        capture_ns(other.capture_ns),
+        buffered_ns(other.buffered_ns) {
+        mutex = other.mutex;
+        other.mutex = nullptr;  // Transfer ownership
+    }
+
+    // Move assignment operator
+    CapturedFrame& operator=(CapturedFrame&& other) noexcept {
+        if (this != &other) {
+            yuv_data = std::move(other.yuv_data);
+            rgb_data = std::move(other.rgb_data);
+            gray_data = std::move(other.gray_data);
+            rgb_updated = other.rgb_updated;
+            gray_updated = other.gray_updated;
+            width = other.width;
+            height = other.height;
+            info = other.info;
+            capture_ns = other.capture_ns;
+            buffered_ns = other.buffered_ns;
+
+            // Handle the mutex
+            delete mutex;
+            mutex = other.mutex;
+            other.mutex = nullptr;  // Transfer ownership
+        }
+        return *this;
+    }
+
+    // Destructor to clean up the mutex
+    ~CapturedFrame() {
+        delete mutex;
+    }
+
+    // Delete copy constructor and assignment operator
+    CapturedFrame(const CapturedFrame&) = delete;
+    CapturedFrame& operator=(const CapturedFrame&) = delete;
+};
+
+// Triple buffer implementation
+template <typename T>
+class TripleBuffer {
+private:
+    T buffers[3];
+    int back = 0;
+    int middle = 1;
+    int front = 2;
+    bool middle_unread = false;  // The middle buffer holds a frame swapFront has not taken yet
+    std::mutex mutex;
+
+public:
+    // Returns true if this replaced a frame that was never swapped to the front
+    bool swapBack(T& data) {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Move the data to the back buffer
+        buffers[back] = std::move(data);
+        std::swap(back, middle);
+        bool overwritten = middle_unread;
+        middle_unread = true;
+        return overwritten;
+    }
+
+    // Returns false, keeping the current front, if no frame arrived since the last swap
+    bool swapFront() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!middle_unread) {
+            return false;
+        }
+        std::swap(middle, front);
+        middle_unread = false;
+        return true;
+    }
+
+    // Only the reader calling swapFront may use the front; writers never touch it
+    T& getFront() {
+        return buffers[front];
+    }
+};
+
+#endif /* BMCAPTURE_FRAME_H */
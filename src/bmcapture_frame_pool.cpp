@@ -0,0 +1,197 @@
+#include "bmcapture_frame_pool.h"
+#include "bmcapture_arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct FramePool::State {
+    std::mutex mutex;
+    std::vector<PooledBuffer*> free_list;
+    size_t buffer_capacity = 0;   // Capacity of buffers handed out for the current frame size
+    size_t allocated_bytes = 0;
+    size_t in_use = 0;
+    bool closed = false;          // Set when the owning FramePool is destroyed
+    std::shared_ptr<SharedArena> arena;  // Preferred source of new buffers, if any
+    MemoryAccount* account = nullptr;    // Charged for allocated_bytes, if set
+    MemoryCategory category = MEMORY_FRAME_POOLS;
+
+    ~State() {
+        clearFreeList();
+    }
+
+    static PooledBuffer* createBuffer(size_t capacity, const std::shared_ptr<SharedArena>& arena) {
+        if (arena && capacity <= arena->slotSize()) {
+            int slot = arena->allocateSlot();
+            if (slot >= 0) {
+                PooledBuffer* buffer = new PooledBuffer();
+                buffer->data = arena->slotData(slot);
+                buffer->capacity = capacity;
+                buffer->arena = arena;
+                buffer->slot = slot;
+                // The slot may have been read by other processes in its previous life
+                arena->beginWrite(slot);
+                memset(buffer->data, 0, capacity);
+                return buffer;
+            }
+        }
+
+        void* memory = nullptr;
+        if (posix_memalign(&memory, BM_FRAME_ALIGNMENT, capacity) != 0) {
+            return nullptr;
+        }
+        // Touch every page now rather than faulting them in on the capture thread
+        memset(memory, 0, capacity);
+
+        PooledBuffer* buffer = new PooledBuffer();
+        buffer->data = static_cast<uint8_t*>(memory);
+        buffer->capacity = capacity;
+        return buffer;
+    }
+
+    static void destroyBuffer(PooledBuffer* buffer) {
+        if (buffer->arena) {
+            buffer->arena->freeSlot(buffer->slot);
+        } else {
+            free(buffer->data);
+        }
+        delete buffer;
+    }
+
+    void addAllocated(size_t bytes) {
+        allocated_bytes += bytes;
+        if (account != nullptr) {
+            account->charge(category, bytes);
+        }
+    }
+
+    void removeAllocated(size_t bytes) {
+        allocated_bytes -= bytes;
+        if (account != nullptr) {
+            account->release(category, bytes);
+        }
+    }
+
+    void clearFreeList() {
+        for (PooledBuffer* buffer : free_list) {
+            removeAllocated(buffer->capacity);
+            destroyBuffer(buffer);
+        }
+        free_list.clear();
+    }
+
+    // Drop cached buffers that no longer match the current frame size
+    void resize(size_t capacity) {
+        if (capacity == buffer_capacity) {
+            return;
+        }
+        clearFreeList();
+        buffer_capacity = capacity;
+    }
+};
+
+FramePool::FramePool() : state(std::make_shared<State>()) {}
+
+FramePool::~FramePool() {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->closed = true;
+}
+
+FrameData FramePool::acquire(size_t size) {
+    size_t capacity = bm_align_up(size > 0 ? size : 1);
+    PooledBuffer* buffer = nullptr;
+    std::shared_ptr<SharedArena> arena;
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->resize(capacity);
+        if (!state->free_list.empty()) {
+            buffer = state->free_list.back();
+            state->free_list.pop_back();
+        } else {
+            arena = state->arena;
+        }
+        state->in_use++;
+    }
+
+    if (buffer == nullptr) {
+        buffer = State::createBuffer(capacity, arena);
+
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (buffer == nullptr) {
+            state->in_use--;
+            return FrameData();
+        }
+        state->addAllocated(capacity);
+    } else {
+        if (buffer->arena) {
+            buffer->arena->beginWrite(buffer->slot);
+        }
+        if (buffer->size > size) {
+            // Keep the padding zeroed when a recycled buffer held a larger frame
+            memset(buffer->data + size, 0, buffer->size - size);
+        }
+    }
+
+    buffer->size = size;
+
+    // The deleter keeps the pool state alive so buffers can safely outlive the pool
+    std::shared_ptr<State> owner = state;
+    return FrameData(std::shared_ptr<PooledBuffer>(buffer, [owner](PooledBuffer* released) {
+        std::lock_guard<std::mutex> lock(owner->mutex);
+        owner->in_use--;
+        if (owner->closed || released->capacity != owner->buffer_capacity ||
+            released->arena != owner->arena) {
+            owner->removeAllocated(released->capacity);
+            State::destroyBuffer(released);
+        } else {
+            owner->free_list.push_back(released);
+        }
+    }));
+}
+
+void FramePool::reserve(size_t count, size_t size) {
+    size_t capacity = bm_align_up(size > 0 ? size : 1);
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->resize(capacity);
+
+    while (state->free_list.size() + state->in_use < count) {
+        PooledBuffer* buffer = State::createBuffer(capacity, state->arena);
+        if (buffer == nullptr) {
+            break;
+        }
+        state->addAllocated(capacity);
+        state->free_list.push_back(buffer);
+    }
+}
+
+void FramePool::setArena(std::shared_ptr<SharedArena> arena) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (arena == state->arena) {
+        return;
+    }
+    // Cached buffers come from the old source; buffers in use are dropped on release
+    state->clearFreeList();
+    state->arena = std::move(arena);
+}
+
+void FramePool::setMemoryAccount(MemoryAccount* account, MemoryCategory category) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->account != nullptr) {
+        state->account->release(state->category, state->allocated_bytes);
+    }
+    state->account = account;
+    state->category = category;
+    if (account != nullptr) {
+        account->charge(category, state->allocated_bytes);
+    }
+}
+
+size_t FramePool::allocatedBytes() const {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->allocated_bytes;
+}
+
+size_t FramePool::buffersInUse() const {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->in_use;
+}
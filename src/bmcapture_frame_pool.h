@@ -0,0 +1,90 @@
+#ifndef BMCAPTURE_FRAME_POOL_H
+#define BMCAPTURE_FRAME_POOL_H
+
+#include "bmcapture_memory.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Alignment of pooled frame buffers. A page is enough for O_DIRECT on every
+// filesystem we record to, and keeps buffers friendly to vmsplice/mmap.
+#define BM_FRAME_ALIGNMENT 4096
+
+class SharedArena;
+
+// Round a byte count up to the pool alignment
+static inline size_t bm_align_up(size_t value, size_t alignment = BM_FRAME_ALIGNMENT) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// A page-aligned buffer owned by a FramePool
+struct PooledBuffer {
+    uint8_t* data = nullptr;
+    size_t size = 0;        // Bytes of valid frame data
+    size_t capacity = 0;    // Allocated bytes, always a multiple of BM_FRAME_ALIGNMENT
+    std::shared_ptr<SharedArena> arena;   // Set when the memory is a shared arena slot
+    int slot = -1;          // Slot index in arena
+};
+
+// Reference-counted handle to a pooled buffer.
+// The capture callback fills the buffer once; after that it is treated as
+// read-only, so the triple buffer and any number of sinks (recorders etc.)
+// can hold references to the same memory without copying it.
+class FrameData {
+public:
+    FrameData() = default;
+    explicit FrameData(std::shared_ptr<PooledBuffer> buffer) : buffer(std::move(buffer)) {}
+
+    uint8_t* data() const { return buffer ? buffer->data : nullptr; }
+    size_t size() const { return buffer ? buffer->size : 0; }
+    size_t capacity() const { return buffer ? buffer->capacity : 0; }
+    bool empty() const { return size() == 0; }
+    SharedArena* arena() const { return buffer ? buffer->arena.get() : nullptr; }
+    int slot() const { return buffer ? buffer->slot : -1; }
+    void reset() { buffer.reset(); }
+
+private:
+    std::shared_ptr<PooledBuffer> buffer;
+};
+
+// Pool of page-aligned frame buffers.
+// Buffers return to the pool when their last FrameData reference is dropped,
+// so steady-state capture performs no large allocations. Buffers may outlive
+// the pool object itself; they are freed when released in that case.
+class FramePool {
+public:
+    FramePool();
+    ~FramePool();
+
+    // Get a buffer holding at least `size` bytes. Padding up to the buffer
+    // capacity is zeroed, so aligned writes of the full capacity are safe.
+    FrameData acquire(size_t size);
+
+    // Make sure at least `count` buffers of `size` bytes exist, allocating
+    // them up front instead of on the capture thread
+    void reserve(size_t count, size_t size);
+
+    // Allocate new buffers from slots of a shared arena while it has free
+    // ones, falling back to private memory; NULL returns to private memory only
+    void setArena(std::shared_ptr<SharedArena> arena);
+
+    // Charge the pool's allocations to `account`, including buffers already allocated
+    void setMemoryAccount(MemoryAccount* account, MemoryCategory category);
+
+    // Total bytes currently allocated by the pool (free and in use)
+    size_t allocatedBytes() const;
+
+    // Number of buffers currently referenced outside the pool
+    size_t buffersInUse() const;
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+private:
+    struct State;
+    std::shared_ptr<State> state;
+};
+
+#endif /* BMCAPTURE_FRAME_POOL_H */
@@ -0,0 +1,35 @@
+#ifndef BMCAPTURE_FRAME_SINK_H
+#define BMCAPTURE_FRAME_SINK_H
+
+#include <stdint.h>
+#include "bmcapture.h"
+#include "bmcapture_frame_pool.h"
+
+// Per-frame metadata handed to sinks alongside the pixel data
+struct FrameInfo {
+    int width = 0;
+    int height = 0;
+    long row_bytes = 0;
+    uint32_t pixel_format = 0;      // DeckLink pixel format code ('2vuy', 'v210')
+    uint32_t flags = 0;             // DeckLink frame flags
+    uint64_t sequence = 0;          // Callback sequence number, starting at 1
+    int64_t stream_time = 0;        // Stream time in time_scale units
+    int64_t frame_duration = 0;     // Frame duration in time_scale units
+    int64_t time_scale = 0;         // Units per second of stream_time and frame_duration
+    int64_t hardware_timestamp = 0; // Hardware reference timestamp in nanoseconds
+    int64_t arrival_ns = 0;         // steady_clock time the callback received the frame
+    bool signal_locked = false;     // Channel signal lock state after this frame
+    BMTimecode timecode = {};       // Preferred timecode, see BMFrameInfo
+    BMTimecode timecodes[BM_TIMECODE_SOURCE_COUNT] = {};
+};
+
+// Consumer of raw captured frames.
+// onFrame() runs on the DeckLink callback thread and must never block on I/O;
+// sinks keep their own reference to `data` and hand it to a worker thread.
+class FrameSink {
+public:
+    virtual ~FrameSink() {}
+    virtual void onFrame(const FrameData& data, const FrameInfo& info) = 0;
+};
+
+#endif /* BMCAPTURE_FRAME_SINK_H */
@@ -0,0 +1,217 @@
+#include "bmcapture_log.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+std::atomic<int> g_log_level(BM_LOG_WARNING);
+
+namespace {
+
+const size_t kLogSlots = 1024;          // Power of two
+const size_t kLogMessageSize = 240;     // Longer messages are truncated
+
+struct LogSlot {
+    std::atomic<uint64_t> sequence;     // Slot state, see Logger::push
+    BMLogLevel level;
+    char text[kLogMessageSize];
+};
+
+void stderr_sink(BMLogLevel level, const char* message, void* user_data) {
+    (void)user_data;
+    switch (level) {
+        case BM_LOG_ERROR:
+            fprintf(stderr, "Error: %s\n", message);
+            break;
+        case BM_LOG_WARNING:
+            fprintf(stderr, "Warning: %s\n", message);
+            break;
+        default:
+            fprintf(stderr, "%s\n", message);
+            break;
+    }
+}
+
+class Logger {
+public:
+    Logger() : head(0), tail(0), delivered(0), dropped(0) {
+        for (size_t i = 0; i < kLogSlots; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            stopping = true;
+        }
+        wake_cv.notify_one();
+        if (drain_thread.joinable()) {
+            drain_thread.join();
+        }
+    }
+
+    // Format a message into the ring; never waits for the sink
+    void push(BMLogLevel level, const char* format, va_list args) {
+        // A slot whose sequence equals the claim position is free; the writer
+        // publishes it as position + 1 and the drain thread frees it again as
+        // position + kLogSlots
+        uint64_t position = tail.load(std::memory_order_relaxed);
+        LogSlot* slot;
+        for (;;) {
+            slot = &slots[position & (kLogSlots - 1)];
+            uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+            int64_t difference = (int64_t)sequence - (int64_t)position;
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->level = level;
+        vsnprintf(slot->text, sizeof(slot->text), format, args);
+        slot->sequence.store(position + 1, std::memory_order_release);
+
+        std::call_once(started, [this] { drain_thread = std::thread(&Logger::drain, this); });
+        wake_cv.notify_one();
+    }
+
+    void setSink(BMLogCallback callback, void* user_data) {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        sink = callback != nullptr ? callback : stderr_sink;
+        sink_data = callback != nullptr ? user_data : nullptr;
+    }
+
+    // Wait until everything logged so far has reached the sink
+    void flush() {
+        uint64_t target = tail.load(std::memory_order_acquire);
+        if (target == 0) {
+            return;     // Nothing was ever logged
+        }
+        // The thread that claimed the first slot may still be starting the drain thread
+        std::call_once(started, [this] { drain_thread = std::thread(&Logger::drain, this); });
+        if (std::this_thread::get_id() == drain_thread.get_id()) {
+            return;
+        }
+        wake_cv.notify_one();
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        flushed_cv.wait(lock, [this, target] {
+            return delivered.load(std::memory_order_acquire) >= target || stopping;
+        });
+    }
+
+    uint64_t droppedCount() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    bool pop(BMLogLevel* level, char* text) {
+        LogSlot& slot = slots[head & (kLogSlots - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+            return false;
+        }
+        *level = slot.level;
+        memcpy(text, slot.text, kLogMessageSize);
+        slot.sequence.store(head + kLogSlots, std::memory_order_release);
+        head++;
+        return true;
+    }
+
+    void drain() {
+        char text[kLogMessageSize];
+        BMLogLevel level;
+        for (;;) {
+            while (pop(&level, text)) {
+                {
+                    std::lock_guard<std::mutex> lock(sink_mutex);
+                    sink(level, text, sink_data);
+                }
+                delivered.fetch_add(1, std::memory_order_release);
+            }
+
+            // Slots claimed but not yet written are waited for on the next
+            // pass; claims that were dropped never advance tail
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            flushed_cv.notify_all();
+            if (stopping && delivered.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire)) {
+                return;
+            }
+            wake_cv.wait_for(lock, std::chrono::milliseconds(50));
+        }
+    }
+
+    LogSlot slots[kLogSlots];
+    uint64_t head;                      // Drain thread only
+    std::atomic<uint64_t> tail;         // Next position to claim
+    std::atomic<uint64_t> delivered;
+    std::atomic<uint64_t> dropped;
+
+    std::once_flag started;
+    std::thread drain_thread;
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+    std::condition_variable flushed_cv;
+    bool stopping = false;
+
+    std::mutex sink_mutex;              // Held while the sink runs, so replacing it waits for the last call
+    BMLogCallback sink = stderr_sink;
+    void* sink_data = nullptr;
+};
+
+Logger& logger() {
+    static Logger instance;
+    return instance;
+}
+
+} // namespace
+
+void log_message(BMLogLevel level, const char* format, ...) {
+    if (!log_enabled(level)) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    logger().push(level, format, args);
+    va_end(args);
+}
+
+#define BM_DEFINE_LOG_FUNCTION(name, level)             \
+    void name(const char* format, ...) {                \
+        if (!log_enabled(level)) {                      \
+            return;                                     \
+        }                                               \
+        va_list args;                                   \
+        va_start(args, format);                         \
+        logger().push(level, format, args);             \
+        va_end(args);                                   \
+    }
+
+BM_DEFINE_LOG_FUNCTION(log_debug, BM_LOG_DEBUG)
+BM_DEFINE_LOG_FUNCTION(log_info, BM_LOG_INFO)
+BM_DEFINE_LOG_FUNCTION(log_warning, BM_LOG_WARNING)
+BM_DEFINE_LOG_FUNCTION(log_error, BM_LOG_ERROR)
+
+void bm_set_log_level(BMLogLevel level) {
+    g_log_level.store(level, std::memory_order_relaxed);
+}
+
+void bm_set_log_callback(BMLogCallback callback, void* user_data) {
+    logger().setSink(callback, user_data);
+}
+
+void bm_flush_log(void) {
+    logger().flush();
+}
+
+uint64_t bm_get_log_dropped(void) {
+    return logger().droppedCount();
+}
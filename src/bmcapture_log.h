@@ -0,0 +1,34 @@
+#ifndef BMCAPTURE_LOG_H
+#define BMCAPTURE_LOG_H
+
+#include "bmcapture.h"
+#include <atomic>
+
+// Leveled logging that never blocks the caller on I/O.
+//
+// Messages are formatted straight into a slot of a fixed ring shared by all
+// threads (a bounded multi-producer queue: claiming a slot is one CAS) and
+// handed to the sink by a background thread, so capture callbacks and
+// teardown paths never wait on stderr or on a user callback. When the ring is
+// full the message is dropped and counted rather than waited for. Messages
+// below the log level cost one relaxed load and are not formatted.
+
+#if defined(__GNUC__)
+#define BM_LOG_PRINTF(format_index, args_index) __attribute__((format(printf, format_index, args_index)))
+#else
+#define BM_LOG_PRINTF(format_index, args_index)
+#endif
+
+extern std::atomic<int> g_log_level;
+
+static inline bool log_enabled(BMLogLevel level) {
+    return (int)level >= g_log_level.load(std::memory_order_relaxed);
+}
+
+void log_message(BMLogLevel level, const char* format, ...) BM_LOG_PRINTF(2, 3);
+void log_debug(const char* format, ...) BM_LOG_PRINTF(1, 2);
+void log_info(const char* format, ...) BM_LOG_PRINTF(1, 2);
+void log_warning(const char* format, ...) BM_LOG_PRINTF(1, 2);
+void log_error(const char* format, ...) BM_LOG_PRINTF(1, 2);
+
+#endif /* BMCAPTURE_LOG_H */
@@ -0,0 +1,495 @@
+#include "bmcapture_matroska.h"
+#include "bmcapture_audio.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const uint32_t kFormat8BitYUV = 0x32767579;     // '2vuy'
+static const uint32_t kFormat10BitYUV = 0x76323130;    // 'v210'
+
+// Element IDs
+static const uint32_t kEBML = 0x1A45DFA3;
+static const uint32_t kEBMLVersion = 0x4286;
+static const uint32_t kEBMLReadVersion = 0x42F7;
+static const uint32_t kEBMLMaxIDLength = 0x42F2;
+static const uint32_t kEBMLMaxSizeLength = 0x42F3;
+static const uint32_t kDocType = 0x4282;
+static const uint32_t kDocTypeVersion = 0x4287;
+static const uint32_t kDocTypeReadVersion = 0x4285;
+static const uint32_t kSegment = 0x18538067;
+static const uint32_t kSeekHead = 0x114D9B74;
+static const uint32_t kSeek = 0x4DBB;
+static const uint32_t kSeekID = 0x53AB;
+static const uint32_t kSeekPosition = 0x53AC;
+static const uint32_t kInfo = 0x1549A966;
+static const uint32_t kTimestampScale = 0x2AD7B1;
+static const uint32_t kMuxingApp = 0x4D80;
+static const uint32_t kWritingApp = 0x5741;
+static const uint32_t kDuration = 0x4489;
+static const uint32_t kTracks = 0x1654AE6B;
+static const uint32_t kTrackEntry = 0xAE;
+static const uint32_t kTrackNumber = 0xD7;
+static const uint32_t kTrackUID = 0x73C5;
+static const uint32_t kTrackType = 0x83;
+static const uint32_t kFlagLacing = 0x9C;
+static const uint32_t kCodecID = 0x86;
+static const uint32_t kCodecPrivate = 0x63A2;
+static const uint32_t kDefaultDuration = 0x23E383;
+static const uint32_t kVideo = 0xE0;
+static const uint32_t kPixelWidth = 0xB0;
+static const uint32_t kPixelHeight = 0xBA;
+static const uint32_t kColourSpace = 0x2EB524;
+static const uint32_t kAudio = 0xE1;
+static const uint32_t kSamplingFrequency = 0xB5;
+static const uint32_t kChannels = 0x9F;
+static const uint32_t kBitDepth = 0x6264;
+static const uint32_t kCues = 0x1C53BB6B;
+static const uint32_t kCuePoint = 0xBB;
+static const uint32_t kCueTime = 0xB3;
+static const uint32_t kCueTrackPositions = 0xB7;
+static const uint32_t kCueTrack = 0xF7;
+static const uint32_t kCueClusterPosition = 0xF1;
+static const uint32_t kCluster = 0x1F43B675;
+static const uint32_t kTimestamp = 0xE7;
+static const uint32_t kSimpleBlock = 0xA3;
+static const uint32_t kVoid = 0xEC;
+
+// Timestamps count microseconds; 1 ms, the Matroska default, is too coarse for 59.94 Hz
+static const uint64_t kNanosecondsPerTick = 1000;
+static const uint64_t kCueInterval = 1000000;          // One cue point per second
+static const size_t kCueRegionSize = 1 << 20;          // About 10 hours of cues
+
+// Sizes of fixed-layout elements
+static const size_t kSizeLength = 8;                    // Every size we may patch is 8 bytes
+static const size_t kMasterHeader = 4 + kSizeLength;    // 4-byte ID, 8-byte size
+static const size_t kCuePointSize = 27;
+static const size_t kLongVoid = 1 + kSizeLength;
+static const size_t kClusterHeader = kMasterHeader + 10;    // Cluster, Timestamp
+static const size_t kBlockHeader = 1 + kSizeLength + 4;     // SimpleBlock, track, timecode, flags
+static const size_t kMaxPadding = 2 * 4096;                 // Void in front of the video block
+
+// value / time_scale seconds in nanoseconds, split so long recordings cannot overflow
+static int64_t to_nanoseconds(int64_t value, int64_t time_scale) {
+    return value / time_scale * 1000000000 + value % time_scale * 1000000000 / time_scale;
+}
+
+static uint8_t* put_be(uint8_t* out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out[i] = (uint8_t)(value >> (8 * (bytes - 1 - i)));
+    }
+    return out + bytes;
+}
+
+static uint8_t* put_id(uint8_t* out, uint32_t id) {
+    size_t bytes = id > 0xFFFFFF ? 4 : id > 0xFFFF ? 3 : id > 0xFF ? 2 : 1;
+    return put_be(out, id, bytes);
+}
+
+// 8-byte EBML size; the all-ones value means "unknown"
+static uint8_t* put_size8(uint8_t* out, uint64_t size) {
+    *out++ = 0x01;
+    return put_be(out, size, 7);
+}
+
+// Void element of exactly `length` bytes (not 1)
+static uint8_t* put_void(uint8_t* out, size_t length) {
+    if (length == 0) {
+        return out;
+    }
+    *out++ = (uint8_t)kVoid;
+    if (length < kLongVoid) {
+        *out++ = (uint8_t)(0x80 | (length - 2));
+        memset(out, 0, length - 2);
+        return out + length - 2;
+    }
+    out = put_size8(out, length - kLongVoid);
+    memset(out, 0, length - kLongVoid);
+    return out + length - kLongVoid;
+}
+
+static uint8_t* put_cue_point(uint8_t* out, uint64_t time, uint64_t position) {
+    out = put_id(out, kCuePoint);
+    *out++ = 0x80 | 25;
+    out = put_id(out, kCueTime);
+    *out++ = 0x88;
+    out = put_be(out, time, 8);
+    out = put_id(out, kCueTrackPositions);
+    *out++ = 0x80 | 13;
+    out = put_id(out, kCueTrack);
+    *out++ = 0x81;
+    *out++ = 1;
+    out = put_id(out, kCueClusterPosition);
+    *out++ = 0x88;
+    return put_be(out, position, 8);
+}
+
+// Appends elements to a growing buffer, for the header
+class EbmlWriter {
+public:
+    std::vector<uint8_t> bytes;
+
+    void id(uint32_t value) {
+        uint8_t buffer[4];
+        bytes.insert(bytes.end(), buffer, put_id(buffer, value));
+    }
+
+    void size(uint64_t value) {
+        uint8_t buffer[kSizeLength];
+        bytes.insert(bytes.end(), buffer, put_size8(buffer, value));
+    }
+
+    void uint(uint32_t element, uint64_t value) {
+        size_t length = 1;
+        while (length < 8 && (value >> (8 * length)) != 0) {
+            length++;
+        }
+        id(element);
+        bytes.push_back((uint8_t)(0x80 | length));
+        uint8_t buffer[8];
+        bytes.insert(bytes.end(), buffer, put_be(buffer, value, length));
+    }
+
+    void float8(uint32_t element, double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        id(element);
+        bytes.push_back(0x88);
+        uint8_t buffer[8];
+        bytes.insert(bytes.end(), buffer, put_be(buffer, bits, 8));
+    }
+
+    // Unsigned integer stored in 8 bytes so it can be patched later
+    size_t uint8(uint32_t element, uint64_t value) {
+        id(element);
+        bytes.push_back(0x88);
+        size_t at = bytes.size();
+        uint8_t buffer[8];
+        bytes.insert(bytes.end(), buffer, put_be(buffer, value, 8));
+        return at;
+    }
+
+    void binary(uint32_t element, const void* data, size_t length) {
+        id(element);
+        bytes.push_back((uint8_t)(0x80 | length));   // Only short values are written
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        bytes.insert(bytes.end(), p, p + length);
+    }
+
+    void string(uint32_t element, const char* value) {
+        binary(element, value, strlen(value));
+    }
+
+    size_t voidElement(size_t length) {
+        size_t at = bytes.size();
+        bytes.resize(at + length);
+        put_void(&bytes[at], length);
+        return at;
+    }
+
+    // Start a master element; end() fills in its size
+    size_t begin(uint32_t element) {
+        id(element);
+        size_t at = bytes.size();
+        size(0);
+        return at;
+    }
+
+    void end(size_t at) {
+        put_size8(&bytes[at], bytes.size() - at - kSizeLength);
+    }
+};
+
+MatroskaMuxer::MatroskaMuxer() {
+}
+
+MatroskaMuxer::~MatroskaMuxer() {
+    free(head);
+}
+
+bool MatroskaMuxer::supports(uint32_t pixel_format) {
+    return pixel_format == kFormat8BitYUV || pixel_format == kFormat10BitYUV;
+}
+
+size_t MatroskaMuxer::maxFrameHeader() const {
+    size_t audio = hasAudio() ? kBlockHeader + (size_t)max_audio_frames * audio_frame_bytes : 0;
+    return kClusterHeader + audio + kMaxPadding + kBlockHeader;
+}
+
+bool MatroskaMuxer::begin(const FrameInfo& info, size_t size, int audio_channels, int audio_depth) {
+    if (started() || !supports(info.pixel_format)) {
+        return false;
+    }
+
+    frame_size = size;
+    frame_duration_ns = info.time_scale > 0 ? (uint64_t)to_nanoseconds(info.frame_duration, info.time_scale) : 0;
+
+    // Samples are placed by stream time, so audio needs a time scale
+    audio_frame_bytes = 0;
+    max_audio_frames = 0;
+    if (audio_channels > 0 && info.time_scale > 0 && info.frame_duration > 0) {
+        audio_frame_bytes = (size_t)audio_channels * (audio_depth / 8);
+        max_audio_frames = (uint32_t)((info.frame_duration * kAudioSampleRate + info.time_scale - 1) / info.time_scale);
+    }
+
+    EbmlWriter w;
+    size_t ebml = w.begin(kEBML);
+    w.uint(kEBMLVersion, 1);
+    w.uint(kEBMLReadVersion, 1);
+    w.uint(kEBMLMaxIDLength, 4);
+    w.uint(kEBMLMaxSizeLength, 8);
+    w.string(kDocType, "matroska");
+    w.uint(kDocTypeVersion, 4);
+    w.uint(kDocTypeReadVersion, 2);
+    w.end(ebml);
+
+    // Unknown size until finish(), so a truncated file still parses
+    w.id(kSegment);
+    segment_size_at = w.bytes.size();
+    w.size(0xFFFFFFFFFFFFFFULL);
+    segment_data = w.bytes.size();
+
+    // Positions are patched in below, once the elements are placed
+    static const uint32_t kSeekTargets[3] = {kInfo, kTracks, kCues};
+    size_t seek_at[3];
+    size_t seek_head = w.begin(kSeekHead);
+    for (int i = 0; i < 3; i++) {
+        size_t seek = w.begin(kSeek);
+        uint8_t id_bytes[4];
+        w.binary(kSeekID, id_bytes, (size_t)(put_id(id_bytes, kSeekTargets[i]) - id_bytes));
+        seek_at[i] = w.uint8(kSeekPosition, 0);
+        w.end(seek);
+    }
+    w.end(seek_head);
+
+    size_t info_at = w.bytes.size();
+    size_t info_element = w.begin(kInfo);
+    w.uint(kTimestampScale, kNanosecondsPerTick);
+    w.string(kMuxingApp, "bmcapture");
+    w.string(kWritingApp, "bmcapture");
+    duration_at = w.voidElement(11);    // Becomes the Duration on finish()
+    w.end(info_element);
+
+    size_t tracks_at = w.bytes.size();
+    size_t tracks = w.begin(kTracks);
+    size_t track = w.begin(kTrackEntry);
+    w.uint(kTrackNumber, 1);
+    w.uint(kTrackUID, 1);
+    w.uint(kTrackType, 1);
+    w.uint(kFlagLacing, 0);
+    if (frame_duration_ns > 0) {
+        w.uint(kDefaultDuration, frame_duration_ns);
+    }
+    if (info.pixel_format == kFormat8BitYUV) {
+        w.string(kCodecID, "V_UNCOMPRESSED");
+    } else {
+        // v210 has no V_UNCOMPRESSED colour space readers agree on; a VfW
+        // BITMAPINFOHEADER with its FourCC is what ffmpeg expects
+        w.string(kCodecID, "V_MS/VFW/FOURCC");
+        uint8_t bitmap[40];
+        memset(bitmap, 0, sizeof(bitmap));
+        uint32_t fields[5] = {40, (uint32_t)info.width, (uint32_t)info.height, 1 | (20u << 16), 0};
+        for (int i = 0; i < 4; i++) {
+            for (int b = 0; b < 4; b++) {
+                bitmap[4 * i + b] = (uint8_t)(fields[i] >> (8 * b));     // Little endian
+            }
+        }
+        memcpy(bitmap + 16, "v210", 4);
+        for (int b = 0; b < 4; b++) {
+            bitmap[20 + b] = (uint8_t)(size >> (8 * b));
+        }
+        w.binary(kCodecPrivate, bitmap, sizeof(bitmap));
+    }
+    size_t video = w.begin(kVideo);
+    w.uint(kPixelWidth, (uint64_t)info.width);
+    w.uint(kPixelHeight, (uint64_t)info.height);
+    if (info.pixel_format == kFormat8BitYUV) {
+        w.binary(kColourSpace, "UYVY", 4);
+    }
+    w.end(video);
+    w.end(track);
+    if (hasAudio()) {
+        size_t audio_track = w.begin(kTrackEntry);
+        w.uint(kTrackNumber, 2);
+        w.uint(kTrackUID, 2);
+        w.uint(kTrackType, 2);
+        w.uint(kFlagLacing, 0);
+        w.string(kCodecID, "A_PCM/INT/LIT");
+        size_t audio = w.begin(kAudio);
+        w.float8(kSamplingFrequency, (double)kAudioSampleRate);
+        w.uint(kChannels, (uint64_t)audio_channels);
+        w.uint(kBitDepth, (uint64_t)audio_depth);
+        w.end(audio);
+        w.end(audio_track);
+    }
+    w.end(tracks);
+
+    // Pad the header to whole pages; the cue region starts on the next one
+    size_t padding = (BM_FRAME_ALIGNMENT - w.bytes.size() % BM_FRAME_ALIGNMENT) % BM_FRAME_ALIGNMENT;
+    if (padding == 1) {
+        padding += BM_FRAME_ALIGNMENT;
+    }
+    w.voidElement(padding);
+
+    cue_region = w.bytes.size();
+    cue_region_size = kCueRegionSize;
+    head_size = cue_region + cue_region_size;
+
+    put_be(&w.bytes[seek_at[0]], info_at - segment_data, 8);
+    put_be(&w.bytes[seek_at[1]], tracks_at - segment_data, 8);
+    put_be(&w.bytes[seek_at[2]], cue_region - segment_data, 8);
+    cues_seek_at = seek_at[2];
+
+    void* page = nullptr;
+    if (posix_memalign(&page, BM_FRAME_ALIGNMENT, head_size) != 0) {
+        return false;
+    }
+    head = static_cast<uint8_t*>(page);
+    memcpy(head, w.bytes.data(), cue_region);
+
+    // The Cues element spans the whole region; a Void after the last cue
+    // point fills the rest, so adding a point never changes the Cues size
+    uint8_t* p = put_id(head + cue_region, kCues);
+    p = put_size8(p, cue_region_size - kMasterHeader);
+    cues_end = cue_region + kMasterHeader;
+    put_void(p, cue_region_size - kMasterHeader);
+    cues_written = 0;
+    cues_overflowed = false;
+
+    have_first = false;
+    next_cue_time = 0;
+    cue_pending = false;
+    cues.clear();
+    return true;
+}
+
+uint64_t MatroskaMuxer::frameTimestamp(const FrameInfo& info) const {
+    // Round to the nearest tick rather than truncating, so 1001-based rates don't run early
+    uint64_t ns = info.time_scale > 0
+        ? (uint64_t)to_nanoseconds(info.stream_time - first_time, info.time_scale)
+        : (uint64_t)(info.arrival_ns - first_time);
+    return (ns + kNanosecondsPerTick / 2) / kNanosecondsPerTick;
+}
+
+size_t MatroskaMuxer::frameHeader(uint8_t* out, size_t pending, uint64_t offset, const FrameInfo& info,
+                                  uint32_t audio_frames, uint8_t** audio_out) {
+    if (!have_first) {
+        first_time = info.time_scale > 0 ? info.stream_time : info.arrival_ns;
+        have_first = true;
+    }
+
+    uint64_t timestamp = frameTimestamp(info);
+    uint64_t cluster = offset + pending;
+    last_timestamp = timestamp;
+    last_cluster = cluster - segment_data;
+
+    if (cues.empty() || timestamp >= next_cue_time) {
+        Cue cue;
+        cue.time = timestamp;
+        cue.position = last_cluster;
+        cues.push_back(cue);
+        next_cue_time = timestamp + kCueInterval;
+        cue_pending = true;
+    }
+
+    // The audio block starts with the cluster, so it shares the frame's timestamp
+    size_t audio_block = 0;
+    if (hasAudio()) {
+        if (audio_frames > max_audio_frames) {
+            audio_frames = max_audio_frames;
+        }
+        audio_block = kBlockHeader + (size_t)audio_frames * audio_frame_bytes;
+    }
+
+    // Void padding so the pixel data lands on a page boundary
+    size_t padding = (BM_FRAME_ALIGNMENT - (cluster + kClusterHeader + audio_block + kBlockHeader) % BM_FRAME_ALIGNMENT) %
+                     BM_FRAME_ALIGNMENT;
+    if (padding == 1) {
+        padding += BM_FRAME_ALIGNMENT;
+    }
+
+    uint8_t* p = out + pending;
+    p = put_id(p, kCluster);
+    p = put_size8(p, 10 + audio_block + padding + kBlockHeader + frame_size);
+    p = put_id(p, kTimestamp);
+    *p++ = 0x88;
+    p = put_be(p, timestamp, 8);
+    if (hasAudio()) {
+        p = put_id(p, kSimpleBlock);
+        p = put_size8(p, audio_block - 1 - kSizeLength);
+        *p++ = 0x82;        // Track 2
+        *p++ = 0;
+        *p++ = 0;
+        *p++ = 0x80;
+        if (audio_out != nullptr) {
+            *audio_out = p;
+        }
+        p += audio_block - kBlockHeader;
+    }
+    p = put_void(p, padding);
+    p = put_id(p, kSimpleBlock);
+    p = put_size8(p, 4 + frame_size);
+    *p++ = 0x81;            // Track 1
+    *p++ = 0;               // Timecode relative to the cluster
+    *p++ = 0;
+    *p++ = 0x80;            // Keyframe
+    return (size_t)(p - out);
+}
+
+bool MatroskaMuxer::updateCues(size_t* begin, size_t* end) {
+    if (!cue_pending || cues_overflowed) {
+        return false;
+    }
+    cue_pending = false;
+
+    size_t region_end = cue_region + cue_region_size;
+    size_t first = cues_end;
+    while (cues_written < cues.size()) {
+        // Keep room for the long Void that fills the rest of the region
+        if (region_end - cues_end < kCuePointSize + kLongVoid) {
+            cues_overflowed = true;
+            break;
+        }
+        const Cue& cue = cues[cues_written++];
+        cues_end = (size_t)(put_cue_point(head + cues_end, cue.time, cue.position) - head);
+    }
+    if (cues_end == first) {
+        return false;
+    }
+
+    put_void(head + cues_end, region_end - cues_end);
+    *begin = first;
+    *end = cues_end + kLongVoid;
+    return true;
+}
+
+void MatroskaMuxer::finish(uint64_t end_offset, std::vector<uint8_t>* trailer, size_t* dirty_end) {
+    trailer->clear();
+    *dirty_end = cue_region;
+
+    size_t begin, end;
+    updateCues(&begin, &end);
+
+    if (cues_overflowed) {
+        // Too many for the region: write all cues after the last cluster and
+        // turn the region into padding
+        trailer->resize(kMasterHeader + cues.size() * kCuePointSize);
+        uint8_t* p = put_id(trailer->data(), kCues);
+        p = put_size8(p, cues.size() * kCuePointSize);
+        for (const Cue& cue : cues) {
+            p = put_cue_point(p, cue.time, cue.position);
+        }
+        put_void(head + cue_region, cue_region_size);
+        put_be(head + cues_seek_at, end_offset - segment_data, 8);
+        *dirty_end = cue_region + kLongVoid;
+    }
+
+    put_size8(head + segment_size_at, end_offset + trailer->size() - segment_data);
+
+    if (have_first) {
+        double duration = (double)last_timestamp + (double)frame_duration_ns / kNanosecondsPerTick;
+        uint64_t bits;
+        memcpy(&bits, &duration, sizeof(bits));
+        uint8_t* p = put_id(head + duration_at, kDuration);
+        *p++ = 0x88;
+        put_be(p, bits, 8);
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef BMCAPTURE_MATROSKA_H
+#define BMCAPTURE_MATROSKA_H
+
+#include "bmcapture_frame_sink.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Builds a streaming Matroska file holding one uncompressed video track
+// (2vuy as V_UNCOMPRESSED/UYVY, v210 as a VfW FourCC track, the two forms
+// ffmpeg and most players read without a codec) and, when the channel
+// captures embedded audio, a 48 kHz A_PCM/INT/LIT track.
+//
+//   [header pages: EBML header, Segment, SeekHead, Info, Tracks][cue region][cluster][cluster]...
+//
+// Every frame is its own cluster, with the frame's audio samples in a
+// SimpleBlock ahead of the video. A Void element in front of the video
+// SimpleBlock header makes the pixel data start on a page boundary, so the recorder can
+// write it straight from the capture buffer with direct I/O; only the bytes
+// around it (the unaligned end of the previous frame and the next cluster
+// header) pass through a staging buffer. Cues live in a region reserved
+// behind the header and are rewritten as points are added, so a file cut
+// short by a crash is still seekable up to its last second. The segment size
+// and duration are filled in on close.
+//
+// The muxer only builds bytes; FrameRecorder does the I/O.
+class MatroskaMuxer {
+public:
+    MatroskaMuxer();
+    ~MatroskaMuxer();
+
+    static bool supports(uint32_t pixel_format);
+
+    // Build the header and empty cue region for frames shaped like `info`,
+    // with an audio track if audio_channels is not 0
+    bool begin(const FrameInfo& info, size_t frame_size, int audio_channels = 0, int audio_depth = 0);
+
+    bool started() const { return head != nullptr; }
+    bool hasAudio() const { return audio_frame_bytes > 0; }
+
+    // Most sample frames one video frame carries; longer frames are cut to this
+    uint32_t maxAudioFrames() const { return max_audio_frames; }
+
+    // Largest number of bytes frameHeader() can add after the pending bytes
+    size_t maxFrameHeader() const;
+
+    // Header and cue region, page aligned and a whole number of pages long,
+    // to be written at offset 0. Clusters follow at headSize().
+    const uint8_t* headData() const { return head; }
+    size_t headSize() const { return head_size; }
+
+    // Append the bytes that precede a frame's pixel data to `out`, which
+    // already holds `pending` bytes and sits at the page-aligned file offset
+    // `offset`. Returns the number of bytes to write from out; the frame data
+    // itself follows them on a page boundary. With an audio track, space for
+    // `audio_frames` sample frames is left at *audio_out for the caller to fill.
+    size_t frameHeader(uint8_t* out, size_t pending, uint64_t offset, const FrameInfo& info,
+                       uint32_t audio_frames = 0, uint8_t** audio_out = nullptr);
+
+    // Add a cue for the last framed frame if one is due. When the cue region
+    // changed, returns true with the byte range of headData() to rewrite.
+    bool updateCues(size_t* begin, size_t* end);
+
+    // Finish the file, which ends at `end_offset`. Any cues that did not fit
+    // the reserved region are returned in `trailer`, to be written at
+    // end_offset. The header is then patched with the segment size and
+    // duration; rewrite headData() from 0 to *dirty_end.
+    void finish(uint64_t end_offset, std::vector<uint8_t>* trailer, size_t* dirty_end);
+
+    MatroskaMuxer(const MatroskaMuxer&) = delete;
+    MatroskaMuxer& operator=(const MatroskaMuxer&) = delete;
+
+private:
+    struct Cue {
+        uint64_t time;          // In timestamp scale units
+        uint64_t position;      // Cluster offset from the segment data
+    };
+
+    uint64_t frameTimestamp(const FrameInfo& info) const;
+
+    uint8_t* head = nullptr;
+    size_t head_size = 0;
+    size_t cue_region = 0;          // Offset of the cue region in head
+    size_t cue_region_size = 0;
+    size_t cues_written = 0;        // Cue points currently in the region
+    size_t cues_end = 0;            // End of the Cues element in the region
+    bool cues_overflowed = false;
+
+    uint64_t segment_data = 0;      // File offset of the segment's first child
+    size_t segment_size_at = 0;     // Offsets in head of the fields patched by finish()
+    size_t duration_at = 0;
+    size_t cues_seek_at = 0;
+
+    size_t frame_size = 0;
+    size_t audio_frame_bytes = 0;   // Bytes per interleaved sample frame, 0 without audio
+    uint32_t max_audio_frames = 0;
+    int64_t first_time = 0;
+    bool have_first = false;
+    uint64_t frame_duration_ns = 0; // Exact, for DefaultDuration; ticks would truncate 1001-based rates
+    uint64_t last_timestamp = 0;
+    uint64_t last_cluster = 0;
+    uint64_t next_cue_time = 0;
+    bool cue_pending = false;
+    std::vector<Cue> cues;
+};
+
+#endif /* BMCAPTURE_MATROSKA_H */
@@ -0,0 +1,58 @@
+#include "bmcapture_memory.h"
+#include "bmcapture_log.h"
+
+MemoryAccount::MemoryAccount() : total(0), peak(0), reserved(0), budget(0), rejected(0) {
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+        bytes[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void MemoryAccount::charge(MemoryCategory category, size_t size) {
+    bytes[category].fetch_add(size, std::memory_order_relaxed);
+    uint64_t now = total.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t highest = peak.load(std::memory_order_relaxed);
+    while (now > highest && !peak.compare_exchange_weak(highest, now, std::memory_order_relaxed)) {
+    }
+}
+
+void MemoryAccount::release(MemoryCategory category, size_t size) {
+    bytes[category].fetch_sub(size, std::memory_order_relaxed);
+    total.fetch_sub(size, std::memory_order_relaxed);
+}
+
+bool MemoryAccount::reserve(size_t size, const char* purpose) {
+    uint64_t current = reserved.load(std::memory_order_relaxed);
+    for (;;) {
+        uint64_t limit = budget.load(std::memory_order_relaxed);
+        if (limit != 0 && current + size > limit) {
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            log_error("%s needs %.1f MB, exceeding the memory budget (%.1f of %.1f MB reserved)",
+                    purpose, size / 1e6, current / 1e6, limit / 1e6);
+            return false;
+        }
+        if (reserved.compare_exchange_weak(current, current + size, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+void MemoryAccount::unreserve(size_t size) {
+    reserved.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void MemoryAccount::setBudget(uint64_t size) {
+    budget.store(size, std::memory_order_relaxed);
+}
+
+void MemoryAccount::read(BMMemoryUsage* usage) const {
+    usage->conversion_tables = bytes[MEMORY_TABLES].load(std::memory_order_relaxed);
+    usage->frame_pools = bytes[MEMORY_FRAME_POOLS].load(std::memory_order_relaxed);
+    usage->conversion_buffers = bytes[MEMORY_CONVERSION].load(std::memory_order_relaxed);
+    usage->recorder_buffers = bytes[MEMORY_RECORDER].load(std::memory_order_relaxed);
+    usage->audio_buffers = bytes[MEMORY_AUDIO].load(std::memory_order_relaxed);
+    usage->total = total.load(std::memory_order_relaxed);
+    usage->peak = peak.load(std::memory_order_relaxed);
+    usage->reserved = reserved.load(std::memory_order_relaxed);
+    usage->budget = budget.load(std::memory_order_relaxed);
+    usage->rejected = rejected.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,101 @@
+#ifndef BMCAPTURE_MEMORY_H
+#define BMCAPTURE_MEMORY_H
+
+#include "bmcapture.h"
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+enum MemoryCategory {
+    MEMORY_TABLES,          // YUV to RGB lookup tables
+    MEMORY_FRAME_POOLS,     // Pooled capture buffers, free and in use
+    MEMORY_CONVERSION,      // RGB and grayscale copies of buffered frames
+    MEMORY_RECORDER,        // Recorder encode buffers
+    MEMORY_AUDIO,           // Embedded audio rings
+    MEMORY_CATEGORY_COUNT
+};
+
+// Memory use of one context, by category, and its budget.
+//
+// Allocations are charged as they happen and never refused here: a capture
+// thread has no good way to fail. The budget is enforced up front instead.
+// Starting a channel, a recording or a pre-trigger ring reserves its
+// worst-case footprint, and the start fails if the reservations would exceed
+// the budget. Reservations are estimates; charged bytes are what is really
+// held.
+class MemoryAccount {
+public:
+    MemoryAccount();
+
+    void charge(MemoryCategory category, size_t bytes);
+    void release(MemoryCategory category, size_t bytes);
+
+    // Reserve `bytes` against the budget, or report `purpose` and refuse
+    bool reserve(size_t bytes, const char* purpose);
+    void unreserve(size_t bytes);
+
+    void setBudget(uint64_t bytes);
+    void read(BMMemoryUsage* usage) const;
+
+    MemoryAccount(const MemoryAccount&) = delete;
+    MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+private:
+    std::atomic<uint64_t> bytes[MEMORY_CATEGORY_COUNT];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> peak;
+    std::atomic<uint64_t> reserved;
+    std::atomic<uint64_t> budget;       // 0 for no limit
+    std::atomic<uint64_t> rejected;
+};
+
+// Allocator that charges a MemoryAccount, for buffers outside the frame pools.
+// It moves with the container, so a buffer keeps charging the account it was
+// created for. Without an account it allocates like std::allocator.
+template <typename T>
+struct AccountedAllocator {
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    MemoryAccount* account = nullptr;
+    MemoryCategory category = MEMORY_CONVERSION;
+
+    AccountedAllocator() = default;
+    AccountedAllocator(MemoryAccount* memory_account, MemoryCategory memory_category)
+        : account(memory_account), category(memory_category) {}
+    template <typename U>
+    AccountedAllocator(const AccountedAllocator<U>& other)
+        : account(other.account), category(other.category) {}
+
+    T* allocate(size_t count) {
+        T* memory = std::allocator<T>().allocate(count);
+        if (account != nullptr) {
+            account->charge(category, count * sizeof(T));
+        }
+        return memory;
+    }
+
+    void deallocate(T* memory, size_t count) {
+        if (account != nullptr) {
+            account->release(category, count * sizeof(T));
+        }
+        std::allocator<T>().deallocate(memory, count);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const AccountedAllocator<T>& a, const AccountedAllocator<U>& b) {
+    return a.account == b.account && a.category == b.category;
+}
+
+template <typename T, typename U>
+bool operator!=(const AccountedAllocator<T>& a, const AccountedAllocator<U>& b) {
+    return !(a == b);
+}
+
+typedef std::vector<uint8_t, AccountedAllocator<uint8_t>> AccountedBuffer;
+
+#endif /* BMCAPTURE_MEMORY_H */
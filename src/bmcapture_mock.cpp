@@ -0,0 +1,787 @@
+#include "bmcapture_mock.h"
+#include "bmcapture_audio.h"
+#include "bmcapture_log.h"
+#include "bmcapture_replay.h"
+#include "bmcapture_timecode.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <math.h>
+#include <mutex>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+// Frames an input holds for a late callback before overwriting the oldest
+static const int64_t kMockBufferedFrames = 4;
+
+// Input connections in the order the library lists ports
+static const BMDVideoConnection kMockConnections[] = {
+    bmdVideoConnectionSDI,
+    bmdVideoConnectionHDMI,
+    bmdVideoConnectionOpticalSDI,
+    bmdVideoConnectionComponent,
+    bmdVideoConnectionComposite,
+    bmdVideoConnectionSVideo
+};
+
+static const int kMockMaxPorts = sizeof(kMockConnections) / sizeof(kMockConnections[0]);
+
+static const MockDisplayMode kStandardModes[] = {
+    {bmdModeHD720p50, 1280, 720, 1000, 50000, "720p50"},
+    {bmdModeHD720p5994, 1280, 720, 1001, 60000, "720p59.94"},
+    {bmdModeHD720p60, 1280, 720, 1000, 60000, "720p60"},
+    {bmdModeHD1080p2398, 1920, 1080, 1001, 24000, "1080p23.98"},
+    {bmdModeHD1080p24, 1920, 1080, 1000, 24000, "1080p24"},
+    {bmdModeHD1080p25, 1920, 1080, 1000, 25000, "1080p25"},
+    {bmdModeHD1080p2997, 1920, 1080, 1001, 30000, "1080p29.97"},
+    {bmdModeHD1080p30, 1920, 1080, 1000, 30000, "1080p30"},
+    {bmdModeHD1080p50, 1920, 1080, 1000, 50000, "1080p50"},
+    {bmdModeHD1080p5994, 1920, 1080, 1001, 60000, "1080p59.94"},
+    {bmdModeHD1080p6000, 1920, 1080, 1000, 60000, "1080p60"},
+    {bmdMode4K2160p2398, 3840, 2160, 1001, 24000, "2160p23.98"},
+    {bmdMode4K2160p24, 3840, 2160, 1000, 24000, "2160p24"},
+    {bmdMode4K2160p25, 3840, 2160, 1000, 25000, "2160p25"},
+    {bmdMode4K2160p2997, 3840, 2160, 1001, 30000, "2160p29.97"},
+    {bmdMode4K2160p30, 3840, 2160, 1000, 30000, "2160p30"},
+};
+
+static bool same_interface(REFIID a, REFIID b) {
+    return memcmp(&a, &b, sizeof(REFIID)) == 0;
+}
+
+static int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static BMDTimeValue rescale_ns(int64_t value, BMDTimeScale time_scale) {
+    return (value / 1000000000LL) * time_scale + (value % 1000000000LL) * time_scale / 1000000000LL;
+}
+
+static CFStringRef make_name(const char* name) {
+    return CFStringCreateWithCString(kCFAllocatorDefault, name, kCFStringEncodingMacRoman);
+}
+
+namespace {
+
+// Reference counting shared by the mock interfaces; objects delete
+// themselves when the last reference is released
+template <typename Interface>
+class MockObject : public Interface {
+public:
+    virtual ULONG STDMETHODCALLTYPE AddRef() override {
+        return ++references;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE Release() override {
+        ULONG remaining = --references;
+        if (remaining == 0) {
+            delete this;
+        }
+        return remaining;
+    }
+
+protected:
+    virtual ~MockObject() {}
+
+private:
+    std::atomic<ULONG> references{1};
+};
+
+class MockDeckLinkDisplayMode : public MockObject<IDeckLinkDisplayMode> {
+public:
+    explicit MockDeckLinkDisplayMode(const MockDisplayMode& display_mode) : mode(display_mode) {}
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) override {
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    virtual HRESULT GetName(CFStringRef* name) override {
+        *name = make_name(mode.name.c_str());
+        return *name != nullptr ? S_OK : E_FAIL;
+    }
+
+    virtual BMDDisplayMode GetDisplayMode() override { return mode.id; }
+    virtual long GetWidth() override { return mode.width; }
+    virtual long GetHeight() override { return mode.height; }
+
+    virtual HRESULT GetFrameRate(BMDTimeValue* frame_duration, BMDTimeScale* time_scale) override {
+        *frame_duration = mode.frame_duration;
+        *time_scale = mode.time_scale;
+        return S_OK;
+    }
+
+    virtual BMDFieldDominance GetFieldDominance() override { return bmdProgressiveFrame; }
+
+    virtual BMDDisplayModeFlags GetFlags() override {
+        return mode.height >= 720 ? bmdDisplayModeColorspaceRec709 : 0;
+    }
+
+private:
+    MockDisplayMode mode;
+};
+
+class MockDisplayModeIterator : public MockObject<IDeckLinkDisplayModeIterator> {
+public:
+    explicit MockDisplayModeIterator(std::shared_ptr<const MockConfig> mock_config)
+        : config(std::move(mock_config)) {}
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) override {
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    virtual HRESULT Next(IDeckLinkDisplayMode** display_mode) override {
+        if (next >= config->modes.size()) {
+            *display_mode = nullptr;
+            return S_FALSE;
+        }
+        *display_mode = new MockDeckLinkDisplayMode(config->modes[next++]);
+        return S_OK;
+    }
+
+private:
+    std::shared_ptr<const MockConfig> config;
+    size_t next = 0;
+};
+
+class MockAttributes : public MockObject<IDeckLinkAttributes> {
+public:
+    explicit MockAttributes(std::shared_ptr<const MockConfig> mock_config)
+        : config(std::move(mock_config)) {}
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) override {
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    virtual HRESULT GetFlag(BMDDeckLinkAttributeID id, bool* value) override {
+        if (id == BMDDeckLinkSupportsInputFormatDetection) {
+            *value = true;
+            return S_OK;
+        }
+        return E_INVALIDARG;
+    }
+
+    virtual HRESULT GetInt(BMDDeckLinkAttributeID id, int64_t* value) override {
+        switch (id) {
+            case BMDDeckLinkVideoInputConnections:
+                *value = 0;
+                for (int i = 0; i < config->options.ports_per_device; i++) {
+                    *value |= kMockConnections[i];
+                }
+                return S_OK;
+            case BMDDeckLinkMaximumAudioChannels:
+                *value = 16;    // Embedded SDI audio
+                return S_OK;
+            default:
+                return E_INVALIDARG;
+        }
+    }
+
+    virtual HRESULT GetFloat(BMDDeckLinkAttributeID id, double* value) override {
+        return E_INVALIDARG;
+    }
+
+    virtual HRESULT GetString(BMDDeckLinkAttributeID id, CFStringRef* value) override {
+        return E_INVALIDARG;
+    }
+
+private:
+    std::shared_ptr<const MockConfig> config;
+};
+
+// One frame's worth of embedded audio: a tone on every channel, a different
+// pitch per channel, with its phase taken from the stream position so it runs
+// on unbroken across packets. Reused for every frame, like the video frame.
+class MockAudioPacket : public IDeckLinkAudioInputPacket {
+public:
+    virtual ~MockAudioPacket() {}
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) override {
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE AddRef() override {
+        return 1;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE Release() override {
+        return 1;
+    }
+
+    virtual long GetSampleFrameCount() override {
+        return frame_count;
+    }
+
+    virtual HRESULT GetBytes(void** buffer) override {
+        *buffer = samples.data();
+        return S_OK;
+    }
+
+    virtual HRESULT GetPacketTime(BMDTimeValue* packet_time, BMDTimeScale time_scale) override {
+        if (time_scale <= 0) {
+            return E_INVALIDARG;
+        }
+        *packet_time = position * time_scale / kAudioSampleRate;
+        return S_OK;
+    }
+
+    void fill(int64_t first, long count, int channel_count, BMDAudioSampleType type) {
+        position = first;
+        frame_count = count > 0 ? count : 0;
+        size_t sample_bytes = type == bmdAudioSampleType32bitInteger ? 4 : 2;
+        samples.resize((size_t)frame_count * channel_count * sample_bytes);
+
+        // A quarter of full scale, 250 Hz on the first channel, 500 Hz on the second, ...
+        const double amplitude = 0.25 * (type == bmdAudioSampleType32bitInteger ? 2147483647.0 : 32767.0);
+        int16_t* out16 = (int16_t*)samples.data();
+        int32_t* out32 = (int32_t*)samples.data();
+        for (long i = 0; i < frame_count; i++) {
+            int64_t n = (first + i) % kAudioSampleRate;   // Whole cycles every second for every pitch
+            for (int channel = 0; channel < channel_count; channel++) {
+                double value = amplitude * sin(2.0 * M_PI * 250.0 * (channel + 1) * n / kAudioSampleRate);
+                if (type == bmdAudioSampleType32bitInteger) {
+                    *out32++ = (int32_t)lrint(value);
+                } else {
+                    *out16++ = (int16_t)lrint(value);
+                }
+            }
+        }
+    }
+
+    // Replace the tone with silence, as a card does without an input signal
+    void silence() {
+        memset(samples.data(), 0, samples.size());
+    }
+
+private:
+    std::vector<uint8_t> samples;
+    long frame_count = 0;
+    int64_t position = 0;       // 48 kHz sample frames
+};
+
+class MockInput : public MockObject<IDeckLinkInput> {
+public:
+    MockInput(std::shared_ptr<const MockConfig> mock_config, int device_index, int input_index)
+        : config(std::move(mock_config)),
+          seed(config->options.seed + (uint32_t)device_index * 7919u + (uint32_t)input_index * 104729u),
+          available_frames(0), callback(nullptr) {}
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) override {
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    virtual HRESULT DoesSupportVideoMode(BMDDisplayMode display_mode, BMDPixelFormat pixel_format,
+                                         BMDVideoInputFlags flags, BMDDisplayModeSupport* result,
+                                         IDeckLinkDisplayMode** result_display_mode) override {
+        const MockDisplayMode* mode = findMode(display_mode);
+        *result = mode != nullptr && pixel_format == bmdFormat8BitYUV ? bmdDisplayModeSupported : bmdDisplayModeNotSupported;
+        if (result_display_mode != nullptr) {
+            *result_display_mode = mode != nullptr ? new MockDeckLinkDisplayMode(*mode) : nullptr;
+        }
+        return S_OK;
+    }
+
+    virtual HRESULT GetDisplayModeIterator(IDeckLinkDisplayModeIterator** iterator) override {
+        *iterator = new MockDisplayModeIterator(config);
+        return S_OK;
+    }
+
+    virtual HRESULT SetScreenPreviewCallback(IDeckLinkScreenPreviewCallback* preview_callback) override {
+        return S_OK;
+    }
+
+    virtual HRESULT EnableVideoInput(BMDDisplayMode display_mode, BMDPixelFormat pixel_format,
+                                     BMDVideoInputFlags flags) override {
+        const MockDisplayMode* mode = findMode(display_mode);
+        // The mock only produces the 8-bit format the library captures in
+        if (mode == nullptr || pixel_format != bmdFormat8BitYUV) {
+            return E_INVALIDARG;
+        }
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if (running) {
+            return E_ACCESSDENIED;
+        }
+        enabled_mode = mode;
+        alternate_mode = alternateMode(mode);
+        input_flags = flags;
+        enabled_pattern.configure(mode->width, mode->height);
+        if (alternate_mode != nullptr) {
+            alternate_pattern.configure(alternate_mode->width, alternate_mode->height);
+        }
+        return S_OK;
+    }
+
+    virtual HRESULT DisableVideoInput() override {
+        StopStreams();
+        std::lock_guard<std::mutex> lock(state_mutex);
+        enabled_mode = nullptr;
+        return S_OK;
+    }
+
+    virtual HRESULT GetAvailableVideoFrameCount(uint32_t* count) override {
+        *count = available_frames.load(std::memory_order_relaxed);
+        return S_OK;
+    }
+
+    virtual HRESULT SetVideoInputFrameMemoryAllocator(IDeckLinkMemoryAllocator* allocator) override {
+        return E_NOTIMPL;
+    }
+
+    virtual HRESULT EnableAudioInput(BMDAudioSampleRate sample_rate, BMDAudioSampleType sample_type,
+                                     uint32_t channel_count) override {
+        if (sample_rate != bmdAudioSampleRate48kHz ||
+            (sample_type != bmdAudioSampleType16bitInteger && sample_type != bmdAudioSampleType32bitInteger) ||
+            (channel_count != 2 && channel_count != 8 && channel_count != 16)) {
+            return E_INVALIDARG;
+        }
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if (running) {
+            return E_ACCESSDENIED;
+        }
+        audio_type = sample_type;
+        audio_channels = channel_count;
+        return S_OK;
+    }
+
+    virtual HRESULT DisableAudioInput() override {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if (running) {
+            return E_ACCESSDENIED;
+        }
+        audio_channels = 0;
+        return S_OK;
+    }
+
+    virtual HRESULT GetAvailableAudioSampleFrameCount(uint32_t* count) override {
+        *count = 0;
+        return S_OK;
+    }
+
+    virtual HRESULT StartStreams() override {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if (enabled_mode == nullptr || callback.load() == nullptr) {
+            return E_ACCESSDENIED;
+        }
+        if (running) {
+            return S_OK;
+        }
+        running = true;
+        thread = std::thread(&MockInput::run, this);
+        return S_OK;
+    }
+
+    virtual HRESULT StopStreams() override {
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            running = false;
+        }
+        wake_cv.notify_all();
+        if (thread.joinable()) {
+            thread.join();
+        }
+        available_frames = 0;
+        return S_OK;
+    }
+
+    virtual HRESULT PauseStreams() override {
+        return StopStreams();
+    }
+
+    virtual HRESULT FlushStreams() override {
+        return S_OK;
+    }
+
+    virtual HRESULT SetCallback(IDeckLinkInputCallback* input_callback) override {
+        callback = input_callback;
+        return S_OK;
+    }
+
+    virtual HRESULT GetHardwareReferenceClock(BMDTimeScale time_scale, BMDTimeValue* hardware_time,
+                                              BMDTimeValue* time_in_frame, BMDTimeValue* ticks_per_frame) override {
+        if (time_scale <= 0) {
+            return E_INVALIDARG;
+        }
+        // The hardware clock is the steady clock, as in the frames' timestamps
+        int64_t now = steady_now_ns();
+        int64_t interval = frame_interval_ns.load(std::memory_order_relaxed);
+        *hardware_time = rescale_ns(now, time_scale);
+        *time_in_frame = interval > 0 ? rescale_ns(now % interval, time_scale) : 0;
+        *ticks_per_frame = rescale_ns(interval, time_scale);
+        return S_OK;
+    }
+
+protected:
+    ~MockInput() {
+        StopStreams();
+    }
+
+private:
+    const MockDisplayMode* findMode(BMDDisplayMode id) const {
+        for (const MockDisplayMode& mode : config->modes) {
+            if (mode.id == id) {
+                return &mode;
+            }
+        }
+        return nullptr;
+    }
+
+    // The mode a format change switches the source to: the next one in the
+    // list with another frame size, or failing that any other mode
+    const MockDisplayMode* alternateMode(const MockDisplayMode* mode) const {
+        const std::vector<MockDisplayMode>& modes = config->modes;
+        size_t start = mode - modes.data();
+        const MockDisplayMode* fallback = nullptr;
+        for (size_t i = 1; i < modes.size(); i++) {
+            const MockDisplayMode* candidate = &modes[(start + i) % modes.size()];
+            if (candidate->width != mode->width || candidate->height != mode->height) {
+                return candidate;
+            }
+            if (fallback == nullptr) {
+                fallback = candidate;
+            }
+        }
+        return fallback;
+    }
+
+    // RP188 VITC1 and LTC counted from stream time zero, drop-frame at
+    // 29.97 and 59.94; the user bits carry the frame number. No signal, no timecode.
+    void setTimecode(const MockDisplayMode* mode, BMDTimeValue stream_time, bool signal) {
+        for (BMTimecode& timecode : frame.timecodes) {
+            timecode = BMTimecode();
+        }
+        if (!signal) {
+            return;
+        }
+        int fps = (int)((mode->time_scale + mode->frame_duration / 2) / mode->frame_duration);
+        bool drop_frame = mode->frame_duration == 1001 && fps % 30 == 0;
+        int64_t frame_number = stream_time / mode->frame_duration;
+        for (int source : {BM_TIMECODE_RP188_VITC1, BM_TIMECODE_RP188_LTC}) {
+            BMTimecode& timecode = frame.timecodes[source];
+            timecode = timecode_from_frame_number(frame_number, fps, drop_frame, source);
+            timecode.user_bits = (uint32_t)frame_number;
+        }
+    }
+
+    void run();
+
+    std::shared_ptr<const MockConfig> config;
+    uint32_t seed;
+
+    std::mutex state_mutex;             // Guards the fields below against the API calls
+    std::condition_variable wake_cv;    // Interrupts pacing waits on StopStreams()
+    bool running = false;
+    std::thread thread;
+    const MockDisplayMode* enabled_mode = nullptr;
+    const MockDisplayMode* alternate_mode = nullptr;
+    BMDVideoInputFlags input_flags = bmdVideoInputFlagDefault;
+    BMDAudioSampleType audio_type = bmdAudioSampleType16bitInteger;
+    uint32_t audio_channels = 0;        // 0 while audio input is disabled
+
+    // Frame state, owned by the timer thread while streams run
+    TestPattern enabled_pattern;
+    TestPattern alternate_pattern;
+    ReplayVideoFrame frame;
+    MockAudioPacket audio;
+
+    std::atomic<uint32_t> available_frames;
+    std::atomic<int64_t> frame_interval_ns{0};
+    std::atomic<IDeckLinkInputCallback*> callback;
+};
+
+void MockInput::run() {
+    const BMMockOptions& options = config->options;
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+    const MockDisplayMode* source_mode = enabled_mode;    // What the simulated signal carries
+    const MockDisplayMode* input_mode = enabled_mode;     // What the input is set up to capture
+    int64_t signal_loss_left = 0;
+    int64_t frames_in_format = 0;
+
+    // Frame times follow the mode's exact rate from the timeline start, so
+    // pacing never drifts; a format change the input follows starts a new one
+    int64_t timeline_start = steady_now_ns();
+    int64_t timeline_index = 0;
+    BMDTimeValue timeline_stream_time = 0;
+    double interval = 1e9 * input_mode->frame_duration / input_mode->time_scale;
+    frame_interval_ns = (int64_t)interval;
+
+    for (int64_t index = 0; ; index++) {
+        int64_t ideal = timeline_start + (int64_t)((index - timeline_index) * interval);
+        int64_t deliver_at = ideal;
+        if (options.jitter_ms > 0.0) {
+            deliver_at += (int64_t)(chance(random) * options.jitter_ms * 1e6);
+        }
+        {
+            std::unique_lock<std::mutex> lock(state_mutex);
+            auto deadline = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deliver_at));
+            wake_cv.wait_until(lock, deadline, [this] { return !running; });
+            if (!running) {
+                break;
+            }
+        }
+
+        // A card only holds a few frames for a late callback; older ones are lost
+        int64_t now = steady_now_ns();
+        int64_t captured = timeline_index + (int64_t)((now - timeline_start) / interval);
+        if (captured - index >= kMockBufferedFrames) {
+            index = captured - kMockBufferedFrames + 1;
+            ideal = timeline_start + (int64_t)((index - timeline_index) * interval);
+        }
+        available_frames.store(captured > index ? (uint32_t)(captured - index) : 0, std::memory_order_relaxed);
+
+        IDeckLinkInputCallback* input_callback = callback.load();
+        if (input_callback == nullptr) {
+            continue;
+        }
+
+        // Switch the source to the alternate mode and back
+        if (options.format_change_interval > 0 && alternate_mode != nullptr &&
+            ++frames_in_format >= options.format_change_interval) {
+            frames_in_format = 0;
+            source_mode = source_mode == enabled_mode ? alternate_mode : enabled_mode;
+            MockDeckLinkDisplayMode* notified = new MockDeckLinkDisplayMode(*source_mode);
+            input_callback->VideoInputFormatChanged(bmdVideoInputDisplayModeChanged, notified,
+                                                    bmdDetectedVideoInputYCbCr422);
+            notified->Release();
+            if (input_flags & bmdVideoInputEnableFormatDetection) {
+                // Carry stream time over into the new mode's time scale
+                BMDTimeValue elapsed = timeline_stream_time + (index - timeline_index) * input_mode->frame_duration;
+                timeline_stream_time = elapsed * source_mode->time_scale / input_mode->time_scale;
+                timeline_start = ideal;
+                timeline_index = index;
+                input_mode = source_mode;
+                interval = 1e9 * input_mode->frame_duration / input_mode->time_scale;
+                frame_interval_ns = (int64_t)interval;
+            }
+        }
+
+        // The samples between this frame's stream time and the next one's
+        BMDTimeValue stream_time = timeline_stream_time + (index - timeline_index) * input_mode->frame_duration;
+        IDeckLinkAudioInputPacket* packet = nullptr;
+        if (audio_channels > 0) {
+            int64_t first = audio_position_for(stream_time, input_mode->time_scale);
+            int64_t end = audio_position_for(stream_time + input_mode->frame_duration, input_mode->time_scale);
+            audio.fill(first, (long)(end - first), (int)audio_channels, audio_type);
+            packet = &audio;
+        }
+
+        // A dropped frame's audio still arrives, without a video frame
+        if (options.drop_rate > 0.0 && chance(random) < options.drop_rate) {
+            if (packet != nullptr) {
+                input_callback->VideoInputFrameArrived(nullptr, packet);
+            }
+            continue;
+        }
+
+        bool signal = source_mode == input_mode;
+        if (signal_loss_left > 0) {
+            signal_loss_left--;
+            signal = false;
+        } else if (options.signal_loss_rate > 0.0 && chance(random) < options.signal_loss_rate) {
+            signal_loss_left = options.signal_loss_frames - 1;
+            signal = false;
+        }
+
+        TestPattern& pattern = input_mode == enabled_mode ? enabled_pattern : alternate_pattern;
+        if (signal) {
+            pattern.render(index);
+        }
+        frame.width = input_mode->width;
+        frame.height = input_mode->height;
+        frame.row_bytes = input_mode->width * 2;
+        frame.pixel_format = bmdFormat8BitYUV;
+        frame.flags = signal ? bmdFrameFlagDefault : bmdFrameHasNoInputSource;
+        frame.bytes = pattern.data();
+        frame.time_scale = input_mode->time_scale;
+        frame.frame_duration = input_mode->frame_duration;
+        frame.stream_time = stream_time;
+        frame.hardware_timestamp_ns = ideal;
+        setTimecode(input_mode, stream_time, signal);
+        if (packet != nullptr && !signal) {
+            audio.silence();
+        }
+        input_callback->VideoInputFrameArrived(&frame, packet);
+    }
+}
+
+class MockConfiguration : public MockObject<IDeckLinkConfiguration> {
+public:
+    MockConfiguration(std::shared_ptr<const MockConfig> mock_config, std::shared_ptr<std::atomic<int64_t>> input_connection)
+        : config(std::move(mock_config)), connection(std::move(input_connection)) {}
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) override {
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    virtual HRESULT SetInt(BMDDeckLinkConfigurationID id, int64_t value) override {
+        if (id != bmdDeckLinkConfigVideoInputConnection) {
+            return E_INVALIDARG;
+        }
+        for (int i = 0; i < config->options.ports_per_device; i++) {
+            if (value == kMockConnections[i]) {
+                connection->store(value);
+                return S_OK;
+            }
+        }
+        return E_INVALIDARG;
+    }
+
+    virtual HRESULT GetInt(BMDDeckLinkConfigurationID id, int64_t* value) override {
+        if (id != bmdDeckLinkConfigVideoInputConnection) {
+            return E_INVALIDARG;
+        }
+        *value = connection->load();
+        return S_OK;
+    }
+
+    virtual HRESULT SetFlag(BMDDeckLinkConfigurationID id, bool value) override { return E_INVALIDARG; }
+    virtual HRESULT GetFlag(BMDDeckLinkConfigurationID id, bool* value) override { return E_INVALIDARG; }
+    virtual HRESULT SetFloat(BMDDeckLinkConfigurationID id, double value) override { return E_INVALIDARG; }
+    virtual HRESULT GetFloat(BMDDeckLinkConfigurationID id, double* value) override { return E_INVALIDARG; }
+    virtual HRESULT SetString(BMDDeckLinkConfigurationID id, CFStringRef value) override { return E_INVALIDARG; }
+    virtual HRESULT GetString(BMDDeckLinkConfigurationID id, CFStringRef* value) override { return E_INVALIDARG; }
+    virtual HRESULT WriteConfigurationToPreferences() override { return S_OK; }
+
+private:
+    std::shared_ptr<const MockConfig> config;
+    std::shared_ptr<std::atomic<int64_t>> connection;   // Shared with the device
+};
+
+class MockDeckLink : public MockObject<IDeckLink> {
+public:
+    MockDeckLink(std::shared_ptr<const MockConfig> mock_config, int device_index)
+        : config(std::move(mock_config)), index(device_index),
+          connection(std::make_shared<std::atomic<int64_t>>(kMockConnections[0])), inputs_created(0) {}
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) override {
+        if (same_interface(iid, IID_IDeckLinkInput)) {
+            // Independent inputs, so each channel of the device captures on its own
+            *ppv = static_cast<IDeckLinkInput*>(new MockInput(config, index, inputs_created++));
+        } else if (same_interface(iid, IID_IDeckLinkAttributes)) {
+            *ppv = static_cast<IDeckLinkAttributes*>(new MockAttributes(config));
+        } else if (same_interface(iid, IID_IDeckLinkConfiguration)) {
+            *ppv = static_cast<IDeckLinkConfiguration*>(new MockConfiguration(config, connection));
+        } else {
+            *ppv = nullptr;
+            return E_NOINTERFACE;
+        }
+        return S_OK;
+    }
+
+    virtual HRESULT GetModelName(CFStringRef* name) override {
+        *name = make_name("Mock DeckLink");
+        return *name != nullptr ? S_OK : E_FAIL;
+    }
+
+    virtual HRESULT GetDisplayName(CFStringRef* name) override {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "Mock DeckLink %d", index + 1);
+        *name = make_name(buffer);
+        return *name != nullptr ? S_OK : E_FAIL;
+    }
+
+private:
+    std::shared_ptr<const MockConfig> config;
+    int index;
+    std::shared_ptr<std::atomic<int64_t>> connection;
+    std::atomic<int> inputs_created;
+};
+
+class MockIterator : public MockObject<IDeckLinkIterator> {
+public:
+    explicit MockIterator(std::shared_ptr<const MockConfig> mock_config) : config(std::move(mock_config)) {}
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) override {
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    virtual HRESULT Next(IDeckLink** device) override {
+        if (next >= config->options.device_count) {
+            *device = nullptr;
+            return S_FALSE;
+        }
+        *device = new MockDeckLink(config, next++);
+        return S_OK;
+    }
+
+private:
+    std::shared_ptr<const MockConfig> config;
+    int next = 0;
+};
+
+} // namespace
+
+void bm_mock_options_init(BMMockOptions* options) {
+    if (options == nullptr) {
+        return;
+    }
+    options->device_count = 1;
+    options->ports_per_device = 2;
+    options->modes = nullptr;
+    options->mode_count = 0;
+    options->jitter_ms = 0.0;
+    options->drop_rate = 0.0;
+    options->signal_loss_rate = 0.0;
+    options->signal_loss_frames = 25;
+    options->format_change_interval = 0;
+    options->seed = 1;
+}
+
+std::shared_ptr<const MockConfig> mock_configure(const BMMockOptions& options) {
+    if (options.device_count < 0 || options.ports_per_device < 1 || options.ports_per_device > kMockMaxPorts) {
+        log_error("Mock devices need 1 to %d ports and a non-negative device count", kMockMaxPorts);
+        return nullptr;
+    }
+    if (options.jitter_ms < 0.0 || options.drop_rate < 0.0 || options.drop_rate >= 1.0 ||
+        options.signal_loss_rate < 0.0 || options.signal_loss_rate > 1.0 ||
+        options.signal_loss_frames < 1 || options.format_change_interval < 0) {
+        log_error("Invalid mock impairment settings");
+        return nullptr;
+    }
+
+    std::shared_ptr<MockConfig> config = std::make_shared<MockConfig>();
+    config->options = options;
+    config->options.modes = nullptr;
+    if (options.modes == nullptr || options.mode_count <= 0) {
+        config->modes.assign(std::begin(kStandardModes), std::end(kStandardModes));
+        config->options.mode_count = (int)config->modes.size();
+        return config;
+    }
+
+    for (int i = 0; i < options.mode_count; i++) {
+        const BMMockMode& mode = options.modes[i];
+        if (mode.width <= 0 || mode.height <= 0 || mode.width % 2 != 0 ||
+            mode.frame_duration <= 0 || mode.time_scale <= 0) {
+            log_error("Invalid mock display mode %d: %dx%d, %lld/%lld", i, mode.width, mode.height,
+                    (long long)mode.frame_duration, (long long)mode.time_scale);
+            return nullptr;
+        }
+        // Custom modes get codes of their own, 'mk' and the index
+        MockDisplayMode display_mode;
+        display_mode.id = (BMDDisplayMode)(('m' << 24) | ('k' << 16) | i);
+        display_mode.width = mode.width;
+        display_mode.height = mode.height;
+        display_mode.frame_duration = mode.frame_duration;
+        display_mode.time_scale = mode.time_scale;
+        char name[64];
+        snprintf(name, sizeof(name), "Mock %dx%d @ %.2f", mode.width, mode.height,
+                 (double)mode.time_scale / mode.frame_duration);
+        display_mode.name = name;
+        config->modes.push_back(display_mode);
+    }
+    return config;
+}
+
+IDeckLinkIterator* mock_create_iterator(const std::shared_ptr<const MockConfig>& config) {
+    return config ? new MockIterator(config) : nullptr;
+}
@@ -0,0 +1,57 @@
+#ifndef BMCAPTURE_MOCK_H
+#define BMCAPTURE_MOCK_H
+
+#include "bmcapture.h"
+#include "DeckLinkAPI.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Simulated DeckLink devices, for running the library without a card.
+//
+// A mock context enumerates its devices through the same IDeckLinkIterator,
+// IDeckLink, IDeckLinkAttributes, IDeckLinkConfiguration and IDeckLinkInput
+// calls as the driver, so none of the capture code knows the difference.
+// Every IDeckLinkInput queried from a mock device is independent, so each
+// channel of a device captures on its own. Once streams start, the input
+// delivers colour bar frames (ReplayVideoFrame) from its own timer thread at
+// the display mode's rate, stamped with stream time, RP188 timecode and a
+// steady clock hardware timestamp, and applies the configured impairments. With audio input
+// enabled, each frame comes with a packet of exactly its own samples, a tone
+// per channel (silent while the signal is lost).
+//
+//  - jitter delays each frame by a random amount, without moving later ones
+//  - dropped frames are never delivered, leaving a gap in stream time; their
+//    audio still arrives, without a video frame
+//  - signal loss delivers frames flagged bmdFrameHasNoInputSource
+//  - format changes switch the source to another mode and back. With format
+//    detection enabled the input follows (as if the application re-enabled
+//    it), otherwise frames are flagged as having no input until the source
+//    returns to the enabled mode
+//
+// Like a card, an input buffers only a few frames for a late callback and
+// then overwrites the oldest, which shows up as missed frames.
+
+struct MockDisplayMode {
+    BMDDisplayMode id;
+    long width;
+    long height;
+    BMDTimeValue frame_duration;
+    BMDTimeScale time_scale;
+    std::string name;
+};
+
+// Configuration shared by every object of a mock context
+struct MockConfig {
+    BMMockOptions options;          // options.modes is not used, see `modes`
+    std::vector<MockDisplayMode> modes;
+};
+
+// Validate the options and build the configuration, or log why they are invalid
+std::shared_ptr<const MockConfig> mock_configure(const BMMockOptions& options);
+
+// Same contract as CreateDeckLinkIteratorInstance: a new iterator over the
+// mock devices, or NULL
+IDeckLinkIterator* mock_create_iterator(const std::shared_ptr<const MockConfig>& config);
+
+#endif /* BMCAPTURE_MOCK_H */
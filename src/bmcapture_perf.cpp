@@ -0,0 +1,162 @@
+#include "bmcapture_perf.h"
+#include <chrono>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+int64_t perf_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// One counter group per thread: cycles leads, instructions and cache misses follow
+struct PerfGroup {
+    bool opened = false;
+    bool available = false;
+    int fds[3] = {-1, -1, -1};
+
+    ~PerfGroup() {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    void open() {
+        opened = true;
+#ifdef __linux__
+        static const uint64_t kConfigs[3] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES
+        };
+        for (int i = 0; i < 3; i++) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = kConfigs[i];
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            int leader = i == 0 ? -1 : fds[0];
+            fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+            if (fds[i] < 0) {
+                return;
+            }
+        }
+        available = true;
+#endif
+    }
+
+    bool read(uint64_t values[3]) {
+#ifdef __linux__
+        uint64_t buffer[4];
+        if (::read(fds[0], buffer, sizeof(buffer)) != (ssize_t)sizeof(buffer) || buffer[0] != 3) {
+            return false;
+        }
+        memcpy(values, &buffer[1], 3 * sizeof(uint64_t));
+        return true;
+#else
+        (void)values;
+        return false;
+#endif
+    }
+};
+
+thread_local PerfGroup t_group;
+
+PerfGroup* thread_group() {
+    if (!t_group.opened) {
+        t_group.open();
+    }
+    return t_group.available ? &t_group : nullptr;
+}
+
+} // namespace
+
+bool perf_counters_available() {
+    return thread_group() != nullptr;
+}
+
+PerfRegionStats::PerfRegionStats() {
+    reset();
+}
+
+void PerfRegionStats::add(int64_t duration_ns, uint64_t bytes, bool counted,
+                          uint64_t region_cycles, uint64_t region_instructions, uint64_t region_misses) {
+    samples.fetch_add(1, std::memory_order_relaxed);
+    total_ns.fetch_add(duration_ns > 0 ? (uint64_t)duration_ns : 0, std::memory_order_relaxed);
+    total_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    if (counted) {
+        counted_samples.fetch_add(1, std::memory_order_relaxed);
+        counted_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        cycles.fetch_add(region_cycles, std::memory_order_relaxed);
+        instructions.fetch_add(region_instructions, std::memory_order_relaxed);
+        llc_misses.fetch_add(region_misses, std::memory_order_relaxed);
+    }
+}
+
+void PerfRegionStats::reset() {
+    samples.store(0, std::memory_order_relaxed);
+    counted_samples.store(0, std::memory_order_relaxed);
+    total_ns.store(0, std::memory_order_relaxed);
+    total_bytes.store(0, std::memory_order_relaxed);
+    counted_bytes.store(0, std::memory_order_relaxed);
+    cycles.store(0, std::memory_order_relaxed);
+    instructions.store(0, std::memory_order_relaxed);
+    llc_misses.store(0, std::memory_order_relaxed);
+}
+
+void PerfRegionStats::summarize(BMPerfCounterSummary* summary) const {
+    uint64_t frames = samples.load(std::memory_order_relaxed);
+    uint64_t counted = counted_samples.load(std::memory_order_relaxed);
+    uint64_t ns = total_ns.load(std::memory_order_relaxed);
+    uint64_t bytes = total_bytes.load(std::memory_order_relaxed);
+    uint64_t bytes_counted = counted_bytes.load(std::memory_order_relaxed);
+    uint64_t cycle_count = cycles.load(std::memory_order_relaxed);
+    uint64_t instruction_count = instructions.load(std::memory_order_relaxed);
+
+    summary->frames = frames;
+    summary->counted_frames = counted;
+    summary->bytes_per_frame = frames > 0 ? (double)bytes / frames : 0.0;
+    summary->gb_per_second = ns > 0 ? (double)bytes / ns : 0.0;     // Bytes per ns is GB/s
+    summary->cycles_per_frame = counted > 0 ? (double)cycle_count / counted : 0.0;
+    summary->instructions_per_frame = counted > 0 ? (double)instruction_count / counted : 0.0;
+    summary->llc_misses_per_frame = counted > 0 ? (double)llc_misses.load(std::memory_order_relaxed) / counted : 0.0;
+    summary->instructions_per_cycle = cycle_count > 0 ? (double)instruction_count / cycle_count : 0.0;
+    summary->bytes_per_cycle = cycle_count > 0 ? (double)bytes_counted / cycle_count : 0.0;
+}
+
+PerfRegion::PerfRegion(PerfRegionStats& region_stats, bool enabled, uint64_t region_bytes)
+    : stats(enabled ? &region_stats : nullptr), bytes(region_bytes) {
+    if (stats == nullptr) {
+        return;
+    }
+    PerfGroup* group = thread_group();
+    counted = group != nullptr && group->read(start_values);
+    start_ns = perf_now();
+}
+
+PerfRegion::~PerfRegion() {
+    if (stats == nullptr) {
+        return;
+    }
+    int64_t end_ns = perf_now();
+    uint64_t end_values[3];
+    bool counted_end = counted && t_group.read(end_values);
+    if (counted_end) {
+        stats->add(end_ns - start_ns, bytes, true, end_values[0] - start_values[0],
+                   end_values[1] - start_values[1], end_values[2] - start_values[2]);
+    } else {
+        stats->add(end_ns - start_ns, bytes, false, 0, 0, 0);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef BMCAPTURE_PERF_H
+#define BMCAPTURE_PERF_H
+
+#include "bmcapture.h"
+#include <atomic>
+#include <stdint.h>
+
+// Hardware performance counters around the conversion and copy kernels, to
+// tell whether a kernel is limited by compute or by memory on a given machine.
+//
+// Counters come from perf_event_open: cycles, instructions and last level
+// cache misses of the calling thread, in user space only, opened as one group
+// per thread on first use. Where perf events are unavailable (not Linux, or
+// refused by perf_event_paranoid, seccomp or a container) regions still
+// record bytes and time, so GB/s is reported and the counter fields stay 0.
+// Reading the group costs two system calls per region, which is why all of
+// this is off unless a channel asks for it.
+
+// Totals of one instrumented region; every field is summed with relaxed atomics
+class PerfRegionStats {
+public:
+    PerfRegionStats();
+
+    void add(int64_t duration_ns, uint64_t bytes, bool counted,
+             uint64_t cycles, uint64_t instructions, uint64_t llc_misses);
+    void reset();
+    void summarize(BMPerfCounterSummary* summary) const;
+
+    PerfRegionStats(const PerfRegionStats&) = delete;
+    PerfRegionStats& operator=(const PerfRegionStats&) = delete;
+
+private:
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> counted_samples;  // Samples with hardware counter readings
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> total_bytes;
+    std::atomic<uint64_t> counted_bytes;
+    std::atomic<uint64_t> cycles;
+    std::atomic<uint64_t> instructions;
+    std::atomic<uint64_t> llc_misses;
+};
+
+// Whether the calling thread can read hardware counters; opens its group on first call
+bool perf_counters_available();
+
+// Measures the code between construction and destruction into `stats`, when
+// `enabled`. `bytes` is the memory the region reads plus what it writes.
+class PerfRegion {
+public:
+    PerfRegion(PerfRegionStats& stats, bool enabled, uint64_t bytes);
+    ~PerfRegion();
+
+    PerfRegion(const PerfRegion&) = delete;
+    PerfRegion& operator=(const PerfRegion&) = delete;
+
+private:
+    PerfRegionStats* stats;
+    uint64_t bytes;
+    int64_t start_ns = 0;
+    bool counted = false;
+    uint64_t start_values[3];
+};
+
+#endif /* BMCAPTURE_PERF_H */
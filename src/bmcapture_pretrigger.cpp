@@ -0,0 +1,275 @@
+#include "bmcapture_pretrigger.h"
+#include "bmcapture_log.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+void bm_pretrigger_options_init(BMPreTriggerOptions* options) {
+    if (options == nullptr) {
+        return;
+    }
+    options->pre_seconds = 10.0;
+    options->post_seconds = 5.0;
+    options->memory_limit = 0;
+    options->signal_loss_prefix = nullptr;
+    bm_recording_options_init(&options->recording);
+    options->recording.format = BM_RECORDING_CONTAINER;
+}
+
+PreTriggerBuffer::PreTriggerBuffer() {
+    bm_recording_options_init(&recording);
+}
+
+PreTriggerBuffer::~PreTriggerBuffer() {
+    stop();
+}
+
+bool PreTriggerBuffer::start(const BMPreTriggerOptions& options, int64_t mode_time_scale,
+                             int64_t mode_frame_duration, size_t frame_size) {
+    stop();
+
+    if (mode_time_scale <= 0 || mode_frame_duration <= 0 || frame_size == 0 ||
+        options.pre_seconds <= 0.0 || options.post_seconds < 0.0) {
+        return false;
+    }
+
+    double fps = (double)mode_time_scale / (double)mode_frame_duration;
+    size_t buffer_bytes = bm_align_up(frame_size);
+    size_t frames = (size_t)ceil(options.pre_seconds * fps);
+    if (options.memory_limit > 0 && frames * buffer_bytes > options.memory_limit) {
+        frames = (size_t)(options.memory_limit / buffer_bytes);
+    }
+    if (frames == 0) {
+        log_error("Pre-trigger memory limit is smaller than one frame");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ring.assign(frames, Entry());
+    ring_head = 0;
+    ring_count = 0;
+    was_locked = false;
+    time_scale = mode_time_scale;
+    frame_duration = mode_frame_duration;
+    memory_bytes = (uint64_t)frames * buffer_bytes;
+    post_frames = (int64_t)ceil(options.post_seconds * fps);
+
+    // The dump writer gets the whole pre-roll at once, plus a second of slack
+    // to absorb post-roll frames while it catches up
+    dump_queue_depth = frames + (size_t)std::max(8.0, ceil(fps));
+    recording = options.recording;
+    recording.queue_depth = (int)dump_queue_depth;
+    signal_loss_prefix = options.signal_loss_prefix != nullptr ? options.signal_loss_prefix : "";
+
+    dumps_completed = 0;
+    frames_dumped = 0;
+    frames_dropped = 0;
+    bytes_dumped = 0;
+    last_dump_seconds = 0.0;
+    last_dump_mb_per_s = 0.0;
+    last_error = 0;
+
+    running = true;
+    stopping = false;
+    worker = std::thread(&PreTriggerBuffer::dumpLoop, this);
+    return true;
+}
+
+void PreTriggerBuffer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        stopping = true;
+    }
+    cv.notify_all();
+
+    // A pending dump is still written, with whatever post-roll it has
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+    stopping = false;
+    ring.clear();
+    ring_head = 0;
+    ring_count = 0;
+    pending.clear();
+}
+
+bool PreTriggerBuffer::trigger(const char* path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return triggerLocked(path);
+}
+
+bool PreTriggerBuffer::triggerLocked(const char* path) {
+    if (!running || stopping || dump_requested) {
+        return false;
+    }
+    if (path == nullptr && signal_loss_prefix.empty()) {
+        return false;
+    }
+
+    // Hand the pre-roll over oldest first; the ring starts refilling once the
+    // post-roll has been captured
+    size_t oldest = (ring_head + ring.size() - ring_count) % ring.size();
+    for (size_t i = 0; i < ring_count; i++) {
+        pending.push_back(std::move(ring[(oldest + i) % ring.size()]));
+    }
+    ring_head = 0;
+    ring_count = 0;
+
+    dump_path = path != nullptr ? path : "";
+    post_remaining = post_frames;
+    dump_requested = true;
+    dump_ready = false;
+    trigger_time = std::chrono::steady_clock::now();
+    cv.notify_all();
+    return true;
+}
+
+void PreTriggerBuffer::onFrame(const FrameData& data, const FrameInfo& info) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running || data.empty()) {
+        return;
+    }
+
+    bool signal_lost = was_locked && !info.signal_locked;
+    was_locked = info.signal_locked;
+
+    if (dump_requested && post_remaining > 0) {
+        if (dump_ready) {
+            recorder->onFrame(data, info);
+        } else if (pending.size() < dump_queue_depth) {
+            Entry entry;
+            entry.data = data;
+            entry.info = info;
+            pending.push_back(entry);
+        } else {
+            frames_dropped++;
+        }
+        if (--post_remaining == 0) {
+            cv.notify_all();
+        }
+        return;
+    }
+
+    Entry& slot = ring[ring_head];
+    slot.data = data;
+    slot.info = info;
+    ring_head = (ring_head + 1) % ring.size();
+    if (ring_count < ring.size()) {
+        ring_count++;
+    }
+
+    if (signal_lost && !signal_loss_prefix.empty()) {
+        triggerLocked(nullptr);
+    }
+}
+
+void PreTriggerBuffer::getStats(BMPreTriggerStats* stats) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats->enabled = running;
+    stats->dumping = dump_requested;
+    stats->ring_capacity = (int)ring.size();
+    stats->ring_frames = (int)ring_count;
+    stats->ring_seconds = time_scale > 0 ? (double)ring_count * frame_duration / time_scale : 0.0;
+    stats->memory_bytes = memory_bytes;
+    stats->dumps_completed = dumps_completed;
+    stats->frames_dumped = frames_dumped;
+    stats->frames_dropped = frames_dropped;
+    stats->bytes_dumped = bytes_dumped;
+    stats->last_dump_seconds = last_dump_seconds;
+    stats->last_dump_mb_per_s = last_dump_mb_per_s;
+    stats->last_error = last_error;
+
+    // Include the progress of a dump that is still being written
+    if (recorder) {
+        BMRecordingStats recording_stats;
+        recorder->getStats(&recording_stats);
+        stats->frames_dumped += recording_stats.frames_written;
+        stats->frames_dropped += recording_stats.frames_dropped;
+        stats->bytes_dumped += recording_stats.bytes_written;
+    }
+}
+
+std::string PreTriggerBuffer::makeDumpPath() {
+    char stamp[32];
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+
+    std::string base = signal_loss_prefix + "-" + stamp;
+    std::string path = base + ".bmraw";
+    for (int n = 1; access(path.c_str(), F_OK) == 0; n++) {
+        path = base + "-" + std::to_string(n) + ".bmraw";
+    }
+    return path;
+}
+
+void PreTriggerBuffer::dumpLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        cv.wait(lock, [this] { return stopping || dump_requested; });
+        if (!dump_requested) {
+            return;
+        }
+
+        std::string path = dump_path.empty() ? makeDumpPath() : dump_path;
+        BMRecordingOptions options = recording;
+
+        // Opening (and preallocating) the file may block, so the capture
+        // callback keeps queueing into pending meanwhile
+        lock.unlock();
+        std::unique_ptr<FrameRecorder> dump(new FrameRecorder());
+        bool opened = dump->open(path.c_str(), options);
+        lock.lock();
+
+        if (!opened) {
+            BMRecordingStats recording_stats;
+            dump->getStats(&recording_stats);
+            last_error = recording_stats.last_error;
+            frames_dropped += pending.size();
+            log_error("Failed to open pre-trigger dump %s", path.c_str());
+            pending.clear();
+            post_remaining = 0;
+            dump_requested = false;
+            continue;
+        }
+
+        recorder = std::move(dump);
+        for (const Entry& entry : pending) {
+            recorder->onFrame(entry.data, entry.info);
+        }
+        pending.clear();
+        dump_ready = true;
+
+        cv.wait(lock, [this] { return stopping || post_remaining == 0; });
+        post_remaining = 0;
+        dump_ready = false;
+
+        // Flush outside the lock so capture keeps filling the ring
+        FrameRecorder* active = recorder.get();
+        lock.unlock();
+        active->close();
+        lock.lock();
+
+        BMRecordingStats recording_stats;
+        active->getStats(&recording_stats);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - trigger_time).count();
+        frames_dumped += recording_stats.frames_written;
+        frames_dropped += recording_stats.frames_dropped;
+        bytes_dumped += recording_stats.bytes_written;
+        last_error = recording_stats.last_error;
+        last_dump_seconds = seconds;
+        last_dump_mb_per_s = seconds > 0.0 ? recording_stats.bytes_written / seconds / 1e6 : 0.0;
+        dumps_completed++;
+        recorder.reset();
+        dump_requested = false;
+    }
+}
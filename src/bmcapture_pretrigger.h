@@ -0,0 +1,95 @@
+#ifndef BMCAPTURE_PRETRIGGER_H
+#define BMCAPTURE_PRETRIGGER_H
+
+#include "bmcapture.h"
+#include "bmcapture_frame_sink.h"
+#include "bmcapture_recorder.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Keeps the last N frames of a channel in memory and writes them, plus a
+// post-roll, to disk when triggered.
+// The ring holds references to pooled capture buffers, so keeping pre-roll
+// costs no copies. A trigger hands the ring contents to a FrameRecorder that a
+// background thread opens and closes; the capture callback only moves
+// references around. While the post-roll is being captured, frames go to the
+// dump instead of the ring, so memory stays bounded by the ring size plus the
+// dump writer's backlog.
+class PreTriggerBuffer : public FrameSink {
+public:
+    PreTriggerBuffer();
+    ~PreTriggerBuffer();
+
+    // Size the ring for the channel's mode and start the dump thread
+    bool start(const BMPreTriggerOptions& options, int64_t time_scale,
+               int64_t frame_duration, size_t frame_size);
+
+    // Finish any dump in progress and release the ring
+    void stop();
+
+    // Start a dump; path may be NULL to name the file from the signal loss prefix
+    bool trigger(const char* path);
+
+    int capacity() const { return (int)ring.size(); }
+
+    void onFrame(const FrameData& data, const FrameInfo& info) override;
+
+    void getStats(BMPreTriggerStats* stats) const;
+
+    PreTriggerBuffer(const PreTriggerBuffer&) = delete;
+    PreTriggerBuffer& operator=(const PreTriggerBuffer&) = delete;
+
+private:
+    struct Entry {
+        FrameData data;
+        FrameInfo info;
+    };
+
+    void dumpLoop();
+    bool triggerLocked(const char* path);
+    std::string makeDumpPath();
+
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    std::thread worker;
+    bool running = false;
+    bool stopping = false;
+
+    std::vector<Entry> ring;
+    size_t ring_head = 0;               // Slot the next frame is stored in
+    size_t ring_count = 0;
+    bool was_locked = false;            // Signal lock state of the previous frame
+
+    // Dump state, guarded by mutex
+    BMRecordingOptions recording;
+    std::string signal_loss_prefix;
+    std::string dump_path;
+    std::deque<Entry> pending;          // Frames waiting for the dump file to open
+    std::unique_ptr<FrameRecorder> recorder;
+    bool dump_requested = false;
+    bool dump_ready = false;            // recorder is open and takes frames directly
+    int64_t post_frames = 0;
+    int64_t post_remaining = 0;
+    size_t dump_queue_depth = 0;
+    std::chrono::steady_clock::time_point trigger_time;
+
+    int64_t time_scale = 0;
+    int64_t frame_duration = 0;
+    uint64_t memory_bytes = 0;
+
+    uint64_t dumps_completed = 0;
+    uint64_t frames_dumped = 0;
+    uint64_t frames_dropped = 0;
+    uint64_t bytes_dumped = 0;
+    double last_dump_seconds = 0.0;
+    double last_dump_mb_per_s = 0.0;
+    int last_error = 0;
+};
+
+#endif /* BMCAPTURE_PRETRIGGER_H */
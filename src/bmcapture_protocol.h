@@ -0,0 +1,57 @@
+#ifndef BMCAPTURE_PROTOCOL_H
+#define BMCAPTURE_PROTOCOL_H
+
+/*
+ * Wire format of the local frame server.
+ * Shared by the server, the C client library and bmcapture/client.py, so it is
+ * plain C with fixed-size little-endian fields; every message is 64 bytes.
+ *
+ * On connect the server sends a HELLO with the shared arena descriptor
+ * attached (SCM_RIGHTS). The arena starts with one 64-bit generation counter
+ * per slot, followed by the slots at data_offset. For every new frame the
+ * server sends a FRAME naming its slot and generation; the client reads the
+ * slot in place and answers with a RELEASE. A slot's generation is incremented
+ * before the slot is rewritten, so a reader that sees a different generation
+ * after reading knows the data was reclaimed underneath it.
+ */
+
+#include <stdint.h>
+
+#define BM_SERVER_PROTOCOL_VERSION 1
+#define BM_SERVER_MESSAGE_SIZE 64
+
+enum {
+    BM_SERVER_HELLO = 1,    /* Server to client: stream format and arena layout */
+    BM_SERVER_FRAME = 2,    /* Server to client: a frame is readable in a slot */
+    BM_SERVER_RELEASE = 3   /* Client to server: the client is done with a slot */
+};
+
+typedef struct {
+    uint32_t type;              /* BM_SERVER_HELLO */
+    uint32_t version;           /* BM_SERVER_PROTOCOL_VERSION */
+    uint32_t slot_count;
+    uint32_t reserved0;
+    uint64_t slot_size;         /* Bytes between consecutive slots */
+    uint64_t data_offset;       /* Offset of slot 0 in the arena */
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_bytes;
+    uint32_t pixel_format;      /* DeckLink pixel format code, '2vuy' */
+    int64_t time_scale;
+    int64_t frame_duration;
+} BMServerHello;
+
+typedef struct {
+    uint32_t type;              /* BM_SERVER_FRAME or BM_SERVER_RELEASE */
+    uint32_t slot;
+    uint64_t generation;        /* Slot generation the frame was published with */
+    uint64_t sequence;
+    int64_t stream_time;
+    int64_t frame_duration;
+    int64_t hardware_timestamp; /* Nanoseconds */
+    uint32_t flags;
+    uint32_t size;              /* Bytes of frame data in the slot */
+    uint64_t reserved;
+} BMServerFrame;
+
+#endif /* BMCAPTURE_PROTOCOL_H */
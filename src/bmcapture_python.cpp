@@ -4,18 +4,21 @@
 #include <numpy/arrayobject.h>
 
 #include "bmcapture.h"
+#include <math.h>
+#include <vector>
 
 // Global context for the library
 static BMContext* g_context = NULL;
 
 
-// Struct for the Python BMCapture object
+// Struct for the Python BMCapture object. It starts with the same fields as
+// BMChannelObject, so the BMChannel methods also work on the primary channel.
 typedef struct {
     PyObject_HEAD
-    BMCaptureDevice* device;
     BMCaptureChannel* channel;  // Primary channel for backward compatibility
     int width;
     int height;
+    BMCaptureDevice* device;
 } BMCaptureObject;
 
 // Struct for the Python BMChannel object
@@ -24,8 +27,25 @@ typedef struct {
     BMCaptureChannel* channel;
     int width;
     int height;
+    PyObject* owner;    // BMCapture whose device holds the channel, kept alive while the channel is open
 } BMChannelObject;
 
+// Struct for the Python RawFile object (reader for .bmraw containers)
+typedef struct {
+    PyObject_HEAD
+    BMRawFile* file;
+    BMRawFileInfo info;
+    int closed;     // Set by close(); the mapping itself lives until dealloc
+} BMRawFileObject;
+
+// Struct for the Python RtpReceiver object
+typedef struct {
+    PyObject_HEAD
+    BMRtpReceiver* receiver;
+    int width;
+    int height;
+} BMRtpReceiverObject;
+
 //Forward Declare functions for reference in static structs.
 static PyObject* BMChannel_new(PyTypeObject* type, PyObject* args, PyObject* kwds);
 static int BMCapture_init(BMCaptureObject* self, PyObject* args, PyObject* kwds);
@@ -37,9 +57,45 @@ static PyObject* BMChannel_get_frame_count(BMChannelObject* self, PyObject* args
 static PyObject* BMChannel_set_signal_parameters(BMChannelObject* self, PyObject* args, PyObject* kwds);
 static PyObject* BMChannel_update(BMChannelObject* self, PyObject* args);
 static PyObject* BMChannel_has_valid_signal(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_get_stats(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_get_frame_info(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_reset_stats(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_enable_perf_counters(BMChannelObject* self, PyObject* args, PyObject* kwds);
 static PyObject* BMChannel_close(BMChannelObject* self, PyObject* args);
 static int BMChannel_init(BMChannelObject* self, PyObject* args, PyObject* kwds);
 static PyObject* BMChannel_get_frame(BMChannelObject* self, PyObject* args, PyObject* kwds);
+static PyObject* BMChannel_start_recording(BMChannelObject* self, PyObject* args, PyObject* kwds);
+static PyObject* BMChannel_stop_recording(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_get_recording_stats(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_start_stream(BMChannelObject* self, PyObject* args, PyObject* kwds);
+static PyObject* BMChannel_stop_stream(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_get_stream_stats(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_start_server(BMChannelObject* self, PyObject* args, PyObject* kwds);
+static PyObject* BMChannel_stop_server(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_get_server_stats(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_start_rtp(BMChannelObject* self, PyObject* args, PyObject* kwds);
+static PyObject* BMChannel_stop_rtp(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_get_rtp_stats(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_enable_pretrigger(BMChannelObject* self, PyObject* args, PyObject* kwds);
+static PyObject* BMChannel_disable_pretrigger(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_trigger_dump(BMChannelObject* self, PyObject* args, PyObject* kwds);
+static PyObject* BMChannel_get_pretrigger_stats(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_get_audio(BMChannelObject* self, PyObject* args);
+static PyObject* BMChannel_get_audio_stats(BMChannelObject* self, PyObject* args);
+
+static int BMRawFile_init(BMRawFileObject* self, PyObject* args, PyObject* kwds);
+static void BMRawFile_dealloc(BMRawFileObject* self);
+static Py_ssize_t BMRawFile_len(BMRawFileObject* self);
+static PyObject* BMRawFile_get_frame(BMRawFileObject* self, PyObject* args);
+static PyObject* BMRawFile_get_frame_info(BMRawFileObject* self, PyObject* args);
+static PyObject* BMRawFile_find_frame(BMRawFileObject* self, PyObject* args);
+static PyObject* BMRawFile_get_info(BMRawFileObject* self, PyObject* args);
+static PyObject* BMRawFile_close(BMRawFileObject* self, PyObject* args);
+static int BMRtpReceiver_init(BMRtpReceiverObject* self, PyObject* args, PyObject* kwds);
+static void BMRtpReceiver_dealloc(BMRtpReceiverObject* self);
+static PyObject* BMRtpReceiver_get_frame(BMRtpReceiverObject* self, PyObject* args, PyObject* kwds);
+static PyObject* BMRtpReceiver_get_stats(BMRtpReceiverObject* self, PyObject* args);
+static PyObject* BMRtpReceiver_close(BMRtpReceiverObject* self, PyObject* args);
 
 static PyObject* BMCapture_create_channel(BMCaptureObject* self, PyObject* args, PyObject* kwds);
 static PyObject* BMCapture_new(PyTypeObject* type, PyObject* args, PyObject* kwds);
@@ -55,7 +111,7 @@ static PyMethodDef BMCapture_methods[] = {
     {"update", (PyCFunction)BMCapture_update, METH_NOARGS,
      "Check for new frames. Returns True if a new frame is available."},
     {"get_frame", (PyCFunction)BMCapture_get_frame, METH_VARARGS | METH_KEYWORDS,
-     "Get the latest frame as a NumPy array. Format can be 'rgb', 'yuv', or 'gray'."},
+     "Get the latest frame as a NumPy array. Format can be 'rgb', 'yuv', or 'gray'. Pass out= to fill an existing array of the frame's shape instead of allocating one."},
     {"get_channel_count", (PyCFunction)BMCapture_get_channel_count, METH_NOARGS,
      "Get the number of channels supported by this device."},
     {"create_channel", (PyCFunction)BMCapture_create_channel, METH_VARARGS | METH_KEYWORDS,
@@ -68,6 +124,14 @@ static PyMethodDef BMCapture_methods[] = {
      "Get the number of frames received since starting capture."},
     {"set_signal_parameters", (PyCFunction)BMChannel_set_signal_parameters, METH_VARARGS | METH_KEYWORDS,
      "Set parameters for signal detection: min_frames (default 3), max_bad_frames (default 5)."},
+    {"get_stats", (PyCFunction)BMChannel_get_stats, METH_NOARGS,
+     "Get pipeline counters and timing histograms of the primary channel as a dict."},
+    {"get_frame_info", (PyCFunction)BMChannel_get_frame_info, METH_NOARGS,
+     "Get the metadata, timecode and latency breakdown of the frame last returned by get_frame, or None."},
+    {"get_audio", (PyCFunction)BMChannel_get_audio, METH_NOARGS,
+     "Get the embedded audio of the frame last returned by get_frame as an int16 or int32 array of shape (samples, channels), or None."},
+    {"get_audio_stats", (PyCFunction)BMChannel_get_audio_stats, METH_NOARGS,
+     "Get embedded audio statistics of the primary channel as a dict."},
     {"close", (PyCFunction)BMCapture_close, METH_NOARGS,
      "Close the device and release resources."},
     {NULL}  /* Sentinel */
@@ -78,14 +142,14 @@ static PyMethodDef BMCapture_methods[] = {
 static PyTypeObject BMCaptureType = {
     PyVarObject_HEAD_INIT(NULL, 0)
     .tp_name = "bmcapture_c.BMCapture",
-    .tp_doc = "BlackMagic Capture Device",
     .tp_basicsize = sizeof(BMCaptureObject),
     .tp_itemsize = 0,
-    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
-    .tp_new = BMCapture_new,
-    .tp_init = (initproc)BMCapture_init,
     .tp_dealloc = (destructor)BMCapture_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+    .tp_doc = "BlackMagic Capture Device",
     .tp_methods = BMCapture_methods,
+    .tp_init = (initproc)BMCapture_init,
+    .tp_new = BMCapture_new,
 };
 
 
@@ -94,7 +158,7 @@ static PyMethodDef BMChannel_methods[] = {
     {"update", (PyCFunction)BMChannel_update, METH_NOARGS,
      "Check for new frames. Returns True if a new frame is available."},
     {"get_frame", (PyCFunction)BMChannel_get_frame, METH_VARARGS | METH_KEYWORDS,
-     "Get the latest frame as a NumPy array. Format can be 'rgb', 'yuv', or 'gray'."},
+     "Get the latest frame as a NumPy array. Format can be 'rgb', 'yuv', or 'gray'. Pass out= to fill an existing array of the frame's shape instead of allocating one."},
     {"has_valid_signal", (PyCFunction)BMChannel_has_valid_signal, METH_NOARGS,
      "Check if the channel has a valid signal lock with stable frames."},
     {"has_stable_frame_rate", (PyCFunction)BMChannel_has_stable_frame_rate, METH_NOARGS,
@@ -103,6 +167,50 @@ static PyMethodDef BMChannel_methods[] = {
      "Get the number of frames received since starting capture."},
     {"set_signal_parameters", (PyCFunction)BMChannel_set_signal_parameters, METH_VARARGS | METH_KEYWORDS,
      "Set parameters for signal detection: min_frames (default 3), max_bad_frames (default 5)."},
+    {"get_stats", (PyCFunction)BMChannel_get_stats, METH_NOARGS,
+     "Get pipeline counters and timing histograms (callback, conversion, arrival-to-delivery latency) as a dict."},
+    {"reset_stats", (PyCFunction)BMChannel_reset_stats, METH_NOARGS,
+     "Clear the pipeline statistics without stopping capture."},
+    {"enable_perf_counters", (PyCFunction)BMChannel_enable_perf_counters, METH_VARARGS | METH_KEYWORDS,
+     "Measure cycles, instructions, cache misses and bytes moved by conversions and copies; returns whether hardware counters are available."},
+    {"get_frame_info", (PyCFunction)BMChannel_get_frame_info, METH_NOARGS,
+     "Get the metadata, RP188/VITC timecodes and latency breakdown (capture to callback, callback, queue, conversion, delivery) of the frame last returned by get_frame, or None."},
+    {"start_recording", (PyCFunction)BMChannel_start_recording, METH_VARARGS | METH_KEYWORDS,
+     "Record raw YUV frames to a file from a native writer thread: path, queue_depth (default 8), preallocate_bytes (default 1 GiB), direct_io (default True), format ('raw', 'container' or 'matroska'), compression ('none' or 'lossless', container only), compression_threads (default 0: one per core), segment_seconds (0: one file), retain_bytes, retain_seconds."},
+    {"stop_recording", (PyCFunction)BMChannel_stop_recording, METH_NOARGS,
+     "Stop recording, writing out any queued frames first."},
+    {"get_recording_stats", (PyCFunction)BMChannel_get_recording_stats, METH_NOARGS,
+     "Get recording statistics as a dict."},
+    {"start_stream", (PyCFunction)BMChannel_start_stream, METH_VARARGS | METH_KEYWORDS,
+     "Stream frames to a file descriptor or file object from a native writer thread: fd, format ('y4m' or 'raw'), overflow ('drop' or 'block'), queue_depth (default 4), zero_copy (default True)."},
+    {"stop_stream", (PyCFunction)BMChannel_stop_stream, METH_NOARGS,
+     "Stop streaming, writing out any queued frames first."},
+    {"get_stream_stats", (PyCFunction)BMChannel_get_stream_stats, METH_NOARGS,
+     "Get streaming statistics as a dict."},
+    {"start_server", (PyCFunction)BMChannel_start_server, METH_VARARGS | METH_KEYWORDS,
+     "Share frames with local processes over a Unix socket (see bmcapture.client): path, slot_count (default 16), max_clients (default 8), max_leases (default 4), lease_ms (default 200)."},
+    {"stop_server", (PyCFunction)BMChannel_stop_server, METH_NOARGS,
+     "Stop the frame server and disconnect its subscribers."},
+    {"get_server_stats", (PyCFunction)BMChannel_get_server_stats, METH_NOARGS,
+     "Get frame server statistics as a dict."},
+    {"start_rtp", (PyCFunction)BMChannel_start_rtp, METH_VARARGS | METH_KEYWORDS,
+     "Send frames as RFC 4175 RTP video: host, port, payload_type (default 96), packet_size (default 1400), paced (default True), gso (default True), queue_depth (default 2), ttl (multicast, default 1)."},
+    {"stop_rtp", (PyCFunction)BMChannel_stop_rtp, METH_NOARGS,
+     "Stop sending RTP video."},
+    {"get_rtp_stats", (PyCFunction)BMChannel_get_rtp_stats, METH_NOARGS,
+     "Get RTP sender statistics as a dict."},
+    {"enable_pretrigger", (PyCFunction)BMChannel_enable_pretrigger, METH_VARARGS | METH_KEYWORDS,
+     "Keep recent raw frames in memory for dumps: pre_seconds (default 10), post_seconds (default 5), memory_limit (bytes, default 0 = none), signal_loss_prefix (dump automatically on signal loss), direct_io (default True)."},
+    {"disable_pretrigger", (PyCFunction)BMChannel_disable_pretrigger, METH_NOARGS,
+     "Release the pre-trigger buffer, finishing any dump in progress."},
+    {"trigger_dump", (PyCFunction)BMChannel_trigger_dump, METH_VARARGS | METH_KEYWORDS,
+     "Write the pre-roll and post-roll to a .bmraw container in the background: path (default: named from signal_loss_prefix). Returns False if a dump is already running."},
+    {"get_pretrigger_stats", (PyCFunction)BMChannel_get_pretrigger_stats, METH_NOARGS,
+     "Get pre-trigger ring occupancy and dump statistics as a dict."},
+    {"get_audio", (PyCFunction)BMChannel_get_audio, METH_NOARGS,
+     "Get the embedded audio of the frame last returned by get_frame as an int16 or int32 array of shape (samples, channels), or None if it is not in the ring."},
+    {"get_audio_stats", (PyCFunction)BMChannel_get_audio_stats, METH_NOARGS,
+     "Get embedded audio statistics (packets, sample frames, silence filled in, discontinuities, failed reads) as a dict."},
     {"close", (PyCFunction)BMChannel_close, METH_NOARGS,
      "Close the channel and release resources."},
     {NULL}  /* Sentinel */
@@ -113,14 +221,73 @@ static PyMethodDef BMChannel_methods[] = {
 static PyTypeObject BMChannelType = {
     PyVarObject_HEAD_INIT(NULL, 0)
     .tp_name = "bmcapture_c.BMChannel",
-    .tp_doc = "BlackMagic Capture Channel",
     .tp_basicsize = sizeof(BMChannelObject),
     .tp_itemsize = 0,
-    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
-    .tp_new = BMChannel_new,
-    .tp_init = (initproc)BMChannel_init,
     .tp_dealloc = (destructor)BMChannel_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+    .tp_doc = "BlackMagic Capture Channel",
     .tp_methods = BMChannel_methods,
+    .tp_init = (initproc)BMChannel_init,
+    .tp_new = BMChannel_new,
+};
+
+// Method definitions for RawFile
+static PyMethodDef BMRawFile_methods[] = {
+    {"get_frame", (PyCFunction)BMRawFile_get_frame, METH_VARARGS,
+     "Get frame N as a read-only NumPy array that views the mapped file (no copy); compressed frames are decoded into a new array."},
+    {"get_frame_info", (PyCFunction)BMRawFile_get_frame_info, METH_VARARGS,
+     "Get the metadata of frame N, including its recorded timecode, as a dict."},
+    {"find_frame", (PyCFunction)BMRawFile_find_frame, METH_VARARGS,
+     "Get the index of the last frame at or before a stream time."},
+    {"get_info", (PyCFunction)BMRawFile_get_info, METH_NOARGS,
+     "Get the container format as a dict."},
+    {"close", (PyCFunction)BMRawFile_close, METH_NOARGS,
+     "Close the container. The mapping is released once no arrays from get_frame remain."},
+    {NULL}  /* Sentinel */
+};
+
+static PySequenceMethods BMRawFile_as_sequence = {
+    (lenfunc)BMRawFile_len,
+};
+
+// Type definition for RawFile
+static PyTypeObject BMRawFileType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "bmcapture_c.RawFile",
+    .tp_basicsize = sizeof(BMRawFileObject),
+    .tp_itemsize = 0,
+    .tp_dealloc = (destructor)BMRawFile_dealloc,
+    .tp_as_sequence = &BMRawFile_as_sequence,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Memory-mapped reader for raw capture containers",
+    .tp_methods = BMRawFile_methods,
+    .tp_init = (initproc)BMRawFile_init,
+    .tp_new = PyType_GenericNew,
+};
+
+// Method definitions for RtpReceiver
+static PyMethodDef BMRtpReceiver_methods[] = {
+    {"get_frame", (PyCFunction)BMRtpReceiver_get_frame, METH_VARARGS | METH_KEYWORDS,
+     "Wait for the next reassembled frame: timeout (seconds, default 1.0). Returns (array, info dict) or None on timeout."},
+    {"get_stats", (PyCFunction)BMRtpReceiver_get_stats, METH_NOARGS,
+     "Get loss and jitter statistics as a dict."},
+    {"close", (PyCFunction)BMRtpReceiver_close, METH_NOARGS,
+     "Stop receiving."},
+    {NULL}  /* Sentinel */
+};
+
+// Type definition for RtpReceiver
+static PyTypeObject BMRtpReceiverType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "bmcapture_c.RtpReceiver",
+    .tp_basicsize = sizeof(BMRtpReceiverObject),
+    .tp_itemsize = 0,
+    .tp_dealloc = (destructor)BMRtpReceiver_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Receiver and frame reassembler for RTP video sent by BMChannel.start_rtp",
+    .tp_methods = BMRtpReceiver_methods,
+    .tp_init = (initproc)BMRtpReceiver_init,
+    .tp_new = PyType_GenericNew,
 };
 
 // Deallocation function for BMCapture
@@ -144,6 +311,7 @@ static void BMChannel_dealloc(BMChannelObject* self) {
         bm_destroy_channel(g_context, self->channel);
         self->channel = NULL;
     }
+    Py_CLEAR(self->owner);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
@@ -168,13 +336,34 @@ static PyObject* BMChannel_new(PyTypeObject* type, PyObject* args, PyObject* kwd
         self->channel = NULL;
         self->width = 0;
         self->height = 0;
+        self->owner = NULL;
     }
     return (PyObject*)self;
 }
 
 // Initialize the capture device
+// Set up embedded audio capture before a channel starts; 0 channels leaves it off
+static bool channel_enable_audio(BMCaptureChannel* channel, int audio_channels, int audio_depth) {
+    if (audio_channels == 0) {
+        return true;
+    }
+
+    BMAudioOptions options;
+    bm_audio_options_init(&options);
+    options.channel_count = audio_channels;
+    options.sample_depth = audio_depth;
+    if (!bm_enable_channel_audio(g_context, channel, &options)) {
+        PyErr_Format(PyExc_ValueError,
+                     "Cannot capture %d channel %d-bit audio (use 2, 8 or 16 channels of 16 or 32 bits)",
+                     audio_channels, audio_depth);
+        return false;
+    }
+    return true;
+}
+
 static int BMCapture_init(BMCaptureObject* self, PyObject* args, PyObject* kwds) {
-    static const char* const_kwlist[] = {"device_index", "width", "height", "framerate", "low_latency", "port_index", NULL};
+    static const char* const_kwlist[] = {"device_index", "width", "height", "framerate", "low_latency", "port_index",
+                                         "audio_channels", "audio_depth", NULL};
     static char** kwlist = const_cast<char**>(const_kwlist);
 
     int device_index = 0;
@@ -183,9 +372,12 @@ static int BMCapture_init(BMCaptureObject* self, PyObject* args, PyObject* kwds)
     float framerate = 30.0f;
     int low_latency = 1; // Default to low latency
     int port_index = 0;  // Default to first port
+    int audio_channels = 0;
+    int audio_depth = 16;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iiifpi", kwlist,
-                                     &device_index, &width, &height, &framerate, &low_latency, &port_index)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iiifpiii", kwlist,
+                                     &device_index, &width, &height, &framerate, &low_latency, &port_index,
+                                     &audio_channels, &audio_depth)) {
         return -1;
     }
 
@@ -214,6 +406,13 @@ static int BMCapture_init(BMCaptureObject* self, PyObject* args, PyObject* kwds)
         return -1;
     }
 
+    if (!channel_enable_audio(self->channel, audio_channels, audio_depth)) {
+        bm_destroy_device(g_context, self->device);
+        self->device = NULL;
+        self->channel = NULL;
+        return -1;
+    }
+
     // Start capture on the channel
     BMCaptureMode mode = low_latency ? BM_LOW_LATENCY : BM_NO_FRAME_DROPS;
     if (!bm_start_channel_capture(g_context, self->channel, width, height, framerate, mode)) {
@@ -235,7 +434,8 @@ static int BMCapture_init(BMCaptureObject* self, PyObject* args, PyObject* kwds)
 
 // Initialize a channel
 static int BMChannel_init(BMChannelObject* self, PyObject* args, PyObject* kwds) {
-    static const char* const_kwlist[] = {"device", "port_index", "width", "height", "framerate", "low_latency", NULL};
+    static const char* const_kwlist[] = {"device", "port_index", "width", "height", "framerate", "low_latency",
+                                         "audio_channels", "audio_depth", NULL};
     static char** kwlist = const_cast<char**>(const_kwlist);
 
     PyObject* device_obj;
@@ -244,9 +444,12 @@ static int BMChannel_init(BMChannelObject* self, PyObject* args, PyObject* kwds)
     int height = 1080;
     float framerate = 30.0f;
     int low_latency = 1;
+    int audio_channels = 0;
+    int audio_depth = 16;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oi|iifp", kwlist,
-                                     &device_obj, &port_index, &width, &height, &framerate, &low_latency)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oi|iifpii", kwlist,
+                                     &device_obj, &port_index, &width, &height, &framerate, &low_latency,
+                                     &audio_channels, &audio_depth)) {
         return -1;
     }
 
@@ -280,6 +483,12 @@ static int BMChannel_init(BMChannelObject* self, PyObject* args, PyObject* kwds)
         return -1;
     }
 
+    if (!channel_enable_audio(self->channel, audio_channels, audio_depth)) {
+        bm_destroy_channel(g_context, self->channel);
+        self->channel = NULL;
+        return -1;
+    }
+
     // Start capture on the channel
     BMCaptureMode mode = low_latency ? BM_LOW_LATENCY : BM_NO_FRAME_DROPS;
     if (!bm_start_channel_capture(g_context, self->channel, width, height, framerate, mode)) {
@@ -294,6 +503,10 @@ static int BMChannel_init(BMChannelObject* self, PyObject* args, PyObject* kwds)
     self->width = width;
     self->height = height;
 
+    // Destroying the device destroys its channels, so it must outlive this one
+    Py_INCREF(device_obj);
+    Py_XSETREF(self->owner, device_obj);
+
     return 0;
 }
 
@@ -308,6 +521,88 @@ static PyObject* BMCapture_initialize(PyObject* self, PyObject* args) {
     Py_RETURN_TRUE;
 }
 
+// Initialize the library with simulated devices instead of the DeckLink driver
+static PyObject* BMCapture_initialize_mock(PyObject* self, PyObject* args, PyObject* kwds) {
+    static const char* const_kwlist[] = {"devices", "ports", "modes", "jitter_ms", "drop_rate",
+                                         "signal_loss_rate", "signal_loss_frames",
+                                         "format_change_interval", "seed", "fallback", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+
+    BMMockOptions options;
+    bm_mock_options_init(&options);
+    PyObject* modes_obj = Py_None;
+    unsigned int seed = options.seed;
+    int fallback = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iiOdddiiIp", kwlist,
+                                     &options.device_count, &options.ports_per_device, &modes_obj,
+                                     &options.jitter_ms, &options.drop_rate, &options.signal_loss_rate,
+                                     &options.signal_loss_frames, &options.format_change_interval, &seed,
+                                     &fallback)) {
+        return NULL;
+    }
+    options.seed = seed;
+
+    // Modes are (width, height, framerate) or (width, height, frame_duration, time_scale)
+    std::vector<BMMockMode> modes;
+    if (modes_obj != Py_None) {
+        PyObject* sequence = PySequence_Fast(modes_obj, "modes must be a sequence of tuples");
+        if (sequence == NULL) {
+            return NULL;
+        }
+        Py_ssize_t count = PySequence_Fast_GET_SIZE(sequence);
+        for (Py_ssize_t i = 0; i < count; i++) {
+            PyObject* item = PySequence_Fast_GET_ITEM(sequence, i);
+            BMMockMode mode;
+            double framerate = 0.0;
+            long long frame_duration = 0;
+            long long time_scale = 0;
+            if (PyTuple_Check(item) && PyTuple_GET_SIZE(item) == 4 &&
+                PyArg_ParseTuple(item, "iiLL", &mode.width, &mode.height, &frame_duration, &time_scale)) {
+                mode.frame_duration = frame_duration;
+                mode.time_scale = time_scale;
+            } else if (!PyErr_Occurred() && PyTuple_Check(item) && PyTuple_GET_SIZE(item) == 3 &&
+                       PyArg_ParseTuple(item, "iid", &mode.width, &mode.height, &framerate)) {
+                // Same time base as replay channels use for a requested rate
+                mode.frame_duration = 1000;
+                mode.time_scale = (int64_t)floor(framerate * 1000.0 + 0.5);
+            } else {
+                Py_DECREF(sequence);
+                if (!PyErr_Occurred()) {
+                    PyErr_SetString(PyExc_TypeError,
+                                    "Each mode must be (width, height, framerate) or "
+                                    "(width, height, frame_duration, time_scale)");
+                }
+                return NULL;
+            }
+            modes.push_back(mode);
+        }
+        Py_DECREF(sequence);
+        options.modes = modes.data();
+        options.mode_count = (int)modes.size();
+    }
+
+    // Replaces the driver context the module opens on import, so this has to
+    // run before any devices or channels are created, like shutdown()
+    if (g_context != NULL) {
+        bm_free_context(g_context);
+        g_context = NULL;
+    }
+
+    // With fallback the mock devices are only used when the driver is missing
+    g_context = fallback ? bm_create_context_or_mock(&options) : bm_create_mock_context(&options);
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_ValueError, "Invalid mock device settings");
+        return NULL;
+    }
+    return PyBool_FromLong(bm_context_is_mock(g_context));
+}
+
+// Check whether the DeckLink driver is installed
+static PyObject* BMCapture_driver_available(PyObject* self, PyObject* args) {
+    return PyBool_FromLong(bm_driver_available());
+}
+
 // Shutdown the library - safely clean up resources
 static PyObject* BMCapture_shutdown(PyObject* self, PyObject* args) {
     if (g_context != NULL) {
@@ -505,42 +800,10 @@ static PyObject* BMCapture_destroy_device(PyObject* self, PyObject* args) {
     Py_RETURN_NONE;
 }
 
-// Update method - check for new frames
-static PyObject* BMCapture_update(BMCaptureObject* self, PyObject* args) {
-    if (!self->device || !self->channel) {
-        PyErr_SetString(PyExc_RuntimeError, "Device not initialized or has been closed");
-        return NULL;
-    }
-
-    if (g_context == NULL) {
-        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
-        return NULL;
-    }
-
-    bool new_frame = bm_update_channel(g_context, self->channel);
-    return PyBool_FromLong(new_frame ? 1 : 0);
-}
-
-// Get the latest frame as a NumPy array
-static PyObject* BMCapture_get_frame(BMCaptureObject* self, PyObject* args, PyObject* kwds) {
-    static const char* const_kwlist[] = {"format", NULL};
-    static char** kwlist = const_cast<char**>(const_kwlist);
-    const char* format_str = "rgb";
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|s", kwlist, &format_str)) {
-        return NULL;
-    }
-
-    if (!self->device || !self->channel) {
-        PyErr_SetString(PyExc_RuntimeError, "Device not initialized or has been closed");
-        return NULL;
-    }
-
-    if (g_context == NULL) {
-        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
-        return NULL;
-    }
-
+// Copy a channel's latest frame into `out`, or into a new array when out is
+// None. Reusing an array saves allocating and faulting in a frame per call.
+static PyObject* channel_frame_array(BMCaptureChannel* channel, int frame_width, int frame_height,
+                                     const char* format_str, PyObject* out) {
     // Determine format
     BMPixelFormat format;
     int channels;
@@ -561,49 +824,55 @@ static PyObject* BMCapture_get_frame(BMCaptureObject* self, PyObject* args, PyOb
 
     // Get dimensions
     int width, height;
-    size_t buffer_size = bm_get_channel_frame_size(g_context, self->channel, format);
+    size_t buffer_size = bm_get_channel_frame_size(g_context, channel, format);
 
     if (buffer_size == 0) {
         PyErr_SetString(PyExc_RuntimeError, "Failed to determine frame size");
         return NULL;
     }
 
-    // Create NumPy array
+    // Shape of the NumPy array
+    int ndim = channels == 1 ? 2 : 3;
     npy_intp dims[3];
     if (format == BM_FORMAT_YUV) {
         // YUV is a special case - it's 4:2:2 format, so width is halved for array shape
-        width = self->width / 2;
-        height = self->height;
-        dims[0] = height;
-        dims[1] = width;
+        dims[0] = frame_height;
+        dims[1] = frame_width / 2;
         dims[2] = 4;  // 4 bytes per 2 pixels (cb-y0-cr-y1)
     } else {
-        width = self->width;
-        height = self->height;
-        dims[0] = height;
-        dims[1] = width;
-        if (channels > 1) {
-            dims[2] = channels;
-        }
+        dims[0] = frame_height;
+        dims[1] = frame_width;
+        dims[2] = channels;
     }
 
-    // Create the NumPy array
     PyObject* array;
-    if (channels == 1) {
-        array = PyArray_SimpleNew(2, dims, NPY_UINT8);
+    if (out == Py_None) {
+        array = PyArray_SimpleNew(ndim, dims, NPY_UINT8);
+        if (!array) {
+            PyErr_SetString(PyExc_MemoryError, "Failed to allocate NumPy array");
+            return NULL;
+        }
     } else {
-        array = PyArray_SimpleNew(3, dims, NPY_UINT8);
-    }
-
-    if (!array) {
-        PyErr_SetString(PyExc_MemoryError, "Failed to allocate NumPy array");
-        return NULL;
+        PyArrayObject* out_array = (PyArrayObject*)out;
+        bool shape_matches = PyArray_Check(out) && PyArray_NDIM(out_array) == ndim;
+        for (int i = 0; shape_matches && i < ndim; i++) {
+            shape_matches = PyArray_DIM(out_array, i) == dims[i];
+        }
+        if (!shape_matches || PyArray_TYPE(out_array) != NPY_UINT8 ||
+            !PyArray_IS_C_CONTIGUOUS(out_array) || !PyArray_ISWRITEABLE(out_array) ||
+            (size_t)PyArray_NBYTES(out_array) < buffer_size) {
+            PyErr_SetString(PyExc_ValueError,
+                            "out must be a writable, C-contiguous uint8 array of the frame's shape");
+            return NULL;
+        }
+        array = out;
+        Py_INCREF(array);
     }
 
     // Get frame data into the NumPy array
     uint8_t* buffer = (uint8_t*)PyArray_DATA((PyArrayObject*)array);
 
-    if (!bm_get_channel_frame(g_context, self->channel, format, buffer, buffer_size, &width, &height, NULL)) {
+    if (!bm_get_channel_frame(g_context, channel, format, buffer, buffer_size, &width, &height, NULL)) {
         Py_DECREF(array);
         PyErr_SetString(PyExc_RuntimeError, "Failed to get frame data");
         return NULL;
@@ -612,6 +881,46 @@ static PyObject* BMCapture_get_frame(BMCaptureObject* self, PyObject* args, PyOb
     return array;
 }
 
+// Update method - check for new frames
+static PyObject* BMCapture_update(BMCaptureObject* self, PyObject* args) {
+    if (!self->device || !self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Device not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    bool new_frame = bm_update_channel(g_context, self->channel);
+    return PyBool_FromLong(new_frame ? 1 : 0);
+}
+
+// Get the latest frame as a NumPy array
+static PyObject* BMCapture_get_frame(BMCaptureObject* self, PyObject* args, PyObject* kwds) {
+    static const char* const_kwlist[] = {"format", "out", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+    const char* format_str = "rgb";
+    PyObject* out = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|sO", kwlist, &format_str, &out)) {
+        return NULL;
+    }
+
+    if (!self->device || !self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Device not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    return channel_frame_array(self->channel, self->width, self->height, format_str, out);
+}
+
 // Get the number of channels supported by the device
 static PyObject* BMCapture_get_channel_count(BMCaptureObject* self, PyObject* args) {
     if (!self->device) {
@@ -630,7 +939,8 @@ static PyObject* BMCapture_get_channel_count(BMCaptureObject* self, PyObject* ar
 
 // Create a new channel on the device
 static PyObject* BMCapture_create_channel(BMCaptureObject* self, PyObject* args, PyObject* kwds) {
-    static const char* const_kwlist[] = {"port_index", "width", "height", "framerate", "low_latency", NULL};
+    static const char* const_kwlist[] = {"port_index", "width", "height", "framerate", "low_latency",
+                                         "audio_channels", "audio_depth", NULL};
     static char** kwlist = const_cast<char**>(const_kwlist);
 
     int port_index = 0;
@@ -638,9 +948,12 @@ static PyObject* BMCapture_create_channel(BMCaptureObject* self, PyObject* args,
     int height = 1080;
     float framerate = 30.0f;
     int low_latency = 1;
+    int audio_channels = 0;
+    int audio_depth = 16;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|iifp", kwlist,
-                                    &port_index, &width, &height, &framerate, &low_latency)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|iifpii", kwlist,
+                                    &port_index, &width, &height, &framerate, &low_latency,
+                                    &audio_channels, &audio_depth)) {
         return NULL;
     }
 
@@ -652,11 +965,13 @@ static PyObject* BMCapture_create_channel(BMCaptureObject* self, PyObject* args,
     // Create a new BMChannel Python object
     PyObject* channel_type = (PyObject*)&BMChannelType;
     PyObject* arglist = Py_BuildValue("Oi", self, port_index);
-    PyObject* kwargdict = Py_BuildValue("{s:i,s:i,s:f,s:O}",
+    PyObject* kwargdict = Py_BuildValue("{s:i,s:i,s:f,s:O,s:i,s:i}",
                                        "width", width,
                                        "height", height,
                                        "framerate", framerate,
-                                       "low_latency", low_latency ? Py_True : Py_False);
+                                       "low_latency", low_latency ? Py_True : Py_False,
+                                       "audio_channels", audio_channels,
+                                       "audio_depth", audio_depth);
 
     PyObject* channel_obj = PyObject_Call(channel_type, arglist, kwargdict);
 
@@ -771,16 +1086,33 @@ static PyObject* BMChannel_set_signal_parameters(BMChannelObject* self, PyObject
     return PyBool_FromLong(success ? 1 : 0);
 }
 
-// Get frame from channel
-static PyObject* BMChannel_get_frame(BMChannelObject* self, PyObject* args, PyObject* kwds) {
-    static const char* const_kwlist[] = {"format", NULL};
-    static char** kwlist = const_cast<char**>(const_kwlist);
-    const char* format_str = "rgb";
+static PyObject* histogram_summary_dict(const BMHistogramSummary& summary) {
+    return Py_BuildValue("{s:K,s:d,s:d,s:d,s:d,s:d,s:d,s:d}",
+                         "count", (unsigned long long)summary.count,
+                         "min_us", summary.min_us,
+                         "mean_us", summary.mean_us,
+                         "max_us", summary.max_us,
+                         "p50_us", summary.p50_us,
+                         "p90_us", summary.p90_us,
+                         "p99_us", summary.p99_us,
+                         "p999_us", summary.p999_us);
+}
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|s", kwlist, &format_str)) {
-        return NULL;
-    }
+static PyObject* perf_counter_summary_dict(const BMPerfCounterSummary& summary) {
+    return Py_BuildValue("{s:K,s:K,s:d,s:d,s:d,s:d,s:d,s:d,s:d}",
+                         "frames", (unsigned long long)summary.frames,
+                         "counted_frames", (unsigned long long)summary.counted_frames,
+                         "bytes_per_frame", summary.bytes_per_frame,
+                         "cycles_per_frame", summary.cycles_per_frame,
+                         "instructions_per_frame", summary.instructions_per_frame,
+                         "llc_misses_per_frame", summary.llc_misses_per_frame,
+                         "instructions_per_cycle", summary.instructions_per_cycle,
+                         "bytes_per_cycle", summary.bytes_per_cycle,
+                         "gb_per_second", summary.gb_per_second);
+}
 
+// Get pipeline statistics
+static PyObject* BMChannel_get_stats(BMChannelObject* self, PyObject* args) {
     if (!self->channel) {
         PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
         return NULL;
@@ -791,124 +1123,1549 @@ static PyObject* BMChannel_get_frame(BMChannelObject* self, PyObject* args, PyOb
         return NULL;
     }
 
-    // Determine format
-    BMPixelFormat format;
-    int channels;
-
-    if (strcmp(format_str, "rgb") == 0) {
-        format = BM_FORMAT_RGB;
-        channels = 3;
-    } else if (strcmp(format_str, "yuv") == 0) {
-        format = BM_FORMAT_YUV;
-        channels = 2;  // 4:2:2 format, 2 bytes per pixel
-    } else if (strcmp(format_str, "gray") == 0 || strcmp(format_str, "grey") == 0) {
-        format = BM_FORMAT_GRAY;
-        channels = 1;
-    } else {
-        PyErr_SetString(PyExc_ValueError, "Invalid format. Must be 'rgb', 'yuv', or 'gray'");
+    BMChannelStats stats;
+    if (!bm_channel_get_stats(g_context, self->channel, &stats)) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to get channel statistics");
         return NULL;
     }
 
-    // Get dimensions
-    int width, height;
-    size_t buffer_size = bm_get_channel_frame_size(g_context, self->channel, format);
+    return Py_BuildValue("{s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:d,s:N,s:N,s:N,s:N,s:N,s:N}",
+                         "frames_missed", (unsigned long long)stats.frames_missed,
+                         "frames_arrived", (unsigned long long)stats.frames_arrived,
+                         "frames_no_signal", (unsigned long long)stats.frames_no_signal,
+                         "frames_dropped", (unsigned long long)stats.frames_dropped,
+                         "frames_overwritten", (unsigned long long)stats.frames_overwritten,
+                         "frames_delivered", (unsigned long long)stats.frames_delivered,
+                         "lock_timeouts", (unsigned long long)stats.lock_timeouts,
+                         "conversions", (unsigned long long)stats.conversions,
+                         "driver_queue_depth", (unsigned long long)stats.driver_queue_depth,
+                         "driver_queue_max", (unsigned long long)stats.driver_queue_max,
+                         "elapsed_seconds", stats.elapsed_seconds,
+                         "callback_time", histogram_summary_dict(stats.callback_time),
+                         "conversion_time", histogram_summary_dict(stats.conversion_time),
+                         "delivery_latency", histogram_summary_dict(stats.delivery_latency),
+                         "capture_latency", histogram_summary_dict(stats.capture_latency),
+                         "conversion_counters", perf_counter_summary_dict(stats.conversion_counters),
+                         "copy_counters", perf_counter_summary_dict(stats.copy_counters));
+}
 
-    if (buffer_size == 0) {
-        PyErr_SetString(PyExc_RuntimeError, "Failed to determine frame size");
+// Get metadata and latency of the last delivered frame
+// Names of the timecode sources in Python dicts, indexed by BMTimecodeSource
+static const char* const kTimecodeSourceNames[BM_TIMECODE_SOURCE_COUNT] = {
+    "rp188_vitc1", "rp188_ltc", "rp188_vitc2", "vitc", "vitc_field2"
+};
+
+// Add timecode, timecode_source, user_bits and the per-source timecodes dict
+// of a frame to its metadata dict; returns the dict, or NULL after an error
+static PyObject* add_frame_timecodes(PyObject* dict, const BMFrameInfo& info) {
+    if (dict == NULL) {
         return NULL;
     }
 
-    // Create NumPy array
-    npy_intp dims[3];
-    if (format == BM_FORMAT_YUV) {
-        // YUV is a special case - it's 4:2:2 format, so width is halved for array shape
-        width = self->width / 2;
-        height = self->height;
-        dims[0] = height;
-        dims[1] = width;
-        dims[2] = 4;  // 4 bytes per 2 pixels (cb-y0-cr-y1)
-    } else {
-        width = self->width;
-        height = self->height;
-        dims[0] = height;
-        dims[1] = width;
-        if (channels > 1) {
-            dims[2] = channels;
+    char text[16];
+    PyObject* timecodes = PyDict_New();
+    bool ok = timecodes != NULL;
+    for (int source = 0; ok && source < BM_TIMECODE_SOURCE_COUNT; source++) {
+        const BMTimecode& timecode = info.timecodes[source];
+        if (!bm_timecode_format(&timecode, text, sizeof(text))) {
+            continue;
         }
+        PyObject* entry = Py_BuildValue("{s:s,s:I,s:O}",
+                                        "timecode", text,
+                                        "user_bits", (unsigned int)timecode.user_bits,
+                                        "drop_frame", timecode.drop_frame ? Py_True : Py_False);
+        ok = entry != NULL && PyDict_SetItemString(timecodes, kTimecodeSourceNames[source], entry) == 0;
+        Py_XDECREF(entry);
+    }
+
+    PyObject* best = NULL;
+    PyObject* best_source = NULL;
+    PyObject* user_bits = NULL;
+    if (ok && bm_timecode_format(&info.timecode, text, sizeof(text)) &&
+        info.timecode.source < BM_TIMECODE_SOURCE_COUNT) {
+        best = PyUnicode_FromString(text);
+        best_source = PyUnicode_FromString(kTimecodeSourceNames[info.timecode.source]);
+        user_bits = PyLong_FromUnsignedLong(info.timecode.user_bits);
+        ok = best != NULL && best_source != NULL && user_bits != NULL;
+    } else if (ok) {
+        best = Py_None;
+        best_source = Py_None;
+        user_bits = Py_None;
+        Py_INCREF(best);
+        Py_INCREF(best_source);
+        Py_INCREF(user_bits);
+    }
+
+    ok = ok && PyDict_SetItemString(dict, "timecode", best) == 0 &&
+         PyDict_SetItemString(dict, "timecode_source", best_source) == 0 &&
+         PyDict_SetItemString(dict, "user_bits", user_bits) == 0 &&
+         PyDict_SetItemString(dict, "timecodes", timecodes) == 0;
+    Py_XDECREF(best);
+    Py_XDECREF(best_source);
+    Py_XDECREF(user_bits);
+    Py_XDECREF(timecodes);
+    if (!ok) {
+        Py_DECREF(dict);
+        return NULL;
     }
+    return dict;
+}
 
-    // Create the NumPy array
-    PyObject* array;
-    if (channels == 1) {
-        array = PyArray_SimpleNew(2, dims, NPY_UINT8);
-    } else {
-        array = PyArray_SimpleNew(3, dims, NPY_UINT8);
+static PyObject* BMChannel_get_frame_info(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
     }
 
-    if (!array) {
-        PyErr_SetString(PyExc_MemoryError, "Failed to allocate NumPy array");
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
         return NULL;
     }
 
-    // Get frame data into the NumPy array
-    uint8_t* buffer = (uint8_t*)PyArray_DATA((PyArrayObject*)array);
-
-    if (!bm_get_channel_frame(g_context, self->channel, format, buffer, buffer_size, &width, &height, NULL)) {
-        Py_DECREF(array);
-        PyErr_SetString(PyExc_RuntimeError, "Failed to get frame data");
-        return NULL;
+    BMFrameInfo info;
+    BMFrameLatency latency;
+    if (!bm_channel_get_frame_info(g_context, self->channel, &info, &latency)) {
+        Py_RETURN_NONE;
     }
 
-    return array;
+    PyObject* dict = Py_BuildValue("{s:K,s:L,s:L,s:L,s:I,s:d,s:d,s:d,s:d,s:d,s:d}",
+                                   "sequence", (unsigned long long)info.sequence,
+                                   "stream_time", (long long)info.stream_time,
+                                   "frame_duration", (long long)info.frame_duration,
+                                   "hardware_timestamp", (long long)info.hardware_timestamp,
+                                   "flags", (unsigned int)info.flags,
+                                   "capture_to_callback_us", latency.capture_to_callback_us,
+                                   "callback_us", latency.callback_us,
+                                   "queue_us", latency.queue_us,
+                                   "conversion_us", latency.conversion_us,
+                                   "delivery_us", latency.delivery_us,
+                                   "total_us", latency.total_us);
+    return add_frame_timecodes(dict, info);
 }
 
-// Close a channel
-static PyObject* BMChannel_close(BMChannelObject* self, PyObject* args) {
-    if (self->channel && g_context) {
-        bm_stop_channel_capture(g_context, self->channel);
-        bm_destroy_channel(g_context, self->channel);
-        self->channel = NULL;
+// Reset pipeline statistics
+static PyObject* BMChannel_reset_stats(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
     }
 
+    bm_channel_reset_stats(g_context, self->channel);
     Py_RETURN_NONE;
 }
 
+// Turn hardware performance counters on or off
+static PyObject* BMChannel_enable_perf_counters(BMChannelObject* self, PyObject* args, PyObject* kwds) {
+    int enable = 1;
 
-// Module-level methods
-static PyMethodDef module_methods[] = {
-    {"initialize", (PyCFunction)BMCapture_initialize, METH_NOARGS,
-     "Initialize the BlackMagic capture library."},
-    {"shutdown", (PyCFunction)BMCapture_shutdown, METH_NOARGS,
-     "Shutdown the BlackMagic capture library."},
-    {"get_device_count", (PyCFunction)BMCapture_get_device_count, METH_NOARGS,
-     "Get number of available BlackMagic devices."},
-    {"get_device_name", (PyCFunction)BMCapture_get_device_name, METH_VARARGS,
-     "Get name of a BlackMagic device by index."},
-    {"get_devices", (PyCFunction)BMCapture_get_devices, METH_NOARGS,
-     "Get a list of available BlackMagic devices."},
-    {"get_input_ports", (PyCFunction)BMCapture_get_input_ports, METH_VARARGS,
-     "Get a list of input ports for a BlackMagic device."},
-    {"create_device", (PyCFunction)BMCapture_create_device, METH_VARARGS,
-     "Create a BlackMagic device instance."},
-    {"select_input_port", (PyCFunction)BMCapture_select_input_port, METH_VARARGS,
-     "Select an input port for a BlackMagic device."},
-    {"destroy_device", (PyCFunction)BMCapture_destroy_device, METH_VARARGS,
-     "Destroy a BlackMagic device instance."},
-    {NULL}  /* Sentinel */
-};
+    static const char* const_kwlist[] = {"enable", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
 
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &enable)) {
+        return NULL;
+    }
 
-// Module definition
-static struct PyModuleDef bmcapture_module = {
-    PyModuleDef_HEAD_INIT,
-    "bmcapture_c",
-    "Python C API interface for BlackMagic capture devices",
-    -1,
-    module_methods
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    bool available = bm_channel_enable_perf_counters(g_context, self->channel, enable != 0);
+    return PyBool_FromLong(available ? 1 : 0);
+}
+
+// Get frame from channel
+static PyObject* BMChannel_get_frame(BMChannelObject* self, PyObject* args, PyObject* kwds) {
+    static const char* const_kwlist[] = {"format", "out", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+    const char* format_str = "rgb";
+    PyObject* out = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|sO", kwlist, &format_str, &out)) {
+        return NULL;
+    }
+
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    return channel_frame_array(self->channel, self->width, self->height, format_str, out);
+}
+
+// Start a native recording on the channel
+static PyObject* BMChannel_start_recording(BMChannelObject* self, PyObject* args, PyObject* kwds) {
+    static const char* const_kwlist[] = {"path", "queue_depth", "preallocate_bytes", "direct_io", "format",
+                                         "compression", "compression_threads", "segment_seconds",
+                                         "retain_bytes", "retain_seconds", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+
+    BMRecordingOptions options;
+    bm_recording_options_init(&options);
+
+    const char* path = NULL;
+    unsigned long long preallocate_bytes = options.preallocate_bytes;
+    int direct_io = options.direct_io ? 1 : 0;
+    const char* format_str = "raw";
+    const char* compression_str = "none";
+    unsigned long long retain_bytes = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|iKpssidKd", kwlist,
+                                    &path, &options.queue_depth, &preallocate_bytes, &direct_io, &format_str,
+                                    &compression_str, &options.compression_threads, &options.segment_seconds,
+                                    &retain_bytes, &options.retain_seconds)) {
+        return NULL;
+    }
+
+    if (strcmp(compression_str, "none") == 0) {
+        options.compression = BM_COMPRESSION_NONE;
+    } else if (strcmp(compression_str, "lossless") == 0) {
+        options.compression = BM_COMPRESSION_LOSSLESS;
+    } else {
+        PyErr_SetString(PyExc_ValueError, "Invalid compression. Must be 'none' or 'lossless'");
+        return NULL;
+    }
+
+    if (strcmp(format_str, "raw") == 0) {
+        options.format = BM_RECORDING_RAW;
+    } else if (strcmp(format_str, "container") == 0) {
+        options.format = BM_RECORDING_CONTAINER;
+    } else if (strcmp(format_str, "matroska") == 0) {
+        options.format = BM_RECORDING_MATROSKA;
+    } else {
+        PyErr_SetString(PyExc_ValueError, "Invalid format. Must be 'raw', 'container' or 'matroska'");
+        return NULL;
+    }
+
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    options.preallocate_bytes = preallocate_bytes;
+    options.direct_io = direct_io != 0;
+    options.retain_bytes = retain_bytes;
+
+    if (!bm_channel_start_recording(g_context, self->channel, path, &options)) {
+        PyErr_Format(PyExc_RuntimeError, "Failed to start recording to %s", path);
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+// Stop the native recording on the channel
+static PyObject* BMChannel_stop_recording(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    // Draining the writer queue can take a while; let other threads run
+    Py_BEGIN_ALLOW_THREADS
+    bm_channel_stop_recording(g_context, self->channel);
+    Py_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+// Get recording statistics
+static PyObject* BMChannel_get_recording_stats(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    BMRecordingStats stats;
+    if (!bm_channel_get_recording_stats(g_context, self->channel, &stats)) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to get recording statistics");
+        return NULL;
+    }
+
+    return Py_BuildValue("{s:O,s:O,s:K,s:K,s:K,s:i,s:i,s:d,s:d,s:d,s:K,s:K,s:d,s:i,s:K,s:i}",
+                         "active", stats.active ? Py_True : Py_False,
+                         "direct_io", stats.direct_io ? Py_True : Py_False,
+                         "frames_written", (unsigned long long)stats.frames_written,
+                         "frames_dropped", (unsigned long long)stats.frames_dropped,
+                         "bytes_written", (unsigned long long)stats.bytes_written,
+                         "queue_length", stats.queue_length,
+                         "queue_high_water", stats.queue_high_water,
+                         "max_write_ms", stats.max_write_ms,
+                         "max_encode_ms", stats.max_encode_ms,
+                         "compression_ratio", stats.compression_ratio,
+                         "segments_completed", (unsigned long long)stats.segments_completed,
+                         "segments_deleted", (unsigned long long)stats.segments_deleted,
+                         "max_segment_switch_ms", stats.max_segment_switch_ms,
+                         "audio_channels", stats.audio_channels,
+                         "audio_silence_frames", (unsigned long long)stats.audio_silence_frames,
+                         "last_error", stats.last_error);
+}
+
+// Start streaming frames to a file descriptor
+static PyObject* BMChannel_start_stream(BMChannelObject* self, PyObject* args, PyObject* kwds) {
+    static const char* const_kwlist[] = {"fd", "format", "overflow", "queue_depth", "zero_copy", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+
+    BMStreamOptions options;
+    bm_stream_options_init(&options);
+
+    PyObject* fd_obj;
+    const char* format_str = "y4m";
+    const char* overflow_str = "drop";
+    int zero_copy = options.zero_copy ? 1 : 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|ssip", kwlist,
+                                    &fd_obj, &format_str, &overflow_str, &options.queue_depth, &zero_copy)) {
+        return NULL;
+    }
+
+    // Accepts an integer descriptor or any object with fileno(), e.g. sys.stdout
+    int fd = PyObject_AsFileDescriptor(fd_obj);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (strcmp(format_str, "y4m") == 0) {
+        options.format = BM_STREAM_Y4M;
+    } else if (strcmp(format_str, "raw") == 0) {
+        options.format = BM_STREAM_RAW;
+    } else {
+        PyErr_SetString(PyExc_ValueError, "Invalid format. Must be 'y4m' or 'raw'");
+        return NULL;
+    }
+
+    if (strcmp(overflow_str, "drop") == 0) {
+        options.overflow = BM_STREAM_DROP;
+    } else if (strcmp(overflow_str, "block") == 0) {
+        options.overflow = BM_STREAM_BLOCK;
+    } else {
+        PyErr_SetString(PyExc_ValueError, "Invalid overflow. Must be 'drop' or 'block'");
+        return NULL;
+    }
+
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    options.zero_copy = zero_copy != 0;
+
+    bool ok;
+    // Stops any previous stream, which may wait for its reader
+    Py_BEGIN_ALLOW_THREADS
+    ok = bm_channel_start_stream(g_context, self->channel, fd, &options);
+    Py_END_ALLOW_THREADS
+
+    if (!ok) {
+        PyErr_Format(PyExc_RuntimeError, "Failed to start stream on descriptor %d", fd);
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+// Stop streaming
+static PyObject* BMChannel_stop_stream(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    // Draining the queue waits for the reader
+    Py_BEGIN_ALLOW_THREADS
+    bm_channel_stop_stream(g_context, self->channel);
+    Py_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+// Get streaming statistics
+static PyObject* BMChannel_get_stream_stats(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    BMStreamStats stats;
+    if (!bm_channel_get_stream_stats(g_context, self->channel, &stats)) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to get stream statistics");
+        return NULL;
+    }
+
+    return Py_BuildValue("{s:O,s:O,s:K,s:K,s:K,s:i,s:i,s:d,s:d,s:i}",
+                         "active", stats.active ? Py_True : Py_False,
+                         "zero_copy", stats.zero_copy ? Py_True : Py_False,
+                         "frames_written", (unsigned long long)stats.frames_written,
+                         "frames_dropped", (unsigned long long)stats.frames_dropped,
+                         "bytes_written", (unsigned long long)stats.bytes_written,
+                         "queue_length", stats.queue_length,
+                         "queue_high_water", stats.queue_high_water,
+                         "max_write_ms", stats.max_write_ms,
+                         "blocked_ms", stats.blocked_ms,
+                         "last_error", stats.last_error);
+}
+
+// Start sharing frames over a Unix socket
+static PyObject* BMChannel_start_server(BMChannelObject* self, PyObject* args, PyObject* kwds) {
+    static const char* const_kwlist[] = {"path", "slot_count", "max_clients", "max_leases", "lease_ms", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+
+    BMServerOptions options;
+    bm_server_options_init(&options);
+
+    const char* path;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|iiii", kwlist,
+                                    &path, &options.slot_count, &options.max_clients,
+                                    &options.max_leases, &options.lease_ms)) {
+        return NULL;
+    }
+
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    bool ok;
+    // Creating the arena touches every slot
+    Py_BEGIN_ALLOW_THREADS
+    ok = bm_channel_start_server(g_context, self->channel, path, &options);
+    Py_END_ALLOW_THREADS
+
+    if (!ok) {
+        PyErr_Format(PyExc_RuntimeError, "Failed to start frame server on %s", path);
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+// Stop the frame server
+static PyObject* BMChannel_stop_server(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    bm_channel_stop_server(g_context, self->channel);
+    Py_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+// Get frame server statistics
+static PyObject* BMChannel_get_server_stats(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    BMServerStats stats;
+    if (!bm_channel_get_server_stats(g_context, self->channel, &stats)) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to get frame server statistics");
+        return NULL;
+    }
+
+    return Py_BuildValue("{s:O,s:i,s:i,s:K,s:K,s:K,s:K,s:K}",
+                         "active", stats.active ? Py_True : Py_False,
+                         "clients", stats.clients,
+                         "slots_in_use", stats.slots_in_use,
+                         "clients_accepted", (unsigned long long)stats.clients_accepted,
+                         "frames_published", (unsigned long long)stats.frames_published,
+                         "frames_unshared", (unsigned long long)stats.frames_unshared,
+                         "frames_skipped", (unsigned long long)stats.frames_skipped,
+                         "leases_expired", (unsigned long long)stats.leases_expired);
+}
+
+// Start sending RTP video
+static PyObject* BMChannel_start_rtp(BMChannelObject* self, PyObject* args, PyObject* kwds) {
+    static const char* const_kwlist[] = {"host", "port", "payload_type", "packet_size", "paced", "gso",
+                                         "queue_depth", "ttl", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+
+    BMRtpOptions options;
+    bm_rtp_options_init(&options);
+
+    const char* host;
+    int port;
+    int paced = options.paced ? 1 : 0;
+    int gso = options.segmentation_offload ? 1 : 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "si|iippii", kwlist,
+                                    &host, &port, &options.payload_type, &options.packet_size,
+                                    &paced, &gso, &options.queue_depth, &options.multicast_ttl)) {
+        return NULL;
+    }
+
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    options.paced = paced != 0;
+    options.segmentation_offload = gso != 0;
+
+    bool ok;
+    // Resolving the host may block
+    Py_BEGIN_ALLOW_THREADS
+    ok = bm_channel_start_rtp(g_context, self->channel, host, port, &options);
+    Py_END_ALLOW_THREADS
+
+    if (!ok) {
+        PyErr_Format(PyExc_RuntimeError, "Failed to start RTP output to %s:%d", host, port);
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+// Stop sending RTP video
+static PyObject* BMChannel_stop_rtp(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    // Waits for the frame being sent
+    Py_BEGIN_ALLOW_THREADS
+    bm_channel_stop_rtp(g_context, self->channel);
+    Py_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+// Get RTP sender statistics
+static PyObject* BMChannel_get_rtp_stats(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    BMRtpStats stats;
+    if (!bm_channel_get_rtp_stats(g_context, self->channel, &stats)) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to get RTP statistics");
+        return NULL;
+    }
+
+    return Py_BuildValue("{s:O,s:O,s:K,s:K,s:K,s:K,s:K,s:i}",
+                         "active", stats.active ? Py_True : Py_False,
+                         "gso", stats.segmentation_offload ? Py_True : Py_False,
+                         "frames_sent", (unsigned long long)stats.frames_sent,
+                         "frames_dropped", (unsigned long long)stats.frames_dropped,
+                         "frames_late", (unsigned long long)stats.frames_late,
+                         "packets_sent", (unsigned long long)stats.packets_sent,
+                         "bytes_sent", (unsigned long long)stats.bytes_sent,
+                         "last_error", stats.last_error);
+}
+
+// Enable the pre-trigger ring buffer
+static PyObject* BMChannel_enable_pretrigger(BMChannelObject* self, PyObject* args, PyObject* kwds) {
+    static const char* const_kwlist[] = {"pre_seconds", "post_seconds", "memory_limit", "signal_loss_prefix", "direct_io", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+
+    BMPreTriggerOptions options;
+    bm_pretrigger_options_init(&options);
+
+    unsigned long long memory_limit = 0;
+    int direct_io = options.recording.direct_io ? 1 : 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|ddKzp", kwlist,
+                                    &options.pre_seconds, &options.post_seconds, &memory_limit,
+                                    &options.signal_loss_prefix, &direct_io)) {
+        return NULL;
+    }
+
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    options.memory_limit = memory_limit;
+    options.recording.direct_io = direct_io != 0;
+
+    bool ok;
+    // Allocating and touching the ring buffers can take a while
+    Py_BEGIN_ALLOW_THREADS
+    ok = bm_channel_enable_pretrigger(g_context, self->channel, &options);
+    Py_END_ALLOW_THREADS
+
+    if (!ok) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to enable pre-trigger buffer");
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+// Disable the pre-trigger ring buffer
+static PyObject* BMChannel_disable_pretrigger(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    // Waits for a running dump to reach disk
+    Py_BEGIN_ALLOW_THREADS
+    bm_channel_disable_pretrigger(g_context, self->channel);
+    Py_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+// Dump the pre-trigger ring to disk
+static PyObject* BMChannel_trigger_dump(BMChannelObject* self, PyObject* args, PyObject* kwds) {
+    static const char* const_kwlist[] = {"path", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+
+    const char* path = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|z", kwlist, &path)) {
+        return NULL;
+    }
+
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    if (bm_channel_trigger_dump(g_context, self->channel, path)) {
+        Py_RETURN_TRUE;
+    }
+    Py_RETURN_FALSE;
+}
+
+// Get pre-trigger statistics
+static PyObject* BMChannel_get_pretrigger_stats(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    BMPreTriggerStats stats;
+    if (!bm_channel_get_pretrigger_stats(g_context, self->channel, &stats)) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to get pre-trigger statistics");
+        return NULL;
+    }
+
+    return Py_BuildValue("{s:O,s:O,s:i,s:i,s:d,s:K,s:K,s:K,s:K,s:K,s:d,s:d,s:i}",
+                         "enabled", stats.enabled ? Py_True : Py_False,
+                         "dumping", stats.dumping ? Py_True : Py_False,
+                         "ring_capacity", stats.ring_capacity,
+                         "ring_frames", stats.ring_frames,
+                         "ring_seconds", stats.ring_seconds,
+                         "memory_bytes", (unsigned long long)stats.memory_bytes,
+                         "dumps_completed", (unsigned long long)stats.dumps_completed,
+                         "frames_dumped", (unsigned long long)stats.frames_dumped,
+                         "frames_dropped", (unsigned long long)stats.frames_dropped,
+                         "bytes_dumped", (unsigned long long)stats.bytes_dumped,
+                         "last_dump_seconds", stats.last_dump_seconds,
+                         "last_dump_mb_per_s", stats.last_dump_mb_per_s,
+                         "last_error", stats.last_error);
+}
+
+// Copy the embedded audio of the last delivered frame into a new array. The
+// ring keeps being overwritten, so Python gets a copy rather than a view.
+static PyObject* BMChannel_get_audio(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    BMAudioStats stats;
+    if (!bm_channel_get_audio_stats(g_context, self->channel, &stats) || !stats.enabled) {
+        PyErr_SetString(PyExc_RuntimeError, "Audio capture is not enabled on this channel");
+        return NULL;
+    }
+
+    BMAudioView view;
+    if (!bm_get_channel_audio_view(g_context, self->channel, NULL, &view)) {
+        Py_RETURN_NONE;
+    }
+
+    npy_intp dims[2] = {(npy_intp)view.frame_count, (npy_intp)view.channel_count};
+    PyObject* array = PyArray_SimpleNew(2, dims, view.sample_depth == 32 ? NPY_INT32 : NPY_INT16);
+    if (!array) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to allocate NumPy array");
+        return NULL;
+    }
+
+    size_t frame_bytes = (size_t)view.channel_count * (view.sample_depth / 8);
+    uint8_t* out = (uint8_t*)PyArray_DATA((PyArrayObject*)array);
+    if (view.frames[0] > 0) {
+        memcpy(out, view.data[0], view.frames[0] * frame_bytes);
+    }
+    if (view.frames[1] > 0) {
+        memcpy(out + view.frames[0] * frame_bytes, view.data[1], view.frames[1] * frame_bytes);
+    }
+    if (!bm_channel_audio_view_valid(g_context, self->channel, &view)) {
+        Py_DECREF(array);
+        Py_RETURN_NONE;     // Overwritten while copying
+    }
+
+    return array;
+}
+
+// Get embedded audio statistics
+static PyObject* BMChannel_get_audio_stats(BMChannelObject* self, PyObject* args) {
+    if (!self->channel) {
+        PyErr_SetString(PyExc_RuntimeError, "Channel not initialized or has been closed");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    BMAudioStats stats;
+    if (!bm_channel_get_audio_stats(g_context, self->channel, &stats)) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to get audio statistics");
+        return NULL;
+    }
+
+    return Py_BuildValue("{s:O,s:i,s:i,s:I,s:K,s:K,s:K,s:K,s:K,s:K,s:L}",
+                         "enabled", stats.enabled ? Py_True : Py_False,
+                         "channel_count", stats.channel_count,
+                         "sample_depth", stats.sample_depth,
+                         "buffer_frames", (unsigned int)stats.buffer_frames,
+                         "packets", (unsigned long long)stats.packets,
+                         "sample_frames", (unsigned long long)stats.sample_frames,
+                         "silence_frames", (unsigned long long)stats.silence_frames,
+                         "discontinuities", (unsigned long long)stats.discontinuities,
+                         "reads_expired", (unsigned long long)stats.reads_expired,
+                         "reads_pending", (unsigned long long)stats.reads_pending,
+                         "write_position", (long long)stats.write_position);
+}
+
+// Close a channel
+static PyObject* BMChannel_close(BMChannelObject* self, PyObject* args) {
+    if (self->channel && g_context) {
+        bm_stop_channel_capture(g_context, self->channel);
+        bm_destroy_channel(g_context, self->channel);
+        self->channel = NULL;
+    }
+    Py_CLEAR(self->owner);
+
+    Py_RETURN_NONE;
+}
+
+// RawFile methods
+
+// Open a raw capture container
+static int BMRawFile_init(BMRawFileObject* self, PyObject* args, PyObject* kwds) {
+    static const char* const_kwlist[] = {"path", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+    const char* path = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &path)) {
+        return -1;
+    }
+
+    if (self->file) {
+        bm_raw_file_close(self->file);
+        self->file = NULL;
+    }
+    self->closed = 0;
+
+    self->file = bm_raw_file_open(path);
+    if (self->file == NULL) {
+        PyErr_Format(PyExc_IOError, "Failed to open raw capture container %s", path);
+        return -1;
+    }
+
+    bm_raw_file_get_info(self->file, &self->info);
+    return 0;
+}
+
+static void BMRawFile_dealloc(BMRawFileObject* self) {
+    if (self->file) {
+        bm_raw_file_close(self->file);
+        self->file = NULL;
+    }
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static Py_ssize_t BMRawFile_len(BMRawFileObject* self) {
+    return (self->file && !self->closed) ? (Py_ssize_t)self->info.frame_count : 0;
+}
+
+// Get a frame as a NumPy view onto the mapping
+static PyObject* BMRawFile_get_frame(BMRawFileObject* self, PyObject* args) {
+    long long index;
+
+    if (!PyArg_ParseTuple(args, "L", &index)) {
+        return NULL;
+    }
+
+    if (!self->file || self->closed) {
+        PyErr_SetString(PyExc_RuntimeError, "RawFile has been closed");
+        return NULL;
+    }
+
+    size_t size = 0;
+    const uint8_t* data = NULL;
+    PyObject* owner = (PyObject*)self;
+
+    if (self->info.compressed) {
+        if (index < 0 || index >= self->info.frame_count) {
+            PyErr_Format(PyExc_IndexError, "Frame %lld out of range", index);
+            return NULL;
+        }
+
+        // Decoded frames get their own array. The GIL stays held, since
+        // decoding uses the file's codec and calls on one file must not overlap
+        npy_intp decoded_dims[2] = {self->info.height, self->info.row_bytes};
+        owner = PyArray_SimpleNew(2, decoded_dims, NPY_UINT8);
+        if (!owner) {
+            return NULL;
+        }
+        size = (size_t)self->info.height * self->info.row_bytes;
+        if (!bm_raw_file_read_frame(self->file, index, (uint8_t*)PyArray_DATA((PyArrayObject*)owner), size, NULL)) {
+            Py_DECREF(owner);
+            PyErr_Format(PyExc_RuntimeError, "Frame %lld could not be decoded", index);
+            return NULL;
+        }
+        data = (const uint8_t*)PyArray_DATA((PyArrayObject*)owner);
+    } else {
+        data = bm_raw_file_get_frame(self->file, index, &size, NULL);
+        if (data == NULL) {
+            PyErr_Format(PyExc_IndexError, "Frame %lld out of range", index);
+            return NULL;
+        }
+        Py_INCREF(owner);
+    }
+
+    npy_intp dims[3];
+    npy_intp strides[3];
+    int nd;
+    if (self->info.pixel_format == 0x32767579 /* '2vuy' */) {
+        // Same shape as get_frame(format='yuv'): 4 bytes per 2 pixels (cb-y0-cr-y1)
+        nd = 3;
+        dims[0] = self->info.height;
+        dims[1] = self->info.width / 2;
+        dims[2] = 4;
+        strides[0] = self->info.row_bytes;
+        strides[1] = 4;
+        strides[2] = 1;
+    } else {
+        // Other packings (e.g. v210) are returned as raw rows of bytes
+        nd = 2;
+        dims[0] = self->info.height;
+        dims[1] = self->info.row_bytes;
+        strides[0] = self->info.row_bytes;
+        strides[1] = 1;
+    }
+
+    if ((size_t)(dims[0] * strides[0]) > size) {
+        Py_DECREF(owner);
+        PyErr_SetString(PyExc_RuntimeError, "Frame is smaller than its declared format");
+        return NULL;
+    }
+
+    // Read-only view; the array keeps this RawFile (and so the mapping), or
+    // the decoded frame, alive
+    PyObject* array = PyArray_New(&PyArray_Type, nd, dims, NPY_UINT8, strides,
+                                  (void*)data, 0, NPY_ARRAY_ALIGNED, NULL);
+    if (!array) {
+        Py_DECREF(owner);
+        return NULL;
+    }
+
+    if (PyArray_SetBaseObject((PyArrayObject*)array, owner) < 0) {
+        Py_DECREF(array);
+        return NULL;
+    }
+
+    return array;
+}
+
+// Get frame metadata as a dict
+static PyObject* BMRawFile_get_frame_info(BMRawFileObject* self, PyObject* args) {
+    long long index;
+
+    if (!PyArg_ParseTuple(args, "L", &index)) {
+        return NULL;
+    }
+
+    if (!self->file || self->closed) {
+        PyErr_SetString(PyExc_RuntimeError, "RawFile has been closed");
+        return NULL;
+    }
+
+    BMFrameInfo info;
+    if (bm_raw_file_get_frame(self->file, index, NULL, &info) == NULL) {
+        PyErr_Format(PyExc_IndexError, "Frame %lld out of range", index);
+        return NULL;
+    }
+
+    PyObject* dict = Py_BuildValue("{s:K,s:L,s:L,s:L,s:I}",
+                                   "sequence", (unsigned long long)info.sequence,
+                                   "stream_time", (long long)info.stream_time,
+                                   "frame_duration", (long long)info.frame_duration,
+                                   "hardware_timestamp", (long long)info.hardware_timestamp,
+                                   "flags", (unsigned int)info.flags);
+    return add_frame_timecodes(dict, info);
+}
+
+// Find the frame at a stream time
+static PyObject* BMRawFile_find_frame(BMRawFileObject* self, PyObject* args) {
+    long long stream_time;
+
+    if (!PyArg_ParseTuple(args, "L", &stream_time)) {
+        return NULL;
+    }
+
+    if (!self->file || self->closed) {
+        PyErr_SetString(PyExc_RuntimeError, "RawFile has been closed");
+        return NULL;
+    }
+
+    return PyLong_FromLongLong(bm_raw_file_find_frame(self->file, stream_time));
+}
+
+// Get the container format
+static PyObject* BMRawFile_get_info(BMRawFileObject* self, PyObject* args) {
+    if (!self->file || self->closed) {
+        PyErr_SetString(PyExc_RuntimeError, "RawFile has been closed");
+        return NULL;
+    }
+
+    char fourcc[5];
+    for (int i = 0; i < 4; i++) {
+        fourcc[i] = (char)((self->info.pixel_format >> (24 - 8 * i)) & 0xff);
+    }
+    fourcc[4] = '\0';
+
+    return Py_BuildValue("{s:i,s:i,s:i,s:s,s:L,s:L,s:L,s:O,s:O}",
+                         "width", self->info.width,
+                         "height", self->info.height,
+                         "row_bytes", self->info.row_bytes,
+                         "pixel_format", fourcc,
+                         "time_scale", (long long)self->info.time_scale,
+                         "frame_duration", (long long)self->info.frame_duration,
+                         "frame_count", (long long)self->info.frame_count,
+                         "indexed", self->info.indexed ? Py_True : Py_False,
+                         "compressed", self->info.compressed ? Py_True : Py_False);
+}
+
+// Close the container
+static PyObject* BMRawFile_close(BMRawFileObject* self, PyObject* args) {
+    // Arrays from get_frame hold a reference to self, so the mapping is
+    // only released in dealloc, once none of them are alive
+    self->closed = 1;
+
+    Py_RETURN_NONE;
+}
+
+// RtpReceiver methods
+
+// Open an RTP receiver
+static int BMRtpReceiver_init(BMRtpReceiverObject* self, PyObject* args, PyObject* kwds) {
+    static const char* const_kwlist[] = {"port", "width", "height", "address", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+    int port;
+    int width = 1920;
+    int height = 1080;
+    const char* address = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|iiz", kwlist, &port, &width, &height, &address)) {
+        return -1;
+    }
+
+    if (self->receiver) {
+        bm_rtp_receiver_close(self->receiver);
+        self->receiver = NULL;
+    }
+
+    self->receiver = bm_rtp_receiver_open(address, port, width, height);
+    if (self->receiver == NULL) {
+        PyErr_Format(PyExc_IOError, "Failed to receive RTP on port %d", port);
+        return -1;
+    }
+
+    self->width = width;
+    self->height = height;
+    return 0;
+}
+
+static void BMRtpReceiver_dealloc(BMRtpReceiverObject* self) {
+    if (self->receiver) {
+        BMRtpReceiver* receiver = self->receiver;
+        self->receiver = NULL;
+        // Joins the receiver thread
+        Py_BEGIN_ALLOW_THREADS
+        bm_rtp_receiver_close(receiver);
+        Py_END_ALLOW_THREADS
+    }
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+// Wait for a reassembled frame
+static PyObject* BMRtpReceiver_get_frame(BMRtpReceiverObject* self, PyObject* args, PyObject* kwds) {
+    static const char* const_kwlist[] = {"timeout", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+    double timeout = 1.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|d", kwlist, &timeout)) {
+        return NULL;
+    }
+
+    if (!self->receiver) {
+        PyErr_SetString(PyExc_RuntimeError, "RtpReceiver has been closed");
+        return NULL;
+    }
+
+    // Same shape as get_frame(format='yuv'): 4 bytes per 2 pixels (cb-y0-cr-y1)
+    npy_intp dims[3] = {self->height, self->width / 2, 4};
+    PyObject* array = PyArray_SimpleNew(3, dims, NPY_UINT8);
+    if (!array) {
+        return NULL;
+    }
+
+    size_t size = (size_t)self->width * 2 * self->height;
+    uint8_t* buffer = (uint8_t*)PyArray_DATA((PyArrayObject*)array);
+    int timeout_ms = timeout < 0 ? -1 : (int)(timeout * 1000);
+    BMRtpFrameInfo info;
+    bool ok;
+
+    Py_BEGIN_ALLOW_THREADS
+    ok = bm_rtp_receiver_get_frame(self->receiver, buffer, size, timeout_ms, &info);
+    Py_END_ALLOW_THREADS
+
+    if (!ok) {
+        Py_DECREF(array);
+        Py_RETURN_NONE;
+    }
+
+    return Py_BuildValue("(N{s:K,s:k,s:O,s:i})", array,
+                         "frame_number", (unsigned long long)info.frame_number,
+                         "rtp_timestamp", (unsigned long)info.rtp_timestamp,
+                         "complete", info.complete ? Py_True : Py_False,
+                         "packets_lost", info.packets_lost);
+}
+
+// Get receiver statistics
+static PyObject* BMRtpReceiver_get_stats(BMRtpReceiverObject* self, PyObject* args) {
+    if (!self->receiver) {
+        PyErr_SetString(PyExc_RuntimeError, "RtpReceiver has been closed");
+        return NULL;
+    }
+
+    BMRtpReceiverStats stats;
+    if (!bm_rtp_receiver_get_stats(self->receiver, &stats)) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to get RTP receiver statistics");
+        return NULL;
+    }
+
+    return Py_BuildValue("{s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:d}",
+                         "frames_received", (unsigned long long)stats.frames_received,
+                         "frames_incomplete", (unsigned long long)stats.frames_incomplete,
+                         "frames_dropped", (unsigned long long)stats.frames_dropped,
+                         "packets_received", (unsigned long long)stats.packets_received,
+                         "packets_lost", (unsigned long long)stats.packets_lost,
+                         "packets_reordered", (unsigned long long)stats.packets_reordered,
+                         "bytes_received", (unsigned long long)stats.bytes_received,
+                         "jitter_ms", stats.jitter_ms);
+}
+
+static PyObject* BMRtpReceiver_close(BMRtpReceiverObject* self, PyObject* args) {
+    if (self->receiver) {
+        BMRtpReceiver* receiver = self->receiver;
+        self->receiver = NULL;
+        Py_BEGIN_ALLOW_THREADS
+        bm_rtp_receiver_close(receiver);
+        Py_END_ALLOW_THREADS
+    }
+
+    Py_RETURN_NONE;
+}
+
+// Open a replay channel
+static PyObject* BMCapture_open_replay(PyObject* self, PyObject* args, PyObject* kwds) {
+    static const char* const_kwlist[] = {"path", "width", "height", "framerate", "low_latency",
+                                         "pacing", "speed", "loop", "latency_probe", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+
+    const char* path = NULL;
+    int width = 1920;
+    int height = 1080;
+    float framerate = 30.0f;
+    int low_latency = 1;
+    const char* pacing = "realtime";
+    double speed = 1.0;
+    int loop = 1;
+    int latency_probe = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|ziifpsdpp", kwlist,
+                                     &path, &width, &height, &framerate, &low_latency,
+                                     &pacing, &speed, &loop, &latency_probe)) {
+        return NULL;
+    }
+
+    BMReplayOptions options;
+    bm_replay_options_init(&options);
+    options.speed = speed;
+    options.loop = loop != 0;
+    options.latency_probe = latency_probe != 0;
+    if (strcmp(pacing, "realtime") == 0) {
+        options.pacing = BM_REPLAY_REALTIME;
+    } else if (strcmp(pacing, "fast") == 0) {
+        options.pacing = BM_REPLAY_AS_FAST_AS_POSSIBLE;
+    } else if (strcmp(pacing, "scaled") == 0) {
+        options.pacing = BM_REPLAY_SCALED;
+    } else {
+        PyErr_SetString(PyExc_ValueError, "pacing must be 'realtime', 'fast' or 'scaled'");
+        return NULL;
+    }
+
+    if (g_context == NULL) {
+        g_context = bm_create_context();
+        if (g_context == NULL) {
+            PyErr_SetString(PyExc_RuntimeError, "Failed to create BlackMagic context");
+            return NULL;
+        }
+    }
+
+    BMChannelObject* channel_obj = (BMChannelObject*)BMChannel_new(&BMChannelType, NULL, NULL);
+    if (channel_obj == NULL) {
+        return NULL;
+    }
+
+    channel_obj->channel = bm_create_replay_channel(g_context, path, &options);
+    if (channel_obj->channel == NULL) {
+        Py_DECREF(channel_obj);
+        PyErr_Format(PyExc_IOError, "Failed to open replay file %s", path);
+        return NULL;
+    }
+
+    BMCaptureMode mode = low_latency ? BM_LOW_LATENCY : BM_NO_FRAME_DROPS;
+    if (!bm_start_channel_capture(g_context, channel_obj->channel, width, height, framerate, mode)) {
+        Py_DECREF(channel_obj);
+        PyErr_Format(PyExc_RuntimeError, "Failed to start replay with settings: %dx%d @ %0.2f fps",
+                     width, height, framerate);
+        return NULL;
+    }
+
+    channel_obj->width = width;
+    channel_obj->height = height;
+    return (PyObject*)channel_obj;
+}
+
+// Read the latency probe code of a frame returned by get_frame
+static PyObject* BMCapture_decode_latency_probe(PyObject* self, PyObject* args) {
+    PyObject* frame_obj = NULL;
+    if (!PyArg_ParseTuple(args, "O", &frame_obj)) {
+        return NULL;
+    }
+
+    PyArrayObject* frame = (PyArrayObject*)PyArray_FROMANY(frame_obj, NPY_UINT8, 2, 3, NPY_ARRAY_C_CONTIGUOUS);
+    if (frame == NULL) {
+        return NULL;
+    }
+
+    // The layout follows get_frame: (h, w) gray, (h, w, 3) RGB, (h, w/2, 4) YUV
+    npy_intp* dims = PyArray_DIMS(frame);
+    BMPixelFormat format;
+    int width;
+    if (PyArray_NDIM(frame) == 2) {
+        format = BM_FORMAT_GRAY;
+        width = (int)dims[1];
+    } else if (dims[2] == 3) {
+        format = BM_FORMAT_RGB;
+        width = (int)dims[1];
+    } else if (dims[2] == 4) {
+        format = BM_FORMAT_YUV;
+        width = (int)dims[1] * 2;
+    } else {
+        Py_DECREF(frame);
+        PyErr_SetString(PyExc_ValueError, "Frame must be a gray, RGB or YUV array from get_frame");
+        return NULL;
+    }
+
+    BMLatencyProbe probe;
+    bool found = bm_decode_latency_probe((const uint8_t*)PyArray_DATA(frame), format, width, (int)dims[0], &probe);
+    Py_DECREF(frame);
+    if (!found) {
+        Py_RETURN_NONE;
+    }
+
+    return Py_BuildValue("{s:I,s:L,s:d}",
+                         "sequence", (unsigned int)probe.sequence,
+                         "emitted_ns", (long long)probe.emitted_ns,
+                         "age_us", probe.age_us);
+}
+
+// Get the memory held by the context and its channels
+static PyObject* BMCapture_get_memory_usage(PyObject* self, PyObject* args) {
+    if (g_context == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+        return NULL;
+    }
+
+    BMMemoryUsage usage;
+    bm_get_memory_usage(g_context, &usage);
+    return Py_BuildValue("{s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K}",
+                         "conversion_tables", (unsigned long long)usage.conversion_tables,
+                         "frame_pools", (unsigned long long)usage.frame_pools,
+                         "conversion_buffers", (unsigned long long)usage.conversion_buffers,
+                         "recorder_buffers", (unsigned long long)usage.recorder_buffers,
+                         "audio_buffers", (unsigned long long)usage.audio_buffers,
+                         "total", (unsigned long long)usage.total,
+                         "peak", (unsigned long long)usage.peak,
+                         "reserved", (unsigned long long)usage.reserved,
+                         "budget", (unsigned long long)usage.budget,
+                         "rejected", (unsigned long long)usage.rejected);
+}
+
+// Limit the memory new channels, recordings and pre-trigger rings may reserve
+static PyObject* BMCapture_set_memory_budget(PyObject* self, PyObject* args) {
+    unsigned long long budget = 0;
+    if (!PyArg_ParseTuple(args, "K", &budget)) {
+        return NULL;
+    }
+
+    // Initialize context if needed, so the budget can be set before opening channels
+    if (g_context == NULL) {
+        g_context = bm_create_context();
+        if (g_context == NULL) {
+            PyErr_SetString(PyExc_RuntimeError, "BlackMagic context not initialized");
+            return NULL;
+        }
+    }
+
+    bm_set_memory_budget(g_context, (uint64_t)budget);
+    Py_RETURN_NONE;
+}
+
+// Start recording pipeline trace events
+static PyObject* BMCapture_trace_start(PyObject* self, PyObject* args, PyObject* kwds) {
+    Py_ssize_t events_per_thread = 65536;
+
+    static const char* const_kwlist[] = {"events_per_thread", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n", kwlist, &events_per_thread)) {
+        return NULL;
+    }
+
+    if (events_per_thread < 0) {
+        PyErr_SetString(PyExc_ValueError, "events_per_thread must not be negative");
+        return NULL;
+    }
+
+    if (!bm_trace_start((size_t)events_per_thread)) {
+        PyErr_SetString(PyExc_ValueError, "events_per_thread is too large");
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+// Stop recording pipeline trace events
+static PyObject* BMCapture_trace_stop(PyObject* self, PyObject* args) {
+    bm_trace_stop();
+    Py_RETURN_NONE;
+}
+
+// Write the trace events recorded since the last write
+static PyObject* BMCapture_trace_write(PyObject* self, PyObject* args, PyObject* kwds) {
+    const char* path = NULL;
+    const char* format_name = "json";
+
+    static const char* const_kwlist[] = {"path", "format", NULL};
+    static char** kwlist = const_cast<char**>(const_kwlist);
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|s", kwlist, &path, &format_name)) {
+        return NULL;
+    }
+
+    BMTraceFormat format;
+    if (strcmp(format_name, "json") == 0) {
+        format = BM_TRACE_JSON;
+    } else if (strcmp(format_name, "perfetto") == 0) {
+        format = BM_TRACE_PERFETTO;
+    } else {
+        PyErr_SetString(PyExc_ValueError, "Trace format must be 'json' or 'perfetto'");
+        return NULL;
+    }
+
+    int64_t written;
+    Py_BEGIN_ALLOW_THREADS
+    written = bm_trace_write(path, format);
+    Py_END_ALLOW_THREADS
+
+    if (written < 0) {
+        PyErr_Format(PyExc_IOError, "Failed to write trace file %s", path);
+        return NULL;
+    }
+
+    return PyLong_FromLongLong((long long)written);
+}
+
+// Python callable receiving log messages, or NULL for stderr
+static PyObject* g_log_callback = NULL;
+
+static const char* log_level_name(BMLogLevel level) {
+    switch (level) {
+        case BM_LOG_DEBUG: return "debug";
+        case BM_LOG_INFO: return "info";
+        case BM_LOG_WARNING: return "warning";
+        case BM_LOG_ERROR: return "error";
+        default: return "off";
+    }
+}
+
+// Runs on the logging thread, which does not hold the GIL
+static void python_log_sink(BMLogLevel level, const char* message, void* user_data) {
+    if (!Py_IsInitialized()) {
+        return;
+    }
+    PyGILState_STATE state = PyGILState_Ensure();
+    PyObject* result = PyObject_CallFunction((PyObject*)user_data, "ss", log_level_name(level), message);
+    if (result == NULL) {
+        PyErr_WriteUnraisable((PyObject*)user_data);
+    }
+    Py_XDECREF(result);
+    PyGILState_Release(state);
+}
+
+// Set the minimum level of messages that are logged
+static PyObject* BMCapture_set_log_level(PyObject* self, PyObject* args) {
+    const char* level_name = NULL;
+    if (!PyArg_ParseTuple(args, "s", &level_name)) {
+        return NULL;
+    }
+
+    BMLogLevel level;
+    if (strcmp(level_name, "debug") == 0) {
+        level = BM_LOG_DEBUG;
+    } else if (strcmp(level_name, "info") == 0) {
+        level = BM_LOG_INFO;
+    } else if (strcmp(level_name, "warning") == 0) {
+        level = BM_LOG_WARNING;
+    } else if (strcmp(level_name, "error") == 0) {
+        level = BM_LOG_ERROR;
+    } else if (strcmp(level_name, "off") == 0) {
+        level = BM_LOG_OFF;
+    } else {
+        PyErr_SetString(PyExc_ValueError, "Log level must be 'debug', 'info', 'warning', 'error' or 'off'");
+        return NULL;
+    }
+
+    bm_set_log_level(level);
+    Py_RETURN_NONE;
+}
+
+// Send log messages to a Python callable instead of stderr
+static PyObject* BMCapture_set_log_callback(PyObject* self, PyObject* args) {
+    PyObject* callback = NULL;
+    if (!PyArg_ParseTuple(args, "O", &callback)) {
+        return NULL;
+    }
+
+    if (callback != Py_None && !PyCallable_Check(callback)) {
+        PyErr_SetString(PyExc_TypeError, "Log callback must be callable or None");
+        return NULL;
+    }
+
+    PyObject* previous = g_log_callback;
+    g_log_callback = callback == Py_None ? NULL : callback;
+    Py_XINCREF(g_log_callback);
+
+    // Replacing the sink waits for a running callback, which needs the GIL
+    Py_BEGIN_ALLOW_THREADS
+    if (g_log_callback != NULL) {
+        bm_set_log_callback(python_log_sink, g_log_callback);
+    } else {
+        bm_set_log_callback(NULL, NULL);
+    }
+    Py_END_ALLOW_THREADS
+
+    Py_XDECREF(previous);
+    Py_RETURN_NONE;
+}
+
+// Wait until every message logged so far has been delivered
+static PyObject* BMCapture_flush_log(PyObject* self, PyObject* args) {
+    Py_BEGIN_ALLOW_THREADS
+    bm_flush_log();
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+// Get the number of messages dropped because the log ring was full
+static PyObject* BMCapture_get_log_dropped(PyObject* self, PyObject* args) {
+    return PyLong_FromUnsignedLongLong((unsigned long long)bm_get_log_dropped());
+}
+
+// Module-level methods
+static PyMethodDef module_methods[] = {
+    {"initialize", (PyCFunction)BMCapture_initialize, METH_NOARGS,
+     "Initialize the BlackMagic capture library."},
+    {"shutdown", (PyCFunction)BMCapture_shutdown, METH_NOARGS,
+     "Shutdown the BlackMagic capture library."},
+    {"initialize_mock", (PyCFunction)BMCapture_initialize_mock, METH_VARARGS | METH_KEYWORDS,
+     "Initialize the library with simulated devices that generate frames without hardware. "
+     "With fallback=True they are only used if the DeckLink driver is missing. "
+     "Returns True if the devices are simulated."},
+    {"driver_available", (PyCFunction)BMCapture_driver_available, METH_NOARGS,
+     "Check whether the DeckLink driver is installed."},
+    {"get_device_count", (PyCFunction)BMCapture_get_device_count, METH_NOARGS,
+     "Get number of available BlackMagic devices."},
+    {"get_device_name", (PyCFunction)BMCapture_get_device_name, METH_VARARGS,
+     "Get name of a BlackMagic device by index."},
+    {"get_devices", (PyCFunction)BMCapture_get_devices, METH_NOARGS,
+     "Get a list of available BlackMagic devices."},
+    {"get_input_ports", (PyCFunction)BMCapture_get_input_ports, METH_VARARGS,
+     "Get a list of input ports for a BlackMagic device."},
+    {"create_device", (PyCFunction)BMCapture_create_device, METH_VARARGS,
+     "Create a BlackMagic device instance."},
+    {"select_input_port", (PyCFunction)BMCapture_select_input_port, METH_VARARGS,
+     "Select an input port for a BlackMagic device."},
+    {"destroy_device", (PyCFunction)BMCapture_destroy_device, METH_VARARGS,
+     "Destroy a BlackMagic device instance."},
+    {"open_replay", (PyCFunction)BMCapture_open_replay, METH_VARARGS | METH_KEYWORDS,
+     "Open a channel that replays a recording, or a test pattern without a path."},
+    {"decode_latency_probe", (PyCFunction)BMCapture_decode_latency_probe, METH_VARARGS,
+     "Read the code of a latency_probe replay frame: dict with sequence, emitted_ns and age_us, or None."},
+    {"get_memory_usage", (PyCFunction)BMCapture_get_memory_usage, METH_NOARGS,
+     "Get the bytes held by conversion tables, frame pools, conversion buffers and recorders, with the budget state."},
+    {"set_memory_budget", (PyCFunction)BMCapture_set_memory_budget, METH_VARARGS,
+     "Limit the memory new channels, recordings and pre-trigger buffers may reserve, in bytes (0 for no limit)."},
+    {"trace_start", (PyCFunction)BMCapture_trace_start, METH_VARARGS | METH_KEYWORDS,
+     "Start recording pipeline trace events into per-thread rings."},
+    {"trace_stop", (PyCFunction)BMCapture_trace_stop, METH_NOARGS,
+     "Stop recording pipeline trace events."},
+    {"trace_write", (PyCFunction)BMCapture_trace_write, METH_VARARGS | METH_KEYWORDS,
+     "Write events recorded since the last write as Chrome JSON or Perfetto protobuf; returns the event count."},
+    {"set_log_level", (PyCFunction)BMCapture_set_log_level, METH_VARARGS,
+     "Set the minimum log level: 'debug', 'info', 'warning' (default), 'error' or 'off'."},
+    {"set_log_callback", (PyCFunction)BMCapture_set_log_callback, METH_VARARGS,
+     "Call callback(level, message) from the logging thread for each message, or restore stderr with None."},
+    {"flush_log", (PyCFunction)BMCapture_flush_log, METH_NOARGS,
+     "Wait until every message logged so far has been delivered."},
+    {"get_log_dropped", (PyCFunction)BMCapture_get_log_dropped, METH_NOARGS,
+     "Get the number of log messages dropped because the log ring was full."},
+    {NULL}  /* Sentinel */
+};
+
+
+// Module definition
+static struct PyModuleDef bmcapture_module = {
+    PyModuleDef_HEAD_INIT,
+    "bmcapture_c",
+    "Python C API interface for BlackMagic capture devices",
+    -1,
+    module_methods
 };
 
 // Module cleanup function
 static void bmcapture_module_free(void) {
+    // The interpreter is gone, so the Python log callback can no longer run
+    bm_set_log_callback(NULL, NULL);
+    g_log_callback = NULL;
+
     // Clean up the global context when the module is unloaded
     if (g_context) {
         bm_free_context(g_context);
@@ -928,6 +2685,10 @@ PyMODINIT_FUNC PyInit_bmcapture_c(void) {
         return NULL;
     if (PyType_Ready(&BMChannelType) < 0)
         return NULL;
+    if (PyType_Ready(&BMRawFileType) < 0)
+        return NULL;
+    if (PyType_Ready(&BMRtpReceiverType) < 0)
+        return NULL;
 
     // Create the module
     m = PyModule_Create(&bmcapture_module);
@@ -951,6 +2712,27 @@ PyMODINIT_FUNC PyInit_bmcapture_c(void) {
         return NULL;
     }
 
+    // Add the RawFile type
+    Py_INCREF(&BMRawFileType);
+    if (PyModule_AddObject(m, "RawFile", (PyObject*)&BMRawFileType) < 0) {
+        Py_DECREF(&BMRawFileType);
+        Py_DECREF(&BMChannelType);
+        Py_DECREF(&BMCaptureType);
+        Py_DECREF(m);
+        return NULL;
+    }
+
+    // Add the RtpReceiver type
+    Py_INCREF(&BMRtpReceiverType);
+    if (PyModule_AddObject(m, "RtpReceiver", (PyObject*)&BMRtpReceiverType) < 0) {
+        Py_DECREF(&BMRtpReceiverType);
+        Py_DECREF(&BMRawFileType);
+        Py_DECREF(&BMChannelType);
+        Py_DECREF(&BMCaptureType);
+        Py_DECREF(m);
+        return NULL;
+    }
+
     // Add module constants
     PyModule_AddIntConstant(m, "LOW_LATENCY", BM_LOW_LATENCY);
     PyModule_AddIntConstant(m, "NO_FRAME_DROPS", BM_NO_FRAME_DROPS);
@@ -0,0 +1,806 @@
+#include "bmcapture_recorder.h"
+#include "bmcapture_audio.h"
+#include "bmcapture_log.h"
+#include "bmcapture_trace.h"
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Write a whole buffer at the given offset, retrying short and interrupted writes
+static bool write_fully(int fd, const uint8_t* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, (off_t)offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+        offset += (uint64_t)written;
+    }
+    return true;
+}
+
+// Create the index sidecar of a container and write its header
+static int create_index(const std::string& data_path) {
+    std::string index_path = data_path + BM_CONTAINER_INDEX_SUFFIX;
+    int index_fd = ::open(index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (index_fd < 0) {
+        return -1;
+    }
+
+    BMRawIndexHeader index_header;
+    bm_container_init_index_header(&index_header);
+    if (write(index_fd, &index_header, sizeof(index_header)) != (ssize_t)sizeof(index_header)) {
+        int saved = errno;
+        ::close(index_fd);
+        errno = saved;
+        return -1;
+    }
+    return index_fd;
+}
+
+// Reserve disk blocks past the end of the file without changing its size,
+// so a crash leaves no zero tail
+static bool preallocate_file(int fd, uint64_t offset, uint64_t length) {
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+    return fallocate(fd, FALLOC_FL_KEEP_SIZE, (off_t)offset, (off_t)length) == 0;
+#elif defined(F_PREALLOCATE)
+    (void)offset;
+    fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, (off_t)length, 0};
+    if (fcntl(fd, F_PREALLOCATE, &store) == 0) {
+        return true;
+    }
+    store.fst_flags = F_ALLOCATEALL;
+    return fcntl(fd, F_PREALLOCATE, &store) == 0;
+#else
+    (void)fd;
+    (void)offset;
+    (void)length;
+    return false;
+#endif
+}
+
+void bm_recording_options_init(BMRecordingOptions* options) {
+    if (options == nullptr) {
+        return;
+    }
+    options->format = BM_RECORDING_RAW;
+    options->queue_depth = 8;
+    options->preallocate_bytes = 1ULL << 30;
+    options->direct_io = true;
+    options->compression = BM_COMPRESSION_NONE;
+    options->compression_threads = 0;
+    options->segment_seconds = 0.0;
+    options->retain_bytes = 0;
+    options->retain_seconds = 0.0;
+}
+
+FrameRecorder::FrameRecorder()
+    : active(false), audio_channels(0), frames_written(0), frames_dropped(0), bytes_written(0), bytes_captured(0),
+      max_write_ns(0), max_encode_ns(0), segments_completed(0), segments_deleted(0),
+      max_switch_ns(0), audio_silence_frames(0), last_error(0), direct_io(false) {
+    bm_recording_options_init(&options);
+}
+
+FrameRecorder::~FrameRecorder() {
+    close();
+}
+
+bool FrameRecorder::open(const char* file_path, const BMRecordingOptions& recording_options) {
+    if (isOpen() || file_path == nullptr) {
+        return false;
+    }
+
+    options = recording_options;
+    if (options.queue_depth < 1) {
+        options.queue_depth = 1;
+    }
+
+    // Compressed frames vary in size, so only the indexed container can hold them
+    if (options.compression != BM_COMPRESSION_NONE && options.format != BM_RECORDING_CONTAINER) {
+        log_error("Compressed recording requires the container format");
+        last_error = EINVAL;
+        return false;
+    }
+
+    // Segments are found through their own index, so they are containers too
+    if (options.segment_seconds > 0.0 && options.format != BM_RECORDING_CONTAINER) {
+        log_error("Segmented recording requires the container format");
+        last_error = EINVAL;
+        return false;
+    }
+
+    segment_base = file_path;
+    segment_number = 0;
+    std::string first_path = segmented() ? segmentPath(0) : segment_base;
+
+    fd = ::open(first_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        last_error = errno;
+        return false;
+    }
+
+    // The staging page is sized once the first frame fixes the track layout
+    if (options.format == BM_RECORDING_MATROSKA) {
+        muxer.reset(new MatroskaMuxer());
+    }
+
+    if (options.format == BM_RECORDING_CONTAINER) {
+        index_fd = create_index(first_path);
+
+        void* page = nullptr;
+        if (index_fd < 0 || posix_memalign(&page, BM_FRAME_ALIGNMENT, BM_FRAME_ALIGNMENT) != 0) {
+            last_error = errno;
+            if (index_fd >= 0) {
+                ::close(index_fd);
+                index_fd = -1;
+            }
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        memset(page, 0, BM_FRAME_ALIGNMENT);
+        header = static_cast<BMRawHeader*>(page);
+    }
+
+    if (options.compression == BM_COMPRESSION_LOSSLESS) {
+        codec.reset(new FrameCodec(options.compression_threads));
+    } else {
+        codec.reset();
+    }
+
+    path = first_path;
+    container_frames = 0;
+    stored_bytes = 0;
+    staging_pending = 0;
+    segment_start_time = 0;
+    completed_segments.clear();
+    completed_bytes = 0;
+    container_frame_size = 0;
+    stopping = false;
+    failed = false;
+    write_offset = 0;
+    preallocated_end = 0;
+    last_offset = 0;
+    last_length = 0;
+    direct_active = false;
+    queue_high_water = 0;
+    frames_written = 0;
+    frames_dropped = 0;
+    bytes_written = 0;
+    bytes_captured = 0;
+    max_write_ns = 0;
+    max_encode_ns = 0;
+    segments_completed = 0;
+    segments_deleted = 0;
+    max_switch_ns = 0;
+    audio_channels = 0;
+    audio_silence_frames = 0;
+    last_error = 0;
+    direct_io = false;
+
+    active = true;
+    writer = std::thread(&FrameRecorder::writerLoop, this);
+    return true;
+}
+
+void FrameRecorder::close() {
+    if (!isOpen()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_one();
+
+    if (writer.joinable()) {
+        writer.join();
+    }
+
+    if (header != nullptr) {
+        // Record the final frame count so readers can trust it over the file size
+        if (container_frames > 0 && !failed) {
+            header->frame_count = container_frames;
+            writeContainerHeader();
+        }
+        if (segmented()) {
+            segments_completed++;
+        }
+        free(header);
+        header = nullptr;
+    }
+
+    if (muxer) {
+        if (muxer->started() && !failed && !finishMatroska()) {
+            last_error = errno;
+            log_error("Could not finish Matroska file %s (errno %d)", path.c_str(), (int)last_error);
+        }
+        muxer.reset();
+        free(staging);
+        staging = nullptr;
+    }
+
+    // A segment prepared ahead of time but never reached is removed again
+    if (next_fd >= 0) {
+        ::close(next_fd);
+        ::close(next_index_fd);
+        unlink(next_path.c_str());
+        unlink((next_path + BM_CONTAINER_INDEX_SUFFIX).c_str());
+        next_fd = -1;
+        next_index_fd = -1;
+    }
+
+    if (index_fd >= 0) {
+        ::close(index_fd);
+        index_fd = -1;
+    }
+
+    // Preallocation keeps the file size, so only the written bytes remain visible
+    ::close(fd);
+    fd = -1;
+    codec.reset();
+    active = false;
+}
+
+void FrameRecorder::onFrame(const FrameData& data, const FrameInfo& info) {
+    if (data.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (stopping || (int)queue.size() >= options.queue_depth) {
+            frames_dropped++;
+            return;
+        }
+
+        // Container frames must share one stride to stay addressable, so the
+        // first frame fixes the size; a format change needs a new recording
+        if (options.format == BM_RECORDING_CONTAINER || options.format == BM_RECORDING_MATROSKA) {
+            if (container_frame_size == 0) {
+                container_frame_size = data.size();
+            } else if (data.size() != container_frame_size) {
+                if (frames_dropped++ == 0) {
+                    log_warning("Frame size changed while recording %s, dropping frames", path.c_str());
+                }
+                return;
+            }
+        }
+        QueuedFrame frame;
+        frame.data = data;
+        frame.info = info;
+        queue.push_back(frame);
+        if ((int)queue.size() > queue_high_water) {
+            queue_high_water = (int)queue.size();
+        }
+    }
+    queue_cv.notify_one();
+}
+
+void FrameRecorder::getStats(BMRecordingStats* stats) const {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stats->queue_length = (int)queue.size();
+        stats->queue_high_water = queue_high_water;
+    }
+    stats->active = isOpen();
+    stats->direct_io = direct_io;
+    stats->frames_written = frames_written;
+    stats->frames_dropped = frames_dropped;
+    stats->bytes_written = bytes_written;
+    stats->max_write_ms = max_write_ns / 1e6;
+    stats->max_encode_ms = max_encode_ns / 1e6;
+    stats->segments_completed = segments_completed;
+    stats->segments_deleted = segments_deleted;
+    stats->max_segment_switch_ms = max_switch_ns / 1e6;
+    stats->audio_channels = audio_channels;
+    stats->audio_silence_frames = audio_silence_frames;
+    uint64_t written = stats->bytes_written;
+    stats->compression_ratio = written > 0 ? (double)bytes_captured / (double)written : 1.0;
+    stats->last_error = last_error;
+}
+
+void FrameRecorder::writerLoop() {
+    for (;;) {
+        QueuedFrame frame;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return; // Stopping and fully drained
+            }
+            frame = queue.front();
+            queue.pop_front();
+        }
+
+        if (failed) {
+            frames_dropped++;
+            continue;
+        }
+
+        trace_name_thread("recorder");
+        auto start = std::chrono::steady_clock::now();
+        bool written;
+        {
+            TraceSpan write_span(TRACE_DISK_WRITE, frame.info.sequence);
+            written = writeFrame(frame);
+        }
+        if (!written) {
+            last_error = errno;
+            failed = true;
+            frames_dropped++;
+            log_error("Recording to %s failed (errno %d)", path.c_str(), (int)last_error);
+            continue;
+        }
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        if (elapsed > max_write_ns) {
+            max_write_ns = elapsed;
+        }
+        frames_written++;
+        bytes_written += stored_bytes;
+        bytes_captured += frame.data.size();
+    }
+}
+
+bool FrameRecorder::writeFrame(const QueuedFrame& frame) {
+    if (header != nullptr) {
+        return writeContainerFrame(frame);
+    }
+    if (muxer) {
+        return writeMatroskaFrame(frame);
+    }
+
+    const FrameData& data = frame.data;
+    size_t length = data.size();
+
+    // Direct I/O needs block-aligned lengths and offsets; the buffer itself is
+    // always page aligned because it comes from the frame pool. Raw files have
+    // no padding, so once a frame is not a whole number of blocks (1080p 2vuy
+    // is 4,147,200 bytes) every later offset is misaligned too, and the rest
+    // of the recording is buffered; the container format pads instead
+    if (options.direct_io && ((length % BM_FRAME_ALIGNMENT) != 0 || (write_offset % BM_FRAME_ALIGNMENT) != 0)) {
+        log_debug("%zu byte frames are not block aligned; recording %s without direct I/O", length, path.c_str());
+        options.direct_io = false;
+    }
+    setDirectIO(options.direct_io);
+
+    preallocate(write_offset + length);
+
+    if (!writeAt(data.data(), length, write_offset)) {
+        return false;
+    }
+
+    if (!direct_active) {
+        releasePageCache(write_offset, length);
+    }
+
+    write_offset += length;
+    stored_bytes = length;
+    return true;
+}
+
+bool FrameRecorder::writeAt(const uint8_t* data, size_t length, uint64_t offset) {
+    if (write_fully(fd, data, length, offset)) {
+        return true;
+    }
+    if (errno != EINVAL || !direct_active) {
+        return false;
+    }
+    // Some filesystems reject O_DIRECT at write time; fall back to buffered writes
+    options.direct_io = false;
+    setDirectIO(false);
+    return write_fully(fd, data, length, offset);
+}
+
+void FrameRecorder::setDirectIO(bool enable) {
+    if (enable == direct_active) {
+        return;
+    }
+
+#if defined(__linux__) && defined(O_DIRECT)
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0) {
+        flags = enable ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+        if (fcntl(fd, F_SETFL, flags) == 0) {
+            direct_active = enable;
+        }
+    }
+#elif defined(F_NOCACHE)
+    if (fcntl(fd, F_NOCACHE, enable ? 1 : 0) == 0) {
+        direct_active = enable;
+    }
+#endif
+
+    if (!direct_active && enable) {
+        // Not supported here; stop asking for every frame
+        options.direct_io = false;
+    }
+    direct_io = direct_active;
+}
+
+void FrameRecorder::preallocate(uint64_t end) {
+    if (options.preallocate_bytes == 0 || end <= preallocated_end) {
+        return;
+    }
+
+    uint64_t length = options.preallocate_bytes;
+    if (end - preallocated_end > length) {
+        length = end - preallocated_end;
+    }
+
+    if (preallocate_file(fd, preallocated_end, length)) {
+        preallocated_end += length;
+    } else {
+        // Filesystem cannot preallocate; don't retry on every frame
+        options.preallocate_bytes = 0;
+    }
+}
+
+void FrameRecorder::releasePageCache(uint64_t offset, uint64_t length) {
+#if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+    // Start writeback of this frame, then wait for the previous one and drop it
+    // from the page cache, so buffered recording does not evict everything else
+    sync_file_range(fd, (off_t)offset, (off_t)length, SYNC_FILE_RANGE_WRITE);
+    if (last_length > 0) {
+        sync_file_range(fd, (off_t)last_offset, (off_t)last_length,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(fd, (off_t)last_offset, (off_t)last_length, POSIX_FADV_DONTNEED);
+    }
+#endif
+    last_offset = offset;
+    last_length = length;
+}
+
+bool FrameRecorder::writeContainerHeader() {
+    setDirectIO(options.direct_io);
+    return write_fully(fd, reinterpret_cast<const uint8_t*>(header), BM_FRAME_ALIGNMENT, 0);
+}
+
+bool FrameRecorder::writeContainerFrame(const QueuedFrame& frame) {
+    const FrameData& data = frame.data;
+
+    if (segmented() && container_frames > 0) {
+        int64_t elapsed = segmentElapsed(frame.info);
+        if (elapsed >= segmentLength(frame.info)) {
+            if (!switchSegment(frame)) {
+                return false;
+            }
+        } else if (next_fd < 0 && elapsed >= segmentLength(frame.info) / 2) {
+            // Halfway through, get the next file ready so the switch itself
+            // is only a swap of descriptors
+            if (!prepareNextSegment(frame)) {
+                return false;
+            }
+        }
+    }
+
+    // The first frame fixes the layout of the whole container
+    if (header->frame_stride == 0) {
+        if (codec && !FrameCodec::supports(frame.info.pixel_format)) {
+            log_error("Lossless compression does not support the captured pixel format");
+            errno = EINVAL;
+            return false;
+        }
+        bm_container_init_header(header, frame.info, data.size(),
+                                 codec ? BM_CONTAINER_LOSSLESS : BM_CONTAINER_UNCOMPRESSED);
+        if (!writeContainerHeader()) {
+            return false;
+        }
+        write_offset = header->data_offset;
+        segment_start_time = frameTime(frame.info);
+    }
+
+    // Pooled buffers are allocated in whole pages with zeroed padding, so the
+    // full stride can be written straight from the buffer
+    FrameData stored = data;
+    size_t stored_size = data.size();
+    size_t length = (size_t)header->frame_stride;
+
+    if (codec) {
+        TraceSpan encode_span(TRACE_ENCODE, frame.info.sequence);
+        auto start = std::chrono::steady_clock::now();
+        size_t capacity = FrameCodec::maxEncodedSize(frame.info.height, frame.info.row_bytes,
+                                                     frame.info.pixel_format);
+        stored = encode_pool.acquire(capacity);
+        stored_size = codec->encode(data.data(), frame.info.width, frame.info.height, frame.info.row_bytes,
+                                    frame.info.pixel_format, stored.data(), stored.capacity());
+        if (stored_size == 0) {
+            errno = EINVAL;
+            return false;
+        }
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        if (elapsed > max_encode_ns) {
+            max_encode_ns = elapsed;
+        }
+
+        // Encoded frames keep page alignment; clear the tail the buffer's
+        // earlier, longer frames may have left behind
+        length = bm_align_up(stored_size);
+        memset(stored.data() + stored_size, 0, length - stored_size);
+    }
+
+    if (stored.capacity() < length) {
+        errno = EINVAL;
+        return false;
+    }
+
+    setDirectIO(options.direct_io);
+    preallocate(write_offset + length);
+
+    if (!writeAt(stored.data(), length, write_offset)) {
+        return false;
+    }
+
+    if (!direct_active) {
+        releasePageCache(write_offset, length);
+    }
+
+    // Only index frames that are completely on disk
+    BMRawIndexEntry entry;
+    bm_container_init_index_entry(&entry, frame.info, write_offset, stored_size);
+    if (write(index_fd, &entry, sizeof(entry)) != (ssize_t)sizeof(entry)) {
+        return false;
+    }
+
+    write_offset += length;
+    stored_bytes = stored_size;
+    container_frames++;
+    return true;
+}
+
+bool FrameRecorder::writeMatroskaFrame(const QueuedFrame& frame) {
+    const FrameData& data = frame.data;
+
+    if (!muxer->started()) {
+        if (!MatroskaMuxer::supports(frame.info.pixel_format)) {
+            log_error("Matroska recording supports only 2vuy and v210 frames");
+            errno = EINVAL;
+            return false;
+        }
+        // Audio captured on the channel becomes a second track
+        int channels = audio != nullptr && audio->enabled() ? audio->channelCount() : 0;
+        int depth = channels > 0 ? audio->sampleDepth() : 0;
+        void* page = nullptr;
+        if (!muxer->begin(frame.info, data.size(), channels, depth) ||
+            posix_memalign(&page, BM_FRAME_ALIGNMENT, BM_FRAME_ALIGNMENT + muxer->maxFrameHeader()) != 0) {
+            errno = ENOMEM;
+            return false;
+        }
+        staging = static_cast<uint8_t*>(page);
+        audio_channels = muxer->hasAudio() ? channels : 0;
+        setDirectIO(options.direct_io);
+        if (!writeAt(muxer->headData(), muxer->headSize(), 0)) {
+            return false;
+        }
+        write_offset = muxer->headSize();
+    }
+
+    // The cluster header ends on a page boundary, so both writes are aligned;
+    // whatever is left of the frame past its last full page goes out with the
+    // next cluster header
+    uint32_t audio_frames = 0;
+    uint8_t* audio_out = nullptr;
+    if (muxer->hasAudio()) {
+        int64_t first = audio_position_for(frame.info.stream_time, frame.info.time_scale);
+        int64_t end = audio_position_for(frame.info.stream_time + frame.info.frame_duration, frame.info.time_scale);
+        audio_frames = (uint32_t)std::min<int64_t>(std::max<int64_t>(end - first, 0), muxer->maxAudioFrames());
+    }
+    size_t chunk = muxer->frameHeader(staging, staging_pending, write_offset, frame.info, audio_frames, &audio_out);
+    if (audio_out != nullptr) {
+        copyAudio(frame.info, audio_out, audio_frames);
+    }
+    size_t bulk = data.size() / BM_FRAME_ALIGNMENT * BM_FRAME_ALIGNMENT;
+    size_t tail = data.size() - bulk;
+
+    setDirectIO(options.direct_io);
+    preallocate(write_offset + chunk + data.size());
+
+    if (!writeAt(staging, chunk, write_offset)) {
+        return false;
+    }
+    if (bulk > 0 && !writeAt(data.data(), bulk, write_offset + chunk)) {
+        return false;
+    }
+    if (!direct_active) {
+        releasePageCache(write_offset, chunk + bulk);
+    }
+    write_offset += chunk + bulk;
+    memcpy(staging, data.data() + bulk, tail);
+    staging_pending = tail;
+
+    // Rewrite the pages of the cue region a new cue point landed in
+    size_t begin, end;
+    if (muxer->updateCues(&begin, &end)) {
+        begin = begin / BM_FRAME_ALIGNMENT * BM_FRAME_ALIGNMENT;
+        end = bm_align_up(end);
+        if (!writeAt(muxer->headData() + begin, end - begin, begin)) {
+            return false;
+        }
+    }
+
+    stored_bytes = data.size();
+    return true;
+}
+
+// Copy the samples of a frame's period out of the channel's ring. Where the
+// ring does not hold them (overwritten because the writer fell behind, or
+// not delivered by the card) the block is filled with silence.
+void FrameRecorder::copyAudio(const FrameInfo& info, uint8_t* out, uint32_t frame_count) {
+    size_t frame_bytes = audio->frameBytes();
+    BMAudioView view;
+    if (audio->view(audio_position_for(info.stream_time, info.time_scale), frame_count, &view)) {
+        if (view.frames[0] > 0) {
+            memcpy(out, view.data[0], view.frames[0] * frame_bytes);
+        }
+        if (view.frames[1] > 0) {
+            memcpy(out + view.frames[0] * frame_bytes, view.data[1], view.frames[1] * frame_bytes);
+        }
+        if (audio->valid(view)) {
+            return;
+        }
+    }
+    memset(out, 0, frame_count * frame_bytes);
+    audio_silence_frames += frame_count;
+}
+
+// Write the last frame's tail and any cues that did not fit the reserved
+// region, then patch the segment size and duration into the header
+bool FrameRecorder::finishMatroska() {
+    setDirectIO(false);
+    if (!write_fully(fd, staging, staging_pending, write_offset)) {
+        return false;
+    }
+    uint64_t end_offset = write_offset + staging_pending;
+
+    std::vector<uint8_t> trailer;
+    size_t dirty_end = 0;
+    muxer->finish(end_offset, &trailer, &dirty_end);
+    if (!trailer.empty() && !write_fully(fd, trailer.data(), trailer.size(), end_offset)) {
+        return false;
+    }
+    return write_fully(fd, muxer->headData(), dirty_end, 0);
+}
+
+std::string FrameRecorder::segmentPath(int64_t number) const {
+    // capture.bmraw -> capture-000000.bmraw
+    size_t slash = segment_base.find_last_of('/');
+    size_t dot = segment_base.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash) || dot == slash + 1) {
+        dot = segment_base.size();
+    }
+
+    char number_text[32];
+    snprintf(number_text, sizeof(number_text), "-%06lld", (long long)number);
+    return segment_base.substr(0, dot) + number_text + segment_base.substr(dot);
+}
+
+// Time of a frame for segmenting: its stream time, or the arrival time in
+// nanoseconds for sources without a time scale
+int64_t FrameRecorder::frameTime(const FrameInfo& info) const {
+    return info.time_scale > 0 ? info.stream_time : info.arrival_ns;
+}
+
+int64_t FrameRecorder::segmentElapsed(const FrameInfo& info) const {
+    return frameTime(info) - segment_start_time;
+}
+
+int64_t FrameRecorder::segmentLength(const FrameInfo& info) const {
+    double scale = info.time_scale > 0 ? (double)info.time_scale : 1e9;
+    return (int64_t)llround(options.segment_seconds * scale);
+}
+
+// Delete the oldest completed segments until the retention limits hold.
+// The segment being written counts towards the size limit but is never deleted.
+void FrameRecorder::enforceRetention() {
+    auto now = std::chrono::steady_clock::now();
+    while (!completed_segments.empty()) {
+        const CompletedSegment& oldest = completed_segments.front();
+        bool too_large = options.retain_bytes > 0 && completed_bytes + write_offset > options.retain_bytes;
+        bool too_old = options.retain_seconds > 0.0 &&
+                       std::chrono::duration<double>(now - oldest.closed).count() > options.retain_seconds;
+        if (!too_large && !too_old) {
+            break;
+        }
+
+        if (unlink(oldest.path.c_str()) != 0 && errno != ENOENT) {
+            log_warning("Could not delete old segment %s (errno %d)", oldest.path.c_str(), errno);
+        }
+        unlink((oldest.path + BM_CONTAINER_INDEX_SUFFIX).c_str());
+        completed_bytes -= oldest.bytes;
+        completed_segments.pop_front();
+        segments_deleted++;
+    }
+}
+
+bool FrameRecorder::prepareNextSegment(const QueuedFrame& frame) {
+    enforceRetention();
+
+    next_path = segmentPath(segment_number + 1);
+    next_fd = ::open(next_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (next_fd < 0) {
+        return false;
+    }
+    next_index_fd = create_index(next_path);
+    if (next_index_fd < 0) {
+        int saved = errno;
+        ::close(next_fd);
+        next_fd = -1;
+        unlink(next_path.c_str());
+        errno = saved;
+        return false;
+    }
+
+    // Reserve a whole segment of uncompressed frames up front
+    next_preallocated = 0;
+    if (options.preallocate_bytes > 0 && frame.info.frame_duration > 0) {
+        uint64_t frames = (uint64_t)(segmentLength(frame.info) / frame.info.frame_duration) + 1;
+        uint64_t length = BM_FRAME_ALIGNMENT + frames * header->frame_stride;
+        if (preallocate_file(next_fd, 0, length)) {
+            next_preallocated = length;
+        }
+    }
+    return true;
+}
+
+bool FrameRecorder::switchSegment(const QueuedFrame& frame) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Segments shorter than two frames never reach the halfway point
+    if (next_fd < 0 && !prepareNextSegment(frame)) {
+        return false;
+    }
+
+    // Finish the current segment the way close() finishes a recording
+    header->frame_count = container_frames;
+    if (!writeContainerHeader()) {
+        return false;
+    }
+    ::close(index_fd);
+    ::close(fd);
+
+    CompletedSegment done;
+    done.path = path;
+    done.bytes = write_offset;
+    done.closed = std::chrono::steady_clock::now();
+    completed_segments.push_back(done);
+    completed_bytes += done.bytes;
+    segments_completed++;
+
+    fd = next_fd;
+    index_fd = next_index_fd;
+    path = next_path;
+    next_fd = -1;
+    next_index_fd = -1;
+    segment_number++;
+
+    // The header is rewritten by the first frame of the new segment
+    memset(header, 0, sizeof(*header));
+    container_frames = 0;
+    write_offset = 0;
+    preallocated_end = next_preallocated;
+    last_offset = 0;
+    last_length = 0;
+    direct_active = false;  // The new descriptor was opened without O_DIRECT
+
+    int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    if (elapsed > max_switch_ns) {
+        max_switch_ns = elapsed;
+    }
+    return true;
+}
@@ -0,0 +1,164 @@
+#ifndef BMCAPTURE_RECORDER_H
+#define BMCAPTURE_RECORDER_H
+
+#include "bmcapture.h"
+#include "bmcapture_codec.h"
+#include "bmcapture_container.h"
+#include "bmcapture_frame_pool.h"
+#include "bmcapture_frame_sink.h"
+#include "bmcapture_matroska.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class AudioRing;
+
+// Writes captured frames to disk from a dedicated thread.
+// The capture callback only queues a reference to the pooled frame buffer, so
+// recording never copies pixel data; the writer issues one pwrite per frame
+// straight from that buffer, with O_DIRECT (Linux) or F_NOCACHE (macOS) when
+// the frame size is block aligned. In container mode every frame is padded to
+// a page boundary, so direct I/O is always possible, and an index entry is
+// appended to the <path>.idx sidecar once the frame is on disk. With lossless
+// compression the writer thread encodes each frame into a pooled buffer
+// (spreading the work over the codec's slice threads) and stores that instead.
+//
+// Segmented recordings rotate to a new container (<name>-NNNNNN.<ext>, each
+// with its own index) once a frame's stream time reaches the segment length,
+// so every frame lands in exactly one segment. The next file is created and
+// preallocated halfway through the current segment, which is also when old
+// segments are deleted to honour the retention limits; the switch itself
+// happens on the writer thread and only finalizes one header.
+//
+// Matroska recordings keep the zero-copy path too: the muxer pads each
+// cluster so the pixel data starts on a page boundary, and the writer issues
+// one write for the cluster header (plus the unaligned end of the previous
+// frame) from a small staging page and one for the aligned bulk of the frame
+// from the capture buffer. When the channel captures audio, each cluster also
+// carries the samples of the frame's period, copied from the audio ring on the
+// writer thread.
+class FrameRecorder : public FrameSink {
+public:
+    FrameRecorder();
+    ~FrameRecorder();
+
+    // Create the output file and start the writer thread
+    bool open(const char* path, const BMRecordingOptions& options);
+
+    // Write out everything still queued, then close the file
+    void close();
+
+    // Charge encode buffers to a context's memory account
+    void setMemoryAccount(MemoryAccount* account) { encode_pool.setMemoryAccount(account, MEMORY_RECORDER); }
+
+    // Channel audio for Matroska recordings; the ring must outlive the recording
+    void setAudioSource(AudioRing* ring) { audio = ring; }
+
+    bool isOpen() const { return active; }
+
+    void onFrame(const FrameData& data, const FrameInfo& info) override;
+
+    void getStats(BMRecordingStats* stats) const;
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+private:
+    struct QueuedFrame {
+        FrameData data;
+        FrameInfo info;
+    };
+
+    void writerLoop();
+    bool writeFrame(const QueuedFrame& frame);
+    bool writeContainerFrame(const QueuedFrame& frame);
+    bool writeContainerHeader();
+    bool writeMatroskaFrame(const QueuedFrame& frame);
+    bool finishMatroska();
+    void copyAudio(const FrameInfo& info, uint8_t* out, uint32_t frame_count);
+    bool writeAt(const uint8_t* data, size_t length, uint64_t offset);
+    void setDirectIO(bool enable);
+    void preallocate(uint64_t end);
+    void releasePageCache(uint64_t offset, uint64_t length);
+
+    bool segmented() const { return options.segment_seconds > 0.0; }
+    std::string segmentPath(int64_t number) const;
+    int64_t frameTime(const FrameInfo& info) const;
+    int64_t segmentElapsed(const FrameInfo& info) const;
+    int64_t segmentLength(const FrameInfo& info) const;
+    bool prepareNextSegment(const QueuedFrame& frame);
+    bool switchSegment(const QueuedFrame& frame);
+    void enforceRetention();
+
+    int fd = -1;                    // Replaced by the writer thread when segments rotate
+    std::atomic<bool> active;       // From a successful open() until close(); safe from any thread
+    std::string path;
+    BMRecordingOptions options;
+    std::thread writer;
+
+    mutable std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<QueuedFrame> queue;
+    bool stopping = false;
+    int queue_high_water = 0;
+    size_t container_frame_size = 0;
+
+    // Writer thread state
+    uint64_t write_offset = 0;
+    uint64_t preallocated_end = 0;
+    uint64_t last_offset = 0;
+    uint64_t last_length = 0;
+    bool direct_active = false;
+    bool failed = false;
+
+    // Container state, owned by the writer thread once recording starts
+    int index_fd = -1;
+    BMRawHeader* header = nullptr;  // Page-aligned so it can be written with O_DIRECT
+    uint64_t container_frames = 0;
+    std::unique_ptr<FrameCodec> codec;  // Set when recording compressed
+    FramePool encode_pool;          // Charged to the context as MEMORY_RECORDER
+    size_t stored_bytes = 0;        // Bytes of the last frame as written
+
+    // Matroska state, owned by the writer thread once recording starts
+    std::unique_ptr<MatroskaMuxer> muxer;
+    uint8_t* staging = nullptr;     // Cluster headers and frame tails, page aligned
+    size_t staging_pending = 0;     // Unaligned end of the last frame, not yet written
+    AudioRing* audio = nullptr;     // Read by the writer thread only
+    std::atomic<int> audio_channels;
+
+    // Segment state, owned by the writer thread
+    struct CompletedSegment {
+        std::string path;
+        uint64_t bytes;
+        std::chrono::steady_clock::time_point closed;
+    };
+    std::string segment_base;       // Path the segment names are derived from
+    int64_t segment_number = 0;
+    int64_t segment_start_time = 0; // frameTime() of the segment's first frame
+    int next_fd = -1;               // Next segment, once prepared
+    int next_index_fd = -1;
+    std::string next_path;
+    uint64_t next_preallocated = 0;
+    std::deque<CompletedSegment> completed_segments;
+    uint64_t completed_bytes = 0;
+
+    std::atomic<uint64_t> frames_written;
+    std::atomic<uint64_t> frames_dropped;
+    std::atomic<uint64_t> bytes_written;
+    std::atomic<uint64_t> bytes_captured;
+    std::atomic<int64_t> max_write_ns;
+    std::atomic<int64_t> max_encode_ns;
+    std::atomic<uint64_t> segments_completed;
+    std::atomic<uint64_t> segments_deleted;
+    std::atomic<int64_t> max_switch_ns;
+    std::atomic<uint64_t> audio_silence_frames;
+    std::atomic<int> last_error;
+    std::atomic<bool> direct_io;
+};
+
+#endif /* BMCAPTURE_RECORDER_H */
@@ -0,0 +1,519 @@
+#include "bmcapture_replay.h"
+#include "bmcapture_log.h"
+#include "bmcapture_timecode.h"
+#include "bmcapture_trace.h"
+#include <chrono>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 75% colour bars in 8-bit BT.709 (Y, Cb, Cr): white, yellow, cyan, green,
+// magenta, red, blue, black
+static const uint8_t kColourBars[8][3] = {
+    {180, 128, 128},
+    {168, 44, 136},
+    {145, 147, 44},
+    {133, 63, 52},
+    {63, 193, 204},
+    {51, 109, 212},
+    {28, 212, 120},
+    {16, 128, 128}
+};
+
+static const long kMarkerPixels = 16;       // Width of the moving marker
+static const long kMarkerStep = 8;          // Pixels the marker moves per frame
+
+// Latency probe code: a row of black and white cells in the top left corner,
+// wide and tall enough to survive conversion to any output format
+//   [sync, 16 bits][sequence, 32 bits][emission time in ns, 64 bits][xor of the bytes, 8 bits]
+static const int kProbeBits = 120;
+static const int kProbeCellPixels = 4;
+static const int kProbeRows = 8;
+static const uint16_t kProbeSync = 0xB5C3;
+
+// Convert a time value between time scales without overflowing for long streams
+static BMDTimeValue rescale_time(BMDTimeValue value, BMDTimeScale from, BMDTimeScale to) {
+    if (from == to) {
+        return value;
+    }
+    return (value / from) * to + (value % from) * to / from;
+}
+
+static int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Probe code as 15 bytes, most significant bit first
+static void probe_bytes(uint32_t sequence, int64_t emitted_ns, uint8_t* bytes) {
+    bytes[0] = (uint8_t)(kProbeSync >> 8);
+    bytes[1] = (uint8_t)kProbeSync;
+    for (int i = 0; i < 4; i++) {
+        bytes[2 + i] = (uint8_t)(sequence >> (24 - 8 * i));
+    }
+    for (int i = 0; i < 8; i++) {
+        bytes[6 + i] = (uint8_t)((uint64_t)emitted_ns >> (56 - 8 * i));
+    }
+    uint8_t check = 0;
+    for (int i = 0; i < 14; i++) {
+        check ^= bytes[i];
+    }
+    bytes[14] = check;
+}
+
+// Draw the probe code into the top rows of an 8-bit 4:2:2 frame
+static void stamp_probe(uint8_t* frame, long row_bytes, uint32_t sequence, int64_t emitted_ns) {
+    uint8_t bytes[kProbeBits / 8];
+    probe_bytes(sequence, emitted_ns, bytes);
+    for (int row = 0; row < kProbeRows; row++) {
+        uint8_t* p = frame + (size_t)row * row_bytes;
+        for (int bit = 0; bit < kProbeBits; bit++) {
+            uint8_t luma = (bytes[bit / 8] >> (7 - bit % 8)) & 1 ? 235 : 16;
+            for (int i = 0; i < kProbeCellPixels / 2; i++) {
+                p[0] = 128;
+                p[1] = luma;
+                p[2] = 128;
+                p[3] = luma;
+                p += 4;
+            }
+        }
+    }
+}
+
+void bm_replay_options_init(BMReplayOptions* options) {
+    if (options == nullptr) {
+        return;
+    }
+    options->pacing = BM_REPLAY_REALTIME;
+    options->speed = 1.0;
+    options->loop = true;
+    options->latency_probe = false;
+}
+
+bool bm_decode_latency_probe(const uint8_t* frame, BMPixelFormat format, int width, int height,
+                             BMLatencyProbe* probe) {
+    if (frame == nullptr || probe == nullptr || width < kProbeBits * kProbeCellPixels || height < kProbeRows) {
+        return false;
+    }
+
+    // Sample the middle of each cell on a middle row
+    size_t row = (size_t)(kProbeRows / 2) * (size_t)width;
+    uint8_t bytes[kProbeBits / 8] = {0};
+    for (int bit = 0; bit < kProbeBits; bit++) {
+        size_t x = (size_t)(bit * kProbeCellPixels + kProbeCellPixels / 2);
+        uint8_t level = 0;
+        switch (format) {
+            case BM_FORMAT_RGB:
+                level = frame[(row + x) * 3 + 1];
+                break;
+            case BM_FORMAT_YUV:
+                level = frame[(row + x) * 2 + 1];
+                break;
+            case BM_FORMAT_GRAY:
+                level = frame[row + x];
+                break;
+            default:
+                return false;
+        }
+        if (level >= 128) {
+            bytes[bit / 8] |= (uint8_t)(0x80 >> (bit % 8));
+        }
+    }
+
+    uint32_t sequence = 0;
+    int64_t emitted_ns = 0;
+    for (int i = 0; i < 4; i++) {
+        sequence = (sequence << 8) | bytes[2 + i];
+    }
+    for (int i = 0; i < 8; i++) {
+        emitted_ns = (int64_t)(((uint64_t)emitted_ns << 8) | bytes[6 + i]);
+    }
+
+    uint8_t expected[kProbeBits / 8];
+    probe_bytes(sequence, emitted_ns, expected);
+    if (memcmp(bytes, expected, sizeof(expected)) != 0) {
+        return false;
+    }
+
+    probe->sequence = sequence;
+    probe->emitted_ns = emitted_ns;
+    probe->age_us = (steady_now_ns() - emitted_ns) / 1e3;
+    return true;
+}
+
+HRESULT ReplayVideoFrame::GetStreamTime(BMDTimeValue* frameTime, BMDTimeValue* frameDuration, BMDTimeScale timeScale) {
+    if (timeScale <= 0 || time_scale <= 0) {
+        return E_INVALIDARG;
+    }
+    *frameTime = rescale_time(stream_time, time_scale, timeScale);
+    *frameDuration = rescale_time(frame_duration, time_scale, timeScale);
+    return S_OK;
+}
+
+HRESULT ReplayVideoFrame::GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode) {
+    *timecode = nullptr;
+    const BMTimecode* found = nullptr;
+    if (format == bmdTimecodeRP188Any) {
+        // The first of VITC1, LTC and VITC2, as the driver does
+        for (int source = BM_TIMECODE_RP188_VITC1; source <= BM_TIMECODE_RP188_VITC2 && found == nullptr; source++) {
+            if (timecodes[source].valid) {
+                found = &timecodes[source];
+            }
+        }
+    } else {
+        for (int source = 0; source < BM_TIMECODE_SOURCE_COUNT; source++) {
+            if (kTimecodeFormats[source] == format && timecodes[source].valid) {
+                found = &timecodes[source];
+            }
+        }
+    }
+    if (found == nullptr) {
+        return S_FALSE;
+    }
+    timecode_object.value = *found;
+    *timecode = &timecode_object;
+    return S_OK;
+}
+
+HRESULT ReplayTimecode::GetComponents(uint8_t* hours, uint8_t* minutes, uint8_t* seconds, uint8_t* frames) {
+    *hours = value.hours;
+    *minutes = value.minutes;
+    *seconds = value.seconds;
+    *frames = value.frames;
+    return S_OK;
+}
+
+HRESULT ReplayTimecode::GetString(CFStringRef* timecode) {
+    char text[16];
+    if (!bm_timecode_format(&value, text, sizeof(text))) {
+        *timecode = nullptr;
+        return E_FAIL;
+    }
+    *timecode = CFStringCreateWithCString(kCFAllocatorDefault, text, kCFStringEncodingUTF8);
+    return *timecode != nullptr ? S_OK : E_OUTOFMEMORY;
+}
+
+HRESULT ReplayVideoFrame::GetHardwareReferenceTimestamp(BMDTimeScale timeScale, BMDTimeValue* frameTime, BMDTimeValue* frameDuration) {
+    if (timeScale <= 0 || time_scale <= 0) {
+        return E_INVALIDARG;
+    }
+    *frameTime = rescale_time(hardware_timestamp_ns, 1000000000LL, timeScale);
+    *frameDuration = rescale_time(frame_duration, time_scale, timeScale);
+    return S_OK;
+}
+
+ReplaySource::ReplaySource(const BMReplayOptions& replay_options)
+    : options(replay_options), frames_delivered(0) {
+    if (options.pacing == BM_REPLAY_SCALED && options.speed <= 0.0) {
+        options.pacing = BM_REPLAY_AS_FAST_AS_POSSIBLE;
+    }
+}
+
+ReplaySource::~ReplaySource() {
+    stop();
+    closeFile();
+}
+
+bool ReplaySource::open(const char* path) {
+    closeFile();
+    if (path == nullptr || path[0] == '\0') {
+        return true;
+    }
+
+    raw_file = bm_raw_file_open(path);
+    if (raw_file != nullptr) {
+        return true;
+    }
+
+    // Not a container: a headerless recording whose format is given at start
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    // Frames are read once, front to back
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    mapping = static_cast<uint8_t*>(data);
+    mapping_size = (size_t)st.st_size;
+    return true;
+}
+
+void ReplaySource::closeFile() {
+    if (raw_file != nullptr) {
+        bm_raw_file_close(raw_file);
+        raw_file = nullptr;
+    }
+    if (mapping != nullptr) {
+        munmap(mapping, mapping_size);
+        mapping = nullptr;
+        mapping_size = 0;
+    }
+}
+
+bool ReplaySource::configure(int width, int height, float framerate,
+                             BMDTimeScale* time_scale, BMDTimeValue* frame_duration) {
+    if (width <= 0 || height <= 0 || (width & 1) != 0) {
+        log_error("Unsupported replay size %dx%d", width, height);
+        return false;
+    }
+
+    // Express the requested rate the way display modes do, e.g. 30000/1001
+    BMDTimeScale scale = 1000;
+    BMDTimeValue duration = 1000;
+    double nominal = floor(framerate + 0.5);
+    if (nominal > 0 && fabs(framerate - nominal * 1000.0 / 1001.0) < 0.01) {
+        scale = (BMDTimeScale)nominal * 1000;
+        duration = 1001;
+    } else if (framerate > 0) {
+        scale = (BMDTimeScale)floor(framerate * 1000.0 + 0.5);
+    } else {
+        log_error("Invalid replay frame rate %.2f", framerate);
+        return false;
+    }
+
+    frame.width = width;
+    frame.height = height;
+    frame.row_bytes = width * 2;
+    frame.pixel_format = bmdFormat8BitYUV;
+    frame.flags = bmdFrameFlagDefault;
+    frame.bytes = nullptr;
+    frame_count = 0;
+
+    if (raw_file != nullptr) {
+        BMRawFileInfo info;
+        bm_raw_file_get_info(raw_file, &info);
+        if (info.width != width || info.height != height) {
+            log_error("Recording is %dx%d, not the requested %dx%d",
+                    info.width, info.height, width, height);
+            return false;
+        }
+        if (info.pixel_format != bmdFormat8BitYUV) {
+            log_error("Only 8-bit YUV recordings can be replayed");
+            return false;
+        }
+        if (info.frame_count == 0) {
+            log_error("Recording contains no frames");
+            return false;
+        }
+
+        frame.row_bytes = info.row_bytes;
+        frame_count = info.frame_count;
+        if (info.compressed) {
+            decoded.resize((size_t)info.row_bytes * info.height);
+        } else {
+            decoded.clear();
+        }
+        if (info.time_scale > 0 && info.frame_duration > 0) {
+            scale = info.time_scale;
+            duration = info.frame_duration;
+        }
+
+        BMFrameInfo first;
+        BMFrameInfo last;
+        bm_raw_file_get_frame(raw_file, 0, nullptr, &first);
+        bm_raw_file_get_frame(raw_file, frame_count - 1, nullptr, &last);
+        first_stream_time = first.stream_time;
+        loop_length = last.stream_time - first.stream_time + duration;
+    } else if (mapping != nullptr) {
+        frame_count = (int64_t)(mapping_size / ((size_t)frame.row_bytes * height));
+        if (frame_count == 0) {
+            log_error("Recording is smaller than one %dx%d frame", width, height);
+            return false;
+        }
+        first_stream_time = 0;
+        loop_length = frame_count * duration;
+    } else {
+        pattern.configure(width, height);
+        frame.bytes = pattern.data();
+    }
+
+    frame.time_scale = scale;
+    frame.frame_duration = duration;
+    *time_scale = scale;
+    *frame_duration = duration;
+    return true;
+}
+
+bool ReplaySource::start(IDeckLinkInputCallback* input_callback) {
+    stop();
+    if (input_callback == nullptr || frame.width == 0) {
+        return false;
+    }
+
+    callback = input_callback;
+    frames_delivered = 0;
+    running = true;
+    thread = std::thread(&ReplaySource::run, this);
+    return true;
+}
+
+void ReplaySource::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        running = false;
+    }
+    wake_cv.notify_all();
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void TestPattern::configure(long pattern_width, long pattern_height) {
+    width = pattern_width;
+    height = pattern_height;
+    row_bytes = width * 2;
+
+    // Bars never change from row to row, so one row is the template
+    pattern_row.resize((size_t)row_bytes);
+    for (long x = 0; x < width; x += 2) {
+        const uint8_t* bar = kColourBars[x * 8 / width];
+        uint8_t* p = &pattern_row[(size_t)x * 2];
+        p[0] = bar[1];
+        p[1] = bar[0];
+        p[2] = bar[2];
+        p[3] = bar[0];
+    }
+    pattern.resize((size_t)row_bytes * height);
+    for (long y = 0; y < height; y++) {
+        memcpy(&pattern[(size_t)y * row_bytes], pattern_row.data(), pattern_row.size());
+    }
+    marker_offset = -1;
+}
+
+void TestPattern::render(int64_t index) {
+    long span = width - kMarkerPixels;
+    if (span <= 0) {
+        return;
+    }
+
+    // Restore the bars under the previous marker, then draw it at its new
+    // position; only a narrow column changes, so frames stay cheap to produce
+    long offset = ((long)((index * kMarkerStep) % span) & ~1L) * 2;
+    long length = kMarkerPixels * 2;
+    for (long y = 0; y < height; y++) {
+        uint8_t* row = &pattern[(size_t)y * row_bytes];
+        if (marker_offset >= 0) {
+            memcpy(row + marker_offset, &pattern_row[(size_t)marker_offset], (size_t)length);
+        }
+        for (long i = 0; i < length; i += 4) {
+            row[offset + i] = 128;
+            row[offset + i + 1] = 235;
+            row[offset + i + 2] = 128;
+            row[offset + i + 3] = 235;
+        }
+    }
+    marker_offset = offset;
+}
+
+bool ReplaySource::nextFrame(int64_t index) {
+    if (frame_count == 0) {
+        pattern.render(index);
+        frame.stream_time = index * frame.frame_duration;
+        return true;
+    }
+
+    if (index >= frame_count && !options.loop) {
+        return false;
+    }
+
+    // Stream time keeps increasing across loops, with recorded gaps preserved
+    int64_t position = index % frame_count;
+    int64_t loop_offset = (index / frame_count) * loop_length;
+
+    if (raw_file != nullptr) {
+        BMFrameInfo info;
+        if (!decoded.empty()) {
+            // Compressed frames are decoded on this thread, ahead of the callback
+            if (!bm_raw_file_read_frame(raw_file, position, decoded.data(), decoded.size(), &info)) {
+                return false;
+            }
+            frame.bytes = decoded.data();
+        } else {
+            size_t size = 0;
+            const uint8_t* data = bm_raw_file_get_frame(raw_file, position, &size, &info);
+            if (data == nullptr) {
+                return false;
+            }
+            // The callback reads a whole frame from the mapping
+            if (size < (size_t)frame.row_bytes * frame.height) {
+                log_error("Frame %lld of the recording is truncated (%zu bytes)", (long long)position, size);
+                return false;
+            }
+            frame.bytes = const_cast<uint8_t*>(data);
+        }
+        frame.flags = info.flags;
+        memcpy(frame.timecodes, info.timecodes, sizeof(frame.timecodes));
+        frame.stream_time = loop_offset + info.stream_time - first_stream_time;
+        bm_raw_file_prefetch(raw_file, (position + 1) % frame_count, 2);
+    } else {
+        frame.bytes = mapping + (size_t)position * frame.row_bytes * frame.height;
+        frame.stream_time = loop_offset + position * frame.frame_duration;
+    }
+    return true;
+}
+
+void ReplaySource::run() {
+    std::chrono::nanoseconds interval(0);
+    if (options.pacing != BM_REPLAY_AS_FAST_AS_POSSIBLE) {
+        double speed = options.pacing == BM_REPLAY_SCALED ? options.speed : 1.0;
+        double seconds = (double)frame.frame_duration / (double)frame.time_scale / speed;
+        interval = std::chrono::nanoseconds((int64_t)(seconds * 1e9));
+    }
+
+    auto deadline = std::chrono::steady_clock::now();
+    for (int64_t index = 0; ; index++) {
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            if (interval.count() > 0) {
+                wake_cv.wait_until(lock, deadline, [this] { return !running; });
+            }
+            if (!running) {
+                break;
+            }
+        }
+
+        if (!nextFrame(index)) {
+            break;
+        }
+
+        frame.hardware_timestamp_ns = steady_now_ns();
+        if (options.latency_probe && frame.width >= kProbeBits * kProbeCellPixels && frame.height >= kProbeRows) {
+            // Recordings are mapped read-only, so their frames are stamped in a copy
+            if (frame_count > 0 && decoded.empty()) {
+                size_t size = (size_t)frame.row_bytes * frame.height;
+                probe_frame.assign(static_cast<uint8_t*>(frame.bytes), static_cast<uint8_t*>(frame.bytes) + size);
+                frame.bytes = probe_frame.data();
+            }
+            stamp_probe(static_cast<uint8_t*>(frame.bytes), frame.row_bytes, (uint32_t)index,
+                        frame.hardware_timestamp_ns);
+        }
+        trace_name_thread("replay");
+        callback->VideoInputFrameArrived(&frame, nullptr);
+        frames_delivered++;
+
+        // Like a card, a late consumer loses time rather than getting a burst
+        deadline += interval;
+        auto now = std::chrono::steady_clock::now();
+        if (now > deadline + interval) {
+            deadline = now;
+        }
+    }
+}
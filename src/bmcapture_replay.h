@@ -0,0 +1,177 @@
+#ifndef BMCAPTURE_REPLAY_H
+#define BMCAPTURE_REPLAY_H
+
+#include "bmcapture.h"
+#include "DeckLinkAPI.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Timecode object a ReplayVideoFrame hands out; like the frame, it lives as
+// long as its owner and ignores reference counting
+class ReplayTimecode : public IDeckLinkTimecode {
+public:
+    virtual ~ReplayTimecode() {}
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) override {
+        return E_NOINTERFACE;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE AddRef() override {
+        return 1;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE Release() override {
+        return 1;
+    }
+
+    virtual BMDTimecodeBCD GetBCD() override { return value.bcd; }
+    virtual HRESULT GetComponents(uint8_t* hours, uint8_t* minutes, uint8_t* seconds, uint8_t* frames) override;
+    virtual HRESULT GetString(CFStringRef* timecode) override;
+    virtual BMDTimecodeFlags GetFlags() override {
+        return value.drop_frame ? bmdTimecodeIsDropFrame : bmdTimecodeFlagDefault;
+    }
+    virtual HRESULT GetTimecodeUserBits(BMDTimecodeUserBits* user_bits) override {
+        *user_bits = value.user_bits;
+        return S_OK;
+    }
+
+    BMTimecode value = {};
+};
+
+// Video frame handed to the channel callback by a ReplaySource.
+// It wraps memory owned by the source (a mapped recording or a generated
+// pattern), so the callback sees exactly what it would get from a card.
+class ReplayVideoFrame : public IDeckLinkVideoInputFrame {
+public:
+    ReplayVideoFrame() {}
+    virtual ~ReplayVideoFrame() {}
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) override {
+        return E_NOINTERFACE;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE AddRef() override {
+        return 1;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE Release() override {
+        return 1;
+    }
+
+    virtual long GetWidth() override { return width; }
+    virtual long GetHeight() override { return height; }
+    virtual long GetRowBytes() override { return row_bytes; }
+    virtual BMDPixelFormat GetPixelFormat() override { return pixel_format; }
+    virtual BMDFrameFlags GetFlags() override { return flags; }
+
+    virtual HRESULT GetBytes(void** buffer) override {
+        *buffer = bytes;
+        return bytes != nullptr ? S_OK : E_FAIL;
+    }
+
+    // Answers with the timecodes[] entry for the format, like a card with those sources
+    virtual HRESULT GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode) override;
+
+    virtual HRESULT GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary) override {
+        *ancillary = nullptr;
+        return S_FALSE;
+    }
+
+    virtual HRESULT GetStreamTime(BMDTimeValue* frameTime, BMDTimeValue* frameDuration, BMDTimeScale timeScale) override;
+    virtual HRESULT GetHardwareReferenceTimestamp(BMDTimeScale timeScale, BMDTimeValue* frameTime, BMDTimeValue* frameDuration) override;
+
+    long width = 0;
+    long height = 0;
+    long row_bytes = 0;
+    BMDPixelFormat pixel_format = bmdFormat8BitYUV;
+    BMDFrameFlags flags = bmdFrameFlagDefault;
+    void* bytes = nullptr;
+    BMDTimeValue stream_time = 0;           // In time_scale units
+    BMDTimeValue frame_duration = 0;        // In time_scale units
+    BMDTimeScale time_scale = 1;
+    int64_t hardware_timestamp_ns = 0;      // steady_clock time the frame was emitted
+    BMTimecode timecodes[BM_TIMECODE_SOURCE_COUNT] = {};   // Carried timecodes, by source
+
+private:
+    ReplayTimecode timecode_object;         // Handed out by GetTimecode, one at a time
+};
+
+// 75% colour bars with a moving marker, in 8-bit 4:2:2 (cb-y0-cr-y1)
+class TestPattern {
+public:
+    void configure(long width, long height);
+
+    // Draw the marker at its position for frame `index`
+    void render(int64_t index);
+
+    uint8_t* data() { return pattern.data(); }
+
+private:
+    long width = 0;
+    long height = 0;
+    long row_bytes = 0;
+    std::vector<uint8_t> pattern;
+    std::vector<uint8_t> pattern_row;   // One unmarked row of colour bars
+    long marker_offset = -1;            // Byte offset of the marker within a row
+};
+
+// Feeds recorded or generated frames into a channel's DeckLink callback from
+// its own thread, so buffering, signal lock and conversion run exactly as they
+// do with a card attached.
+class ReplaySource {
+public:
+    explicit ReplaySource(const BMReplayOptions& options);
+    ~ReplaySource();
+
+    // Map a container or headerless recording; without a file the source
+    // generates a colour bar test pattern
+    bool open(const char* path);
+
+    // Prepare frames for the requested format and report the stream time base.
+    // A container must match the requested size and carries its own frame
+    // rate; headerless recordings and the pattern use the requested format.
+    bool configure(int width, int height, float framerate,
+                   BMDTimeScale* time_scale, BMDTimeValue* frame_duration);
+
+    bool start(IDeckLinkInputCallback* callback);
+    void stop();
+
+    int64_t framesDelivered() const { return frames_delivered; }
+
+    ReplaySource(const ReplaySource&) = delete;
+    ReplaySource& operator=(const ReplaySource&) = delete;
+
+private:
+    void run();
+    bool nextFrame(int64_t index);
+    void closeFile();
+
+    BMReplayOptions options;
+    IDeckLinkInputCallback* callback = nullptr;
+    std::thread thread;
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;    // Interrupts pacing sleeps on stop()
+    bool running = false;
+    std::atomic<int64_t> frames_delivered;
+
+    ReplayVideoFrame frame;
+    int64_t frame_count = 0;        // Frames available in the file, 0 for the pattern
+
+    // Container recording
+    BMRawFile* raw_file = nullptr;
+    std::vector<uint8_t> decoded;       // Current frame of a compressed container
+    std::vector<uint8_t> probe_frame;   // Copy of the current frame to stamp a latency probe into
+    int64_t first_stream_time = 0;
+    int64_t loop_length = 0;        // Stream time covered by one pass over the file
+
+    // Headerless recording
+    uint8_t* mapping = nullptr;
+    size_t mapping_size = 0;
+
+    TestPattern pattern;
+};
+
+#endif /* BMCAPTURE_REPLAY_H */
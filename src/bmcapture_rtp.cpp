@@ -0,0 +1,840 @@
+#include "bmcapture_rtp.h"
+#include "bmcapture_log.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <netinet/udp.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#endif
+
+// RTP header plus the RFC 4175 extended sequence number and one line header
+static const size_t kHeaderSize = 20;
+
+// Bytes of one 4:2:2 pixel group (two pixels, Cb Y0 Cr Y1)
+static const size_t kPixelGroupSize = 4;
+
+// Kernel limits of one UDP GSO send
+static const size_t kMaxSegments = 64;
+static const size_t kMaxSegmentBytes = 60000;
+
+// Packets handed to the kernel between pacing points
+static const size_t kPacedBatch = 64;
+static const size_t kUnpacedBatch = 1024;
+
+// Share of the frame interval the packets of a frame are spread across
+static const double kPacingWindow = 0.9;
+
+static const size_t kReceiveBatch = 32;
+static const size_t kReceiveBufferSize = 65536;
+static const size_t kReadyFrames = 2;
+
+static void put16(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+static void put32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+static uint32_t get16(const uint8_t* p) {
+    return ((uint32_t)p[0] << 8) | p[1];
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Convert a stream time to the 90 kHz RTP video clock without overflowing
+static uint32_t rtp_timestamp(int64_t stream_time, int64_t time_scale) {
+    if (time_scale <= 0) {
+        time_scale = 1000000;
+    }
+    int64_t seconds = stream_time / time_scale;
+    int64_t remainder = stream_time % time_scale;
+    return (uint32_t)(seconds * 90000 + remainder * 90000 / time_scale);
+}
+
+static int64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void bm_rtp_options_init(BMRtpOptions* options) {
+    if (options == nullptr) {
+        return;
+    }
+    options->payload_type = 96;
+    options->packet_size = 1400;
+    options->paced = true;
+    options->segmentation_offload = true;
+    options->queue_depth = 2;
+    options->multicast_ttl = 1;
+}
+
+// RtpSender
+
+RtpSender::RtpSender()
+    : frames_sent(0), frames_dropped(0), frames_late(0), packets_sent(0),
+      bytes_sent(0), last_error(0), gso_active(false) {
+    bm_rtp_options_init(&options);
+}
+
+RtpSender::~RtpSender() {
+    close();
+}
+
+bool RtpSender::open(const char* host, int port, const BMRtpOptions& sender_options, const FrameInfo& stream_format) {
+    if (isOpen() || host == nullptr || port <= 0 || port > 65535) {
+        return false;
+    }
+
+    options = sender_options;
+    format = stream_format;
+    if (options.payload_type < 96 || options.payload_type > 127) {
+        options.payload_type = 96;
+    }
+    if (options.packet_size < (int)(kHeaderSize + kPixelGroupSize)) {
+        options.packet_size = (int)(kHeaderSize + kPixelGroupSize);
+    }
+    if (options.packet_size > 65507) {
+        options.packet_size = 65507;
+    }
+    if (options.queue_depth < 1) {
+        options.queue_depth = 1;
+    }
+    if (format.width <= 0 || format.height <= 0 || (format.width & 1) != 0) {
+        log_error("RTP output needs a known frame size with an even width");
+        return false;
+    }
+    if (format.row_bytes <= 0) {
+        format.row_bytes = (long)format.width * 2;
+    }
+
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo* result = nullptr;
+    int status = getaddrinfo(host, service, &hints, &result);
+    if (status != 0) {
+        log_error("Could not resolve RTP destination %s: %s", host, gai_strerror(status));
+        return false;
+    }
+
+    int sock = -1;
+    for (struct addrinfo* ai = result; ai != nullptr && sock < 0; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sock < 0) {
+            continue;
+        }
+        int ttl = options.multicast_ttl;
+        if (ai->ai_family == AF_INET) {
+            unsigned char ttl_byte = (unsigned char)ttl;
+            setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl_byte, sizeof(ttl_byte));
+        } else if (ai->ai_family == AF_INET6) {
+            setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &ttl, sizeof(ttl));
+        }
+        if (connect(sock, ai->ai_addr, ai->ai_addrlen) != 0) {
+            ::close(sock);
+            sock = -1;
+        }
+    }
+    freeaddrinfo(result);
+    if (sock < 0) {
+        log_error("Could not open RTP socket to %s:%d (errno %d)", host, port, errno);
+        return false;
+    }
+    fcntl(sock, F_SETFD, FD_CLOEXEC);
+
+    // Room for a good part of a frame, so pacing rather than the buffer sets the rate
+    int buffer_size = 8 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+
+    std::random_device random;
+    ssrc = random();
+    sequence = random();
+    fd = sock;
+    stopping = false;
+    queue.clear();
+    frames_sent = 0;
+    frames_dropped = 0;
+    frames_late = 0;
+    packets_sent = 0;
+    bytes_sent = 0;
+    last_error = 0;
+#if defined(__linux__)
+    gso = options.segmentation_offload;
+#else
+    gso = false;
+#endif
+    gso_active = gso;
+
+    buildPacketLayout();
+    sender = std::thread(&RtpSender::senderLoop, this);
+    return true;
+}
+
+void RtpSender::close() {
+    if (!isOpen()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+        queue.clear();
+    }
+    queue_cv.notify_one();
+    if (sender.joinable()) {
+        sender.join();
+    }
+
+    ::close(fd);
+    fd = -1;
+    gso_active = false;
+}
+
+void RtpSender::onFrame(const FrameData& data, const FrameInfo& info) {
+    if (data.empty()) {
+        return;
+    }
+    if ((size_t)format.row_bytes * format.height > data.size()) {
+        frames_dropped++;   // The input mode changed under the sender
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (stopping || (int)queue.size() >= options.queue_depth) {
+            frames_dropped++;
+            return;
+        }
+        QueuedFrame frame;
+        frame.data = data;
+        frame.info = info;
+        queue.push_back(frame);
+    }
+    queue_cv.notify_one();
+}
+
+void RtpSender::getStats(BMRtpStats* stats) const {
+    stats->active = isOpen();
+    stats->segmentation_offload = gso_active;
+    stats->frames_sent = frames_sent;
+    stats->frames_dropped = frames_dropped;
+    stats->frames_late = frames_late;
+    stats->packets_sent = packets_sent;
+    stats->bytes_sent = bytes_sent;
+    stats->last_error = last_error;
+}
+
+void RtpSender::buildPacketLayout() {
+    // Split each line into the fewest packets that fit, then even them out so
+    // every packet of the frame has the same size when the line allows it
+    size_t line_bytes = (size_t)format.width * 2;
+    size_t max_data = ((size_t)options.packet_size - kHeaderSize) / kPixelGroupSize * kPixelGroupSize;
+    size_t per_line = (line_bytes + max_data - 1) / max_data;
+    size_t groups = line_bytes / kPixelGroupSize;
+    size_t packet_data = (groups + per_line - 1) / per_line * kPixelGroupSize;
+
+    packets.clear();
+    for (int line = 0; line < format.height; line++) {
+        for (size_t offset = 0; offset < line_bytes; offset += packet_data) {
+            Packet packet;
+            packet.line = (uint16_t)line;
+            packet.offset = (uint16_t)(offset / 2);
+            packet.length = (uint16_t)std::min(packet_data, line_bytes - offset);
+            packets.push_back(packet);
+        }
+    }
+    headers.assign(packets.size() * kHeaderSize, 0);
+}
+
+void RtpSender::writeHeader(uint8_t* header, const Packet& packet, bool last, uint32_t timestamp) {
+    header[0] = 0x80;   // Version 2, no padding, extension or CSRCs
+    header[1] = (uint8_t)((last ? 0x80 : 0) | options.payload_type);
+    put16(header + 2, sequence & 0xffff);
+    put32(header + 4, timestamp);
+    put32(header + 8, ssrc);
+    put16(header + 12, sequence >> 16);
+    put16(header + 14, packet.length);
+    put16(header + 16, packet.line & 0x7fff);   // Field 0: progressive
+    put16(header + 18, packet.offset & 0x7fff); // No further line headers
+    sequence++;
+}
+
+void RtpSender::senderLoop() {
+    for (;;) {
+        QueuedFrame frame;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) {
+                break;
+            }
+            frame = queue.front();
+            queue.pop_front();
+        }
+        sendFrame(frame);
+    }
+}
+
+void RtpSender::sendFrame(const QueuedFrame& frame) {
+    uint32_t timestamp = rtp_timestamp(frame.info.stream_time, frame.info.time_scale);
+    for (size_t i = 0; i < packets.size(); i++) {
+        writeHeader(&headers[i * kHeaderSize], packets[i], i + 1 == packets.size(), timestamp);
+    }
+
+    int64_t interval_ns = 1000000000LL / 30;
+    if (format.time_scale > 0 && format.frame_duration > 0) {
+        interval_ns = format.frame_duration * 1000000000LL / format.time_scale;
+    }
+    int64_t window_ns = (int64_t)(interval_ns * kPacingWindow);
+
+    size_t batch = options.paced ? kPacedBatch : kUnpacedBatch;
+    int64_t start = steady_ns();
+    size_t total = packets.size();
+
+    for (size_t done = 0; done < total; ) {
+        if (options.paced && done > 0) {
+            int64_t target = start + (int64_t)((double)window_ns * done / total);
+            int64_t wait = target - steady_ns();
+            if (wait > 0) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+            }
+        }
+        size_t count = std::min(batch, total - done);
+        sendBatch(frame.data.data(), done, count);
+        done += count;
+    }
+
+    if (steady_ns() - start > interval_ns) {
+        frames_late++;
+    }
+    frames_sent++;
+}
+
+// Send packets [first, first + count); returns the number handed to the kernel
+int RtpSender::sendBatch(const uint8_t* frame_data, size_t first, size_t count) {
+    std::vector<struct iovec> iov(count * 2);
+    for (size_t i = 0; i < count; i++) {
+        const Packet& packet = packets[first + i];
+        iov[i * 2].iov_base = &headers[(first + i) * kHeaderSize];
+        iov[i * 2].iov_len = kHeaderSize;
+        iov[i * 2 + 1].iov_base = const_cast<uint8_t*>(frame_data) + (size_t)packet.line * format.row_bytes +
+                                  (size_t)packet.offset * 2;
+        iov[i * 2 + 1].iov_len = packet.length;
+    }
+
+#if defined(__linux__)
+    // Group runs of equal-size packets (the last of a run may be shorter) into one message each
+    struct Message {
+        size_t first;
+        size_t count;
+        uint16_t segment;
+    };
+    std::vector<Message> messages;
+    for (size_t i = 0; i < count; ) {
+        Message message;
+        message.first = i;
+        message.count = 1;
+        message.segment = (uint16_t)(kHeaderSize + packets[first + i].length);
+        i++;
+        if (gso) {
+            size_t limit = std::min(kMaxSegments, std::max<size_t>(1, kMaxSegmentBytes / message.segment));
+            while (i < count && message.count < limit) {
+                size_t size = kHeaderSize + packets[first + i].length;
+                if (size > message.segment) {
+                    break;
+                }
+                message.count++;
+                i++;
+                if (size < message.segment) {
+                    break;
+                }
+            }
+        }
+        messages.push_back(message);
+    }
+
+    const size_t control_size = CMSG_SPACE(sizeof(uint16_t));
+    std::vector<char> control(messages.size() * control_size, 0);
+    std::vector<struct mmsghdr> headers_out(messages.size());
+    for (size_t m = 0; m < messages.size(); m++) {
+        struct msghdr& msg = headers_out[m].msg_hdr;
+        memset(&headers_out[m], 0, sizeof(headers_out[m]));
+        msg.msg_iov = &iov[messages[m].first * 2];
+        msg.msg_iovlen = messages[m].count * 2;
+        if (messages[m].count > 1) {
+            msg.msg_control = &control[m * control_size];
+            msg.msg_controllen = control_size;
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            memcpy(CMSG_DATA(cmsg), &messages[m].segment, sizeof(uint16_t));
+        }
+    }
+
+    int sent_packets = 0;
+    size_t m = 0;
+    while (m < messages.size()) {
+        int sent = sendmmsg(fd, &headers_out[m], (unsigned int)(messages.size() - m), 0);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (gso && messages[m].count > 1 && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT ||
+                                                 errno == EOPNOTSUPP)) {
+                // No segmentation offload on this path; send the rest one packet at a
+                // time, counting what already went out since the call below counts only its own
+                gso = false;
+                gso_active = false;
+                packets_sent += (uint64_t)sent_packets;
+                return sent_packets + sendBatch(frame_data, first + messages[m].first, count - messages[m].first);
+            }
+            // Typically ECONNREFUSED from an earlier ICMP error; lose this message and go on
+            last_error = errno;
+            m++;
+            continue;
+        }
+        for (int k = 0; k < sent; k++) {
+            const Message& message = messages[m + k];
+            sent_packets += (int)message.count;
+            for (size_t p = 0; p < message.count; p++) {
+                bytes_sent += kHeaderSize + packets[first + message.first + p].length;
+            }
+        }
+        m += (size_t)sent;
+    }
+    packets_sent += (uint64_t)sent_packets;
+    return sent_packets;
+#else
+    int sent_packets = 0;
+    for (size_t i = 0; i < count; i++) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov[i * 2];
+        msg.msg_iovlen = 2;
+        ssize_t sent;
+        do {
+            sent = sendmsg(fd, &msg, 0);
+        } while (sent < 0 && errno == EINTR);
+        if (sent < 0) {
+            last_error = errno;
+            continue;
+        }
+        sent_packets++;
+        bytes_sent += (uint64_t)sent;
+    }
+    packets_sent += (uint64_t)sent_packets;
+    return sent_packets;
+#endif
+}
+
+// RtpReceiver
+
+struct BMRtpReceiver {
+    RtpReceiver receiver;
+};
+
+RtpReceiver::RtpReceiver() {
+    memset(&stats, 0, sizeof(stats));
+    memset(&counters, 0, sizeof(counters));
+}
+
+RtpReceiver::~RtpReceiver() {
+    close();
+}
+
+bool RtpReceiver::open(const char* address, int port, int frame_width, int frame_height) {
+    if (fd >= 0 || port <= 0 || port > 65535 || frame_width <= 0 || frame_height <= 0 || (frame_width & 1) != 0) {
+        return false;
+    }
+
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = address != nullptr ? AF_UNSPEC : AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_PASSIVE;
+    struct addrinfo* result = nullptr;
+    int status = getaddrinfo(address, service, &hints, &result);
+    if (status != 0) {
+        log_error("Could not resolve RTP address %s: %s", address, gai_strerror(status));
+        return false;
+    }
+
+    int sock = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (sock < 0) {
+        freeaddrinfo(result);
+        return false;
+    }
+    int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    // A whole frame or more, so packets survive while the thread is descheduled
+    int buffer_size = 32 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+    bool bound = bind(sock, result->ai_addr, result->ai_addrlen) == 0;
+    if (bound && result->ai_family == AF_INET) {
+        const struct sockaddr_in* group = (const struct sockaddr_in*)result->ai_addr;
+        if (IN_MULTICAST(ntohl(group->sin_addr.s_addr))) {
+            struct ip_mreq request;
+            request.imr_multiaddr = group->sin_addr;
+            request.imr_interface.s_addr = htonl(INADDR_ANY);
+            bound = setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) == 0;
+        }
+    } else if (bound && result->ai_family == AF_INET6) {
+        const struct sockaddr_in6* group = (const struct sockaddr_in6*)result->ai_addr;
+        if (IN6_IS_ADDR_MULTICAST(&group->sin6_addr)) {
+            struct ipv6_mreq request;
+            request.ipv6mr_multiaddr = group->sin6_addr;
+            request.ipv6mr_interface = 0;
+            bound = setsockopt(sock, IPPROTO_IPV6, IPV6_JOIN_GROUP, &request, sizeof(request)) == 0;
+        }
+    }
+    freeaddrinfo(result);
+    if (!bound) {
+        log_error("Could not receive RTP on port %d (errno %d)", port, errno);
+        ::close(sock);
+        return false;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+    fcntl(sock, F_SETFD, FD_CLOEXEC);
+
+    width = frame_width;
+    height = frame_height;
+    row_bytes = (size_t)width * 2;
+    frame_size = row_bytes * height;
+    pool.reserve(kReadyFrames + 2, frame_size);
+
+    memset(&stats, 0, sizeof(stats));
+    memset(&counters, 0, sizeof(counters));
+    ready.clear();
+    stopping = false;
+    have_current = false;
+    have_timestamp = false;
+    have_sequence = false;
+    have_start = false;
+    jitter = 0.0;
+    fd = sock;
+
+    receiver = std::thread(&RtpReceiver::receiverLoop, this);
+    return true;
+}
+
+void RtpReceiver::close() {
+    if (fd < 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready_cv.notify_all();
+    if (receiver.joinable()) {
+        receiver.join();
+    }
+
+    ::close(fd);
+    fd = -1;
+    current.reset();
+    ready.clear();
+}
+
+int RtpReceiver::getFrame(uint8_t* buffer, size_t size, int timeout_ms, BMRtpFrameInfo* info) {
+    ReadyFrame frame;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto has_frame = [this] { return stopping || !ready.empty(); };
+        if (timeout_ms < 0) {
+            ready_cv.wait(lock, has_frame);
+        } else {
+            ready_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), has_frame);
+        }
+        if (ready.empty()) {
+            return 0;
+        }
+        frame = ready.front();
+        ready.pop_front();
+    }
+
+    if (buffer == nullptr || size < frame_size) {
+        return 0;
+    }
+    memcpy(buffer, frame.data.data(), frame_size);
+    if (info != nullptr) {
+        *info = frame.info;
+    }
+    return 1;
+}
+
+void RtpReceiver::getStats(BMRtpReceiverStats* out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    *out = stats;
+}
+
+void RtpReceiver::receiverLoop() {
+    std::vector<uint8_t> storage(kReceiveBatch * kReceiveBufferSize);
+
+#if defined(__linux__)
+    std::vector<struct iovec> iov(kReceiveBatch);
+    std::vector<struct mmsghdr> messages(kReceiveBatch);
+    for (size_t i = 0; i < kReceiveBatch; i++) {
+        iov[i].iov_base = &storage[i * kReceiveBufferSize];
+        iov[i].iov_len = kReceiveBufferSize;
+    }
+#endif
+
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                break;
+            }
+        }
+
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+
+        for (;;) {
+#if defined(__linux__)
+            memset(messages.data(), 0, messages.size() * sizeof(struct mmsghdr));
+            for (size_t i = 0; i < kReceiveBatch; i++) {
+                messages[i].msg_hdr.msg_iov = &iov[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+            int received = recvmmsg(fd, messages.data(), (unsigned int)kReceiveBatch, MSG_DONTWAIT, nullptr);
+            if (received <= 0) {
+                break;
+            }
+            int64_t arrival = steady_ns();
+            for (int i = 0; i < received; i++) {
+                if ((messages[i].msg_hdr.msg_flags & MSG_TRUNC) == 0) {
+                    handlePacket(&storage[i * kReceiveBufferSize], messages[i].msg_len, arrival);
+                }
+            }
+#else
+            ssize_t received = recv(fd, storage.data(), kReceiveBufferSize, MSG_DONTWAIT);
+            if (received <= 0) {
+                break;
+            }
+            handlePacket(storage.data(), (size_t)received, steady_ns());
+#endif
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t frames_dropped = stats.frames_dropped;
+        stats = counters;
+        stats.frames_dropped = frames_dropped;
+        stats.jitter_ms = jitter / 90.0;
+    }
+}
+
+void RtpReceiver::handlePacket(const uint8_t* packet, size_t length, int64_t arrival_ns) {
+    if (length < kHeaderSize || (packet[0] >> 6) != 2) {
+        return;
+    }
+
+    size_t position = 12 + 4 * (size_t)(packet[0] & 0x0f);
+    if (packet[0] & 0x10) {
+        // Header extension: skip it
+        if (position + 4 > length) {
+            return;
+        }
+        position += 4 + 4 * (size_t)get16(packet + position + 2);
+    }
+    if (packet[0] & 0x20) {
+        // RFC 3550 5.1: the last byte counts the padding, itself included
+        size_t padding = packet[length - 1];
+        if (padding == 0 || position > length || padding > length - position) {
+            return;
+        }
+        length -= padding;
+    }
+    if (position + 2 > length) {
+        return;
+    }
+
+    bool marker = (packet[1] & 0x80) != 0;
+    uint32_t timestamp = get32(packet + 4);
+    uint32_t sequence = (get16(packet + position) << 16) | get16(packet + 2);
+    position += 2;
+
+    counters.packets_received++;
+    counters.bytes_received += length;
+
+    if (have_timestamp && timestamp != current_timestamp) {
+        if ((int32_t)(timestamp - current_timestamp) < 0) {
+            counters.packets_reordered++;
+            return; // Belongs to a frame that is already finished
+        }
+        if (have_current) {
+            finishFrame(false);
+        }
+    } else if (have_timestamp && !have_current) {
+        counters.packets_reordered++;
+        return; // Late packet of the frame just finished
+    }
+
+    if (!have_current) {
+        current = pool.acquire(frame_size);
+        if (current.empty()) {
+            return;
+        }
+        have_current = true;
+        have_timestamp = true;
+        current_timestamp = timestamp;
+        current_bytes = 0;
+        current_lost = 0;
+
+        // RFC 3550 jitter, measured on the first packet of each frame
+        int64_t arrival = arrival_ns / 1000 * 9 / 100;
+        if (have_start) {
+            int64_t difference = (arrival - last_start_arrival) - (int32_t)(timestamp - last_start_timestamp);
+            jitter += (fabs((double)difference) - jitter) / 16.0;
+        }
+        have_start = true;
+        last_start_arrival = arrival;
+        last_start_timestamp = timestamp;
+    }
+
+    if (have_sequence) {
+        int32_t delta = (int32_t)(sequence - last_sequence);
+        if (delta > 0) {
+            counters.packets_lost += (uint64_t)(delta - 1);
+            current_lost += delta - 1;
+            last_sequence = sequence;
+        } else {
+            // Arrived after a later packet, so an earlier gap counted it as lost
+            counters.packets_reordered++;
+            if (counters.packets_lost > 0) {
+                counters.packets_lost--;
+            }
+            if (current_lost > 0) {
+                current_lost--;
+            }
+        }
+    } else {
+        have_sequence = true;
+        last_sequence = sequence;
+    }
+
+    // Line headers, then the data of each line run in the same order
+    size_t first_header = position;
+    size_t header_count = 0;
+    while (position + 6 <= length) {
+        header_count++;
+        bool more = (packet[position + 4] & 0x80) != 0;
+        position += 6;
+        if (!more) {
+            break;
+        }
+    }
+    for (size_t i = 0; i < header_count; i++) {
+        const uint8_t* header = packet + first_header + i * 6;
+        size_t run = get16(header);
+        size_t line = get16(header + 2) & 0x7fff;
+        size_t offset = (get16(header + 4) & 0x7fff) * 2;
+        if (position + run > length) {
+            break;
+        }
+        if (line < (size_t)height && offset + run <= row_bytes) {
+            memcpy(current.data() + line * row_bytes + offset, packet + position, run);
+            current_bytes += run;
+        }
+        position += run;
+    }
+
+    if (marker) {
+        finishFrame(true);
+    }
+}
+
+void RtpReceiver::finishFrame(bool marker) {
+    ReadyFrame frame;
+    frame.data = current;
+    frame.info.frame_number = ++counters.frames_received;
+    frame.info.rtp_timestamp = current_timestamp;
+    frame.info.packets_lost = current_lost;
+    frame.info.complete = marker && current_lost == 0 && current_bytes >= frame_size;
+    if (!frame.info.complete) {
+        counters.frames_incomplete++;
+    }
+    current.reset();
+    have_current = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ready.size() >= kReadyFrames) {
+            ready.pop_front();
+            stats.frames_dropped++;
+        }
+        ready.push_back(frame);
+    }
+    ready_cv.notify_one();
+}
+
+// C API
+
+BMRtpReceiver* bm_rtp_receiver_open(const char* address, int port, int width, int height) {
+    BMRtpReceiver* receiver = new BMRtpReceiver();
+    if (!receiver->receiver.open(address, port, width, height)) {
+        delete receiver;
+        return nullptr;
+    }
+    return receiver;
+}
+
+void bm_rtp_receiver_close(BMRtpReceiver* receiver) {
+    delete receiver;
+}
+
+bool bm_rtp_receiver_get_frame(BMRtpReceiver* receiver, uint8_t* buffer, size_t size,
+                               int timeout_ms, BMRtpFrameInfo* info) {
+    if (receiver == nullptr || buffer == nullptr || size < receiver->receiver.frameSize()) {
+        return false;
+    }
+    return receiver->receiver.getFrame(buffer, size, timeout_ms, info) == 1;
+}
+
+bool bm_rtp_receiver_get_stats(BMRtpReceiver* receiver, BMRtpReceiverStats* stats) {
+    if (receiver == nullptr || stats == nullptr) {
+        return false;
+    }
+    receiver->receiver.getStats(stats);
+    return true;
+}
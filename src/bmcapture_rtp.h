@@ -0,0 +1,149 @@
+#ifndef BMCAPTURE_RTP_H
+#define BMCAPTURE_RTP_H
+
+#include "bmcapture.h"
+#include "bmcapture_frame_pool.h"
+#include "bmcapture_frame_sink.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Sends captured 8-bit 4:2:2 frames as RFC 4175 RTP video (the ST 2110-20
+// packing of 2vuy is byte-identical to the capture buffer, so packets point
+// straight into it). Each packet carries one run of one line; runs are sized
+// so that a line splits into equal packets, which lets whole groups of packets
+// go to the kernel as a single UDP GSO send on Linux. A frame's packets are
+// spread across its frame interval instead of being sent as one burst.
+class RtpSender : public FrameSink {
+public:
+    RtpSender();
+    ~RtpSender();
+
+    // Resolve host, connect the socket and start the sender thread.
+    // format gives the frame size and rate used for packetization and pacing.
+    bool open(const char* host, int port, const BMRtpOptions& options, const FrameInfo& format);
+
+    // Stop after the frame being sent; queued frames are dropped
+    void close();
+
+    bool isOpen() const { return fd >= 0; }
+
+    void onFrame(const FrameData& data, const FrameInfo& info) override;
+
+    void getStats(BMRtpStats* stats) const;
+
+    RtpSender(const RtpSender&) = delete;
+    RtpSender& operator=(const RtpSender&) = delete;
+
+private:
+    struct QueuedFrame {
+        FrameData data;
+        FrameInfo info;
+    };
+
+    // The line run carried by one packet
+    struct Packet {
+        uint16_t line;
+        uint16_t offset;        // In pixels
+        uint16_t length;        // In bytes
+    };
+
+    void senderLoop();
+    void buildPacketLayout();
+    void sendFrame(const QueuedFrame& frame);
+    int sendBatch(const uint8_t* frame_data, size_t first, size_t count);
+    void writeHeader(uint8_t* header, const Packet& packet, bool last, uint32_t timestamp);
+
+    int fd = -1;
+    BMRtpOptions options;
+    FrameInfo format;
+    std::thread sender;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<QueuedFrame> queue;
+    bool stopping = false;
+
+    // Sender thread state
+    std::vector<Packet> packets;        // Layout of every frame
+    std::vector<uint8_t> headers;       // RTP and payload headers of the frame being sent
+    uint32_t sequence = 0;              // Extended RTP sequence number
+    uint32_t ssrc = 0;
+    bool gso = false;
+
+    std::atomic<uint64_t> frames_sent;
+    std::atomic<uint64_t> frames_dropped;
+    std::atomic<uint64_t> frames_late;
+    std::atomic<uint64_t> packets_sent;
+    std::atomic<uint64_t> bytes_sent;
+    std::atomic<int> last_error;
+    std::atomic<bool> gso_active;
+};
+
+// Receives RFC 4175 video sent by RtpSender (or any sender using the same
+// 8-bit 4:2:2 packing) and reassembles it into frames on its own thread.
+// Completed frames are queued for get_frame(); loss, reordering and the
+// frame arrival jitter are measured as packets come in.
+class RtpReceiver {
+public:
+    RtpReceiver();
+    ~RtpReceiver();
+
+    // Bind to address:port (joining the group for multicast addresses)
+    bool open(const char* address, int port, int width, int height);
+    void close();
+
+    // Wait for the next frame and copy it out; 1 on success, 0 on timeout
+    int getFrame(uint8_t* buffer, size_t size, int timeout_ms, BMRtpFrameInfo* info);
+
+    void getStats(BMRtpReceiverStats* stats) const;
+
+    size_t frameSize() const { return frame_size; }
+
+    RtpReceiver(const RtpReceiver&) = delete;
+    RtpReceiver& operator=(const RtpReceiver&) = delete;
+
+private:
+    struct ReadyFrame {
+        FrameData data;
+        BMRtpFrameInfo info;
+    };
+
+    void receiverLoop();
+    void handlePacket(const uint8_t* packet, size_t length, int64_t arrival_ns);
+    void finishFrame(bool marker);
+
+    int fd = -1;
+    int width = 0;
+    int height = 0;
+    size_t row_bytes = 0;
+    size_t frame_size = 0;
+    std::thread receiver;
+    FramePool pool;
+
+    mutable std::mutex mutex;
+    std::condition_variable ready_cv;
+    std::deque<ReadyFrame> ready;
+    bool stopping = false;
+    BMRtpReceiverStats stats;
+
+    // Receiver thread state; counters are published to stats once per batch
+    BMRtpReceiverStats counters;
+    FrameData current;                  // Frame being reassembled
+    bool have_current = false;
+    bool have_timestamp = false;
+    uint32_t current_timestamp = 0;     // Also the last finished frame while have_current is false
+    size_t current_bytes = 0;
+    int current_lost = 0;
+    bool have_sequence = false;
+    uint32_t last_sequence = 0;         // Highest extended sequence number seen
+    bool have_start = false;
+    int64_t last_start_arrival = 0;     // Arrival of the last frame's first packet, in 90 kHz units
+    uint32_t last_start_timestamp = 0;
+    double jitter = 0.0;                // RFC 3550 interarrival jitter, in 90 kHz units
+};
+
+#endif /* BMCAPTURE_RTP_H */
@@ -0,0 +1,452 @@
+#include "bmcapture_server.h"
+#include "bmcapture_log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // macOS uses SO_NOSIGPIPE on the socket instead
+#endif
+
+// Frames waiting for the server thread; older ones are dropped past this
+static const size_t kMaxQueuedFrames = 8;
+
+static void set_nonblocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+static void set_nosigpipe(int fd) {
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+    (void)fd;
+#endif
+}
+
+void bm_server_options_init(BMServerOptions* options) {
+    if (options == nullptr) {
+        return;
+    }
+    options->slot_count = 16;
+    options->max_clients = 8;
+    options->max_leases = 4;
+    options->lease_ms = 200;
+}
+
+FrameServer::FrameServer()
+    : frames_published(0), frames_unshared(0), frames_skipped(0),
+      leases_expired(0), clients_accepted(0), client_count(0) {
+    bm_server_options_init(&options);
+}
+
+FrameServer::~FrameServer() {
+    close();
+}
+
+bool FrameServer::open(const char* path, const BMServerOptions& server_options, const FrameInfo& stream_format) {
+    if (isOpen() || path == nullptr) {
+        return false;
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        log_error("Socket path too long: %s", path);
+        return false;
+    }
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+    options = server_options;
+    if (options.slot_count < 2) {
+        options.slot_count = 2;
+    }
+    if (options.max_clients < 1) {
+        options.max_clients = 1;
+    }
+    if (options.max_leases < 1) {
+        options.max_leases = 1;
+    }
+    if (options.lease_ms < 1) {
+        options.lease_ms = 1;
+    }
+    format = stream_format;
+
+    size_t frame_size = (size_t)format.row_bytes * format.height;
+    shared_arena.reset(SharedArena::create((size_t)options.slot_count, frame_size));
+    if (!shared_arena) {
+        log_error("Could not create shared frame memory (errno %d)", errno);
+        return false;
+    }
+
+    // Message boundaries come for free with SOCK_SEQPACKET; macOS only has SOCK_STREAM
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    }
+    if (fd < 0) {
+        log_error("Could not create server socket (errno %d)", errno);
+        shared_arena.reset();
+        return false;
+    }
+    set_nonblocking(fd);
+
+    // Replace a socket left behind by an earlier server, but never a regular file
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, options.max_clients) != 0) {
+        log_error("Could not listen on %s (errno %d)", path, errno);
+        ::close(fd);
+        shared_arena.reset();
+        return false;
+    }
+
+    if (pipe(wake_pipe) != 0) {
+        ::close(fd);
+        unlink(path);
+        shared_arena.reset();
+        return false;
+    }
+    set_nonblocking(wake_pipe[0]);
+    set_nonblocking(wake_pipe[1]);
+
+    socket_path = path;
+    listen_fd = fd;
+    stopping = false;
+    queue.clear();
+    frames_published = 0;
+    frames_unshared = 0;
+    frames_skipped = 0;
+    leases_expired = 0;
+    clients_accepted = 0;
+    client_count = 0;
+
+    thread = std::thread(&FrameServer::serverLoop, this);
+    return true;
+}
+
+void FrameServer::close() {
+    if (!isOpen()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+    wake();
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    for (Client& client : clients) {
+        ::close(client.fd);
+    }
+    clients.clear();
+    client_count = 0;
+
+    ::close(listen_fd);
+    listen_fd = -1;
+    unlink(socket_path.c_str());
+    ::close(wake_pipe[0]);
+    ::close(wake_pipe[1]);
+    wake_pipe[0] = wake_pipe[1] = -1;
+
+    // Pool buffers keep their own reference until they are released
+    shared_arena.reset();
+}
+
+void FrameServer::onFrame(const FrameData& data, const FrameInfo& info) {
+    if (data.empty()) {
+        return;
+    }
+    if (data.arena() != shared_arena.get()) {
+        // Every slot was busy, so this frame lives in memory subscribers cannot see
+        frames_unshared++;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            return;
+        }
+        if (queue.size() >= kMaxQueuedFrames) {
+            queue.pop_front();
+        }
+        QueuedFrame frame;
+        frame.data = data;
+        frame.info = info;
+        queue.push_back(frame);
+    }
+    wake();
+}
+
+void FrameServer::getStats(BMServerStats* stats) const {
+    stats->active = isOpen();
+    stats->clients = client_count;
+    stats->slots_in_use = shared_arena ? (int)shared_arena->slotsInUse() : 0;
+    stats->clients_accepted = clients_accepted;
+    stats->frames_published = frames_published;
+    stats->frames_unshared = frames_unshared;
+    stats->frames_skipped = frames_skipped;
+    stats->leases_expired = leases_expired;
+}
+
+void FrameServer::wake() {
+    char byte = 1;
+    // A full pipe already has a wakeup pending
+    ssize_t ignored = write(wake_pipe[1], &byte, 1);
+    (void)ignored;
+}
+
+void FrameServer::serverLoop() {
+    std::vector<struct pollfd> fds;
+
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                break;
+            }
+        }
+
+        int timeout = expireLeases();
+
+        fds.clear();
+        fds.push_back({wake_pipe[0], POLLIN, 0});
+        fds.push_back({listen_fd, POLLIN, 0});
+        for (const Client& client : clients) {
+            fds.push_back({client.fd, POLLIN, 0});
+        }
+
+        if (poll(fds.data(), (nfds_t)fds.size(), timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error("Frame server poll failed (errno %d)", errno);
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char buffer[64];
+            while (read(wake_pipe[0], buffer, sizeof(buffer)) > 0) {
+            }
+        }
+
+        // Releases first, so freed lease slots can take the new frames
+        for (size_t i = 0; i < clients.size(); i++) {
+            if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) {
+                if (!readReleases(clients[i])) {
+                    clients[i].dead = true;
+                }
+            }
+        }
+
+        std::deque<QueuedFrame> frames;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            frames.swap(queue);
+        }
+        for (const QueuedFrame& frame : frames) {
+            publish(frame);
+        }
+
+        removeDeadClients();
+
+        if (fds[1].revents & POLLIN) {
+            acceptClient();
+        }
+    }
+}
+
+void FrameServer::acceptClient() {
+    for (;;) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+        if ((int)clients.size() >= options.max_clients) {
+            ::close(fd);
+            continue;
+        }
+
+        set_nonblocking(fd);
+        set_nosigpipe(fd);
+        if (!sendHello(fd)) {
+            ::close(fd);
+            continue;
+        }
+
+        Client client;
+        client.fd = fd;
+        clients.push_back(std::move(client));
+        clients_accepted++;
+        client_count = (int)clients.size();
+    }
+}
+
+bool FrameServer::sendHello(int fd) {
+    uint8_t message[BM_SERVER_MESSAGE_SIZE];
+    memset(message, 0, sizeof(message));
+    BMServerHello* hello = reinterpret_cast<BMServerHello*>(message);
+    hello->type = BM_SERVER_HELLO;
+    hello->version = BM_SERVER_PROTOCOL_VERSION;
+    hello->slot_count = (uint32_t)shared_arena->slotCount();
+    hello->slot_size = shared_arena->slotSize();
+    hello->data_offset = shared_arena->dataOffset();
+    hello->width = (uint32_t)format.width;
+    hello->height = (uint32_t)format.height;
+    hello->row_bytes = (uint32_t)format.row_bytes;
+    hello->pixel_format = format.pixel_format;
+    hello->time_scale = format.time_scale;
+    hello->frame_duration = format.frame_duration;
+
+    struct iovec iov;
+    iov.iov_base = message;
+    iov.iov_len = sizeof(message);
+
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    int arena_fd = shared_arena->fd();
+    memcpy(CMSG_DATA(cmsg), &arena_fd, sizeof(int));
+
+    return sendmsg(fd, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(message);
+}
+
+void FrameServer::publish(const QueuedFrame& frame) {
+    int slot = frame.data.slot();
+    frames_published++;
+
+    uint8_t message[BM_SERVER_MESSAGE_SIZE];
+    memset(message, 0, sizeof(message));
+    BMServerFrame* announce = reinterpret_cast<BMServerFrame*>(message);
+    announce->type = BM_SERVER_FRAME;
+    announce->slot = (uint32_t)slot;
+    announce->generation = shared_arena->generation(slot);
+    announce->sequence = frame.info.sequence;
+    announce->stream_time = frame.info.stream_time;
+    announce->frame_duration = frame.info.frame_duration;
+    announce->hardware_timestamp = frame.info.hardware_timestamp;
+    announce->flags = frame.info.flags;
+    announce->size = (uint32_t)frame.data.size();
+
+    auto expires = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.lease_ms);
+
+    for (Client& client : clients) {
+        if (client.dead) {
+            continue;
+        }
+        if ((int)client.leases.size() >= options.max_leases) {
+            frames_skipped++;
+            continue;
+        }
+
+        ssize_t sent = send(client.fd, message, sizeof(message), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent == (ssize_t)sizeof(message)) {
+            Lease lease;
+            lease.data = frame.data;
+            lease.generation = announce->generation;
+            lease.expires = expires;
+            client.leases.push_back(lease);
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            frames_skipped++;
+        } else {
+            // Gone, or a partial message on a stream socket left it out of sync
+            client.dead = true;
+        }
+    }
+}
+
+bool FrameServer::readReleases(Client& client) {
+    for (;;) {
+        ssize_t received = recv(client.fd, client.pending + client.pending_length,
+                                sizeof(client.pending) - client.pending_length, MSG_DONTWAIT);
+        if (received == 0) {
+            return false;
+        }
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        client.pending_length += (size_t)received;
+        if (client.pending_length < sizeof(client.pending)) {
+            continue;
+        }
+        client.pending_length = 0;
+
+        const BMServerFrame* release = reinterpret_cast<const BMServerFrame*>(client.pending);
+        if (release->type != BM_SERVER_RELEASE) {
+            continue;
+        }
+        for (auto it = client.leases.begin(); it != client.leases.end(); ++it) {
+            if (it->data.slot() == (int)release->slot && it->generation == release->generation) {
+                client.leases.erase(it);
+                break;
+            }
+        }
+    }
+}
+
+int FrameServer::expireLeases() {
+    auto now = std::chrono::steady_clock::now();
+    bool have_next = false;
+    std::chrono::steady_clock::time_point next;
+
+    for (Client& client : clients) {
+        while (!client.leases.empty() && client.leases.front().expires <= now) {
+            client.leases.pop_front();
+            leases_expired++;
+        }
+        if (!client.leases.empty() && (!have_next || client.leases.front().expires < next)) {
+            next = client.leases.front().expires;
+            have_next = true;
+        }
+    }
+
+    if (!have_next) {
+        return -1;
+    }
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+    return (int)wait + 1;
+}
+
+void FrameServer::removeDeadClients() {
+    for (size_t i = clients.size(); i > 0; i--) {
+        if (clients[i - 1].dead) {
+            ::close(clients[i - 1].fd);
+            clients.erase(clients.begin() + (long)(i - 1));
+        }
+    }
+    client_count = (int)clients.size();
+}
@@ -0,0 +1,101 @@
+#ifndef BMCAPTURE_SERVER_H
+#define BMCAPTURE_SERVER_H
+
+#include "bmcapture.h"
+#include "bmcapture_arena.h"
+#include "bmcapture_frame_sink.h"
+#include "bmcapture_protocol.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Publishes a channel's frames to other local processes over a Unix socket.
+// The channel's frame pool allocates from a SharedArena, so frames are
+// captured straight into memory the subscribers have mapped; each subscriber
+// only receives small FRAME messages naming a slot. While a subscriber holds
+// a lease on a slot the server keeps a reference to the frame, which keeps
+// the pool from reusing it. Leases expire after lease_ms and each subscriber
+// may hold at most max_leases, so a slow or stuck client only loses frames;
+// capture falls back to private buffers if every slot is taken.
+class FrameServer : public FrameSink {
+public:
+    FrameServer();
+    ~FrameServer();
+
+    // Create the arena and start listening on socket_path; format gives the
+    // size, pixel format and rate announced to subscribers
+    bool open(const char* socket_path, const BMServerOptions& options, const FrameInfo& format);
+
+    // Disconnect all subscribers and remove the socket
+    void close();
+
+    bool isOpen() const { return listen_fd >= 0; }
+
+    std::shared_ptr<SharedArena> arena() const { return shared_arena; }
+
+    void onFrame(const FrameData& data, const FrameInfo& info) override;
+
+    void getStats(BMServerStats* stats) const;
+
+    FrameServer(const FrameServer&) = delete;
+    FrameServer& operator=(const FrameServer&) = delete;
+
+private:
+    struct Lease {
+        FrameData data;
+        uint64_t generation;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    struct Client {
+        int fd = -1;
+        bool dead = false;
+        std::deque<Lease> leases;   // Oldest first, so also ordered by expiry
+        uint8_t pending[BM_SERVER_MESSAGE_SIZE];    // Partially received message
+        size_t pending_length = 0;
+    };
+
+    struct QueuedFrame {
+        FrameData data;
+        FrameInfo info;
+    };
+
+    void serverLoop();
+    void acceptClient();
+    bool sendHello(int fd);
+    void publish(const QueuedFrame& frame);
+    bool readReleases(Client& client);
+    int expireLeases();
+    void removeDeadClients();
+    void wake();
+
+    int listen_fd = -1;
+    int wake_pipe[2] = {-1, -1};
+    std::string socket_path;
+    BMServerOptions options;
+    FrameInfo format;
+    std::shared_ptr<SharedArena> shared_arena;
+    std::thread thread;
+
+    // Shared with the capture callback
+    mutable std::mutex mutex;
+    std::deque<QueuedFrame> queue;
+    bool stopping = false;
+
+    // Server thread state
+    std::vector<Client> clients;
+
+    std::atomic<uint64_t> frames_published;
+    std::atomic<uint64_t> frames_unshared;
+    std::atomic<uint64_t> frames_skipped;
+    std::atomic<uint64_t> leases_expired;
+    std::atomic<uint64_t> clients_accepted;
+    std::atomic<int> client_count;
+};
+
+#endif /* BMCAPTURE_SERVER_H */
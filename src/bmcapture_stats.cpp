@@ -0,0 +1,175 @@
+#include "bmcapture_stats.h"
+#include <chrono>
+#include <math.h>
+
+LogHistogram::LogHistogram() {
+    reset();
+}
+
+int LogHistogram::bucketIndex(uint64_t value) {
+    const uint64_t sub_buckets = 1ULL << kSubBucketBits;
+    if (value < sub_buckets) {
+        return (int)value;
+    }
+    if (value >= (1ULL << kMaxExponent)) {
+        return kBucketCount - 1;
+    }
+
+    int exponent = 63;
+    while (!(value & (1ULL << exponent))) {
+        exponent--;
+    }
+    int shift = exponent - kSubBucketBits;
+    return ((shift + 1) << kSubBucketBits) + (int)((value >> shift) & (sub_buckets - 1));
+}
+
+// Largest value that falls into a bucket
+uint64_t LogHistogram::bucketHighest(int index) {
+    const int sub_buckets = 1 << kSubBucketBits;
+    if (index < sub_buckets) {
+        return (uint64_t)index;
+    }
+    int shift = (index >> kSubBucketBits) - 1;
+    uint64_t lowest = (uint64_t)(sub_buckets + (index & (sub_buckets - 1))) << shift;
+    return lowest + (1ULL << shift) - 1;
+}
+
+void LogHistogram::record(int64_t ns) {
+    if (ns < 0) {
+        ns = 0;
+    }
+    buckets[bucketIndex((uint64_t)ns)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    total_ns.fetch_add((uint64_t)ns, std::memory_order_relaxed);
+
+    int64_t current = min_ns.load(std::memory_order_relaxed);
+    while (ns < current && !min_ns.compare_exchange_weak(current, ns, std::memory_order_relaxed)) {
+    }
+    current = max_ns.load(std::memory_order_relaxed);
+    while (ns > current && !max_ns.compare_exchange_weak(current, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void LogHistogram::reset() {
+    for (int i = 0; i < kBucketCount; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    total_ns.store(0, std::memory_order_relaxed);
+    min_ns.store(INT64_MAX, std::memory_order_relaxed);
+    max_ns.store(0, std::memory_order_relaxed);
+}
+
+void LogHistogram::summarize(BMHistogramSummary* summary) const {
+    static const double kPercentiles[4] = {0.50, 0.90, 0.99, 0.999};
+    double* outputs[4] = {&summary->p50_us, &summary->p90_us, &summary->p99_us, &summary->p999_us};
+
+    // Take the buckets once so the percentiles agree with each other
+    uint64_t counts[kBucketCount];
+    uint64_t samples = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        samples += counts[i];
+    }
+
+    int64_t min_value = min_ns.load(std::memory_order_relaxed);
+    int64_t max_value = max_ns.load(std::memory_order_relaxed);
+    summary->count = samples;
+    summary->min_us = samples > 0 && min_value != INT64_MAX ? min_value / 1e3 : 0.0;
+    summary->max_us = samples > 0 ? max_value / 1e3 : 0.0;
+    uint64_t recorded = count.load(std::memory_order_relaxed);
+    summary->mean_us = recorded > 0 ? (double)total_ns.load(std::memory_order_relaxed) / recorded / 1e3 : 0.0;
+
+    int bucket = 0;
+    uint64_t seen = 0;
+    for (int p = 0; p < 4; p++) {
+        if (samples == 0) {
+            *outputs[p] = 0.0;
+            continue;
+        }
+        uint64_t rank = (uint64_t)ceil(kPercentiles[p] * (double)samples);
+        if (rank == 0) {
+            rank = 1;
+        }
+        while (bucket < kBucketCount - 1 && seen + counts[bucket] < rank) {
+            seen += counts[bucket++];
+        }
+        // Report the top of the bucket, but never more than was recorded
+        uint64_t value = bucketHighest(bucket);
+        if (value > (uint64_t)max_value) {
+            value = (uint64_t)max_value;
+        }
+        *outputs[p] = value / 1e3;
+    }
+}
+
+ChannelStats::ChannelStats() : perf_enabled(false) {
+    reset();
+}
+
+int64_t ChannelStats::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ChannelStats::reset() {
+    frames_missed.store(0, std::memory_order_relaxed);
+    frames_arrived.store(0, std::memory_order_relaxed);
+    frames_no_signal.store(0, std::memory_order_relaxed);
+    frames_dropped.store(0, std::memory_order_relaxed);
+    frames_overwritten.store(0, std::memory_order_relaxed);
+    frames_delivered.store(0, std::memory_order_relaxed);
+    lock_timeouts.store(0, std::memory_order_relaxed);
+    conversions.store(0, std::memory_order_relaxed);
+    driver_queue_depth.store(0, std::memory_order_relaxed);
+    driver_queue_max.store(0, std::memory_order_relaxed);
+    callback_time.reset();
+    conversion_time.reset();
+    delivery_latency.reset();
+    capture_latency.reset();
+    conversion_counters.reset();
+    copy_counters.reset();
+    reset_ns.store(now(), std::memory_order_relaxed);
+}
+
+void ChannelStats::read(BMChannelStats* stats) const {
+    stats->frames_missed = frames_missed.load(std::memory_order_relaxed);
+    stats->frames_arrived = frames_arrived.load(std::memory_order_relaxed);
+    stats->frames_no_signal = frames_no_signal.load(std::memory_order_relaxed);
+    stats->frames_dropped = frames_dropped.load(std::memory_order_relaxed);
+    stats->frames_overwritten = frames_overwritten.load(std::memory_order_relaxed);
+    stats->frames_delivered = frames_delivered.load(std::memory_order_relaxed);
+    stats->lock_timeouts = lock_timeouts.load(std::memory_order_relaxed);
+    stats->conversions = conversions.load(std::memory_order_relaxed);
+    stats->driver_queue_depth = driver_queue_depth.load(std::memory_order_relaxed);
+    stats->driver_queue_max = driver_queue_max.load(std::memory_order_relaxed);
+    stats->elapsed_seconds = (now() - reset_ns.load(std::memory_order_relaxed)) / 1e9;
+    callback_time.summarize(&stats->callback_time);
+    conversion_time.summarize(&stats->conversion_time);
+    delivery_latency.summarize(&stats->delivery_latency);
+    capture_latency.summarize(&stats->capture_latency);
+    conversion_counters.summarize(&stats->conversion_counters);
+    copy_counters.summarize(&stats->copy_counters);
+}
+
+void ChannelStats::recordStreamTime(int64_t stream_time, int64_t frame_duration) {
+    // Each frame advances stream time by one duration; anything more is frames
+    // the card or driver never delivered. Rounding absorbs the alternating
+    // durations of drop-frame rates. A jump backwards means the stream was
+    // restarted, so counting starts again from there.
+    if (has_stream_time && frame_duration > 0 && stream_time > last_stream_time) {
+        int64_t frames = (stream_time - last_stream_time + frame_duration / 2) / frame_duration;
+        if (frames > 1) {
+            frames_missed.fetch_add((uint64_t)(frames - 1), std::memory_order_relaxed);
+        }
+    }
+    has_stream_time = true;
+    last_stream_time = stream_time;
+}
+
+void ChannelStats::recordDriverQueue(uint64_t depth) {
+    driver_queue_depth.store(depth, std::memory_order_relaxed);
+    if (depth > driver_queue_max.load(std::memory_order_relaxed)) {
+        driver_queue_max.store(depth, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef BMCAPTURE_STATS_H
+#define BMCAPTURE_STATS_H
+
+#include "bmcapture.h"
+#include "bmcapture_perf.h"
+#include <atomic>
+#include <stdint.h>
+
+// Log-bucketed histogram of durations in nanoseconds, in the style of
+// HdrHistogram: every power of two is split into 16 linear sub-buckets, so a
+// value is reported to within 1/16 of itself from 1 ns up to about 18
+// minutes, in a fixed 4.6 KB of counters. Recording is a handful of relaxed
+// atomic operations and never blocks, so it is safe on the capture callback.
+// Reads and resets run alongside recording; a sample that races with them
+// may be seen half counted, which is acceptable for monitoring.
+class LogHistogram {
+public:
+    static const int kSubBucketBits = 4;
+    static const int kMaxExponent = 40;     // Values from 2^40 ns on share the last bucket
+    static const int kBucketCount = (kMaxExponent - kSubBucketBits + 1) << kSubBucketBits;
+
+    LogHistogram();
+
+    void record(int64_t ns);
+    void reset();
+    void summarize(BMHistogramSummary* summary) const;
+
+    LogHistogram(const LogHistogram&) = delete;
+    LogHistogram& operator=(const LogHistogram&) = delete;
+
+private:
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketHighest(int index);
+
+    std::atomic<uint64_t> buckets[kBucketCount];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total_ns;
+    std::atomic<int64_t> min_ns;
+    std::atomic<int64_t> max_ns;
+};
+
+// Pipeline counters and timings of one capture channel. The callback and
+// bm_get_channel_frame update them with relaxed atomics; nothing here orders
+// other memory, so readers get a consistent-enough snapshot, not an exact one.
+struct ChannelStats {
+    std::atomic<uint64_t> frames_missed;
+    std::atomic<uint64_t> frames_arrived;
+    std::atomic<uint64_t> frames_no_signal;
+    std::atomic<uint64_t> frames_dropped;
+    std::atomic<uint64_t> frames_overwritten;
+    std::atomic<uint64_t> frames_delivered;
+    std::atomic<uint64_t> lock_timeouts;
+    std::atomic<uint64_t> conversions;
+    std::atomic<uint64_t> driver_queue_depth;
+    std::atomic<uint64_t> driver_queue_max;    // Written only by the callback thread
+    std::atomic<int64_t> reset_ns;          // Steady clock time of the last reset
+
+    LogHistogram callback_time;
+    LogHistogram conversion_time;
+    LogHistogram delivery_latency;
+    LogHistogram capture_latency;
+
+    std::atomic<bool> perf_enabled;     // Measure the regions below; not cleared by reset
+    PerfRegionStats conversion_counters;
+    PerfRegionStats copy_counters;
+
+    ChannelStats();
+
+    static int64_t now();
+
+    static void count(std::atomic<uint64_t>& counter) {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void reset();
+    void read(BMChannelStats* stats) const;
+
+    // Count the frames missing between two consecutive stream times
+    void recordStreamTime(int64_t stream_time, int64_t frame_duration);
+
+    void recordDriverQueue(uint64_t depth);
+
+    ChannelStats(const ChannelStats&) = delete;
+    ChannelStats& operator=(const ChannelStats&) = delete;
+
+private:
+    // Callback thread only
+    bool has_stream_time = false;
+    int64_t last_stream_time = 0;
+};
+
+#endif /* BMCAPTURE_STATS_H */
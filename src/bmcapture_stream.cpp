@@ -0,0 +1,397 @@
+#include "bmcapture_stream.h"
+#include "bmcapture_log.h"
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static const char kY4MFrameHeader[] = "FRAME\n";
+
+// Pipes are grown to hold a whole frame when the system allows it
+static const int kDefaultPipeSize = 1 << 20;
+
+// Drop the first `count` bytes from an iovec array
+static void advance_iov(struct iovec*& iov, int& iov_count, size_t count) {
+    while (count > 0 && iov_count > 0) {
+        if (count >= iov->iov_len) {
+            count -= iov->iov_len;
+            iov++;
+            iov_count--;
+        } else {
+            iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + count;
+            iov->iov_len -= count;
+            count = 0;
+        }
+    }
+}
+
+void bm_stream_options_init(BMStreamOptions* options) {
+    if (options == nullptr) {
+        return;
+    }
+    options->format = BM_STREAM_Y4M;
+    options->overflow = BM_STREAM_DROP;
+    options->queue_depth = 4;
+    options->zero_copy = true;
+}
+
+FrameStreamer::FrameStreamer()
+    : active(false), frames_written(0), frames_dropped(0), bytes_written(0), max_write_ns(0),
+      blocked_ns(0), last_error(0), zero_copy(false) {
+    bm_stream_options_init(&options);
+}
+
+FrameStreamer::~FrameStreamer() {
+    close();
+}
+
+bool FrameStreamer::open(int output_fd, const BMStreamOptions& stream_options) {
+    if (isOpen() || output_fd < 0) {
+        return false;
+    }
+
+    options = stream_options;
+    if (options.queue_depth < 1) {
+        options.queue_depth = 1;
+    }
+
+    fd = dup(output_fd);
+    if (fd < 0) {
+        last_error = errno;
+        return false;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    struct stat st;
+    is_pipe = fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+
+    stopping = false;
+    failed = false;
+    header_written = false;
+    pipe_bytes = 0;
+    in_flight.clear();
+    queue_high_water = 0;
+    frames_written = 0;
+    frames_dropped = 0;
+    bytes_written = 0;
+    max_write_ns = 0;
+    blocked_ns = 0;
+    last_error = 0;
+    zero_copy = false;
+
+    active = true;
+    writer = std::thread(&FrameStreamer::writerLoop, this);
+    return true;
+}
+
+void FrameStreamer::close() {
+    if (!isOpen()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_one();
+    space_cv.notify_all();
+
+    if (writer.joinable()) {
+        writer.join();
+    }
+
+    ::close(fd);
+    fd = -1;
+    active = false;
+}
+
+void FrameStreamer::onFrame(const FrameData& data, const FrameInfo& info) {
+    if (data.empty()) {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        if (!stopping && (int)queue.size() >= options.queue_depth &&
+            options.overflow == BM_STREAM_BLOCK) {
+            // Backpressure: hold the capture thread until the reader catches up
+            auto start = std::chrono::steady_clock::now();
+            space_cv.wait(lock, [this] { return stopping || (int)queue.size() < options.queue_depth; });
+            blocked_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        }
+
+        if (stopping || (int)queue.size() >= options.queue_depth) {
+            frames_dropped++;
+            return;
+        }
+
+        QueuedFrame frame;
+        frame.data = data;
+        frame.info = info;
+        queue.push_back(frame);
+        if ((int)queue.size() > queue_high_water) {
+            queue_high_water = (int)queue.size();
+        }
+    }
+    queue_cv.notify_one();
+}
+
+void FrameStreamer::getStats(BMStreamStats* stats) const {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stats->queue_length = (int)queue.size();
+        stats->queue_high_water = queue_high_water;
+    }
+    stats->active = isOpen();
+    stats->zero_copy = zero_copy;
+    stats->frames_written = frames_written;
+    stats->frames_dropped = frames_dropped;
+    stats->bytes_written = bytes_written;
+    stats->max_write_ms = max_write_ns / 1e6;
+    stats->blocked_ms = blocked_ns / 1e6;
+    stats->last_error = last_error;
+}
+
+void FrameStreamer::writerLoop() {
+    // A reader that exits must not kill the process; the write fails with EPIPE instead
+    sigset_t sigpipe;
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, nullptr);
+
+    for (;;) {
+        QueuedFrame frame;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                break; // Stopping and fully drained
+            }
+            frame = queue.front();
+            queue.pop_front();
+        }
+        space_cv.notify_one();
+
+        if (failed) {
+            frames_dropped++;
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (!writeFrame(frame)) {
+            last_error = errno;
+            failed = true;
+            frames_dropped++;
+            if (last_error != EPIPE) {
+                log_error("Streaming output failed (errno %d)", (int)last_error);
+            }
+            continue;
+        }
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        if (elapsed > max_write_ns) {
+            max_write_ns = elapsed;
+        }
+        frames_written++;
+    }
+
+    // Keep spliced buffers alive until the reader has taken them
+    releaseConsumed(!failed);
+    in_flight.clear();
+}
+
+bool FrameStreamer::writeFrame(const QueuedFrame& frame) {
+    if (!header_written) {
+        if (!writeStreamHeader(frame.info)) {
+            return false;
+        }
+        header_written = true;
+    }
+
+    if (options.format == BM_STREAM_Y4M) {
+        FrameData planar = convertToPlanar(frame);
+        if (planar.empty()) {
+            errno = ENOMEM;
+            return false;
+        }
+        return writePayload(kY4MFrameHeader, sizeof(kY4MFrameHeader) - 1, planar, planar.size());
+    }
+
+    return writePayload(nullptr, 0, frame.data, frame.data.size());
+}
+
+bool FrameStreamer::writeStreamHeader(const FrameInfo& info) {
+#if defined(__linux__) && defined(F_SETPIPE_SZ)
+    if (is_pipe) {
+        // A pipe that holds a whole frame lets the reader take it in one go
+        int frame_bytes = (int)bm_align_up((size_t)info.width * info.height * 2 + sizeof(kY4MFrameHeader));
+        if (fcntl(fd, F_SETPIPE_SZ, frame_bytes) < 0) {
+            fcntl(fd, F_SETPIPE_SZ, kDefaultPipeSize);
+        }
+    }
+#endif
+
+    if (options.format != BM_STREAM_Y4M) {
+        return true;
+    }
+
+    char header[128];
+    int64_t rate_num = 30;
+    int64_t rate_den = 1;
+    if (info.time_scale > 0 && info.frame_duration > 0) {
+        rate_num = info.time_scale;
+        rate_den = info.frame_duration;
+    }
+    int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%lld:%lld Ip A1:1 C422 XCOLORRANGE=LIMITED\n",
+                          info.width, info.height, (long long)rate_num, (long long)rate_den);
+
+    const char* p = header;
+    while (length > 0) {
+        ssize_t written = write(fd, p, (size_t)length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += written;
+        length -= (int)written;
+        pipe_bytes += (uint64_t)written;
+        bytes_written += (uint64_t)written;
+    }
+    return true;
+}
+
+bool FrameStreamer::writePayload(const char* header, size_t header_length,
+                                 const FrameData& payload, size_t length) {
+    struct iovec iov_storage[2];
+    struct iovec* iov = iov_storage;
+    int iov_count = 0;
+    if (header_length > 0) {
+        iov[iov_count].iov_base = const_cast<char*>(header);
+        iov[iov_count].iov_len = header_length;
+        iov_count++;
+    }
+    iov[iov_count].iov_base = payload.data();
+    iov[iov_count].iov_len = length;
+    iov_count++;
+
+#if defined(__linux__)
+    if (is_pipe && options.zero_copy) {
+        while (iov_count > 0) {
+            ssize_t spliced = vmsplice(fd, iov, (unsigned long)iov_count, 0);
+            if (spliced < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if ((errno == EINVAL || errno == ENOSYS) && !zero_copy) {
+                    // Not supported here; fall back to copying writes
+                    options.zero_copy = false;
+                    break;
+                }
+                return false;
+            }
+            advance_iov(iov, iov_count, (size_t)spliced);
+            pipe_bytes += (uint64_t)spliced;
+            bytes_written += (uint64_t)spliced;
+            zero_copy = true;
+        }
+
+        if (iov_count == 0) {
+            InFlight entry;
+            entry.data = payload;
+            entry.end = pipe_bytes;
+            in_flight.push_back(entry);
+            releaseConsumed(false);
+            return true;
+        }
+    }
+#endif
+
+    zero_copy = false;
+    while (iov_count > 0) {
+        ssize_t written = writev(fd, iov, iov_count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        advance_iov(iov, iov_count, (size_t)written);
+        pipe_bytes += (uint64_t)written;
+        bytes_written += (uint64_t)written;
+    }
+    return true;
+}
+
+void FrameStreamer::releaseConsumed(bool drain) {
+    if (in_flight.empty()) {
+        return;
+    }
+
+    // Whatever is no longer in the pipe has been read
+    for (int attempt = 0; ; attempt++) {
+        int unread = 0;
+        if (ioctl(fd, FIONREAD, &unread) != 0) {
+            in_flight.clear();
+            return;
+        }
+        uint64_t consumed = pipe_bytes - (uint64_t)unread;
+        while (!in_flight.empty() && in_flight.front().end <= consumed) {
+            in_flight.pop_front();
+        }
+
+        // On close, give the reader up to a second to finish the spliced data
+        if (!drain || in_flight.empty() || attempt >= 100) {
+            return;
+        }
+        usleep(10000);
+    }
+}
+
+FrameData FrameStreamer::convertToPlanar(const QueuedFrame& frame) {
+    int width = frame.info.width;
+    int height = frame.info.height;
+    long row_bytes = frame.info.row_bytes > 0 ? frame.info.row_bytes : (long)width * 2;
+    size_t luma_size = (size_t)width * height;
+    size_t chroma_size = luma_size / 2;
+
+    if ((size_t)row_bytes * height > frame.data.size() || (width & 1) != 0) {
+        return FrameData();
+    }
+
+    FrameData planar = planar_pool.acquire(luma_size + chroma_size * 2);
+    if (planar.empty()) {
+        return planar;
+    }
+
+    uint8_t* y_plane = planar.data();
+    uint8_t* u_plane = y_plane + luma_size;
+    uint8_t* v_plane = u_plane + chroma_size;
+    int half_width = width / 2;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* src = frame.data.data() + (size_t)y * row_bytes;
+        uint8_t* y_row = y_plane + (size_t)y * width;
+        uint8_t* u_row = u_plane + (size_t)y * half_width;
+        uint8_t* v_row = v_plane + (size_t)y * half_width;
+        for (int x = 0; x < half_width; x++) {
+            u_row[x] = src[0];
+            y_row[2 * x] = src[1];
+            v_row[x] = src[2];
+            y_row[2 * x + 1] = src[3];
+            src += 4;
+        }
+    }
+
+    return planar;
+}
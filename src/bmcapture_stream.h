@@ -0,0 +1,88 @@
+#ifndef BMCAPTURE_STREAM_H
+#define BMCAPTURE_STREAM_H
+
+#include "bmcapture.h"
+#include "bmcapture_frame_pool.h"
+#include "bmcapture_frame_sink.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Streams captured frames to a file descriptor from a dedicated thread.
+// Raw frames are written straight from the pooled capture buffers; Y4M frames
+// are converted to planar 4:2:2 on the writer thread into buffers from the
+// streamer's own pool. When the descriptor is a pipe the payload is vmspliced
+// rather than copied, and each buffer stays referenced until the reader has
+// consumed it, so the pool cannot recycle memory the pipe still points at.
+class FrameStreamer : public FrameSink {
+public:
+    FrameStreamer();
+    ~FrameStreamer();
+
+    // Duplicate fd and start the writer thread
+    bool open(int fd, const BMStreamOptions& options);
+
+    // Write out everything still queued, then close the descriptor.
+    // Also releases a callback blocked by BM_STREAM_BLOCK.
+    void close();
+
+    bool isOpen() const { return active; }
+
+    void onFrame(const FrameData& data, const FrameInfo& info) override;
+
+    void getStats(BMStreamStats* stats) const;
+
+    FrameStreamer(const FrameStreamer&) = delete;
+    FrameStreamer& operator=(const FrameStreamer&) = delete;
+
+private:
+    struct QueuedFrame {
+        FrameData data;
+        FrameInfo info;
+    };
+
+    // Payload the pipe may still reference, with the stream offset it ends at
+    struct InFlight {
+        FrameData data;
+        uint64_t end;
+    };
+
+    void writerLoop();
+    bool writeFrame(const QueuedFrame& frame);
+    bool writeStreamHeader(const FrameInfo& info);
+    bool writePayload(const char* header, size_t header_length, const FrameData& payload, size_t length);
+    FrameData convertToPlanar(const QueuedFrame& frame);
+    void releaseConsumed(bool drain);
+
+    int fd = -1;
+    std::atomic<bool> active;           // From a successful open() until close(); safe from any thread
+    BMStreamOptions options;
+    std::thread writer;
+    FramePool planar_pool;
+
+    mutable std::mutex queue_mutex;
+    std::condition_variable queue_cv;   // Signals the writer
+    std::condition_variable space_cv;   // Signals callbacks blocked on a full queue
+    std::deque<QueuedFrame> queue;
+    bool stopping = false;
+    int queue_high_water = 0;
+
+    // Writer thread state
+    bool is_pipe = false;
+    bool header_written = false;
+    bool failed = false;
+    uint64_t pipe_bytes = 0;            // Bytes put into the pipe so far
+    std::deque<InFlight> in_flight;
+
+    std::atomic<uint64_t> frames_written;
+    std::atomic<uint64_t> frames_dropped;
+    std::atomic<uint64_t> bytes_written;
+    std::atomic<int64_t> max_write_ns;
+    std::atomic<int64_t> blocked_ns;
+    std::atomic<int> last_error;
+    std::atomic<bool> zero_copy;
+};
+
+#endif /* BMCAPTURE_STREAM_H */
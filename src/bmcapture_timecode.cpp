@@ -0,0 +1,97 @@
+#include "bmcapture_timecode.h"
+#include <stdio.h>
+#include <string.h>
+
+const BMDTimecodeFormat kTimecodeFormats[BM_TIMECODE_SOURCE_COUNT] = {
+    bmdTimecodeRP188VITC1,
+    bmdTimecodeRP188LTC,
+    bmdTimecodeRP188VITC2,
+    bmdTimecodeVITC,
+    bmdTimecodeVITCField2,
+};
+
+static uint8_t from_bcd(uint32_t value) {
+    return (uint8_t)(((value >> 4) & 0xF) * 10 + (value & 0xF));
+}
+
+static uint32_t to_bcd(int value) {
+    return (uint32_t)(((value / 10) << 4) | (value % 10));
+}
+
+void timecode_read_frame(IDeckLinkVideoFrame* frame, BMTimecode* timecodes, BMTimecode* best) {
+    memset(best, 0, sizeof(*best));
+    for (int source = 0; source < BM_TIMECODE_SOURCE_COUNT; source++) {
+        BMTimecode& out = timecodes[source];
+        memset(&out, 0, sizeof(out));
+
+        IDeckLinkTimecode* timecode = nullptr;
+        if (frame->GetTimecode(kTimecodeFormats[source], &timecode) != S_OK || timecode == nullptr) {
+            continue;
+        }
+        uint8_t hours = 0, minutes = 0, seconds = 0, frames = 0;
+        if (timecode->GetComponents(&hours, &minutes, &seconds, &frames) == S_OK) {
+            BMDTimecodeUserBits user_bits = 0;
+            timecode->GetTimecodeUserBits(&user_bits);
+            out.valid = true;
+            out.drop_frame = (timecode->GetFlags() & bmdTimecodeIsDropFrame) != 0;
+            out.hours = hours;
+            out.minutes = minutes;
+            out.seconds = seconds;
+            out.frames = frames;
+            out.source = (uint8_t)source;
+            out.bcd = timecode->GetBCD();
+            out.user_bits = user_bits;
+            if (!best->valid) {
+                *best = out;
+            }
+        }
+        timecode->Release();
+    }
+}
+
+BMTimecode timecode_from_bcd(uint32_t bcd, uint32_t user_bits, bool drop_frame, int source) {
+    BMTimecode timecode;
+    timecode.valid = true;
+    timecode.drop_frame = drop_frame;
+    timecode.hours = from_bcd(bcd >> 24);
+    timecode.minutes = from_bcd(bcd >> 16);
+    timecode.seconds = from_bcd(bcd >> 8);
+    timecode.frames = from_bcd(bcd);
+    timecode.source = (uint8_t)source;
+    timecode.bcd = bcd;
+    timecode.user_bits = user_bits;
+    return timecode;
+}
+
+BMTimecode timecode_from_frame_number(int64_t frame_number, int fps, bool drop_frame, int source) {
+    if (drop_frame) {
+        // Add back the frame numbers skipped at the start of each minute
+        int64_t dropped = fps / 15;                     // 2 at 30 fps, 4 at 60 fps
+        int64_t per_ten_minutes = fps * 600 - dropped * 9;
+        int64_t per_minute = fps * 60 - dropped;
+        int64_t tens = frame_number / per_ten_minutes;
+        int64_t rest = frame_number % per_ten_minutes;
+        frame_number += dropped * 9 * tens;
+        if (rest >= dropped) {
+            frame_number += dropped * ((rest - dropped) / per_minute);
+        }
+    }
+
+    int64_t total_seconds = frame_number / fps;
+    int hours = (int)((total_seconds / 3600) % 24);
+    int minutes = (int)((total_seconds / 60) % 60);
+    int seconds = (int)(total_seconds % 60);
+    int frames = (int)(frame_number % fps);
+    uint32_t bcd = (to_bcd(hours) << 24) | (to_bcd(minutes) << 16) | (to_bcd(seconds) << 8) | to_bcd(frames);
+    return timecode_from_bcd(bcd, 0, drop_frame, source);
+}
+
+bool bm_timecode_format(const BMTimecode* timecode, char* buffer, size_t size) {
+    if (timecode == nullptr || buffer == nullptr || !timecode->valid) {
+        return false;
+    }
+    int written = snprintf(buffer, size, "%02u:%02u:%02u%c%02u",
+                           timecode->hours, timecode->minutes, timecode->seconds,
+                           timecode->drop_frame ? ';' : ':', timecode->frames);
+    return written > 0 && (size_t)written < size;
+}
@@ -0,0 +1,23 @@
+#ifndef BMCAPTURE_TIMECODE_H
+#define BMCAPTURE_TIMECODE_H
+
+#include "bmcapture.h"
+#include "DeckLinkAPI.h"
+
+// Timecode formats to ask the driver for, indexed by BMTimecodeSource
+extern const BMDTimecodeFormat kTimecodeFormats[BM_TIMECODE_SOURCE_COUNT];
+
+// Read every timecode a frame carries into `timecodes` and pick the preferred
+// one into `best`. Runs in the capture callback: it only calls the numeric
+// IDeckLinkTimecode getters, never GetString, and allocates nothing itself.
+void timecode_read_frame(IDeckLinkVideoFrame* frame, BMTimecode* timecodes, BMTimecode* best);
+
+// Build a timecode from its BCD form, as stored in the container index
+BMTimecode timecode_from_bcd(uint32_t bcd, uint32_t user_bits, bool drop_frame, int source);
+
+// The timecode of the frame_number-th frame of a count starting at 00:00:00:00,
+// at a nominal rate of `fps` whole frames per second. Drop-frame counting
+// skips frames 0 and 1 (0 to 3 at 60 fps) of every minute not divisible by 10.
+BMTimecode timecode_from_frame_number(int64_t frame_number, int fps, bool drop_frame, int source);
+
+#endif /* BMCAPTURE_TIMECODE_H */
@@ -0,0 +1,386 @@
+#include "bmcapture_trace.h"
+#include "bmcapture_log.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+std::atomic<bool> g_trace_enabled(false);
+
+static const char* const kTraceNames[TRACE_NAME_COUNT] = {
+    "callback",
+    "frame copy",
+    "sinks",
+    "swap back",
+    "swap front",
+    "lock wait",
+    "convert rgb",
+    "convert gray",
+    "copy out",
+    "disk write",
+    "encode",
+    "audio"
+};
+
+static const size_t kDefaultEventsPerThread = 1 << 16;
+
+struct TraceRing {
+    std::vector<TraceEvent> events;     // Power-of-two capacity
+    uint64_t mask = 0;
+    std::atomic<uint64_t> head;         // Events ever written; the writer's release publishes them
+    uint64_t flushed = 0;               // Events already written out, guarded by g_rings_mutex
+    uint64_t generation = 0;
+    uint32_t id = 0;
+    char name[32];                      // Set once by the owning thread under g_rings_mutex
+
+    TraceRing() : head(0) {
+        name[0] = '\0';
+    }
+};
+
+static std::mutex g_rings_mutex;
+static std::vector<std::shared_ptr<TraceRing>> g_rings;
+static size_t g_ring_capacity = kDefaultEventsPerThread;
+static uint32_t g_next_ring_id = 1;
+static std::atomic<uint64_t> g_generation(0);
+
+// The thread's ring; the registry keeps it alive after the thread exits so
+// its events can still be written out
+static thread_local std::shared_ptr<TraceRing> t_ring;
+
+int64_t trace_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Give the calling thread a ring for the current trace session
+static TraceRing* attach_ring() {
+    std::lock_guard<std::mutex> lock(g_rings_mutex);
+    std::shared_ptr<TraceRing> ring = std::make_shared<TraceRing>();
+    ring->events.resize(g_ring_capacity);
+    ring->mask = g_ring_capacity - 1;
+    ring->generation = g_generation.load(std::memory_order_relaxed);
+    ring->id = g_next_ring_id++;
+    g_rings.push_back(ring);
+    t_ring = ring;
+    return ring.get();
+}
+
+static TraceRing* current_ring() {
+    TraceRing* ring = t_ring.get();
+    if (ring == nullptr || ring->generation != g_generation.load(std::memory_order_relaxed)) {
+        ring = attach_ring();
+    }
+    return ring;
+}
+
+void trace_record(TraceName name, int64_t start_ns, int64_t end_ns, uint64_t arg) {
+    if (!trace_enabled()) {
+        return;
+    }
+    TraceRing* ring = current_ring();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    TraceEvent& event = ring->events[head & ring->mask];
+    event.start_ns = start_ns;
+    event.duration_ns = end_ns - start_ns;
+    event.arg = arg;
+    event.name = name;
+    event.reserved = 0;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void trace_name_thread(const char* name) {
+    if (!trace_enabled()) {
+        return;
+    }
+    TraceRing* ring = current_ring();
+    if (ring->name[0] == '\0') {
+        std::lock_guard<std::mutex> lock(g_rings_mutex);
+        snprintf(ring->name, sizeof(ring->name), "%s", name);
+    }
+}
+
+bool bm_trace_start(size_t events_per_thread) {
+    size_t capacity = events_per_thread > 0 ? events_per_thread : kDefaultEventsPerThread;
+    if (capacity > (1u << 24)) {
+        log_error("Trace rings are limited to %u events per thread", 1u << 24);
+        return false;
+    }
+    size_t rounded = 1;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+
+    std::lock_guard<std::mutex> lock(g_rings_mutex);
+    // Threads notice the new generation and attach fresh rings on their next event
+    g_rings.clear();
+    g_ring_capacity = rounded;
+    g_next_ring_id = 1;
+    g_generation.fetch_add(1, std::memory_order_relaxed);
+    g_trace_enabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void bm_trace_stop(void) {
+    g_trace_enabled.store(false, std::memory_order_relaxed);
+}
+
+namespace {
+
+struct ThreadEvents {
+    uint32_t id;
+    std::string name;
+    std::vector<TraceEvent> events;
+};
+
+// Minimal protobuf encoder for the Perfetto trace format
+class ProtoWriter {
+public:
+    std::string bytes;
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            bytes.push_back((char)(value | 0x80));
+            value >>= 7;
+        }
+        bytes.push_back((char)value);
+    }
+
+    void tag(int field, int wire_type) {
+        varint(((uint64_t)field << 3) | (uint64_t)wire_type);
+    }
+
+    void uint(int field, uint64_t value) {
+        tag(field, 0);
+        varint(value);
+    }
+
+    void string(int field, const std::string& value) {
+        tag(field, 2);
+        varint(value.size());
+        bytes += value;
+    }
+
+    void message(int field, const ProtoWriter& nested) {
+        string(field, nested.bytes);
+    }
+};
+
+// Perfetto field numbers (protos/perfetto/trace)
+enum {
+    kTracePacket = 1,
+    kPacketTimestamp = 8,
+    kPacketSequenceId = 10,
+    kPacketTrackEvent = 11,
+    kPacketSequenceFlags = 13,
+    kPacketTrackDescriptor = 60,
+    kTrackUuid = 1,
+    kTrackProcess = 3,
+    kTrackThread = 4,
+    kProcessPid = 1,
+    kProcessName = 6,
+    kThreadPid = 1,
+    kThreadTid = 2,
+    kThreadName = 5,
+    kEventDebugAnnotations = 4,
+    kEventType = 9,
+    kEventTrackUuid = 11,
+    kEventName = 23,
+    kAnnotationIntValue = 4,
+    kAnnotationName = 10,
+    kSliceBegin = 1,
+    kSliceEnd = 2,
+    kSequenceId = 1,
+    kIncrementalStateCleared = 1
+};
+
+bool write_chrome_json(FILE* file, const std::vector<ThreadEvents>& threads, int64_t origin) {
+    int pid = (int)getpid();
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"bmcapture\"}}", pid);
+    for (const ThreadEvents& thread : threads) {
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                pid, thread.id, thread.name.c_str());
+        for (const TraceEvent& event : thread.events) {
+            int64_t start = event.start_ns - origin;
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"bmcapture\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+                          "\"ts\":%lld.%03lld,\"dur\":%lld.%03lld,\"args\":{\"frame\":%llu}}",
+                    kTraceNames[event.name], pid, thread.id,
+                    (long long)(start / 1000), (long long)(start % 1000),
+                    (long long)(event.duration_ns / 1000), (long long)(event.duration_ns % 1000),
+                    (unsigned long long)event.arg);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return ferror(file) == 0;
+}
+
+struct SliceMarker {
+    int64_t ns;
+    bool end;
+    const TraceEvent* event;
+
+    bool operator<(const SliceMarker& other) const {
+        if (ns != other.ns) {
+            return ns < other.ns;
+        }
+        if (end != other.end) {
+            return end;
+        }
+        // Among begins the longer slice is the parent; among ends the later-starting one is the child
+        if (!end) {
+            return event->duration_ns > other.event->duration_ns;
+        }
+        return event->start_ns > other.event->start_ns;
+    }
+};
+
+bool write_perfetto(FILE* file, const std::vector<ThreadEvents>& threads, int64_t origin) {
+    int pid = (int)getpid();
+    const uint64_t process_uuid = 1;
+    bool first = true;
+
+    auto emit = [&](ProtoWriter& packet) {
+        packet.uint(kPacketSequenceId, kSequenceId);
+        if (first) {
+            packet.uint(kPacketSequenceFlags, kIncrementalStateCleared);
+            first = false;
+        }
+        ProtoWriter trace;
+        trace.message(kTracePacket, packet);
+        return fwrite(trace.bytes.data(), 1, trace.bytes.size(), file) == trace.bytes.size();
+    };
+
+    ProtoWriter process;
+    process.uint(kProcessPid, (uint64_t)pid);
+    process.string(kProcessName, "bmcapture");
+    ProtoWriter process_track;
+    process_track.uint(kTrackUuid, process_uuid);
+    process_track.message(kTrackProcess, process);
+    ProtoWriter packet;
+    packet.message(kPacketTrackDescriptor, process_track);
+    if (!emit(packet)) {
+        return false;
+    }
+
+    for (const ThreadEvents& thread : threads) {
+        uint64_t track_uuid = process_uuid + thread.id;
+        ProtoWriter descriptor;
+        descriptor.uint(kThreadPid, (uint64_t)pid);
+        descriptor.uint(kThreadTid, thread.id);
+        descriptor.string(kThreadName, thread.name);
+        ProtoWriter track;
+        track.uint(kTrackUuid, track_uuid);
+        track.message(kTrackThread, descriptor);
+        ProtoWriter track_packet;
+        track_packet.message(kPacketTrackDescriptor, track);
+        if (!emit(track_packet)) {
+            return false;
+        }
+
+        // Begin and end markers must nest on a track, so emit them in time
+        // order: ends before begins at the same instant, outer slices opened
+        // first and closed last
+        std::vector<SliceMarker> markers;
+        markers.reserve(thread.events.size() * 2);
+        for (const TraceEvent& event : thread.events) {
+            markers.push_back({event.start_ns, false, &event});
+            markers.push_back({event.start_ns + event.duration_ns, true, &event});
+        }
+        std::stable_sort(markers.begin(), markers.end());
+
+        for (const SliceMarker& marker : markers) {
+            ProtoWriter track_event;
+            if (marker.end) {
+                track_event.uint(kEventType, kSliceEnd);
+                track_event.uint(kEventTrackUuid, track_uuid);
+            } else {
+                ProtoWriter annotation;
+                annotation.string(kAnnotationName, "frame");
+                annotation.uint(kAnnotationIntValue, marker.event->arg);
+                track_event.uint(kEventType, kSliceBegin);
+                track_event.uint(kEventTrackUuid, track_uuid);
+                track_event.string(kEventName, kTraceNames[marker.event->name]);
+                track_event.message(kEventDebugAnnotations, annotation);
+            }
+            ProtoWriter event_packet;
+            event_packet.uint(kPacketTimestamp, (uint64_t)(marker.ns - origin));
+            event_packet.message(kPacketTrackEvent, track_event);
+            if (!emit(event_packet)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int64_t bm_trace_write(const char* path, BMTraceFormat format) {
+    if (path == nullptr) {
+        return -1;
+    }
+
+    // Copy out everything recorded since the last write. A writer may be
+    // overwriting the oldest slots while they are copied, so anything the
+    // head has moved past by the end of the copy is thrown away.
+    std::vector<ThreadEvents> threads;
+    int64_t origin = INT64_MAX;
+    size_t total = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_rings_mutex);
+        for (const std::shared_ptr<TraceRing>& ring : g_rings) {
+            uint64_t capacity = ring->mask + 1;
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t first = std::max(ring->flushed, head > capacity ? head - capacity : 0);
+
+            ThreadEvents thread;
+            thread.id = ring->id;
+            thread.name = ring->name[0] != '\0' ? ring->name : "thread " + std::to_string(ring->id);
+            for (uint64_t i = first; i < head; i++) {
+                thread.events.push_back(ring->events[i & ring->mask]);
+            }
+
+            // The writer may already be filling slot `after`, which aliases index after - capacity
+            uint64_t after = ring->head.load(std::memory_order_acquire);
+            if (after >= capacity && after - capacity >= first) {
+                size_t lost = (size_t)std::min<uint64_t>(after - capacity + 1 - first, thread.events.size());
+                thread.events.erase(thread.events.begin(), thread.events.begin() + lost);
+            }
+            ring->flushed = head;
+
+            total += thread.events.size();
+            threads.push_back(std::move(thread));
+        }
+    }
+
+    // Spans are recorded when they end, so nested ones come first
+    for (ThreadEvents& thread : threads) {
+        std::stable_sort(thread.events.begin(), thread.events.end(),
+                         [](const TraceEvent& a, const TraceEvent& b) { return a.start_ns < b.start_ns; });
+        if (!thread.events.empty()) {
+            origin = std::min(origin, thread.events.front().start_ns);
+        }
+    }
+    if (origin == INT64_MAX) {
+        origin = 0;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        log_error("Cannot create trace file %s", path);
+        return -1;
+    }
+    bool ok = format == BM_TRACE_PERFETTO ? write_perfetto(file, threads, origin)
+                                          : write_chrome_json(file, threads, origin);
+    if (fclose(file) != 0 || !ok) {
+        log_error("Failed to write trace file %s", path);
+        return -1;
+    }
+    return (int64_t)total;
+}
@@ -0,0 +1,78 @@
+#ifndef BMCAPTURE_TRACE_H
+#define BMCAPTURE_TRACE_H
+
+#include "bmcapture.h"
+#include <atomic>
+#include <stdint.h>
+
+// Opt-in timeline tracing of the capture pipeline.
+//
+// Every thread that records a span gets its own ring of fixed-size events,
+// written without locks: the thread is the only writer and publishes each
+// event by bumping the ring's head. When a ring wraps, the oldest events are
+// overwritten. bm_trace_write() copies what the rings hold and converts it to
+// Chrome trace JSON or Perfetto protobuf. With tracing off a span costs one
+// relaxed load and a branch.
+
+enum TraceName : uint32_t {
+    TRACE_CALLBACK,         // Whole capture callback
+    TRACE_FRAME_COPY,       // Copy of the card's frame into the frame pool
+    TRACE_SINKS,            // Hand-off to recorders, streams and other sinks
+    TRACE_SWAP_BACK,        // Publishing the frame to the triple buffer
+    TRACE_SWAP_FRONT,       // bm_update_channel taking the newest frame
+    TRACE_LOCK_WAIT,        // bm_get_channel_frame waiting for the frame lock
+    TRACE_CONVERT_RGB,
+    TRACE_CONVERT_GRAY,
+    TRACE_COPY_OUT,         // Copy into the caller's buffer
+    TRACE_DISK_WRITE,       // Recorder writing one frame
+    TRACE_ENCODE,           // Recorder compressing one frame
+    TRACE_AUDIO,            // Storing an audio packet in the channel's ring
+    TRACE_NAME_COUNT
+};
+
+struct TraceEvent {
+    int64_t start_ns;       // steady_clock
+    int64_t duration_ns;
+    uint64_t arg;           // Frame sequence number where there is one
+    uint32_t name;          // TraceName
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TraceEvent) == 32, "trace events must stay 32 bytes");
+
+extern std::atomic<bool> g_trace_enabled;
+
+static inline bool trace_enabled() {
+    return g_trace_enabled.load(std::memory_order_relaxed);
+}
+
+int64_t trace_now();
+void trace_record(TraceName name, int64_t start_ns, int64_t end_ns, uint64_t arg);
+
+// Name the calling thread's track in the trace, if tracing and not yet named
+void trace_name_thread(const char* name);
+
+// Records the time between construction and destruction as one event
+class TraceSpan {
+public:
+    explicit TraceSpan(TraceName span_name, uint64_t span_arg = 0)
+        : name(span_name), arg(span_arg), start(trace_enabled() ? trace_now() : 0) {}
+
+    ~TraceSpan() {
+        if (start != 0) {
+            trace_record(name, start, trace_now(), arg);
+        }
+    }
+
+    void setArg(uint64_t value) { arg = value; }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    TraceName name;
+    uint64_t arg;
+    int64_t start;
+};
+
+#endif /* BMCAPTURE_TRACE_H */